@@ -42,6 +42,7 @@
 #include "lsst/jointcal/CcdImage.h"
 #include "lsst/jointcal/Point.h"
 #include "lsst/jointcal/JointcalControl.h"
+#include "lsst/jointcal/PhaseTimer.h"
 
 #include "lsst/afw/table/SortedCatalog.h"
 
@@ -191,6 +192,9 @@ public:
      */
     size_t nFittedStarsWithAssociatedRefStar() const;
 
+    /// Resources used so far by associateCatalogs(), collectRefStars() and prepareFittedStars().
+    AssociationsTimings const &getTimings() const { return _timings; }
+
 private:
     void associateRefStars(double matchCutInArcsec, const AstrometryTransform *transform);
 
@@ -212,6 +216,7 @@ private:
     void normalizeFittedStars() const;
 
     Point _commonTangentPoint;
+    AssociationsTimings _timings;
 };
 
 }  // namespace jointcal
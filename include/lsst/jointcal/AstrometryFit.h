@@ -25,9 +25,13 @@
 #ifndef LSST_JOINTCAL_ASTROMETRY_FIT_H
 #define LSST_JOINTCAL_ASTROMETRY_FIT_H
 
+#include <cstdint>
 #include <string>
 #include <iostream>
+#include <memory>
 #include <sstream>
+#include <unordered_map>
+#include <vector>
 
 #include "lsst/jointcal/Associations.h"
 #include "lsst/jointcal/CcdImage.h"
@@ -79,7 +83,8 @@ class AstrometryFit : public FitterBase {
 public:
     //! this is the only constructor
     AstrometryFit(std::shared_ptr<Associations> associations,
-                  std::shared_ptr<AstrometryModel> astrometryModel, double posError);
+                  std::shared_ptr<AstrometryModel> astrometryModel, double posError,
+                  JointcalControl const &control = JointcalControl());
 
     /// No copy or move: there is only ever one fitter of a given type.
     AstrometryFit(AstrometryFit const &) = delete;
@@ -133,7 +138,50 @@ protected:
     /// @copydoc FitterBase::saveChi2RefContributions
     void saveChi2RefContributions(std::string const &filename) const override;
 
+    /// @copydoc FitterBase::getModelParameters
+    Eigen::VectorXd getModelParameters() const override;
+
+    /// @copydoc FitterBase::setModelParameters
+    void setModelParameters(Eigen::VectorXd const &parameters) override;
+
+    /// Bring the cache of the FittedStar projections up to date.
+    void prepareMeasurementTerms() override;
+
 private:
+    /// A FittedStar projected to a tangent plane, and the derivative of the projection there.
+    struct ProjectedFittedStar {
+        double x, y;
+        double a11, a12, a21, a22;
+    };
+
+    /**
+     * The projections of the FittedStars to the tangent planes, for the measurement terms.
+     *
+     * The projection of a FittedStar only depends on the sky to tangent plane transform, which is shared by
+     * many CcdImages (all the CcdImages of a visit, with OneTPPerVisitHandler): each FittedStar is
+     * projected once per transform it is measured under, instead of once per measurement in every
+     * derivative and chi2 computation. The projections are computed again after the FittedStars moved.
+     */
+    struct ProjectionCache {
+        /// The FittedStars measured under one sky to tangent plane transform, and their projections.
+        struct TangentPlane {
+            std::shared_ptr<AstrometryTransform const> sky2TP;
+            std::vector<FittedStar const *> fittedStars;
+            std::vector<ProjectedFittedStar> projections;
+        };
+        std::vector<TangentPlane> tangentPlanes;
+        /// The projection of the FittedStar of each measurement of a CcdImage, in measurement order.
+        struct Measurements {
+            std::uint64_t catalogGeneration;  // CcdImage::getCatalogForFitGeneration() when built
+            std::vector<ProjectedFittedStar const *> projections;
+        };
+        std::unordered_map<CcdImage const *, Measurements> ccdImages;
+        /// Whether the projections are those of the current FittedStar positions.
+        bool upToDate = false;
+    };
+    // Filled by prepareMeasurementTerms(), and only read by the (possibly concurrent) const computations.
+    ProjectionCache _projectionCache;
+
     bool _fittingDistortions, _fittingPos, _fittingRefrac, _fittingPM;
     std::shared_ptr<AstrometryModel> _astrometryModel;
     double _referenceColor, _sigCol;  // average and r.m.s color
@@ -148,25 +196,60 @@ private:
 
     double _posError;  // constant term on error on position (in pixel unit)
 
-    void leastSquareDerivativesMeasurement(CcdImage const &ccdImage, TripletList &tripletList,
-                                           Eigen::VectorXd &grad,
-                                           MeasuredStarList const *msList = nullptr) const override;
+    void leastSquareDerivativesMeasurement(CcdImage const &ccdImage, JacobianAccumulator &accumulator,
+                                           Eigen::VectorXd &grad, MeasuredStarList const *msList = nullptr,
+                                           Eigen::VectorXd const *offset = nullptr) const override;
+
+    void leastSquareDerivativesReference(FittedStarList const &fittedStarList,
+                                         JacobianAccumulator &accumulator, Eigen::VectorXd &grad,
+                                         Eigen::VectorXd const *offset = nullptr) const override;
+
+    void accumulateStatImage(CcdImage const &ccdImage, Chi2Accumulator &accum,
+                             Eigen::VectorXd const *offset = nullptr) const override;
+
+    void accumulateStatRefStars(Chi2Accumulator &accum,
+                                Eigen::VectorXd const *offset = nullptr) const override;
 
-    void leastSquareDerivativesReference(FittedStarList const &fittedStarList, TripletList &tripletList,
-                                         Eigen::VectorXd &grad) const override;
+    /// Offset the position (and proper motion, if fitted) of fittedStar, as offsetParams(delta) does.
+    void offsetFittedStar(FittedStar &fittedStar, Eigen::VectorXd const &delta) const;
 
-    void accumulateStatImageList(CcdImageList const &ccdImageList, Chi2Accumulator &accum) const override;
+    /// Project fittedStar to a tangent plane, with the derivative of the projection.
+    void projectFittedStar(FittedStar const &fittedStar, AstrometryTransform const &sky2TP,
+                           AstrometryTransformLinear &derivative, ProjectedFittedStar &projection) const;
 
-    void accumulateStatRefStars(Chi2Accumulator &accum) const override;
+    /// Add the proper motion and refraction of fittedStar to its position projected to a tangent plane.
+    Point addMotionAndRefraction(FittedStar const &fittedStar, Point const &projected,
+                                 Point const &refractionVector, double refractionCoeff, double mjd) const;
+
+    /// Build the cache of the FittedStar projections for the measurements of all the CcdImages.
+    void buildProjectionCache();
+
+    /**
+     * The cached projections of the FittedStars of the measurements of ccdImage, or nullptr if the cache
+     * is not up to date or was built from an older catalog for fit.
+     */
+    std::vector<ProjectedFittedStar const *> const *getCachedProjections(CcdImage const &ccdImage) const;
+
+    void getIndicesOfMapping(CcdImage const &ccdImage, IndexVector &indices) const override;
+
+    void getIndicesOfFittedStar(FittedStar const &fittedStar, IndexVector &indices) const override;
 
     void getIndicesOfMeasuredStar(MeasuredStar const &measuredStar,
                                   IndexVector &indices) const override;
 
-    Point transformFittedStar(FittedStar const &fittedStar, AstrometryTransform const &sky2TP,
-                              Point const &refractionVector, double refractionCoeff, double mjd) const;
+    /// The parameters of each FittedStar (position, and proper motion if fitted), when fitting positions.
+    std::vector<ParameterBlock> getEliminableBlocks() const override;
 
-    /// Compute the chi2 (per star or total, depending on which Chi2Accumulator is used) from one CcdImage.
-    void accumulateStatImage(CcdImage const &ccdImage, Chi2Accumulator &accum) const;
+    /**
+     * Transform a FittedStar to the tangent plane of a CcdImage, accounting for its proper motion and
+     * for the refraction.
+     *
+     * @param[out] derivative If not null, receives the derivative of the projection to the tangent plane
+     *                        at the FittedStar position, computed along with the projection itself.
+     */
+    Point transformFittedStar(FittedStar const &fittedStar, AstrometryTransform const &sky2TP,
+                              Point const &refractionVector, double refractionCoeff, double mjd,
+                              AstrometryTransformLinear *derivative = nullptr) const;
 };
 }  // namespace jointcal
 }  // namespace lsst
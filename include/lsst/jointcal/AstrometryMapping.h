@@ -26,6 +26,7 @@
 #define LSST_JOINTCAL_ASTROMETRY_MAPPING_H
 
 #include <iostream>
+#include <memory>
 #include <vector>
 #include "lsst/jointcal/Eigenstuff.h"
 
@@ -33,6 +34,7 @@ namespace lsst {
 namespace jointcal {
 
 class FatPoint;
+struct FatPointArrays;
 class Point;
 
 //! virtual class needed in the abstraction of the distortion model
@@ -54,11 +56,50 @@ public:
     //! The same as above but without the parameter derivatives (used to evaluate chi^2)
     virtual void transformPosAndErrors(FatPoint const &where, FatPoint &outPoint) const = 0;
 
+    /**
+     * Apply computeTransformAndDerivatives() to all the points of where, in a single virtual call.
+     *
+     * @param[in]  where      The points to transform.
+     * @param[out] outPoints  The transformed points, resized to the size of where; must not be where.
+     * @param[out] H          The derivatives w.r.t. the fitted parameters, resized to getNpar() rows and
+     *                        2*where.size() columns: those of point k are columns 2k and 2k+1.
+     */
+    virtual void computeTransformAndDerivativesBatch(FatPointArrays const &where, FatPointArrays &outPoints,
+                                                     Eigen::MatrixXd &H) const = 0;
+
+    /**
+     * Apply transformPosAndErrors() to all the points of where, in a single virtual call.
+     *
+     * @param[in]  where      The points to transform.
+     * @param[out] outPoints  The transformed points, resized to the size of where; must not be where.
+     */
+    virtual void transformPosAndErrorsBatch(FatPointArrays const &where, FatPointArrays &outPoints) const = 0;
+
     //! Remember the error scale and freeze it
     //  virtual void freezeErrorTransform() = 0;
 
     virtual void offsetParams(Eigen::VectorXd const &delta) = 0;
 
+    /**
+     * Return an independent copy of this mapping, with its parameters offset as the model's
+     * offsetParams(delta) would offset them. This mapping is left untouched.
+     *
+     * This allows evaluating the chi2 at trial parameters without modifying the model.
+     *
+     * @param[in]  delta  Offsets for all of the fitted parameters, indexed as in the "grand" fit.
+     */
+    virtual std::unique_ptr<AstrometryMapping> cloneWithOffset(Eigen::VectorXd const &delta) const = 0;
+
+    /**
+     * Get all the parameters of this mapping, including those that are not being fit.
+     *
+     * For checkpointing a fit: setAllParameters() restores them.
+     */
+    virtual Eigen::VectorXd getAllParameters() const = 0;
+
+    /// Set all the parameters of this mapping, as returned by getAllParameters().
+    virtual void setAllParameters(Eigen::VectorXd const &parameters) = 0;
+
     //! The derivative w.r.t. position
     virtual void positionDerivative(Point const &where, Eigen::Matrix2d &derivative,
                                     double epsilon) const = 0;
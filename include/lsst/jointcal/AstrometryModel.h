@@ -111,6 +111,22 @@ public:
      */
     bool validate(CcdImageList const &ccdImageList, int ndof) const;
 
+    /**
+     * Get the parameters of the mappings of all ccdImages, including those that are not being fit,
+     * concatenated in the order of ccdImageList.
+     *
+     * For checkpointing a fit: setAllParameters() restores them. Mappings shared between ccdImages
+     * appear once per ccdImage.
+     */
+    Eigen::VectorXd getAllParameters(CcdImageList const &ccdImageList) const;
+
+    /**
+     * Set the parameters returned by getAllParameters() for the same ccdImageList.
+     *
+     * @throws lsst::pex::exceptions::LengthError if parameters does not have the expected size.
+     */
+    void setAllParameters(CcdImageList const &ccdImageList, Eigen::VectorXd const &parameters);
+
 protected:
     /// lsst.logging instance, to be created by a subclass so that messages have consistent name.
     LOG_LOGGER _log;
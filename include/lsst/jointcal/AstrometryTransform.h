@@ -141,11 +141,45 @@ public:
     virtual void computeDerivative(Point const &where, AstrometryTransformLinear &derivative,
                                    const double step = 0.01) const;
 
+    /**
+     * apply() and computeDerivative() at the same point.
+     *
+     * Transforms with analytic derivatives override it to share the work of both.
+     *
+     * @param[in] where The point to transform.
+     * @param[out] out The transformed point.
+     * @param[out] derivative The derivative of the transform at where.
+     * @param[in] step The step of the numerical derivation, if any.
+     */
+    virtual void applyWithDerivative(Point const &where, Point &out, AstrometryTransformLinear &derivative,
+                                     const double step = 0.01) const;
+
     //! linear (local) approximation.
     virtual AstrometryTransformLinear linearApproximation(Point const &where, const double step = 0.01) const;
 
     virtual void transformPosAndErrors(const FatPoint &in, FatPoint &out) const;
 
+    /**
+     * Apply the transform to arrays of points: (xOut[i], yOut[i]) = apply(x[i], y[i]).
+     *
+     * A single virtual call for a whole list of points, e.g. the measurements of a CcdImage. The default
+     * calls apply() for each point; the transforms applied to many points override it with loops over the
+     * arrays. The outputs may be the inputs.
+     *
+     * @throws lsst::pex::exceptions::LengthError if the arrays do not all have the same size.
+     */
+    virtual void applyBatch(Eigen::Ref<Eigen::ArrayXd const> const &x,
+                            Eigen::Ref<Eigen::ArrayXd const> const &y, Eigen::Ref<Eigen::ArrayXd> xOut,
+                            Eigen::Ref<Eigen::ArrayXd> yOut) const;
+
+    /**
+     * Apply the transform to arrays of points and propagate their errors, as transformPosAndErrors() does
+     * for a single point. out is resized to the size of in; it may be in.
+     *
+     * @throws lsst::pex::exceptions::LengthError if the arrays of in do not all have the same size.
+     */
+    virtual void transformPosAndErrorsBatch(FatPointArrays const &in, FatPointArrays &out) const;
+
     //! transform errors (represented as double[3] in order V(xx),V(yy),Cov(xy))
     virtual void transformErrors(Point const &where, const double *vIn, double *vOut) const;
 
@@ -317,6 +351,25 @@ public:
     //! a mix of apply and Derivative
     virtual void transformPosAndErrors(const FatPoint &in, FatPoint &out) const override;
 
+    //! position and analytic derivative in a single evaluation of the monomials.
+    void applyWithDerivative(Point const &where, Point &out, AstrometryTransformLinear &derivative,
+                             const double step = 0.01) const override;
+
+    /**
+     * transformPosAndErrors() and paramDerivatives() together, from a single evaluation of the monomials.
+     *
+     * @param[in] in The point to transform, with its errors.
+     * @param[out] out The transformed point and errors; may be in.
+     * @param[out] dx, dy The derivatives of out.x and out.y w.r.t. the parameters, getNpar() long each.
+     */
+    void computeTransformAndDerivatives(FatPoint const &in, FatPoint &out, double *dx, double *dy) const;
+
+    //! These two loop over the arrays once per monomial, computing the powers of x and y once per point.
+    void applyBatch(Eigen::Ref<Eigen::ArrayXd const> const &x, Eigen::Ref<Eigen::ArrayXd const> const &y,
+                    Eigen::Ref<Eigen::ArrayXd> xOut, Eigen::Ref<Eigen::ArrayXd> yOut) const override;
+
+    void transformPosAndErrorsBatch(FatPointArrays const &in, FatPointArrays &out) const override;
+
     //! total number of parameters
     std::size_t getNpar() const override { return 2 * _nterms; }
 
@@ -383,6 +436,11 @@ private:
     std::vector<double> _coeffs;  // the actual coefficients
                                   // both polynomials in a single vector to speed up allocation and copies
 
+    // Evaluation routines compiled for a given order, so that their loops over the monomials are unrolled.
+    struct Kernels;
+    // The routines for _order, picked when the order is set, or nullptr for the generic code (large orders).
+    Kernels const *_kernels;
+
     /* use std::vector rather than double * to avoid
        writing copy constructor and "operator =".
        Vect would work as well but introduces a dependence
@@ -394,6 +452,11 @@ private:
        part of C++, but gcc implements it. */
     void computeMonomials(double xIn, double yIn, double *monomial) const;
 
+    /// Fill column i of xPowers (yPowers) with x^i (y^i), for i = 0.._order.
+    void computePowerArrays(Eigen::Ref<Eigen::ArrayXd const> const &x,
+                            Eigen::Ref<Eigen::ArrayXd const> const &y, Eigen::ArrayXXd &xPowers,
+                            Eigen::ArrayXXd &yPowers) const;
+
     /**
      * Return the sparse coefficients matrix that ast::PolyMap requires.
      *
@@ -450,6 +513,11 @@ public:
     AstrometryTransformLinear linearApproximation(Point const &where,
                                                   const double step = 0.01) const override;
 
+    void applyBatch(Eigen::Ref<Eigen::ArrayXd const> const &x, Eigen::Ref<Eigen::ArrayXd const> const &y,
+                    Eigen::Ref<Eigen::ArrayXd> xOut, Eigen::Ref<Eigen::ArrayXd> yOut) const override;
+
+    void transformPosAndErrorsBatch(FatPointArrays const &in, FatPointArrays &out) const override;
+
     //  void print(std::ostream &out) const;
 
     // double fit(StarMatchList const &starMatchList);
@@ -585,6 +653,18 @@ public:
     /// Transform pixels to ICRS RA, Dec in degrees
     void apply(const double xIn, const double yIn, double &xOut, double &yOut) const;
 
+    //! analytic derivative; step is ignored.
+    void computeDerivative(Point const &where, AstrometryTransformLinear &derivative,
+                           const double step = 0.01) const override;
+
+    //! analytic derivative, sharing the computations of apply(); step is ignored.
+    void applyWithDerivative(Point const &where, Point &out, AstrometryTransformLinear &derivative,
+                             const double step = 0.01) const override;
+
+    /// Transform arrays of pixels to ICRS RA, Dec in degrees
+    void applyBatch(Eigen::Ref<Eigen::ArrayXd const> const &x, Eigen::Ref<Eigen::ArrayXd const> const &y,
+                    Eigen::Ref<Eigen::ArrayXd> xOut, Eigen::Ref<Eigen::ArrayXd> yOut) const override;
+
     //! Get the sky origin (CRVAL in FITS WCS terminology) in degrees
     Point getTangentPoint() const;
 
@@ -608,9 +688,25 @@ public:
     virtual void pixToTangentPlane(double xPixel, double yPixel, double &xTangentPlane,
                                    double &yTangentPlane) const = 0;
 
+    //! Transform arrays from pixels to tangent plane (degrees); the outputs may be the inputs.
+    //! The default calls pixToTangentPlane() for each point.
+    virtual void pixToTangentPlaneBatch(Eigen::Ref<Eigen::ArrayXd const> const &xPixel,
+                                        Eigen::Ref<Eigen::ArrayXd const> const &yPixel,
+                                        Eigen::Ref<Eigen::ArrayXd> xTangentPlane,
+                                        Eigen::Ref<Eigen::ArrayXd> yTangentPlane) const;
+
     ~BaseTanWcs();
 
 protected:
+    //! Deproject tangent plane coordinates (degrees) to ICRS RA, Dec (degrees). If derivative is not null,
+    //! also store there the derivative of the deprojection, as (a11, a12, a21, a22).
+    void tangentPlaneToSky(double xTangentPlane, double yTangentPlane, double &ra, double &dec,
+                           double *derivative = nullptr) const;
+
+    //! pixToTangentPlane() and its derivative
+    virtual void pixToTangentPlaneWithDerivative(Point const &pixel, Point &tangentPlane,
+                                                 AstrometryTransformLinear &derivative) const = 0;
+
     AstrometryTransformLinear linPixelToTan;  // transform from pixels to tangent plane (degrees)
                                               // a linear approximation centered at the pixel and sky origins
     std::unique_ptr<AstrometryTransformPolynomial> corr;
@@ -639,6 +735,11 @@ public:
     virtual void pixToTangentPlane(double xPixel, double yPixel, double &xTangentPlane,
                                    double &yTangentPlane) const;
 
+    void pixToTangentPlaneBatch(Eigen::Ref<Eigen::ArrayXd const> const &xPixel,
+                                Eigen::Ref<Eigen::ArrayXd const> const &yPixel,
+                                Eigen::Ref<Eigen::ArrayXd> xTangentPlane,
+                                Eigen::Ref<Eigen::ArrayXd> yTangentPlane) const override;
+
     TanPixelToRaDec();
 
     //! composition with AstrometryTransformLinear
@@ -666,6 +767,10 @@ public:
 
     //! Not implemented yet, because we do it otherwise.
     double fit(StarMatchList const &starMatchList);
+
+protected:
+    void pixToTangentPlaneWithDerivative(Point const &pixel, Point &tangentPlane,
+                                         AstrometryTransformLinear &derivative) const override;
 };
 
 //! Implements the (forward) SIP distorsion scheme
@@ -683,6 +788,11 @@ public:
     virtual void pixToTangentPlane(double xPixel, double yPixel, double &xTangentPlane,
                                    double &yTangentPlane) const;
 
+    void pixToTangentPlaneBatch(Eigen::Ref<Eigen::ArrayXd const> const &xPixel,
+                                Eigen::Ref<Eigen::ArrayXd const> const &yPixel,
+                                Eigen::Ref<Eigen::ArrayXd> xTangentPlane,
+                                Eigen::Ref<Eigen::ArrayXd> yTangentPlane) const override;
+
     TanSipPixelToRaDec();
 
     //! Inverse transform: returns a TanRaDecToPixel if there are no corrections, or the iterative solver if
@@ -695,6 +805,10 @@ public:
 
     //! Not implemented yet, because we do it otherwise.
     double fit(StarMatchList const &starMatchList);
+
+protected:
+    void pixToTangentPlaneWithDerivative(Point const &pixel, Point &tangentPlane,
+                                         AstrometryTransformLinear &derivative) const override;
 };
 
 //! This one is the Tangent Plane (called gnomonic) projection (from celestial sphere to tangent plane)
@@ -729,6 +843,19 @@ public:
     //! transform with analytical derivatives
     void transformPosAndErrors(const FatPoint &in, FatPoint &out) const;
 
+    //! analytic derivative; step is ignored.
+    void computeDerivative(Point const &where, AstrometryTransformLinear &derivative,
+                           const double step = 0.01) const override;
+
+    //! analytic derivative, sharing the computations of apply(); step is ignored.
+    void applyWithDerivative(Point const &where, Point &out, AstrometryTransformLinear &derivative,
+                             const double step = 0.01) const override;
+
+    void applyBatch(Eigen::Ref<Eigen::ArrayXd const> const &x, Eigen::Ref<Eigen::ArrayXd const> const &y,
+                    Eigen::Ref<Eigen::ArrayXd> xOut, Eigen::Ref<Eigen::ArrayXd> yOut) const override;
+
+    void transformPosAndErrorsBatch(FatPointArrays const &in, FatPointArrays &out) const override;
+
     //! exact typed inverse:
     TanPixelToRaDec inverted() const;
 
@@ -745,6 +872,13 @@ public:
     double fit(StarMatchList const &starMatchList);
 
 private:
+    // project ICRS RA, Dec (degrees) to the tangent plane (degrees), i.e. apply() without linTan2Pix.
+    // If derivative is not null, also store there the derivative of the projection, as (a11, a12, a21, a22).
+    void skyToTangentPlane(double ra, double dec, double &xTangentPlane, double &yTangentPlane,
+                           double *derivative = nullptr) const;
+    // the same with errors, i.e. transformPosAndErrors() without linTan2Pix.
+    void skyToTangentPlane(FatPoint const &in, FatPoint &out) const;
+
     double ra0, dec0;  // tangent point (radians)
     double cos0, sin0;
     AstrometryTransformLinear linTan2Pix;  // tangent plane (probably degrees) to pixels
@@ -0,0 +1,93 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef LSST_JOINTCAL_BLOCK_JACOBI_PRECONDITIONER_H
+#define LSST_JOINTCAL_BLOCK_JACOBI_PRECONDITIONER_H
+
+#include <memory>
+#include <vector>
+
+#include "Eigen/Core"
+
+#include "lsst/jointcal/HessianSolver.h"
+#include "lsst/jointcal/Tripletlist.h"
+
+namespace lsst {
+namespace jointcal {
+
+/**
+ * Block-Jacobi preconditioner for the normal equations: the inverse of the diagonal blocks of the Hessian.
+ *
+ * The diagonal blocks are accumulated from the Jacobian terms, as any JacobianAccumulator, without
+ * forming the Hessian. Once all terms are added, invert() replaces them by their inverses, and apply()
+ * multiplies a vector with the preconditioner.
+ */
+class BlockJacobiPreconditioner : public JacobianAccumulator {
+public:
+    /**
+     * @param nParTot  Number of parameters of the fit.
+     * @param blocks   Non-overlapping blocks of parameters (e.g. one per mapping and per FittedStar);
+     *                 each parameter in none of them gets its own 1x1 block.
+     */
+    BlockJacobiPreconditioner(Eigen::Index nParTot, std::vector<ParameterBlock> const &blocks);
+
+    void addTerm(IndexVector const &indices, Eigen::Ref<Eigen::MatrixXd const> const &jacobian) override;
+
+    std::unique_ptr<JacobianAccumulator> makeEmptyClone() const override;
+
+    void merge(JacobianAccumulator &other) override;
+
+    /**
+     * Invert the accumulated diagonal blocks.
+     *
+     * A block that is not positive definite falls back to the inverse of its diagonal, and a zero diagonal
+     * entry to 1.
+     *
+     * @return The number of blocks that were not positive definite.
+     */
+    std::size_t invert();
+
+    /// Multiply vector with the preconditioner; invert() must have been called.
+    Eigen::VectorXd apply(Eigen::VectorXd const &vector) const;
+
+private:
+    // The partition of the parameters into blocks, shared by the clones.
+    struct Layout {
+        std::vector<ParameterBlock> blocks;
+        std::vector<Eigen::Index> blockOf;   // block of each parameter
+        std::vector<std::size_t> offsets;    // where each block starts in _values
+        std::size_t nValues;                 // total size of the blocks
+    };
+
+    explicit BlockJacobiPreconditioner(std::shared_ptr<Layout const> layout);
+
+    std::shared_ptr<Layout const> _layout;
+    // All the blocks, one after the other, column-major.
+    std::vector<double> _values;
+};
+
+}  // namespace jointcal
+}  // namespace lsst
+
+#endif  // LSST_JOINTCAL_BLOCK_JACOBI_PRECONDITIONER_H
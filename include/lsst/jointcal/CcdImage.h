@@ -25,6 +25,7 @@
 #ifndef LSST_JOINTCAL_CCD_IMAGE_H
 #define LSST_JOINTCAL_CCD_IMAGE_H
 
+#include <cstdint>
 #include <list>
 #include <string>
 
@@ -37,6 +38,7 @@
 #include "lsst/geom/Box.h"
 #include "lsst/geom/SpherePoint.h"
 #include "lsst/jointcal/MeasuredStar.h"
+#include "lsst/jointcal/MeasurementArrays.h"
 #include "lsst/jointcal/AstrometryTransform.h"
 #include "lsst/jointcal/Frame.h"
 
@@ -85,22 +87,59 @@ public:
      */
     MeasuredStarList const &getWholeCatalog() const { return _wholeCatalog; }
 
-    //@{
     /**
      * @brief      Gets the catalog to be used for fitting, which may have been cleaned-up.
      *
      * @return     The catalog for fitting.
      */
     MeasuredStarList const &getCatalogForFit() const { return _catalogForFit; }
-    MeasuredStarList &getCatalogForFit() { return _catalogForFit; }
-    //@}
+
+    /**
+     * Get the catalog for fitting, to add or remove measurements.
+     *
+     * Counts as a change of the catalog: the measurement arrays have to be built again before fitting.
+     */
+    MeasuredStarList &modifyCatalogForFit() {
+        ++_catalogForFitGeneration;
+        return _catalogForFit;
+    }
+
+    /**
+     * The number of changes of the catalog for fitting, to tell whether something built from it is
+     * still current.
+     */
+    std::uint64_t getCatalogForFitGeneration() const { return _catalogForFitGeneration; }
 
     /// Clear the catalog for fitting and set it to a copy of the whole catalog.
     void resetCatalogForFit() {
-        getCatalogForFit().clear();
-        getWholeCatalog().copyTo(getCatalogForFit());
+        modifyCatalogForFit().clear();
+        getWholeCatalog().copyTo(_catalogForFit);
+        _measurementArrays = MeasurementArrays();
     }
 
+    /**
+     * Copy the catalog for fitting into contiguous arrays, for the loops of the fitters over the
+     * measurements. Called by each fitter when it is constructed.
+     */
+    void buildMeasurementArrays() {
+        _measurementArrays.assign(_catalogForFit);
+        _measurementArraysGeneration = _catalogForFitGeneration;
+    }
+
+    /**
+     * Copy the valid flags of the catalog for fitting again into its arrays, after outliers were
+     * rejected.
+     */
+    void updateMeasurementValidity();
+
+    /**
+     * Get the catalog for fitting as contiguous arrays, in catalog order.
+     *
+     * @throws lsst::pex::exceptions::LogicError if the arrays were not built from the current catalog for
+     *         fitting with buildMeasurementArrays().
+     */
+    MeasurementArrays const &getMeasurementArrays() const;
+
     /**
      * Count the number of valid measured and reference stars that fall within this ccdImage.
      *
@@ -198,6 +237,10 @@ private:
 
     MeasuredStarList _wholeCatalog;  // the catalog of measured objets
     MeasuredStarList _catalogForFit;
+    MeasurementArrays _measurementArrays;  // copy of _catalogForFit for the fitters
+    // changes of _catalogForFit, and the change _measurementArrays were built at (0: never built).
+    std::uint64_t _catalogForFitGeneration = 1;
+    std::uint64_t _measurementArraysGeneration = 0;
 
     std::shared_ptr<AstrometryTransformSkyWcs> _readWcs;  // apply goes from pix to sky
 
@@ -25,14 +25,13 @@
 #ifndef LSST_JOINTCAL_CHI2_H
 #define LSST_JOINTCAL_CHI2_H
 
+#include <cstdint>
 #include <string>
 #include <iostream>
+#include <memory>
 #include <sstream>
-#include <utility>
 #include <vector>
 
-#include "lsst/jointcal/BaseStar.h"
-
 namespace lsst {
 namespace jointcal {
 
@@ -43,7 +42,36 @@ namespace jointcal {
  */
 class Chi2Accumulator {
 public:
-    virtual void addEntry(double inc, std::size_t dof, std::shared_ptr<BaseStar> star) = 0;
+    /**
+     * Add the contribution of one chi2 term.
+     *
+     * @param inc        The chi2 of the term.
+     * @param dof        The number of degrees of freedom of the term.
+     * @param starIndex  The position of the star of the term: in the catalog for fit of the current
+     *                   CcdImage for measurement terms, in the fittedStarList for reference terms.
+     */
+    virtual void addEntry(double inc, std::size_t dof, std::size_t starIndex) = 0;
+
+    /**
+     * Announce that the following entries are measurement terms of the CcdImage at position
+     * ccdImageIndex in the CcdImageList being accumulated. The default implementation ignores it.
+     */
+    virtual void beginCcdImage(std::size_t ccdImageIndex) {}
+
+    /// Announce that the following entries are reference terms. The default implementation ignores it.
+    virtual void beginReferences() {}
+
+    /**
+     * Should the measurement terms be accumulated as their robust loss (see JointcalControl::robustLoss),
+     * i.e. as the quantity that the fit minimizes, rather than as their chi2? The default is true.
+     */
+    virtual bool useRobustLoss() const { return true; }
+
+    /// Return a new, empty accumulator of the same kind, to be filled independently and then merged.
+    virtual std::unique_ptr<Chi2Accumulator> makeEmptyClone() const = 0;
+
+    /// Add the entries of other (obtained from makeEmptyClone()) after the ones already here.
+    virtual void merge(Chi2Accumulator& other) = 0;
 
     virtual ~Chi2Accumulator(){};
 };
@@ -62,7 +90,7 @@ public:
     }
 
     // Addentry has an ignored third argument in order to make it compatible with Chi2List.
-    void addEntry(double inc, std::size_t dof, std::shared_ptr<BaseStar>) override {
+    void addEntry(double inc, std::size_t dof, std::size_t) override {
         chi2 += inc;
         ndof += dof;
     }
@@ -72,41 +100,101 @@ public:
         ndof += rhs.ndof;
         return *this;
     }
+
+    std::unique_ptr<Chi2Accumulator> makeEmptyClone() const override {
+        return std::unique_ptr<Chi2Accumulator>(new Chi2Statistic());
+    }
+
+    void merge(Chi2Accumulator& other) override { *this += dynamic_cast<Chi2Statistic const&>(other); }
 };
 
-/*
- * A class to accumulate chi2 contributions together with pointers to the contributors.
+/// The kind of chi2 term a Chi2Record comes from.
+enum class Chi2TermKind : std::uint32_t { Measurement, Reference };
+
+/**
+ * One chi2 contribution, and the indices of its contributor (see Chi2Accumulator::addEntry).
  *
- * This structure lets one compute the chi2 statistics (average and variance) and directly point back
- * to the bad guys without relooping.
- * The Chi2Star routine makes it compatible with AstrometryFit's
- * accumulateStatImage and accumulateStatImageList.
+ * Indices rather than pointers keep the records small and trivially copyable: the stars are only looked
+ * up for the few records that turn out to be outliers.
  */
-struct Chi2Star {
+struct Chi2Record {
     double chi2;
-    std::shared_ptr<BaseStar> star;
-
-    Chi2Star(double chi2, std::shared_ptr<BaseStar> star) : chi2(chi2), star(std::move(star)) {}
-    // for sorting
-    bool operator<(Chi2Star const& rhs) const { return (chi2 < rhs.chi2); }
-
-    friend std::ostream& operator<<(std::ostream& s, Chi2Star const& chi2Star) {
-        s << "chi2: " << chi2Star.chi2 << " star: " << *(chi2Star.star) << std::endl;
+    Chi2TermKind kind;
+    std::uint32_t ccdImageIndex;  // only meaningful for measurement terms
+    std::uint64_t starIndex;
+
+    friend std::ostream& operator<<(std::ostream& s, Chi2Record const& record) {
+        if (record.kind == Chi2TermKind::Measurement) {
+            s << "chi2: " << record.chi2 << " ccdImage: " << record.ccdImageIndex
+              << " measuredStar: " << record.starIndex;
+        } else {
+            s << "chi2: " << record.chi2 << " fittedStar: " << record.starIndex;
+        }
         return s;
     }
 };
 
-/// Structure to accumulate the chi2 contributions per each star (to help find outliers).
-class Chi2List : public Chi2Accumulator, public std::vector<Chi2Star> {
+/// Mean, median and standard deviation of the chi2 of the entries of a Chi2List.
+struct Chi2Summary {
+    double average;
+    double median;
+    double sigma;
+};
+
+/**
+ * Structure to accumulate the chi2 contributions per each star (to help find outliers).
+ *
+ * This structure lets one compute the chi2 statistics (average, median and variance) and select the
+ * largest contributions without fully sorting them. Clearing it keeps its storage, so that it can be
+ * reused from one outlier rejection step to the next.
+ */
+class Chi2List : public Chi2Accumulator, public std::vector<Chi2Record> {
 public:
-    void addEntry(double chi2, std::size_t ndof, std::shared_ptr<BaseStar> star) override {
-        push_back(Chi2Star(chi2, std::move(star)));
+    Chi2List() : _kind(Chi2TermKind::Measurement), _ccdImageIndex(0) {}
+
+    void addEntry(double chi2, std::size_t ndof, std::size_t starIndex) override {
+        push_back({chi2, _kind, _ccdImageIndex, starIndex});
     }
 
-    /// Compute the average and std-deviation of these chisq values.
-    std::pair<double, double> computeAverageAndSigma();
+    /// @throws lsst::pex::exceptions::LengthError if ccdImageIndex does not fit in Chi2Record.
+    void beginCcdImage(std::size_t ccdImageIndex) override;
+
+    void beginReferences() override { _kind = Chi2TermKind::Reference; }
+
+    /// Outliers are found from the chi2 of each term.
+    bool useRobustLoss() const override { return false; }
+
+    std::unique_ptr<Chi2Accumulator> makeEmptyClone() const override {
+        return std::unique_ptr<Chi2Accumulator>(new Chi2List());
+    }
+
+    void merge(Chi2Accumulator& other) override {
+        auto& otherList = dynamic_cast<Chi2List&>(other);
+        insert(end(), otherList.begin(), otherList.end());
+        std::vector<Chi2Record>().swap(otherList);
+    }
+
+    /**
+     * Compute the average, median and std-deviation of these chisq values.
+     *
+     * The average and sigma come from a single pass over the entries, the median from a partial sort
+     * (std::nth_element), which reorders the entries. They are all NaN if there are no entries.
+     */
+    Chi2Summary computeSummary();
+
+    /**
+     * Move the entries with chi2 >= cut to the front, sorted by decreasing chi2, without sorting the
+     * others (which are left in unspecified order).
+     *
+     * @return The number of entries with chi2 >= cut.
+     */
+    std::size_t selectAbove(double cut);
 
     friend std::ostream& operator<<(std::ostream& s, Chi2List const& chi2List);
+
+private:
+    Chi2TermKind _kind;
+    std::uint32_t _ccdImageIndex;
 };
 
 }  // namespace jointcal
@@ -57,6 +57,13 @@ public:
     //!
     void transformPosAndErrors(FatPoint const &where, FatPoint &outPoint) const override;
 
+    /// @copydoc AstrometryMapping::computeTransformAndDerivativesBatch
+    void computeTransformAndDerivativesBatch(FatPointArrays const &where, FatPointArrays &outPoints,
+                                             Eigen::MatrixXd &H) const override;
+
+    /// @copydoc AstrometryMapping::transformPosAndErrorsBatch
+    void transformPosAndErrorsBatch(FatPointArrays const &where, FatPointArrays &outPoints) const override;
+
     /**
      * @copydoc AstrometryMapping::offsetParams
      *
@@ -68,6 +75,15 @@ public:
         _m2->offsetParams(delta.segment(_m2->getIndex() + _m1->getNpar(), _m2->getNpar()));
     }
 
+    /// @copydoc AstrometryMapping::cloneWithOffset
+    std::unique_ptr<AstrometryMapping> cloneWithOffset(Eigen::VectorXd const &delta) const override;
+
+    /// @copydoc AstrometryMapping::getAllParameters
+    Eigen::VectorXd getAllParameters() const override;
+
+    /// @copydoc AstrometryMapping::setAllParameters
+    void setAllParameters(Eigen::VectorXd const &parameters) override;
+
     //! access to transforms
     AstrometryTransform const &getTransform1() const { return _m1->getTransform(); }
 
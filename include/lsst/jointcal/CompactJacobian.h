@@ -0,0 +1,107 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef LSST_JOINTCAL_COMPACT_JACOBIAN_H
+#define LSST_JOINTCAL_COMPACT_JACOBIAN_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "Eigen/Core"
+
+#include "lsst/jointcal/Eigenstuff.h"
+#include "lsst/jointcal/Tripletlist.h"
+
+namespace lsst {
+namespace jointcal {
+
+/**
+ * Store the Jacobian of the fit in compressed sparse column (CSC) layout, with 32-bit row indices.
+ *
+ * Each call to addTerm() appends the columns of one term, with their rows sorted and duplicates summed,
+ * so that the storage can be handed to cholmod as a cholmod_sparse without any copy. This takes
+ * 12 bytes per non-zero entry (plus one column start per column), instead of the 16 bytes of a
+ * TripletList, and avoids building an Eigen copy of the Jacobian (and of its transpose) to compute
+ * the Hessian.
+ *
+ * Fits with more parameters than 32-bit indices can address get 64-bit row indices instead, i.e.
+ * 16 bytes per non-zero entry.
+ */
+class CompactJacobian : public JacobianAccumulator {
+public:
+    /**
+     * @param nParTot   Number of parameters of the fit, i.e. the number of rows of the Jacobian.
+     * @param nEntries  Number of non-zero entries to reserve space for.
+     */
+    CompactJacobian(Eigen::Index nParTot, std::size_t nEntries);
+
+    void addTerm(IndexVector const &indices, Eigen::Ref<Eigen::MatrixXd const> const &jacobian) override;
+
+    std::unique_ptr<JacobianAccumulator> makeEmptyClone() const override;
+
+    void merge(JacobianAccumulator &other) override;
+
+    /// Number of non-zero entries accumulated so far.
+    std::size_t size() const { return _values.size(); }
+
+    /// Whether the row indices are stored on 64 bits, because there are too many parameters for 32.
+    bool hasWideRows() const { return _wideRows; }
+
+    /// Number of columns accumulated so far.
+    std::size_t getNColumns() const { return _columnStarts.size() - 1; }
+
+    /**
+     * Compute the lower triangle of the Hessian (J*J^T) with cholmod, straight from the stored Jacobian.
+     *
+     * 32-bit column starts are used when the number of entries and of parameters allows it, 64-bit
+     * indices otherwise.
+     *
+     * @throws lsst::pex::exceptions::RuntimeError if cholmod fails (e.g. runs out of memory).
+     */
+    SparseMatrixD makeHessian() const;
+
+private:
+    /// Append the non-zero entries of column ic of the term, sorted by row, with duplicate rows summed.
+    template <typename Row>
+    void _appendColumn(std::vector<Row> &rows, IndexVector const &indices,
+                       Eigen::Ref<Eigen::MatrixXd const> const &jacobian, Eigen::Index ic);
+
+    Eigen::Index _nParTot;
+    bool _wideRows;
+    // Only one of the two is filled, depending on _wideRows.
+    std::vector<std::int32_t> _rows;
+    std::vector<SuiteSparse_long> _longRows;
+    std::vector<double> _values;
+    // Scratch space for the (row, value) pairs of the column being added.
+    std::vector<std::pair<SuiteSparse_long, double>> _column;
+    // Offset in _rows/_values of the first entry of each column, followed by the total number of entries.
+    std::vector<SuiteSparse_long> _columnStarts;
+};
+
+}  // namespace jointcal
+}  // namespace lsst
+
+#endif  // LSST_JOINTCAL_COMPACT_JACOBIAN_H
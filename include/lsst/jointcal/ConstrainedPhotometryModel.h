@@ -88,6 +88,10 @@ public:
     void computeParameterDerivatives(MeasuredStar const &measuredStar, CcdImage const &ccdImage,
                                      Eigen::VectorXd &derivatives) const override;
 
+    /// @copydoc PhotometryModel::computeParameterDerivatives
+    void computeParameterDerivatives(MeasuredStar const &measuredStar, PhotometryMappingBase const &mapping,
+                                     Eigen::VectorXd &derivatives) const override;
+
     /// @copydoc PhotometryModel::print
     void print(std::ostream &out) const override;
 
@@ -153,6 +157,10 @@ public:
     /// @copydoc PhotometryModel::computeResidual
     double computeResidual(CcdImage const &ccdImage, MeasuredStar const &measuredStar) const override;
 
+    /// @copydoc PhotometryModel::computeResidual
+    double computeResidual(MeasuredStar const &measuredStar, FittedStar const &fittedStar,
+                           PhotometryMappingBase const &mapping) const override;
+
     /// @copydoc PhotometryModel::computeRefResidual
     double computeRefResidual(FittedStar const &fittedStar, RefStar const &refStar) const override {
         return fittedStar.getFlux() - refStar.getFlux();
@@ -167,6 +175,10 @@ public:
     /// @copydoc PhotometryModel::transformError
     double transformError(CcdImage const &ccdImage, MeasuredStar const &measuredStar) const override;
 
+    /// @copydoc PhotometryModel::transformError
+    double transformError(MeasuredStar const &measuredStar,
+                          PhotometryMappingBase const &mapping) const override;
+
     /// @copydoc PhotometryModel::toPhotoCalib
     std::shared_ptr<afw::image::PhotoCalib> toPhotoCalib(CcdImage const &ccdImage) const override;
 
@@ -199,6 +211,10 @@ public:
     /// @copydoc PhotometryModel::computeResidual
     double computeResidual(CcdImage const &ccdImage, MeasuredStar const &measuredStar) const override;
 
+    /// @copydoc PhotometryModel::computeResidual
+    double computeResidual(MeasuredStar const &measuredStar, FittedStar const &fittedStar,
+                           PhotometryMappingBase const &mapping) const override;
+
     /// @copydoc PhotometryModel::computeRefResidual
     double computeRefResidual(FittedStar const &fittedStar, RefStar const &refStar) const override {
         return fittedStar.getMag() - refStar.getMag();
@@ -213,6 +229,10 @@ public:
     /// @copydoc PhotometryModel::transformError
     double transformError(CcdImage const &ccdImage, MeasuredStar const &measuredStar) const override;
 
+    /// @copydoc PhotometryModel::transformError
+    double transformError(MeasuredStar const &measuredStar,
+                          PhotometryMappingBase const &mapping) const override;
+
     /// @copydoc PhotometryModel::toPhotoCalib
     std::shared_ptr<afw::image::PhotoCalib> toPhotoCalib(CcdImage const &ccdImage) const override;
 
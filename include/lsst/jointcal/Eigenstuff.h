@@ -25,6 +25,8 @@
 #ifndef LSST_JOINTCAL_EIGENSTUFF_H
 #define LSST_JOINTCAL_EIGENSTUFF_H
 
+#include <vector>
+
 #include "lsst/pex/exceptions.h"
 
 #include "Eigen/CholmodSupport"  // to switch to cholmod
@@ -37,6 +39,53 @@ typedef Eigen::SparseMatrix<double, 0, Eigen::Index> SparseMatrixD;
 // To make our indices and triplets conform to Eigen's desire for taking a signed type
 typedef std::vector<std::ptrdiff_t> IndexVector;
 
+/**
+ * Apply the rank update (UpOrDown=true) or downdate (UpOrDown=false) H*H^T to a cholmod factor.
+ *
+ * The factor must be simplicial; an LL^T factor is converted to LDL^T by cholmod.
+ */
+inline void cholmodUpdate(SparseMatrixD const &H, bool UpOrDown, cholmod_factor *factor,
+                          cholmod_common *common) {
+    eigen_assert(static_cast<Eigen::Index>(factor->n) == H.rows());
+
+    cholmod_sparse C_cs = Eigen::viewAsCholmod(H);
+    /* We have to apply the magic permutation to the update matrix,
+    read page 117 of Cholmod UserGuide.pdf */
+    // Using cholmod_l_* functions instead of cholmod_* because index is Eigen::Index instead of int.
+    cholmod_sparse *C_cs_perm = cholmod_l_submatrix(&C_cs, (Eigen::Index *)factor->Perm, factor->n, nullptr,
+                                                    -1, true, true, common);
+    assert(C_cs_perm);
+    int isOk = cholmod_l_updown(UpOrDown, C_cs_perm, factor, common);
+    cholmod_l_free_sparse(&C_cs_perm, common);
+    if (!isOk) {
+        throw(LSST_EXCEPT(lsst::pex::exceptions::RuntimeError, "cholmod_update failed!"));
+    }
+}
+
+/**
+ * Symbolic analysis of the lower triangle of matrix with the given fill-reducing permutation, instead of
+ * the orderings configured in common.
+ *
+ * @param permutation  The row of matrix of each row of the factor, as in cholmod_factor::Perm.
+ *
+ * @return The new factor, or null if the analysis failed.
+ */
+inline cholmod_factor *cholmodAnalyzeGiven(SparseMatrixD const &matrix,
+                                           std::vector<Eigen::Index> const &permutation,
+                                           cholmod_common *common) {
+    cholmod_sparse A = Eigen::viewAsCholmod(matrix.selfadjointView<Eigen::Lower>());
+    // Only try the given ordering, restoring the configured ones afterwards.
+    int const nmethods = common->nmethods;
+    int const ordering = common->method[0].ordering;
+    common->nmethods = 1;
+    common->method[0].ordering = CHOLMOD_GIVEN;
+    cholmod_factor *factor = cholmod_l_analyze_p(&A, const_cast<Eigen::Index *>(permutation.data()), nullptr,
+                                                 0, common);
+    common->nmethods = nmethods;
+    common->method[0].ordering = ordering;
+    return factor;
+}
+
 /* Cholesky factorization class using cholmod, with the small-rank update capability.
  *
  * Class derived from Eigen's CholmodBase, to add the factorization
@@ -64,28 +113,29 @@ public:
         this->compute(matrix);
     }
 
+    using Base::analyzePattern;
+
+    /// Symbolic analysis with the given fill-reducing permutation (see cholmodAnalyzeGiven).
+    void analyzePattern(MatrixType const &matrix, std::vector<Eigen::Index> const &permutation) {
+        if (Base::m_cholmodFactor) cholmod_l_free_factor(&this->m_cholmodFactor, &m_cholmod);
+        Base::m_cholmodFactor = cholmodAnalyzeGiven(matrix, permutation, &m_cholmod);
+        this->m_isInitialized = true;
+        this->m_info = Base::m_cholmodFactor ? Eigen::Success : Eigen::InvalidInput;
+        Base::m_analysisIsOk = Base::m_cholmodFactor != nullptr;
+        Base::m_factorizationIsOk = false;
+    }
+
     // this routine is the one we added
     void update(SparseMatrixD const &H, bool UpOrDown) {
-        // check size
-        Index const size = Base::m_cholmodFactor->n;
-        EIGEN_UNUSED_VARIABLE(size);
-        eigen_assert(size == H.rows());
-
-        cholmod_sparse C_cs = viewAsCholmod(H);
-        /* We have to apply the magic permutation to the update matrix,
-        read page 117 of Cholmod UserGuide.pdf */
-        // Using cholmod_l_* functions instead of cholmod_* because index is Eigen::Index instead of int.
-        cholmod_sparse *C_cs_perm =
-                cholmod_l_submatrix(&C_cs, (Eigen::Index*)Base::m_cholmodFactor->Perm,
-                                  Base::m_cholmodFactor->n, nullptr, -1, true, true, &this->cholmod());
-        assert(C_cs_perm);
-        int isOk = cholmod_l_updown(UpOrDown, C_cs_perm, Base::m_cholmodFactor, &this->cholmod());
-        cholmod_l_free_sparse(&C_cs_perm, &this->cholmod());
-        if (!isOk) {
-            throw(LSST_EXCEPT(lsst::pex::exceptions::RuntimeError, "cholmod_update failed!"));
-        }
+        cholmodUpdate(H, UpOrDown, Base::m_cholmodFactor, &this->cholmod());
     }
 
+    /// The cholmod factor (null before the first factorization), e.g. to compute a selected inverse.
+    cholmod_factor *getFactor() const { return Base::m_cholmodFactor; }
+
+    /// The cholmod workspace to use with getFactor().
+    cholmod_common *getCommon() const { return &m_cholmod; }
+
 protected:
     void init() {
         m_cholmod.final_asis = 1;
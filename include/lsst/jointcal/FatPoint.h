@@ -25,6 +25,8 @@
 #ifndef LSST_JOINTCAL_FAT_POINT_H
 #define LSST_JOINTCAL_FAT_POINT_H
 
+#include "Eigen/Core"
+
 #include "lsst/jointcal/Point.h"
 
 namespace lsst {
@@ -51,6 +53,42 @@ public:
         s << " vxx,vyy,vxy " << vx << ' ' << vy << ' ' << vxy;
     }
 };
+
+/**
+ * Points with uncertainties, as contiguous arrays of their coordinates and (co)variances.
+ *
+ * The batch counterpart of FatPoint, used by AstrometryTransform::transformPosAndErrorsBatch().
+ */
+struct FatPointArrays {
+    Eigen::ArrayXd x, y;
+    Eigen::ArrayXd vx, vy, vxy;
+
+    FatPointArrays() = default;
+    explicit FatPointArrays(Eigen::Index size) { resize(size); }
+
+    Eigen::Index size() const { return x.size(); }
+
+    /// Resize all the arrays; their content is undefined if the size changes.
+    void resize(Eigen::Index size) {
+        x.resize(size);
+        y.resize(size);
+        vx.resize(size);
+        vy.resize(size);
+        vxy.resize(size);
+    }
+
+    /// Set point i from a FatPoint.
+    void set(Eigen::Index i, FatPoint const &point) {
+        x[i] = point.x;
+        y[i] = point.y;
+        vx[i] = point.vx;
+        vy[i] = point.vy;
+        vxy[i] = point.vxy;
+    }
+
+    /// Return point i as a FatPoint.
+    FatPoint get(Eigen::Index i) const { return FatPoint(x[i], y[i], vx[i], vy[i], vxy[i]); }
+};
 }  // namespace jointcal
 }  // namespace lsst
 
@@ -25,12 +25,23 @@
 #ifndef LSST_JOINTCAL_FITTER_BASE_H
 #define LSST_JOINTCAL_FITTER_BASE_H
 
+#include <limits>
+#include <string>
+#include <vector>
+
 #include "lsst/log/Log.h"
 #include "lsst/jointcal/Associations.h"
+#include "lsst/jointcal/BlockJacobiPreconditioner.h"
 #include "lsst/jointcal/CcdImage.h"
 #include "lsst/jointcal/Chi2.h"
 #include "lsst/jointcal/FittedStar.h"
+#include "lsst/jointcal/FitterStatistics.h"
+#include "lsst/jointcal/HessianSolver.h"
+#include "lsst/jointcal/JointcalControl.h"
 #include "lsst/jointcal/MeasuredStar.h"
+#include "lsst/jointcal/PhaseTimer.h"
+#include "lsst/jointcal/RobustLoss.h"
+#include "lsst/jointcal/SparsityPattern.h"
 #include "lsst/jointcal/Tripletlist.h"
 
 namespace lsst {
@@ -44,6 +55,37 @@ enum class MinimizeResult {
     NonFinite       // non-finite chi2 statistic
 };
 
+/// Summary of one call to FitterBase::minimize() made by FitterBase::iterate().
+struct IterationStep {
+    MinimizeResult result;
+    Chi2Statistic chi2;                ///< chi2 after the step.
+    std::size_t nMeasurementOutliers;  ///< Number of measurement outliers rejected by the step.
+    std::size_t nReferenceOutliers;    ///< Number of reference outliers rejected by the step.
+    double seconds;                    ///< Wall time of the step.
+};
+
+/// Result of FitterBase::iterate().
+struct IterationResult {
+    /// Result of the last step: anything but Converged means that the fit did not converge.
+    MinimizeResult result = MinimizeResult::Failed;
+    /// chi2 after the last step.
+    Chi2Statistic chi2;
+    /// All the steps, including the final refit if any.
+    std::vector<IterationStep> steps;
+    /// Was the final refit after rank updates done?
+    bool refit = false;
+    /// The chi2 decrease predicted for the final refit, if it was estimated (NaN otherwise).
+    double refitPredictedDecrease = std::numeric_limits<double>::quiet_NaN();
+};
+
+/// Result of FitterBase::computeParameterCovariances().
+struct ParameterCovariances {
+    /// The covariance of the parameters of the mapping of each CcdImage, in the order of the CcdImageList.
+    std::vector<Eigen::MatrixXd> mappings;
+    /// The covariance of the parameters of each FittedStar, in the order of the FittedStarList.
+    std::vector<Eigen::MatrixXd> fittedStars;
+};
+
 /**
  * Base class for fitters.
  *
@@ -52,8 +94,28 @@ enum class MinimizeResult {
  */
 class FitterBase {
 public:
-    explicit FitterBase(std::shared_ptr<Associations> associations)
-            : _associations(associations), _whatToFit(""), _lastNTrip(0), _nParTot(0), _nMeasuredStars(0) {}
+    /**
+     * @param associations  The associations (images, fitted and reference stars) to fit.
+     * @param control       Options controlling how the fit is computed.
+     *
+     * @throws lsst::pex::exceptions::InvalidParameterError if control is not valid (see
+     *         JointcalControl::validate), e.g. after its fields were set.
+     */
+    explicit FitterBase(std::shared_ptr<Associations> associations,
+                        JointcalControl const &control = JointcalControl())
+            : _associations(associations),
+              _control(validated(control)),
+              _robustLoss(_control.robustLoss, _control.robustLossScale),
+              _solver(makeHessianSolver(_control)),
+              _whatToFit(""),
+              _lastNTrip(0),
+              _nParTot(0),
+              _nMeasuredStars(0),
+              _damping(0) {
+        for (auto const &ccdImage : _associations->getCcdImageList()) {
+            ccdImage->buildMeasurementArrays();
+        }
+    }
 
     /// No copy or move: there is only ever one fitter of a given type.
     FitterBase(FitterBase const &) = delete;
@@ -71,27 +133,47 @@ public:
      * offsetParams, then removes outliers in a loop if requested.
      * Relies on sparse linear algebra via Eigen's CholmodSupport package.
      *
+     * If JointcalControl::assembleNormalEquations is set, the Hessian is accumulated directly from the
+     * derivatives of each term (see HessianAccumulator), instead of being computed as J*J^T from the
+     * full sparse Jacobian J. This uses much less memory on large fits.
+     *
      * @param[in]  whatToFit  See child method assignIndices for valid string values.
      * @param[in]  nSigmaCut  How many sigma to reject outliers at. Outlier
-     *                        rejection ignored for nSigmaCut=0.
+     *                        rejection ignored for nSigmaCut=0. With JointcalControl::robustLoss, the
+     *                        measurement terms are instead down-weighted according to their residuals at
+     *                        each step, so that this cut only needs to catch gross outliers: they are all
+     *                        removed in one pass, and the Hessian is always recomputed.
      * @param[in]  doRankUpdate  Use CholmodSimplicialLDLT2.update() to do a fast rank update after outlier
      *                           removal; otherwise do a slower full recomputation of the matrix.
-     *                           Only matters if nSigmaCut != 0.
-     * @param[in]  doLineSearch  Use boost's brent_find_minima to perform a line search after the gradient
-     *                           solution is found, and apply the scale factor to the computed offsets.
+     *                           Only matters if nSigmaCut != 0. Ignored (always recomputed) if
+     *                           JointcalControl::schurComplement is set. With
+     *                           JointcalControl::adaptiveDowndate, each rejection step only downdates if
+     *                           that is predicted to be faster than recomputing (see _shouldDowndate()).
+     * @param[in]  doLineSearch  Perform a line search after the gradient solution is found, and apply the
+     *                           scale factor to the computed offsets. The search uses boost's
+     *                           brent_find_minima, or the cheaper model based search if
+     *                           JointcalControl::lineSearchMethod is "model".
      *                           The line search is done in the domain [-1, 2], but if the scale factor
      *                           is far from 1.0, then the problem is likely in a significantly non-linear
      *                           regime.
-     * @param[in] dumpMatrixFile  Write the pre-fit Hessian matrix and gradient to the files with "-mat.txt"
-     *                            and "-grad.txt". Be aware, this requires a large increase in memory usage
-     *                            to create a dense matrix before writing it; the output file may be large.
-     *                            Writing the matrix can be helpful for debugging bad fits.
-     *                            Read it and compute the real eigenvalues (recall that the Hessian is
-     *                            symmetric by construction) with numpy:
-     *                            @code{.py}
-     *                             hessian = np.matrix(np.loadtxt("dumpMatrixFile-mat.txt"))
-     *                             values, vectors = np.linalg.eigh(hessian)
-     *                            @endcode
+     *                           Ignored with JointcalControl::levenbergMarquardt, which instead damps the
+     *                           step (see _dampedStep()) until it decreases the chi2.
+     * @param[in] dumpMatrixFile  Write the pre-fit Hessian matrix and gradient to files with this base name,
+     *                            in the format set by JointcalControl::dumpMatrixFormat. Writing the matrix
+     *                            can be helpful for debugging bad fits, and to benchmark solvers offline.
+     *                            - "text": files with "-mat.txt" and "-grad.txt". Be aware, this requires a
+     *                              large increase in memory usage to create a dense matrix before writing
+     *                              it; matrices with more than 2e8 entries are written in binary instead.
+     *                              Read it and compute the real eigenvalues (recall that the Hessian is
+     *                              symmetric by construction) with numpy:
+     *                              @code{.py}
+     *                               hessian = np.matrix(np.loadtxt("dumpMatrixFile-mat.txt"))
+     *                               values, vectors = np.linalg.eigh(hessian)
+     *                              @endcode
+     *                            - "binary": one "-system.bin" file, streamed from the sparse matrix (see
+     *                              writeSparseSystem()). Read it with readSparseSystem() or with
+     *                              `lsst.jointcal.readSparseSystem`.
+     *                            - "matrixMarket": files with "-mat.mtx" and "-grad.mtx".
      *
      * @return  Return code describing success/failure of fit.
      *
@@ -106,21 +188,109 @@ public:
                             bool const doRankUpdate = true, bool const doLineSearch = false,
                             std::string const &dumpMatrixFile = "");
 
+    /**
+     * Call minimize() until it converges (no more outliers), up to maxSteps times.
+     *
+     * A step is retried when rejecting outliers made the chi2 increase. The solver, and so the symbolic
+     * analysis of the Hessian, is kept from step to step. After converging with rank updates, the
+     * downdated factorization may have lost accuracy: the step from the gradient at the final parameters
+     * is then computed with it, and a final full minimize() is only done if that step would decrease the
+     * chi2 by more than JointcalControl::refitTolerance times the chi2. With a zero tolerance, the final
+     * minimize() is always done. If it rejects outliers and the chi2 increases, the iteration goes on.
+     *
+     * @param[in]  whatToFit, nSigmaCut, doRankUpdate, doLineSearch  As for minimize().
+     * @param[in]  maxSteps  Maximum number of calls to minimize(), not counting the final refit.
+     * @param[in]  dumpMatrixFile  As for minimize(), for the first step only.
+     * @param[in]  saveChi2BaseName  If not empty, call saveChi2Contributions() after each step, with
+     *                               "{step}" replaced by the step number in this name.
+     * @param[in]  checkpointFile  If not empty, call saveCheckpoint() with this file every
+     *                             JointcalControl::checkpointInterval steps.
+     * @param[in]  firstStep  The number of steps already done, e.g. as returned by loadCheckpoint() when
+     *                        resuming a fit: the step numbers, and maxSteps, count from there.
+     *
+     * @return  The per step results. The iteration stops at the first step that does not return
+     *          MinimizeResult::Chi2Increased; its result is the one of the whole iteration, which is
+     *          still MinimizeResult::Chi2Increased if maxSteps was reached.
+     */
+    IterationResult iterate(std::string const &whatToFit, std::size_t maxSteps, double nSigmaCut = 0,
+                            bool doRankUpdate = true, bool doLineSearch = false,
+                            std::string const &dumpMatrixFile = "", std::string const &saveChi2BaseName = "",
+                            std::string const &checkpointFile = "", std::size_t firstStep = 0);
+
     /**
      * Returns the chi2 for the current state.
+     *
+     * With JointcalControl::robustLoss, this is the quantity minimized by the fit: the measurement terms
+     * contribute their robust loss (see RobustLoss) instead of their chi2.
      */
     Chi2Statistic computeChi2() const;
 
+    /**
+     * Returns the chi2 for the current state offset by the provided quantities, as it would be after
+     * offsetParams(offset), without modifying the models or the FittedStars.
+     *
+     * Several offsets can thus be evaluated concurrently, and no rounding drift is accumulated by
+     * offsetting the parameters back and forth.
+     *
+     * @param[in]  offset  vector of offsets, with the parameter layout of the last assignIndices().
+     */
+    Chi2Statistic computeChi2(Eigen::VectorXd const &offset) const;
+
+    /**
+     * Compute blocks of the covariance matrix of the fitted parameters (the inverse of the Hessian), for the
+     * current whatToFit, at the current parameters and outliers.
+     *
+     * The Hessian is recomputed and factorized, reusing the symbolic analysis of the previous minimize().
+     * With a cholmod factorization, the entries of its inverse on the pattern of the factor are then
+     * computed all at once by sparse selected inversion, at about the cost of the factorization (see
+     * HessianSolver::computeInverseBlocks): the blocks of parameters that are coupled in the Hessian, like
+     * those of a mapping or a star, are in that pattern. With JointcalControl::schurComplement, the blocks
+     * of a star are formed from its eliminated block and the selected inverse of the reduced system (see
+     * SchurComplementSolver::computeInverseBlocks), without any solve.
+     *
+     * @param blocks  The parameter indices of each block, in the layout of the last assignIndices().
+     *
+     * @return For each block, the covariance matrix of its parameters, in the order of its indices.
+     *
+     * @throws lsst::pex::exceptions::InvalidParameterError if an index is not that of a fitted parameter.
+     * @throws lsst::pex::exceptions::RuntimeError if the Hessian cannot be factorized.
+     */
+    std::vector<Eigen::MatrixXd> computeCovarianceBlocks(std::vector<IndexVector> const &blocks);
+
+    /**
+     * Compute the covariance of the parameters of each mapping and of each FittedStar with
+     * computeCovarianceBlocks(): the block of a mapping that is not being fit is empty, and the block of a
+     * FittedStar holds its fitted position (astrometry) or flux (photometry), or is empty if these are not
+     * being fit.
+     */
+    ParameterCovariances computeParameterCovariances();
+
+    /// The number of parameters being fit, as set by the last assignIndices().
+    Eigen::Index getTotalParameters() const { return _nParTot; }
+
+    /// Counters describing the work done by this fitter so far, including which factorization was used.
+    FitterStatistics const &getStatistics() const { return _statistics; }
+
+    /// Wall time, CPU time and memory used so far by each phase of the fit.
+    FitterTimings const &getTimings() const { return _timings; }
+
     /**
      * Evaluates the chI^2 derivatives (Jacobian and gradient) for the current whatToFit setting.
      *
-     * The Jacobian is given as triplets in a sparse matrix, the gradient as a dense vector.
+     * The Jacobian is passed term by term to an accumulator (e.g. a TripletList that stores it as
+     * triplets of a sparse matrix), the gradient is a dense vector.
      * The parameters which vary, and their indices, are to be set using  assignIndices.
      *
-     * @param      tripletList  tripletList of (row,col,value) representing the Jacobian of the chi2.
+     * With JointcalControl::nThreads > 1, the measurement terms are computed in parallel over groups of
+     * CcdImages, and merged in CcdImage order: the Jacobian is the same as with a single thread.
+     *
+     * @param      accumulator  Receives the Jacobian of the chi2.
      * @param      grad         The gradient of the chi2.
+     * @param      offset       If not null, compute the derivatives at the parameters offset by it, without
+     *                          modifying them.
      */
-    void leastSquareDerivatives(TripletList &tripletList, Eigen::VectorXd &grad) const;
+    void leastSquareDerivatives(JacobianAccumulator &accumulator, Eigen::VectorXd &grad,
+                                Eigen::VectorXd const *offset = nullptr) const;
 
     /**
      * Offset the parameters by the requested quantities. The used parameter
@@ -149,14 +319,65 @@ public:
      */
     virtual void saveChi2Contributions(std::string const &baseName) const;
 
+    /**
+     * Write a checkpoint of the fit in progress to a binary file: the model parameters, the state of
+     * the FittedStars (positions, proper motions, fluxes, measurement counts and reference star
+     * associations), the outlier flags of the MeasuredStars and the current whatToFit.
+     *
+     * The file is written under a temporary name and then renamed, so that an interrupted write does
+     * not destroy a previous checkpoint.
+     *
+     * @param path  The file to write.
+     * @param step  The number of iterate() steps done, returned by loadCheckpoint().
+     *
+     * @throws lsst::pex::exceptions::IoError if the file cannot be written.
+     */
+    void saveCheckpoint(std::string const &path, std::size_t step = 0) const;
+
+    /**
+     * Restore a checkpoint written by saveCheckpoint() into this fitter, which must have been built
+     * from the same inputs: the same CcdImages, stars and associations, and the same kind of model.
+     *
+     * The frozen error transforms of the model (see e.g. AstrometryModel::freezeErrorTransform) are
+     * not part of the checkpoint.
+     *
+     * @param path  The file to read.
+     *
+     * @return The step number that was given to saveCheckpoint().
+     *
+     * @throws lsst::pex::exceptions::IoError if the file cannot be read, or is not a checkpoint.
+     * @throws lsst::pex::exceptions::LengthError if the checkpoint does not match this fit. Nothing is
+     *         modified in that case.
+     */
+    std::size_t loadCheckpoint(std::string const &path);
+
 protected:
     std::shared_ptr<Associations> _associations;
+    JointcalControl _control;
+    // Applied to the measurement terms by the derivative and chi2 computations of the child classes.
+    RobustLoss _robustLoss;
+    // Kept between calls to minimize(), so that the symbolic analysis of the Hessian can be reused.
+    std::unique_ptr<HessianSolver> _solver;
+    // Preconditioner of the conjugate gradient solver, for the current whatToFit and outliers.
+    std::unique_ptr<BlockJacobiPreconditioner> _preconditioner;
+    FitterStatistics _statistics;
+    // Only updated by the non-const driver methods: the const computations may run concurrently.
+    FitterTimings _timings;
     std::string _whatToFit;
+    // The chi2 contributions examined by findOutliers(), kept to reuse their storage from call to call.
+    mutable Chi2List _outlierChi2List;
 
     Eigen::Index _lastNTrip;  // last triplet count, used to speed up allocation
     Eigen::Index _nParTot;
     Eigen::Index _nMeasuredStars;
 
+    // Pattern of the last Hessian assembled from the normal equations, for the same whatToFit.
+    SparsityPattern _hessianPattern;
+
+    // Levenberg-Marquardt state: the undamped Hessian (lower triangle) and the current damping factor.
+    SparseMatrixD _hessian;
+    double _damping;
+
     // lsst.logging instance, to be created by subclass so that messages have consistent name while fitting.
     LOG_LOGGER _log;
 
@@ -174,7 +395,8 @@ protected:
      * The outliers are NOT removed, and no refit is done.
      *
      * After returning from here, there are still measurements that contribute above the cut,
-     * but their contribution should be evaluated after a refit before discarding them.
+     * but their contribution should be evaluated after a refit before discarding them; except with a
+     * robust loss, where all the terms above the cut are returned.
      *
      * @param[in]  nSigmaCut   Number of sigma to select on.
      * @param[out] msOutliers  list of MeasuredStar outliers to populate
@@ -187,52 +409,225 @@ protected:
 
     /**
      * Contributions to derivatives from (presumably) outlier terms. No
-     * discarding done.
+     * discarding done. The measurement terms are computed once per CcdImage.
      */
     void outliersContributions(MeasuredStarList &msOutliers, FittedStarList &fsOutliers,
                                TripletList &tripletList, Eigen::VectorXd &grad);
 
+    /// The parameters of the model, and any other fitted parameter not attached to stars, for checkpoints.
+    virtual Eigen::VectorXd getModelParameters() const = 0;
+
+    /**
+     * Set the parameters returned by getModelParameters(), to restore a checkpoint.
+     *
+     * @throws lsst::pex::exceptions::LengthError if parameters does not match the model. Nothing is
+     *         modified in that case.
+     */
+    virtual void setModelParameters(Eigen::VectorXd const &parameters) = 0;
+
     /// Remove measuredStar outliers from the fit. No Refit done.
     void removeMeasOutliers(MeasuredStarList &outliers);
 
     /// Remove refStar outliers from the fit. No Refit done.
     void removeRefOutliers(FittedStarList &outliers);
 
+    /**
+     * Blocks of parameters that are only coupled to parameters outside of all the blocks, for the current
+     * whatToFit, which a Schur complement solver can eliminate (see JointcalControl::schurComplement).
+     */
+    virtual std::vector<ParameterBlock> getEliminableBlocks() const { return {}; }
+
+    /// Set the indices of the parameters of the mapping of ccdImage being fitted (none if not fitted).
+    virtual void getIndicesOfMapping(CcdImage const &ccdImage, IndexVector &indices) const = 0;
+
+    /// Set the indices of the fitted position or flux of fittedStar (none if not fitted).
+    virtual void getIndicesOfFittedStar(FittedStar const &fittedStar, IndexVector &indices) const = 0;
+
     /// Set the indices of a measured star from the full matrix, for outlier removal.
     virtual void getIndicesOfMeasuredStar(MeasuredStar const &measuredStar,
                                           IndexVector &indices) const = 0;
 
-    /// Compute the chi2 (per star or total, depending on which Chi2Accumulator is used) for measurements.
-    virtual void accumulateStatImageList(CcdImageList const &ccdImageList, Chi2Accumulator &accum) const = 0;
+    /**
+     * Compute the chi2 (per star or total, depending on which Chi2Accumulator is used) for measurements.
+     *
+     * Each CcdImage is accumulated separately (in parallel if JointcalControl::nThreads > 1), and the
+     * results are merged in CcdImage order, so that they are bit-identical for any number of threads.
+     * The last argument evaluates the chi2 at the parameters offset by it, without modifying them.
+     */
+    void accumulateStatImageList(CcdImageList const &ccdImageList, Chi2Accumulator &accum,
+                                 Eigen::VectorXd const *offset = nullptr) const;
+
+    /**
+     * Bring up to date what the measurement term computations share between the CcdImages, e.g. a cache,
+     * after the parameters changed. Does nothing by default.
+     *
+     * The const computations (accumulateStatImageList(), leastSquareDerivatives()) only read what this
+     * prepares, so that several of them can run concurrently: it is called by the non-const methods that
+     * change the parameters, e.g. assignIndices(), offsetParams() and loadCheckpoint().
+     */
+    virtual void prepareMeasurementTerms() {}
+
+    /**
+     * Compute the chi2 (per star or total, depending on which Chi2Accumulator is used) from one CcdImage.
+     *
+     * The last argument evaluates the chi2 at the parameters offset by it, without modifying them.
+     */
+    virtual void accumulateStatImage(CcdImage const &ccdImage, Chi2Accumulator &accum,
+                                     Eigen::VectorXd const *offset = nullptr) const = 0;
 
-    /// Compute the chi2 (per star or total, depending on which Chi2Accumulator is used) for RefStars.
-    virtual void accumulateStatRefStars(Chi2Accumulator &accum) const = 0;
+    /**
+     * Compute the chi2 (per star or total, depending on which Chi2Accumulator is used) for RefStars.
+     *
+     * The last argument evaluates the chi2 at the parameters offset by it, without modifying them.
+     */
+    virtual void accumulateStatRefStars(Chi2Accumulator &accum,
+                                        Eigen::VectorXd const *offset = nullptr) const = 0;
 
     /**
      * Compute the derivatives of the measured stars and model for one CcdImage.
      *
-     * The last argument will process a sub-list for outlier removal.
+     * The measuredStarList argument will process a sub-list for outlier removal. The offset argument
+     * computes the derivatives at the parameters offset by it, without modifying them.
      */
-    virtual void leastSquareDerivativesMeasurement(
-            CcdImage const &ccdImage, TripletList &tripletList, Eigen::VectorXd &grad,
-            MeasuredStarList const *measuredStarList = nullptr) const = 0;
+    virtual void leastSquareDerivativesMeasurement(CcdImage const &ccdImage, JacobianAccumulator &accumulator,
+                                                   Eigen::VectorXd &grad,
+                                                   MeasuredStarList const *measuredStarList = nullptr,
+                                                   Eigen::VectorXd const *offset = nullptr) const = 0;
 
-    /// Compute the derivatives of the reference terms
+    /**
+     * Compute the derivatives of the reference terms.
+     *
+     * The last argument computes the derivatives at the parameters offset by it, without modifying them.
+     */
     virtual void leastSquareDerivativesReference(FittedStarList const &fittedStarList,
-                                                 TripletList &tripletList, Eigen::VectorXd &grad) const = 0;
+                                                 JacobianAccumulator &accumulator, Eigen::VectorXd &grad,
+                                                 Eigen::VectorXd const *offset = nullptr) const = 0;
 
 private:
+    /**
+     * Validate control before anything is built from it: its fields may have been set after its
+     * constructor validated them.
+     */
+    static JointcalControl const &validated(JointcalControl const &control) {
+        control.validate();
+        return control;
+    }
+
+    /**
+     * Compute the gradient, and prepare to solve for the step: factorize the Hessian, or compute the
+     * preconditioner with JointcalControl::conjugateGradient.
+     *
+     * @param[out] grad  The gradient of the chi2, must be zeroed and of size _nParTot.
+     * @param dumpMatrixFile  If not empty, dump the Hessian and gradient to this file.
+     *
+     * @return false if the factorization failed.
+     */
+    bool _prepareSolve(Eigen::VectorXd &grad, std::string const &dumpMatrixFile);
+
+    /// Factorize _hessian with its diagonal scaled by 1 + _damping.
+    bool _factorizeDamped();
+
+    /**
+     * Take a Levenberg-Marquardt step from the current damped factorization.
+     *
+     * The step is accepted (and applied with offsetParams) if it decreases the chi2, and the damping is then
+     * reduced according to the ratio of the actual to the predicted decrease; otherwise the damping is
+     * increased and the Hessian refactorized, up to JointcalControl::levenbergMarquardtMaxTrials times.
+     *
+     * @param grad  The gradient at the current parameters.
+     * @param chi2  The chi2 at the current parameters.
+     *
+     * @return false if a factorization failed.
+     */
+    bool _dampedStep(Eigen::VectorXd const &grad, double chi2);
+
+    /// Solve for the step, after _prepareSolve().
+    Eigen::VectorXd _solveStep(Eigen::VectorXd const &grad);
+
+    /**
+     * The blocks of the block-Jacobi preconditioner: the parameters of each mapping, those of each block
+     * returned by getEliminableBlocks(), and single parameters for the rest.
+     */
+    std::vector<ParameterBlock> _getPreconditionerBlocks() const;
+
+    /// Compute the gradient and the preconditioner of the conjugate gradient solver.
+    void _computePreconditioner(Eigen::VectorXd &grad);
+
+    /// Product of the Hessian with vector, computed from the derivatives without forming the Hessian.
+    Eigen::VectorXd _hessianProduct(Eigen::VectorXd const &vector) const;
+
+    /**
+     * Solve Hessian*delta = grad with a matrix-free preconditioned conjugate gradient, stopping at
+     * JointcalControl::conjugateGradientTolerance relative residual, or after
+     * JointcalControl::conjugateGradientMaxIterations iterations.
+     */
+    Eigen::VectorXd _solveConjugateGradient(Eigen::VectorXd const &grad);
+
+    /**
+     * Compute the Hessian and the gradient for the current whatToFit setting.
+     *
+     * Depending on JointcalControl::assembleNormalEquations, the Hessian is either computed as
+     * J*J^T from the sparse Jacobian, or accumulated directly, in which case only its lower triangle
+     * is filled.
+     *
+     * @param[out] grad  The gradient of the chi2, must be zeroed and of size _nParTot.
+     *
+     * @return The Hessian.
+     */
+    SparseMatrixD _computeHessian(Eigen::VectorXd &grad);
+
+    /**
+     * Decide whether to downdate the factorization by the outlier contribution of the given rank (number of
+     * Jacobian columns), rather than recomputing and refactorizing the Hessian, and record the prediction
+     * in the statistics. Always true unless JointcalControl::adaptiveDowndate is set.
+     *
+     * The downdate cost is the rank times the cost per rank of the last downdate or, before any, the
+     * factorization time times HessianSolver::getRelativeDowndateCost(); it is compared to the measured
+     * time of the last refactorization.
+     */
+    bool _shouldDowndate(std::size_t rank);
+
+    /**
+     * The chi2 decrease of the step computed with the current factorization (or preconditioner) from the
+     * gradient at the current parameters.
+     */
+    double _predictedChi2Decrease();
+
+    /// The number of threads to use, from JointcalControl::nThreads.
+    std::size_t _getNThreads() const;
+
+    //@{
+    /// computeChi2(), timed in _timings.chi2.
+    Chi2Statistic _timedChi2();
+    Chi2Statistic _timedChi2(Eigen::VectorXd const &offset);
+    //@}
+
     /**
      * Performe a line search along vector delta, returning a scale factor for the minimum.
      *
-     * Note that this offsets and restores the model during each iteration of the line search,
-     * as part of the minimization schema.
+     * The chi2 is evaluated at each trial step with computeChi2(offset), which leaves the model untouched
+     * (the slopes used by the "model" line search with the Wolfe condition still offset and restore it).
      *
      * @param delta The vector of offsets that is expected to reach the minimium value.
+     * @param grad  The gradient delta was solved for.
+     * @param startChi2  The chi2 at the current parameters, or NaN if unknown.
      *
      * @return The scale factor to apply to delta that gets it to the true minimum.
      */
-    double _lineSearch(Eigen::VectorXd const &delta);
+    double _lineSearch(Eigen::VectorXd const &delta, Eigen::VectorXd const &grad, double startChi2);
+
+    /**
+     * Line search based on the quadratic model of the chi2 given by the gradient and Hessian: the full
+     * step is tried first, and refined by quadratic or cubic interpolation of the chi2 until it satisfies
+     * the Armijo (and, if JointcalControl::lineSearchWolfe > 0, the strong Wolfe curvature) condition,
+     * within JointcalControl::lineSearchMaxEvaluations chi2 evaluations.
+     *
+     * Parameters and return value as for _lineSearch().
+     */
+    double _modelLineSearch(Eigen::VectorXd const &delta, Eigen::VectorXd const &grad, double startChi2);
+
+    /// The derivative of the chi2 along delta at the parameters offset by offset, without modifying them.
+    double _slopeAtOffset(Eigen::VectorXd const &offset, Eigen::VectorXd const &delta) const;
 };
 }  // namespace jointcal
 }  // namespace lsst
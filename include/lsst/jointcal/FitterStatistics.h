@@ -0,0 +1,117 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef LSST_JOINTCAL_FITTER_STATISTICS_H
+#define LSST_JOINTCAL_FITTER_STATISTICS_H
+
+#include <cstddef>
+#include <string>
+
+namespace lsst {
+namespace jointcal {
+
+/**
+ * Counters describing the work done by a fitter, accumulated over its lifetime.
+ */
+struct FitterStatistics {
+    /// The factorization actually computed by the last successful factorization.
+    std::string factorization;
+    /// Number of symbolic analyses (fill-reducing ordering and elimination tree) of the Hessian.
+    std::size_t nSymbolicAnalyses = 0;
+    /**
+     * Fill-reducing ordering chosen by the last symbolic analysis: "amd", "colamd", "metis", "nesdis",
+     * "natural", or "cached" if it was read from the ordering cache (see JointcalControl::orderingCacheDir).
+     */
+    std::string ordering;
+    /// Number of symbolic analyses that read their ordering from the ordering cache.
+    std::size_t nCachedOrderings = 0;
+    /// Number of non-zeros of the factor, as predicted by the last symbolic analysis.
+    double factorNonZeros = 0;
+    /// Number of floating point operations of a numeric factorization, from the last symbolic analysis.
+    double factorizationFlops = 0;
+    /**
+     * Number of triplets stored by the last assembly of the normal equations (see
+     * JointcalControl::assembleNormalEquations): the entries found in the pattern of the previous Hessian
+     * are summed in place instead.
+     */
+    std::size_t lastHessianTriplets = 0;
+    /// Number of numeric factorizations of the Hessian.
+    std::size_t nNumericFactorizations = 0;
+    /// Number of measurement outliers rejected by the last minimize().
+    std::size_t lastMeasurementOutliers = 0;
+    /// Number of reference outliers rejected by the last minimize().
+    std::size_t lastReferenceOutliers = 0;
+    /// Number of outlier downdates applied to a factorization.
+    std::size_t nDowndates = 0;
+    /// Number of outlier rejection steps that recomputed and refactorized the Hessian instead of downdating.
+    std::size_t nOutlierRefactorizations = 0;
+    /// How the last outlier rejection step updated the factorization: "downdate" or "refactorization".
+    std::string lastOutlierUpdate;
+    /**
+     * Rank (number of Jacobian columns) of the contribution of the outliers of the last rejection step,
+     * 0 if it was not computed because the factorization could not be downdated anyway.
+     */
+    std::size_t lastOutlierRank = 0;
+    /// Wall time (seconds) of the last numeric factorization.
+    double lastFactorizationSeconds = 0;
+    /// Wall time (seconds) of the last computation of the Hessian and gradient followed by a factorization.
+    double lastRefactorizationSeconds = 0;
+    /// Wall time (seconds) of the last outlier downdate, including the outlier derivatives.
+    double lastDowndateSeconds = 0;
+    /// Rank of the last outlier downdate.
+    std::size_t lastDowndateRank = 0;
+    /// Downdate time (seconds) predicted by the cost model at the last adaptive decision.
+    double lastPredictedDowndateSeconds = 0;
+    /// Refactorization time (seconds) the prediction was compared to at the last adaptive decision.
+    double lastComparedRefactorizationSeconds = 0;
+    /// Number of parameters of the last reduced system factorized by the Schur complement solver.
+    std::size_t nReducedParameters = 0;
+    /// Total number of iterations of the conjugate gradient solver.
+    std::size_t nConjugateGradientIterations = 0;
+    /// Number of iterations of the last conjugate gradient solve.
+    std::size_t lastConjugateGradientIterations = 0;
+    /// Residual norm of the last conjugate gradient solve, relative to the norm of the gradient.
+    double lastConjugateGradientResidual = 0;
+    /// Number of line searches.
+    std::size_t nLineSearches = 0;
+    /// Total number of chi2 evaluations spent in line searches.
+    std::size_t nLineSearchChi2Evaluations = 0;
+    /// Total number of gradient evaluations spent in line searches (to check the Wolfe condition).
+    std::size_t nLineSearchGradientEvaluations = 0;
+    /// Scale factor found by the last line search.
+    double lastLineSearchScale = 0;
+    /// Number of Levenberg-Marquardt trial steps (each but the first of a step costing a factorization).
+    std::size_t nDampedSteps = 0;
+    /// Number of Levenberg-Marquardt trial steps rejected because they did not decrease the chi2.
+    std::size_t nRejectedDampedSteps = 0;
+    /// Damping factor of the last Levenberg-Marquardt trial step.
+    double lastDampingFactor = 0;
+    /// Ratio of the actual to the predicted chi2 decrease of the last Levenberg-Marquardt trial step.
+    double lastDampingRatio = 0;
+};
+
+}  // namespace jointcal
+}  // namespace lsst
+
+#endif  // LSST_JOINTCAL_FITTER_STATISTICS_H
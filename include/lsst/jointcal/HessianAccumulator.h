@@ -0,0 +1,133 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef LSST_JOINTCAL_HESSIAN_ACCUMULATOR_H
+#define LSST_JOINTCAL_HESSIAN_ACCUMULATOR_H
+
+#include <utility>
+#include <vector>
+
+#include "Eigen/Core"
+
+#include "lsst/jointcal/Eigenstuff.h"
+#include "lsst/jointcal/SparsityPattern.h"
+#include "lsst/jointcal/Tripletlist.h"
+
+namespace lsst {
+namespace jointcal {
+
+/**
+ * Accumulate the normal equations matrix (J*J^T) of the fit directly from the Jacobian terms.
+ *
+ * The Jacobian is never stored: each term's block contributes its outer product to the lower triangle
+ * of the Hessian, kept as triplets (duplicates are summed when the matrix is built). Between
+ * beginSharedBlock() and endSharedBlock(), the products between the shared parameters (the mapping
+ * of one CcdImage) are summed in a small dense matrix and emitted once per block.
+ *
+ * Given the pattern of a previous Hessian of the same fit (typically the last one, before outliers were
+ * rejected), the entries it contains are instead summed in place into one value per entry of the
+ * pattern: only the entries outside of it are stored as triplets.
+ *
+ * Only the lower triangle is stored, which is what CholmodSimplicialLDLT2<SparseMatrixD, Eigen::Lower>
+ * reads.
+ */
+class HessianAccumulator : public JacobianAccumulator {
+public:
+    /**
+     * @param nParTot  Number of parameters of the fit, i.e. the size of the Hessian.
+     * @param count    Number of triplets to reserve space for.
+     * @param pattern  If not null, and of size nParTot, the pattern to sum entries into. Must outlive this
+     *                 accumulator and its clones.
+     */
+    HessianAccumulator(Eigen::Index nParTot, std::size_t count, SparsityPattern const *pattern = nullptr);
+
+    void addTerm(IndexVector const &indices, Eigen::Ref<Eigen::MatrixXd const> const &jacobian) override;
+
+    void beginSharedBlock(IndexVector const &indices) override;
+
+    void endSharedBlock() override;
+
+    std::unique_ptr<JacobianAccumulator> makeEmptyClone() const override;
+
+    void merge(JacobianAccumulator &other) override;
+
+    /// Number of (not yet summed) triplets accumulated so far: none for the entries of the pattern.
+    std::size_t size() const { return _triplets.size(); }
+
+    /// Build the lower triangle of the Hessian, and release the triplets and summed values.
+    SparseMatrixD makeHessian();
+
+private:
+    Eigen::Index _nParTot;
+    std::vector<Trip> _triplets;
+    // The pattern the entries are summed into (null if none), and their sums.
+    SparsityPattern const *_pattern;
+    std::vector<double> _values;
+    // The parameters shared by the current block of terms, and their dense Hessian block (lower part).
+    IndexVector _sharedIndices;
+    Eigen::MatrixXd _sharedBlock;
+
+    void addLower(Eigen::Index i, Eigen::Index j, double val) {
+        if (i < j) std::swap(i, j);
+        std::ptrdiff_t entry = (_pattern) ? _pattern->findEntry(i, j) : -1;
+        if (entry >= 0) {
+            _values[entry] += val;
+        } else {
+            _triplets.emplace_back(i, j, val);
+        }
+    }
+};
+
+/**
+ * Accumulate the product of the Hessian (J*J^T) of the fit with a vector, without storing J nor J*J^T.
+ *
+ * Each term adds J_t*(J_t^T*v), where J_t is its block of the Jacobian. This is what matrix-free
+ * solvers need at each iteration.
+ */
+class HessianProductAccumulator : public JacobianAccumulator {
+public:
+    /**
+     * @param vector  The vector to multiply the Hessian with. Must outlive this accumulator and its clones.
+     */
+    explicit HessianProductAccumulator(Eigen::VectorXd const &vector);
+
+    void addTerm(IndexVector const &indices, Eigen::Ref<Eigen::MatrixXd const> const &jacobian) override;
+
+    std::unique_ptr<JacobianAccumulator> makeEmptyClone() const override;
+
+    void merge(JacobianAccumulator &other) override;
+
+    /// The accumulated product.
+    Eigen::VectorXd const &getProduct() const { return _product; }
+
+private:
+    Eigen::VectorXd const &_vector;
+    Eigen::VectorXd _product;
+};
+
+}  // namespace jointcal
+}  // namespace lsst
+
+#endif  // LSST_JOINTCAL_HESSIAN_ACCUMULATOR_H
@@ -0,0 +1,179 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef LSST_JOINTCAL_HESSIAN_SOLVER_H
+#define LSST_JOINTCAL_HESSIAN_SOLVER_H
+
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Eigen/Core"
+
+#include "lsst/jointcal/Eigenstuff.h"
+#include "lsst/jointcal/FitterStatistics.h"
+#include "lsst/jointcal/JointcalControl.h"
+#include "lsst/jointcal/SparsityPattern.h"
+
+namespace lsst {
+namespace jointcal {
+
+/// A contiguous range of fit parameters.
+struct ParameterBlock {
+    Eigen::Index start;  ///< Index of the first parameter.
+    Eigen::Index size;   ///< Number of parameters.
+};
+
+/**
+ * Factorization of the Hessian of a fit, used by FitterBase::minimize to solve for the step.
+ *
+ * The symbolic analysis is kept between calls to factorize(): it is only redone if the pattern of the
+ * new Hessian is not contained in the pattern of the analyzed one; otherwise only the numeric
+ * factorization is computed. Only the lower triangle of the Hessian is read.
+ */
+class HessianSolver {
+public:
+    HessianSolver() = default;
+    virtual ~HessianSolver() = default;
+
+    /// No copy or move: the factorization can be large.
+    HessianSolver(HessianSolver const &) = delete;
+    HessianSolver(HessianSolver &&) = delete;
+    HessianSolver &operator=(HessianSolver const &) = delete;
+    HessianSolver &operator=(HessianSolver &&) = delete;
+
+    /**
+     * Factorize hessian, reusing the previous symbolic analysis if possible.
+     *
+     * @param hessian  The (compressed) Hessian; only its lower triangle is used.
+     * @param statistics  Updated with the work done.
+     *
+     * @return true if the factorization succeeded.
+     */
+    virtual bool factorize(SparseMatrixD const &hessian, FitterStatistics &statistics);
+
+    /// Solve hessian*x = rhs with the current factorization.
+    virtual Eigen::VectorXd solve(Eigen::VectorXd const &rhs) const = 0;
+
+    /// The number of parameters of the last factorized Hessian.
+    virtual Eigen::Index getNParameters() const = 0;
+
+    /**
+     * Remove the contribution H*H^T from the factorized Hessian.
+     *
+     * @param H  The Jacobian of the removed terms, with one row per parameter.
+     * @param statistics  Updated with the work done.
+     */
+    virtual void downdate(SparseMatrixD const &H, FitterStatistics &statistics) = 0;
+
+    /**
+     * Compute blocks of the inverse of the Hessian, which must have been successfully factorized.
+     *
+     * This implementation solves for one column of the inverse per parameter of each block; the cholmod
+     * solvers instead compute the entries of the inverse on the pattern of their factor, at about the
+     * cost of a numeric factorization, and only solve for the blocks that are not in that pattern.
+     *
+     * @param blocks  The parameter indices of each block.
+     *
+     * @return For each block, the submatrix of the inverse with its indices as rows and columns.
+     */
+    virtual std::vector<Eigen::MatrixXd> computeInverseBlocks(std::vector<IndexVector> const &blocks) const;
+
+    /// Can downdate() be called? If not, the Hessian must be recomputed and factorized instead.
+    virtual bool canDowndate() const { return true; }
+
+    /**
+     * Estimated cost of a rank-1 downdate of the current factorization, relative to the cost of its
+     * numeric factorization, or NaN if unknown.
+     */
+    virtual double getRelativeDowndateCost() const { return std::numeric_limits<double>::quiet_NaN(); }
+
+    /// A description of the current factorization (e.g. "simplicial LDLT").
+    virtual std::string getMethod() const = 0;
+
+    /**
+     * Declare blocks of parameters that are coupled only to parameters outside of all the blocks.
+     *
+     * Solvers that can take advantage of this structure use it from the next factorize() on; the others
+     * ignore it.
+     */
+    virtual void setEliminableBlocks(std::vector<ParameterBlock> blocks) {}
+
+protected:
+    /**
+     * Compute the symbolic analysis of hessian; return true on success.
+     *
+     * @param hessian  The Hessian to analyze.
+     * @param statistics  Updated with the ordering, and the predicted size and cost of the factorization.
+     */
+    virtual bool analyzePattern(SparseMatrixD const &hessian, FitterStatistics &statistics) = 0;
+
+    /// Compute the numeric factorization of hessian, whose pattern was analyzed; return true on success.
+    virtual bool factorizeNumeric(SparseMatrixD const &hessian) = 0;
+
+    /// Force the next factorize() to redo the symbolic analysis.
+    void invalidateAnalysis() { _analyzedPattern.clear(); }
+
+    /// The submatrix of the inverse of the factorized Hessian with the given indices, computed with solve().
+    Eigen::MatrixXd solveInverseBlock(IndexVector const &indices) const;
+
+private:
+    // The pattern of the Hessian that the symbolic analysis was computed for.
+    SparsityPattern _analyzedPattern;
+};
+
+/**
+ * Are the METIS based orderings ("metis" and "nesdis") available? They are not if jointcal is built with
+ * NPARTITION (see lib/SConscript), which leaves out the partition module of cholmod.
+ */
+bool isPartitioningAvailable();
+
+/**
+ * Make a HessianSolver with a cholmod simplicial LDLT factorization, which can be downdated in place.
+ *
+ * @param ordering  The fill-reducing ordering of the symbolic analysis: "default" for the cholmod default
+ *                  strategy (AMD, and METIS too if AMD gives a lot of fill-in and isPartitioningAvailable()),
+ *                  or one of "amd", "colamd", "metis", "nesdis" and "natural". "metis" and "nesdis" fall back
+ *                  to "amd", with a warning, if the cholmod library was built without METIS.
+ * @param orderingCacheDir  If not empty, an existing directory where the orderings are cached, in files
+ *                          named after the ordering and a hash of the pattern of the Hessian: the analysis
+ *                          of a Hessian with a cached pattern skips the computation of the ordering.
+ *
+ * @throws lsst::pex::exceptions::InvalidParameterError if ordering is not one of the above, or if it is
+ *         "metis" or "nesdis" but isPartitioningAvailable() is false.
+ */
+std::unique_ptr<HessianSolver> makeHessianSolver(std::string const &ordering = "default",
+                                                 std::string const &orderingCacheDir = "");
+
+/**
+ * Make the HessianSolver requested by control: a Schur complement solver if control.schurComplement is set,
+ * using a cholmod solver for the reduced system, or else just the latter.
+ */
+std::unique_ptr<HessianSolver> makeHessianSolver(JointcalControl const &control);
+
+}  // namespace jointcal
+}  // namespace lsst
+
+#endif  // LSST_JOINTCAL_HESSIAN_SOLVER_H
@@ -38,10 +38,95 @@ namespace jointcal {
 
 struct JointcalControl {
     LSST_CONTROL_FIELD(sourceFluxField, std::string, "name of flux field in source catalog");
+    LSST_CONTROL_FIELD(assembleNormalEquations, bool,
+                       "Accumulate the Hessian directly from each term's derivatives, instead of building "
+                       "the full sparse Jacobian J and computing J*J^T");
+    LSST_CONTROL_FIELD(nThreads, int,
+                       "Number of threads used to compute the fit derivatives (0 means one per core)");
+    LSST_CONTROL_FIELD(ordering, std::string,
+                       "Fill-reducing ordering of the factorization: default (cholmod's strategy), amd, "
+                       "colamd, metis, nesdis or natural. metis and nesdis are only available if "
+                       "isPartitioningAvailable()");
+    LSST_CONTROL_FIELD(orderingCacheDir, std::string,
+                       "Existing directory where the fill-reducing orderings are cached, keyed by a hash of "
+                       "the pattern of the Hessian, so that repeated fits skip computing them; empty to not "
+                       "cache them");
+    LSST_CONTROL_FIELD(schurComplement, bool,
+                       "Eliminate the fitted star parameters from the normal equations, factorize the "
+                       "reduced system over the other parameters, then back-substitute the stars");
+    LSST_CONTROL_FIELD(adaptiveDowndate, bool,
+                       "When rejecting outliers with rank updates, downdate the factorization only if the "
+                       "cost model predicts it to be faster than recomputing and refactorizing the Hessian");
+    LSST_CONTROL_FIELD(refitTolerance, double,
+                       "FitterBase::iterate() skips the final refit after rank updates if the step it would "
+                       "take is predicted to decrease the chi2 by less than this fraction of the chi2; "
+                       "with 0, the refit is always done");
+    LSST_CONTROL_FIELD(conjugateGradient, bool,
+                       "Solve the normal equations with a matrix-free block-Jacobi preconditioned conjugate "
+                       "gradient, which never builds nor factorizes the Hessian");
+    LSST_CONTROL_FIELD(conjugateGradientTolerance, double,
+                       "Residual norm, relative to the gradient norm, at which the conjugate gradient stops");
+    LSST_CONTROL_FIELD(conjugateGradientMaxIterations, int,
+                       "Maximum number of conjugate gradient iterations per solve");
+    LSST_CONTROL_FIELD(lineSearchMethod, std::string,
+                       "Line search method: brent (precise minimum, many chi2 evaluations) or model "
+                       "(checks and refines the minimum of the quadratic model with few evaluations)");
+    LSST_CONTROL_FIELD(lineSearchArmijo, double,
+                       "Sufficient decrease (Armijo) parameter of the model line search, in (0, 1)");
+    LSST_CONTROL_FIELD(lineSearchWolfe, double,
+                       "Curvature (strong Wolfe) parameter of the model line search, in "
+                       "(lineSearchArmijo, 1); 0 to skip this check, which costs a gradient evaluation");
+    LSST_CONTROL_FIELD(lineSearchMaxEvaluations, int,
+                       "Maximum number of chi2 evaluations of the model line search");
+    LSST_CONTROL_FIELD(levenbergMarquardt, bool,
+                       "Take damped (Levenberg-Marquardt) steps, solving (H + lambda*diag(H))*delta = grad "
+                       "and adapting lambda to the ratio of the actual to the predicted chi2 decrease");
+    LSST_CONTROL_FIELD(levenbergMarquardtInitialDamping, double,
+                       "Initial damping factor lambda of the Levenberg-Marquardt steps");
+    LSST_CONTROL_FIELD(levenbergMarquardtMaxTrials, int,
+                       "Maximum number of damping factors tried per Levenberg-Marquardt step");
+    LSST_CONTROL_FIELD(levenbergMarquardtTolerance, double,
+                       "A Levenberg-Marquardt step predicted to decrease the chi2 by less than this fraction "
+                       "of the chi2 is converged: it is not retried with more damping");
+    LSST_CONTROL_FIELD(robustLoss, std::string,
+                       "Loss applied to the measurement terms, by reweighting them at each step (see "
+                       "RobustLoss): none (least squares), huber, cauchy or tukey. Tukey gives no weight at "
+                       "all (but a tiny floor) to the terms beyond robustLossScale");
+    LSST_CONTROL_FIELD(robustLossScale, double,
+                       "Scale of the robust loss, in units of the measurement errors; 0 for the usual "
+                       "tuning constant of the loss");
+    LSST_CONTROL_FIELD(checkpointInterval, int,
+                       "FitterBase::iterate() writes a checkpoint every this many steps, if given a "
+                       "checkpoint file; 0 to never write checkpoints");
+    LSST_CONTROL_FIELD(dumpMatrixFormat, std::string,
+                       "Format of the Hessian and gradient dumps: text (dense matrix, limited in size), "
+                       "binary (streamed sparse CSC arrays, see writeSparseSystem) or matrixMarket");
 
     explicit JointcalControl(std::string const& sourceFluxField = "slot_CalibFlux")
             :  // Set sourceFluxType to the value used in the source selector.
-              sourceFluxField(sourceFluxField) {
+              sourceFluxField(sourceFluxField),
+              assembleNormalEquations(false),
+              nThreads(1),
+              ordering("default"),
+              orderingCacheDir(""),
+              schurComplement(false),
+              adaptiveDowndate(false),
+              refitTolerance(0),
+              conjugateGradient(false),
+              conjugateGradientTolerance(1e-8),
+              conjugateGradientMaxIterations(1000),
+              lineSearchMethod("brent"),
+              lineSearchArmijo(1e-4),
+              lineSearchWolfe(0),
+              lineSearchMaxEvaluations(3),
+              levenbergMarquardt(false),
+              levenbergMarquardtInitialDamping(1e-3),
+              levenbergMarquardtMaxTrials(10),
+              levenbergMarquardtTolerance(1e-10),
+              robustLoss("none"),
+              robustLossScale(0),
+              checkpointInterval(1),
+              dumpMatrixFormat("text") {
         validate();
     }
 
@@ -51,6 +136,69 @@ struct JointcalControl {
         if (sourceFluxField.empty()) {
             throw LSST_EXCEPT(pexExcept::InvalidParameterError, "sourceFluxField must be specified");
         }
+        if (nThreads < 0) {
+            throw LSST_EXCEPT(pexExcept::InvalidParameterError, "nThreads must be >= 0");
+        }
+        if (ordering != "default" && ordering != "amd" && ordering != "colamd" && ordering != "metis" &&
+            ordering != "nesdis" && ordering != "natural") {
+            throw LSST_EXCEPT(pexExcept::InvalidParameterError,
+                              "ordering must be default, amd, colamd, metis, nesdis or natural, not " +
+                                      ordering);
+        }
+        if (!(refitTolerance >= 0)) {
+            throw LSST_EXCEPT(pexExcept::InvalidParameterError, "refitTolerance must be >= 0");
+        }
+        if (!(conjugateGradientTolerance > 0)) {
+            throw LSST_EXCEPT(pexExcept::InvalidParameterError, "conjugateGradientTolerance must be > 0");
+        }
+        if (conjugateGradientMaxIterations <= 0) {
+            throw LSST_EXCEPT(pexExcept::InvalidParameterError, "conjugateGradientMaxIterations must be > 0");
+        }
+        if (lineSearchMethod != "brent" && lineSearchMethod != "model") {
+            throw LSST_EXCEPT(pexExcept::InvalidParameterError,
+                              "lineSearchMethod must be brent or model, not " + lineSearchMethod);
+        }
+        if (!(lineSearchArmijo > 0 && lineSearchArmijo < 1)) {
+            throw LSST_EXCEPT(pexExcept::InvalidParameterError, "lineSearchArmijo must be in (0, 1)");
+        }
+        if (lineSearchWolfe != 0 && !(lineSearchWolfe > lineSearchArmijo && lineSearchWolfe < 1)) {
+            throw LSST_EXCEPT(pexExcept::InvalidParameterError,
+                              "lineSearchWolfe must be 0, or in (lineSearchArmijo, 1)");
+        }
+        if (lineSearchMaxEvaluations <= 0) {
+            throw LSST_EXCEPT(pexExcept::InvalidParameterError, "lineSearchMaxEvaluations must be > 0");
+        }
+        if (levenbergMarquardt && conjugateGradient) {
+            throw LSST_EXCEPT(pexExcept::InvalidParameterError,
+                              "levenbergMarquardt cannot be used with conjugateGradient");
+        }
+        if (!(levenbergMarquardtInitialDamping > 0)) {
+            throw LSST_EXCEPT(pexExcept::InvalidParameterError,
+                              "levenbergMarquardtInitialDamping must be > 0");
+        }
+        if (levenbergMarquardtMaxTrials <= 0) {
+            throw LSST_EXCEPT(pexExcept::InvalidParameterError, "levenbergMarquardtMaxTrials must be > 0");
+        }
+        if (!(levenbergMarquardtTolerance >= 0)) {
+            throw LSST_EXCEPT(pexExcept::InvalidParameterError, "levenbergMarquardtTolerance must be >= 0");
+        }
+        if (robustLoss != "none" && robustLoss != "huber" && robustLoss != "cauchy" &&
+            robustLoss != "tukey") {
+            throw LSST_EXCEPT(pexExcept::InvalidParameterError,
+                              "robustLoss must be none, huber, cauchy or tukey, not " + robustLoss);
+        }
+        if (!(robustLossScale >= 0)) {
+            throw LSST_EXCEPT(pexExcept::InvalidParameterError, "robustLossScale must be >= 0");
+        }
+        if (checkpointInterval < 0) {
+            throw LSST_EXCEPT(pexExcept::InvalidParameterError, "checkpointInterval must be >= 0");
+        }
+        if (dumpMatrixFormat != "text" && dumpMatrixFormat != "binary" &&
+            dumpMatrixFormat != "matrixMarket") {
+            throw LSST_EXCEPT(pexExcept::InvalidParameterError,
+                              "dumpMatrixFormat must be text, binary or matrixMarket, not " +
+                                      dumpMatrixFormat);
+        }
     }
 };
 }  // namespace jointcal
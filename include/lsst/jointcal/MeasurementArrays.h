@@ -0,0 +1,73 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef LSST_JOINTCAL_MEASUREMENT_ARRAYS_H
+#define LSST_JOINTCAL_MEASUREMENT_ARRAYS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "lsst/jointcal/FittedStar.h"
+#include "lsst/jointcal/MeasuredStar.h"
+
+namespace lsst {
+namespace jointcal {
+
+/**
+ * A list of measurements as contiguous arrays (a "structure of arrays"), in list order.
+ *
+ * The fitters loop over these arrays rather than over the MeasuredStarList, whose elements are each
+ * allocated separately and reached through a list node and a shared_ptr. The positions and errors are
+ * copies; the stars themselves are still reachable, for what is not copied.
+ */
+struct MeasurementArrays {
+    /// Measured positions (pixels).
+    std::vector<double> x, y;
+    /// Variances and covariance of the measured positions (pixels^2).
+    std::vector<double> vx, vy, vxy;
+    /// The MeasuredStar of each measurement.
+    std::vector<MeasuredStar const *> measuredStars;
+    /// The FittedStar each measurement is associated with.
+    std::vector<FittedStar const *> fittedStars;
+    /// MeasuredStar::isValid() of each measurement (bytes rather than a packed std::vector<bool>).
+    std::vector<std::uint8_t> valid;
+
+    std::size_t size() const { return measuredStars.size(); }
+
+    /// Copy the measurements of a list.
+    void assign(MeasuredStarList const &measuredStarList);
+
+    /**
+     * Copy again the valid flags of the list the arrays were assigned from.
+     *
+     * @throws lsst::pex::exceptions::LengthError if the list does not have the size of the arrays.
+     */
+    void updateValid(MeasuredStarList const &measuredStarList);
+};
+
+}  // namespace jointcal
+}  // namespace lsst
+
+#endif  // LSST_JOINTCAL_MEASUREMENT_ARRAYS_H
@@ -0,0 +1,121 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef LSST_JOINTCAL_PHASE_TIMER_H
+#define LSST_JOINTCAL_PHASE_TIMER_H
+
+#include <chrono>
+#include <cstddef>
+
+namespace lsst {
+namespace jointcal {
+
+/**
+ * Resources used by one phase of a computation, accumulated over all its calls.
+ *
+ * The memory is that of the whole process: there is no per-phase allocation tracking, but the phases that
+ * raise the high-water mark of the process are the ones that need the memory.
+ */
+struct PhaseStatistics {
+    /// Number of calls of the phase.
+    std::size_t nCalls = 0;
+    /// Total wall time (seconds).
+    double wallSeconds = 0;
+    /// Total CPU time (seconds) of the process, summed over its threads.
+    double cpuSeconds = 0;
+    /// Peak resident memory (bytes) of the process at the end of the last call.
+    std::size_t peakResidentBytes = 0;
+    /// Total increase (bytes) of the peak resident memory of the process during the calls.
+    std::size_t peakResidentIncreaseBytes = 0;
+};
+
+/**
+ * Resources used by the phases of a fit. Phases may nest: e.g. lineSearch includes the chi2 evaluations
+ * it needs, which are also counted in chi2.
+ */
+struct FitterTimings {
+    /// Assignment of the parameter indices for a whatToFit.
+    PhaseStatistics assignIndices;
+    /// Computation of the derivatives of the fit terms, stored as Jacobian or Hessian triplets.
+    PhaseStatistics tripletFill;
+    /// Assembly of the sparse Hessian from the triplets.
+    PhaseStatistics hessianBuild;
+    /// Factorization of the Hessian, including its symbolic analysis when needed.
+    PhaseStatistics factorization;
+    /// Solution of the normal equations for a step.
+    PhaseStatistics solve;
+    /**
+     * Computation of the chi2 by the fit steps. Direct calls of FitterBase::computeChi2, which may run
+     * concurrently, are not timed.
+     */
+    PhaseStatistics chi2;
+    /// Search for outliers.
+    PhaseStatistics findOutliers;
+    /// Rank update (downdate) of the factorization with the contributions of the outliers.
+    PhaseStatistics rankUpdate;
+    /// Line searches along the steps.
+    PhaseStatistics lineSearch;
+};
+
+/// Resources used by the phases of the association of the input catalogs.
+struct AssociationsTimings {
+    /// Association of the measurements into fitted stars.
+    PhaseStatistics associateCatalogs;
+    /// Association of the reference stars with the fitted stars.
+    PhaseStatistics collectRefStars;
+    /// Selection and normalization of the fitted stars.
+    PhaseStatistics prepareFittedStars;
+};
+
+/**
+ * Accumulate the resources used from its construction to its destruction into a PhaseStatistics.
+ *
+ * @code
+ * {
+ *     PhaseTimer timer(_timings.solve);
+ *     delta = _solver->solve(grad);
+ * }
+ * @endcode
+ */
+class PhaseTimer {
+public:
+    explicit PhaseTimer(PhaseStatistics &statistics);
+    ~PhaseTimer();
+
+    PhaseTimer(PhaseTimer const &) = delete;
+    PhaseTimer(PhaseTimer &&) = delete;
+    PhaseTimer &operator=(PhaseTimer const &) = delete;
+    PhaseTimer &operator=(PhaseTimer &&) = delete;
+
+private:
+    PhaseStatistics &_statistics;
+    std::chrono::steady_clock::time_point _wallStart;
+    double _cpuStart;
+    std::size_t _peakResidentStart;
+};
+
+}  // namespace jointcal
+}  // namespace lsst
+
+#endif  // LSST_JOINTCAL_PHASE_TIMER_H
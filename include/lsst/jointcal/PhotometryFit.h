@@ -49,10 +49,12 @@ public:
      *
      * @param associations The associations catalog to use in the fitter.
      * @param photometryModel The model to build the fitter for.
+     * @param control Options controlling how the fit is computed.
      */
     PhotometryFit(std::shared_ptr<Associations> associations,
-                  std::shared_ptr<PhotometryModel> photometryModel)
-            : FitterBase(associations),
+                  std::shared_ptr<PhotometryModel> photometryModel,
+                  JointcalControl const &control = JointcalControl())
+            : FitterBase(associations, control),
               _fittingModel(false),
               _fittingFluxes(false),
               _photometryModel(photometryModel),
@@ -94,6 +96,12 @@ protected:
     /// @copydoc FitterBase::saveChi2RefContributions
     void saveChi2RefContributions(std::string const &filename) const override;
 
+    /// @copydoc FitterBase::getModelParameters
+    Eigen::VectorXd getModelParameters() const override;
+
+    /// @copydoc FitterBase::setModelParameters
+    void setModelParameters(Eigen::VectorXd const &parameters) override;
+
 private:
     bool _fittingModel, _fittingFluxes;
     std::shared_ptr<PhotometryModel> _photometryModel;
@@ -102,20 +110,28 @@ private:
     std::size_t _nParModel;
     std::size_t _nParFluxes;
 
-    void accumulateStatImageList(CcdImageList const &ccdImageList, Chi2Accumulator &accum) const override;
+    void accumulateStatImage(CcdImage const &ccdImage, Chi2Accumulator &accum,
+                             Eigen::VectorXd const *offset = nullptr) const override;
+
+    void accumulateStatRefStars(Chi2Accumulator &accum,
+                                Eigen::VectorXd const *offset = nullptr) const override;
+
+    void getIndicesOfMapping(CcdImage const &ccdImage, IndexVector &indices) const override;
 
-    void accumulateStatRefStars(Chi2Accumulator &accum) const override;
+    void getIndicesOfFittedStar(FittedStar const &fittedStar, IndexVector &indices) const override;
 
     void getIndicesOfMeasuredStar(MeasuredStar const &measuredStar,
                                   IndexVector &indices) const override;
 
-    void leastSquareDerivativesMeasurement(CcdImage const &ccdImage, TripletList &tripletList,
+    void leastSquareDerivativesMeasurement(CcdImage const &ccdImage, JacobianAccumulator &accumulator,
                                            Eigen::VectorXd &grad,
-                                           MeasuredStarList const *measuredStarList = nullptr) const override;
+                                           MeasuredStarList const *measuredStarList = nullptr,
+                                           Eigen::VectorXd const *offset = nullptr) const override;
 
     /// Compute the derivatives of the reference terms
-    void leastSquareDerivativesReference(FittedStarList const &fittedStarList, TripletList &tripletList,
-                                         Eigen::VectorXd &grad) const override;
+    void leastSquareDerivativesReference(FittedStarList const &fittedStarList,
+                                         JacobianAccumulator &accumulator, Eigen::VectorXd &grad,
+                                         Eigen::VectorXd const *offset = nullptr) const override;
 
 #ifdef STORAGE
     Point transformFittedStar(FittedStar const &fittedStar, AstrometryTransform const *sky2TP,
@@ -86,6 +86,16 @@ public:
      */
     virtual void freezeErrorTransform() = 0;
 
+    /**
+     * Return an independent copy of this mapping, with its parameters offset as the model's
+     * offsetParams(delta) would offset them. This mapping is left untouched.
+     *
+     * This allows evaluating the chi2 at trial parameters without modifying the model.
+     *
+     * @param[in]  delta  Offsets for all of the fitted parameters, indexed as in the "grand" fit.
+     */
+    virtual std::unique_ptr<PhotometryMappingBase> cloneWithOffset(Eigen::VectorXd const &delta) const = 0;
+
     /**
      * Compute the derivatives with respect to the parameters (i.e. the coefficients).
      *
@@ -102,6 +112,16 @@ public:
 
     virtual Eigen::VectorXd getParameters() = 0;
 
+    /**
+     * Get all the parameters of this mapping, including those that are not being fit.
+     *
+     * For checkpointing a fit: setAllParameters() restores them.
+     */
+    virtual Eigen::VectorXd getAllParameters() const = 0;
+
+    /// Set all the parameters of this mapping, as returned by getAllParameters().
+    virtual void setAllParameters(Eigen::VectorXd const &parameters) = 0;
+
     /**
      * Gets how this set of parameters (of length getNpar()) map into the "grand" fit.
      * Expects that indices has enough space reserved.
@@ -184,9 +204,38 @@ public:
      */
     void offsetParams(Eigen::VectorXd const &delta) { _transform->offsetParams(delta); }
 
+    /// @copydoc PhotometryMappingBase::cloneWithOffset
+    std::unique_ptr<PhotometryMappingBase> cloneWithOffset(Eigen::VectorXd const &delta) const override {
+        auto result = clone();
+        if (getNpar() > 0) result->offsetParams(delta.segment(index, getNpar()));
+        return result;
+    }
+
+    /**
+     * Return an independent copy of this mapping, with the same parameters, index and error transform.
+     *
+     * @note Only meant for evaluating trial parameters: the fit only ever uses one instance of a mapping.
+     */
+    std::unique_ptr<PhotometryMapping> clone() const {
+        auto result = std::make_unique<PhotometryMapping>(_transform->clone());
+        result->index = index;
+        result->fixed = fixed;
+        // A frozen error transform no longer follows the parameters: share it rather than the new transform.
+        if (_transformErrors != _transform) result->_transformErrors = _transformErrors;
+        return result;
+    }
+
     /// @copydoc PhotometryMappingBase::getParameters
     Eigen::VectorXd getParameters() override { return _transform->getParameters(); }
 
+    /// @copydoc PhotometryMappingBase::getAllParameters
+    Eigen::VectorXd getAllParameters() const override { return _transform->getParameters(); }
+
+    /// @copydoc PhotometryMappingBase::setAllParameters
+    void setAllParameters(Eigen::VectorXd const &parameters) override {
+        _transform->setParameters(parameters);
+    }
+
     /// @copydoc PhotometryMappingBase::getMappingIndices
     void getMappingIndices(IndexVector &indices) const override {
         if (indices.size() < getNpar()) indices.resize(getNpar());
@@ -248,6 +297,22 @@ public:
         return joined;
     }
 
+    /// @copydoc PhotometryMappingBase::getAllParameters
+    Eigen::VectorXd getAllParameters() const override {
+        Eigen::VectorXd chip = _chipMapping->getAllParameters();
+        Eigen::VectorXd visit = _visitMapping->getAllParameters();
+        Eigen::VectorXd joined(chip.size() + visit.size());
+        joined << chip, visit;
+        return joined;
+    }
+
+    /// @copydoc PhotometryMappingBase::setAllParameters
+    void setAllParameters(Eigen::VectorXd const &parameters) override {
+        Eigen::Index nChip = _chipMapping->getTransform()->getNpar();
+        _chipMapping->setAllParameters(parameters.head(nChip));
+        _visitMapping->setAllParameters(parameters.tail(parameters.size() - nChip));
+    }
+
     /// @copydoc PhotometryMappingBase::getMappingIndices
     void getMappingIndices(IndexVector &indices) const override;
 
@@ -278,6 +343,15 @@ public:
     std::size_t getNParVisit() const { return _nParVisit; }
 
 protected:
+    /**
+     * Copy this mapping's index and fit status into result, and offset result's chip and visit mappings
+     * as the model's offsetParams(delta) would. For implementing cloneWithOffset().
+     *
+     * @param[in]  delta   Offsets for all of the fitted parameters, indexed as in the "grand" fit.
+     * @param[out] result  A ChipVisitPhotometryMapping built on clones of this one's chip and visit mappings.
+     */
+    void offsetClone(Eigen::VectorXd const &delta, ChipVisitPhotometryMapping &result) const;
+
     // These are either transform.getNpar() or 0, depending on whether we are fitting that component or not.
     std::size_t _nParChip, _nParVisit;
 
@@ -292,6 +366,9 @@ public:
                          std::shared_ptr<PhotometryMapping> visitMapping)
             : ChipVisitPhotometryMapping(chipMapping, visitMapping) {}
 
+    /// @copydoc PhotometryMappingBase::cloneWithOffset
+    std::unique_ptr<PhotometryMappingBase> cloneWithOffset(Eigen::VectorXd const &delta) const override;
+
     /// @copydoc PhotometryMappingBase::transformError
     double transformError(MeasuredStar const &measuredStar, double value, double valueErr) const override;
 
@@ -306,6 +383,9 @@ public:
                               std::shared_ptr<PhotometryMapping> visitMapping)
             : ChipVisitPhotometryMapping(chipMapping, visitMapping) {}
 
+    /// @copydoc PhotometryMappingBase::cloneWithOffset
+    std::unique_ptr<PhotometryMappingBase> cloneWithOffset(Eigen::VectorXd const &delta) const override;
+
     /**
      * @copydoc PhotometryMappingBase::transformError
      *
@@ -90,6 +90,21 @@ public:
      */
     virtual double computeResidual(CcdImage const &ccdImage, MeasuredStar const &measuredStar) const = 0;
 
+    /**
+     * Compute the residual between the model applied to a star and fittedStar, through mapping.
+     *
+     * With the offset copies from PhotometryMappingBase::cloneWithOffset() and offsetFittedStar(), this
+     * evaluates the residual at trial parameters without modifying the model or the FittedStars.
+     *
+     * @param measuredStar The measured star position to compute the residual of.
+     * @param fittedStar The fitted star to compare with (possibly an offset copy of measuredStar's).
+     * @param mapping The mapping of the ccdImage where measuredStar resides.
+     *
+     * @return The residual.
+     */
+    virtual double computeResidual(MeasuredStar const &measuredStar, FittedStar const &fittedStar,
+                                   PhotometryMappingBase const &mapping) const = 0;
+
     /**
      * Return the on-sky transformed flux for measuredStar on ccdImage.
      *
@@ -111,6 +126,17 @@ public:
      */
     virtual double transformError(CcdImage const &ccdImage, MeasuredStar const &measuredStar) const = 0;
 
+    /**
+     * Return the on-sky transformed flux uncertainty for measuredStar, through mapping.
+     *
+     * @param[in]  measuredStar The measured star position to transform.
+     * @param[in]  mapping      The mapping of the ccdImage where measuredStar resides.
+     *
+     * @return     The on-sky flux transformed from instFlux at measuredStar's position.
+     */
+    virtual double transformError(MeasuredStar const &measuredStar,
+                                  PhotometryMappingBase const &mapping) const = 0;
+
     /**
      * Once this routine has been called, the error transform is not modified by offsetParams().
      *
@@ -138,6 +164,18 @@ public:
     virtual void computeParameterDerivatives(MeasuredStar const &measuredStar, CcdImage const &ccdImage,
                                              Eigen::VectorXd &derivatives) const = 0;
 
+    /**
+     * Compute the parametric derivatives of this model, through mapping.
+     *
+     * @param[in]   measuredStar  The measured star with the position and flux to compute at.
+     * @param[in]   mapping       The mapping of the ccdImage containing the measured star (possibly an offset
+     *                            copy from PhotometryMappingBase::cloneWithOffset()).
+     * @param[out]  derivatives   The computed derivatives. Must be pre-allocated to the correct size.
+     */
+    virtual void computeParameterDerivatives(MeasuredStar const &measuredStar,
+                                             PhotometryMappingBase const &mapping,
+                                             Eigen::VectorXd &derivatives) const = 0;
+
     /// Return the refStar error appropriate for this model (e.g. fluxErr or magErr).
     virtual double getRefError(RefStar const &refStar) const = 0;
 
@@ -188,6 +226,22 @@ public:
      */
     bool checkPositiveOnBBox(CcdImage const &ccdImage) const;
 
+    /**
+     * Get the parameters of the mappings of all ccdImages, including those that are not being fit,
+     * concatenated in the order of ccdImageList.
+     *
+     * For checkpointing a fit: setAllParameters() restores them. Mappings shared between ccdImages
+     * appear once per ccdImage.
+     */
+    Eigen::VectorXd getAllParameters(CcdImageList const &ccdImageList) const;
+
+    /**
+     * Set the parameters returned by getAllParameters() for the same ccdImageList.
+     *
+     * @throws lsst::pex::exceptions::LengthError if parameters does not have the expected size.
+     */
+    void setAllParameters(CcdImageList const &ccdImageList, Eigen::VectorXd const &parameters);
+
     friend std::ostream &operator<<(std::ostream &s, PhotometryModel const &model) {
         model.print(s);
         return s;
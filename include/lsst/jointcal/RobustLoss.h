@@ -0,0 +1,93 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef LSST_JOINTCAL_ROBUST_LOSS_H
+#define LSST_JOINTCAL_ROBUST_LOSS_H
+
+#include <string>
+
+namespace lsst {
+namespace jointcal {
+
+/**
+ * A robust loss function rho of the chi2 of a fit term, used to down-weight outliers by iteratively
+ * reweighted least squares (IRLS).
+ *
+ * With s the normalized residual of a term (s^2 is its chi2) and c the scale of the loss:
+ *  - "none": rho = s^2;
+ *  - "huber": rho = s^2 for s <= c, 2 c s - c^2 beyond;
+ *  - "cauchy": rho = c^2 ln(1 + s^2/c^2);
+ *  - "tukey": rho = c^2/3 (1 - (1 - s^2/c^2)^3) for s <= c, c^2/3 beyond.
+ *
+ * All of them are s^2 for small residuals. Minimizing the sum of rho is a least-squares problem whose
+ * terms are weighted by the derivative of rho with respect to s^2, evaluated at the current residuals:
+ * recomputing these weights at each step converges to the robust fit.
+ *
+ * The weights are floored at minWeight: a term beyond the scale of the Tukey loss, or far beyond it for
+ * the others, keeps a tiny weight, so that the parameters of a star whose terms are all outliers remain
+ * constrained and the Hessian does not become singular.
+ */
+class RobustLoss {
+public:
+    /**
+     * @param name  The loss: "none", "huber", "cauchy" or "tukey".
+     * @param scale  The scale c of the loss, in units of the measurement errors. 0 means the usual tuning
+     *               constant of the loss, with 95% efficiency for Gaussian errors: 1.345 (Huber),
+     *               2.385 (Cauchy) or 4.685 (Tukey).
+     *
+     * @throws lsst::pex::exceptions::InvalidParameterError if name is not one of the above, or if scale
+     *         is negative.
+     */
+    explicit RobustLoss(std::string const &name = "none", double scale = 0);
+
+    /// Is this a robust loss, i.e. not "none"?
+    bool isRobust() const { return _kind != Kind::None; }
+
+    /// The loss rho of a term with this chi2.
+    double loss(double chi2) const;
+
+    /// The smallest weight() of a term.
+    static constexpr double minWeight = 1e-6;
+
+    /**
+     * The IRLS weight of a term with this chi2: the derivative of loss() with respect to chi2, but not
+     * less than minWeight.
+     */
+    double weight(double chi2) const;
+
+    /// The scale c of the loss, in units of the measurement errors.
+    double getScale() const { return _scale; }
+
+private:
+    enum class Kind { None, Huber, Cauchy, Tukey };
+
+    Kind _kind;
+    double _scale;
+    double _scale2;  // _scale^2
+};
+
+}  // namespace jointcal
+}  // namespace lsst
+
+#endif  // LSST_JOINTCAL_ROBUST_LOSS_H
@@ -0,0 +1,118 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef LSST_JOINTCAL_SCHUR_COMPLEMENT_SOLVER_H
+#define LSST_JOINTCAL_SCHUR_COMPLEMENT_SOLVER_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Eigen/Core"
+
+#include "lsst/jointcal/Eigenstuff.h"
+#include "lsst/jointcal/HessianSolver.h"
+
+namespace lsst {
+namespace jointcal {
+
+/**
+ * Solve the normal equations by eliminating blocks of parameters that are only coupled to the others.
+ *
+ * With the eliminable blocks (e.g. the position and proper motion of each FittedStar) gathered in C, and
+ * the other parameters (e.g. the mappings) in A, the Hessian reads
+ * @f[
+ *     H = \begin{pmatrix} A & B \\ B^T & C \end{pmatrix}
+ * @f]
+ * where C is block diagonal. factorize() computes the inverse of each small block of C and factorizes
+ * the reduced system (the Schur complement) @f$ S = A - B C^{-1} B^T @f$ with another HessianSolver;
+ * solve() then solves for the parameters of A, and back-substitutes those of each block of C.
+ * The work on the blocks is split among threads.
+ *
+ * The reduced system cannot be downdated: outlier rejection recomputes and refactorizes the Hessian.
+ *
+ * The blocks of the inverse of H are formed from the same pieces: the inverse of the reduced system
+ * for the parameters of A, and @f$ C^{-1} + C^{-1} B^T S^{-1} B C^{-1} @f$ for those of a block of C.
+ */
+class SchurComplementSolver : public HessianSolver {
+public:
+    /**
+     * @param reducedSolver  The solver used for the reduced system.
+     * @param nThreads       Number of threads used to process the blocks (0 means one per core).
+     */
+    SchurComplementSolver(std::unique_ptr<HessianSolver> reducedSolver, int nThreads);
+
+    bool factorize(SparseMatrixD const &hessian, FitterStatistics &statistics) override;
+
+    Eigen::VectorXd solve(Eigen::VectorXd const &rhs) const override;
+
+    /**
+     * Compute blocks of the inverse of the Hessian from the inverse blocks of the reduced system.
+     *
+     * The blocks within the parameters of A, or within a single block of C, only need blocks of the
+     * inverse of the reduced system, which are all computed at once by its solver. The other blocks, which
+     * mix parameters of A and C or of several blocks of C, are solved for.
+     */
+    std::vector<Eigen::MatrixXd> computeInverseBlocks(std::vector<IndexVector> const &blocks) const override;
+
+    Eigen::Index getNParameters() const override { return _nParTot; }
+
+    /// Always throws: check canDowndate() first.
+    void downdate(SparseMatrixD const &H, FitterStatistics &statistics) override;
+
+    bool canDowndate() const override { return false; }
+
+    std::string getMethod() const override;
+
+    void setEliminableBlocks(std::vector<ParameterBlock> blocks) override { _blocks = std::move(blocks); }
+
+protected:
+    // Not used: factorize() is overridden, and the reduced solver takes care of reusing its analysis.
+    bool analyzePattern(SparseMatrixD const &hessian, FitterStatistics &statistics) override {
+        return true;
+    }
+    bool factorizeNumeric(SparseMatrixD const &hessian) override { return true; }
+
+private:
+    // What is kept from each eliminated block for solve().
+    struct EliminatedBlock {
+        IndexVector kept;        // indices, in the reduced system, of the parameters coupled to the block
+        Eigen::MatrixXd coupling;  // the block of B: one row per entry of kept, one column per parameter
+        Eigen::MatrixXd inverse;   // the inverse of the block of C
+    };
+
+    std::unique_ptr<HessianSolver> _reducedSolver;
+    std::size_t _nThreads;
+    std::vector<ParameterBlock> _blocks;
+
+    // State of the last factorize().
+    Eigen::Index _nParTot;
+    std::vector<Eigen::Index> _keptParameters;  // index in the full system of each reduced parameter
+    std::vector<EliminatedBlock> _eliminated;
+};
+
+}  // namespace jointcal
+}  // namespace lsst
+
+#endif  // LSST_JOINTCAL_SCHUR_COMPLEMENT_SOLVER_H
@@ -43,8 +43,7 @@ public:
     SimpleAstrometryMapping(AstrometryTransform const &astrometryTransform, bool toBeFit = true)
             : toBeFit(toBeFit),
               transform(astrometryTransform.clone()),
-              errorProp(transform),
-              lin(new AstrometryTransformLinear) {}
+              errorProp(transform) {}
 
     /// No copy or move: there is only ever one instance of a given mapping (i.e.. per ccd+visit)
     SimpleAstrometryMapping(SimpleAstrometryMapping const &) = delete;
@@ -79,6 +78,28 @@ public:
         if (toBeFit) transform->offsetParams(delta);
     }
 
+    /// @copydoc AstrometryMapping::cloneWithOffset
+    std::unique_ptr<AstrometryMapping> cloneWithOffset(Eigen::VectorXd const &delta) const override;
+
+    /// @copydoc AstrometryMapping::getAllParameters
+    Eigen::VectorXd getAllParameters() const override {
+        Eigen::VectorXd parameters(transform->getNpar());
+        for (Eigen::Index i = 0; i < parameters.size(); ++i) parameters[i] = transform->paramRef(i);
+        return parameters;
+    }
+
+    /// @copydoc AstrometryMapping::setAllParameters
+    void setAllParameters(Eigen::VectorXd const &parameters) override {
+        for (Eigen::Index i = 0; i < parameters.size(); ++i) transform->paramRef(i) = parameters[i];
+    }
+
+    /**
+     * Return an independent copy of this mapping, with the same parameters, index and error transform.
+     *
+     * @note Only meant for evaluating trial parameters: the fit only ever uses one instance of a mapping.
+     */
+    virtual std::unique_ptr<SimpleAstrometryMapping> clone() const;
+
     //! position of the parameters within the grand fitting scheme
     Eigen::Index getIndex() const { return index; }
 
@@ -89,6 +110,13 @@ public:
     virtual void computeTransformAndDerivatives(FatPoint const &where, FatPoint &outPoint,
                                                 Eigen::MatrixX2d &H) const override;
 
+    /// @copydoc AstrometryMapping::computeTransformAndDerivativesBatch
+    void computeTransformAndDerivativesBatch(FatPointArrays const &where, FatPointArrays &outPoints,
+                                             Eigen::MatrixXd &H) const override;
+
+    /// @copydoc AstrometryMapping::transformPosAndErrorsBatch
+    void transformPosAndErrorsBatch(FatPointArrays const &where, FatPointArrays &outPoints) const override;
+
     //! Access to the (fitted) transform
     virtual AstrometryTransform const &getTransform() const { return *transform; }
 
@@ -100,6 +128,9 @@ public:
     void print(std::ostream &out) const override;
 
 protected:
+    /// Copy the fit status, index and (if frozen) error transform of other into this mapping.
+    void copyFitState(SimpleAstrometryMapping const &other);
+
     // Whether this Mapping is fit as part of a Model.
     bool toBeFit;
     Eigen::Index index;
@@ -108,9 +139,6 @@ protected:
     std::shared_ptr<AstrometryTransform> transform;
 
     std::shared_ptr<AstrometryTransform> errorProp;
-    /* to avoid allocation at every call of positionDerivative.
-       use a pointer for constness */
-    std::unique_ptr<AstrometryTransformLinear> lin;
 };
 
 //! Mapping implementation for a polynomial transformation.
@@ -145,9 +173,19 @@ public:
     /// @copydoc AstrometryMapping::transformPosAndErrors
     void transformPosAndErrors(FatPoint const &where, FatPoint &outPoint) const override;
 
+    /// @copydoc AstrometryMapping::computeTransformAndDerivativesBatch
+    void computeTransformAndDerivativesBatch(FatPointArrays const &where, FatPointArrays &outPoints,
+                                             Eigen::MatrixXd &H) const override;
+
+    /// @copydoc AstrometryMapping::transformPosAndErrorsBatch
+    void transformPosAndErrorsBatch(FatPointArrays const &where, FatPointArrays &outPoints) const override;
+
     /// @copydoc SimpleAstrometryMapping::getTransform
     AstrometryTransform const &getTransform() const override;
 
+    /// @copydoc SimpleAstrometryMapping::clone
+    std::unique_ptr<SimpleAstrometryMapping> clone() const override;
+
 private:
     /* to better condition the 2nd derivative matrix, the
     transformed coordinates are mapped (roughly) on [-1,1].
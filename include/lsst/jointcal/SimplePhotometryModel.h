@@ -72,6 +72,10 @@ public:
     void computeParameterDerivatives(MeasuredStar const &measuredStar, CcdImage const &ccdImage,
                                      Eigen::VectorXd &derivatives) const override;
 
+    /// @copydoc PhotometryModel::computeParameterDerivatives
+    void computeParameterDerivatives(MeasuredStar const &measuredStar, PhotometryMappingBase const &mapping,
+                                     Eigen::VectorXd &derivatives) const override;
+
     /// @copydoc PhotometryModel::print
     virtual void print(std::ostream &out) const override;
 
@@ -95,12 +99,20 @@ public:
     /// @copydoc PhotometryModel::computeResidual
     double computeResidual(CcdImage const &ccdImage, MeasuredStar const &measuredStar) const override;
 
+    /// @copydoc PhotometryModel::computeResidual
+    double computeResidual(MeasuredStar const &measuredStar, FittedStar const &fittedStar,
+                           PhotometryMappingBase const &mapping) const override;
+
     /// @copydoc PhotometryModel::transform
     double transform(CcdImage const &ccdImage, MeasuredStar const &measuredStar) const override;
 
     /// @copydoc PhotometryModel::transformError
     double transformError(CcdImage const &ccdImage, MeasuredStar const &measuredStar) const override;
 
+    /// @copydoc PhotometryModel::transformError
+    double transformError(MeasuredStar const &measuredStar,
+                          PhotometryMappingBase const &mapping) const override;
+
     /// @copydoc PhotometryModel::getRefError
     double getRefError(RefStar const &refStar) const override { return refStar.getFluxErr(); }
 
@@ -132,12 +144,20 @@ public:
     /// @copydoc PhotometryModel::computeResidual
     double computeResidual(CcdImage const &ccdImage, MeasuredStar const &measuredStar) const override;
 
+    /// @copydoc PhotometryModel::computeResidual
+    double computeResidual(MeasuredStar const &measuredStar, FittedStar const &fittedStar,
+                           PhotometryMappingBase const &mapping) const override;
+
     /// @copydoc PhotometryModel::transform
     double transform(CcdImage const &ccdImage, MeasuredStar const &measuredStar) const override;
 
     /// @copydoc PhotometryModel::transformError
     double transformError(CcdImage const &ccdImage, MeasuredStar const &measuredStar) const override;
 
+    /// @copydoc PhotometryModel::transformError
+    double transformError(MeasuredStar const &measuredStar,
+                          PhotometryMappingBase const &mapping) const override;
+
     /// @copydoc PhotometryModel::getRefError
     double getRefError(RefStar const &refStar) const override { return refStar.getMagErr(); }
 
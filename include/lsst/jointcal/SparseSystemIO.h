@@ -0,0 +1,88 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef LSST_JOINTCAL_SPARSE_SYSTEM_IO_H
+#define LSST_JOINTCAL_SPARSE_SYSTEM_IO_H
+
+#include <string>
+
+#include "Eigen/Core"
+
+#include "lsst/jointcal/Eigenstuff.h"
+
+namespace lsst {
+namespace jointcal {
+
+/**
+ * The normal equations of a fit: the lower triangle of the Hessian, and the gradient.
+ */
+struct SparseSystem {
+    SparseMatrixD hessian;
+    Eigen::VectorXd gradient;
+};
+
+/**
+ * Write the lower triangle of a Hessian and its gradient to a binary file.
+ *
+ * The matrix is written from its compressed sparse column (CSC) arrays, without any copy, so there is no
+ * limit on its size. The file holds, in native byte order:
+ *  - a 56 byte header: the magic string "JCSPARSE", a byte order mark (uint32 0x01020304), the format
+ *    version (uint32 1), a flag set to 1 if only the lower triangle is stored (uint32) and the size in
+ *    bytes of the indices (uint32 8), then the number of rows, columns, non-zero entries and gradient
+ *    entries (int64 each);
+ *  - the column starts (int64, number of columns + 1);
+ *  - the row indices (int64, number of non-zero entries);
+ *  - the values (float64, number of non-zero entries);
+ *  - the gradient (float64).
+ *
+ * Read it back with readSparseSystem(), or with lsst.jointcal.readSparseSystem in python.
+ *
+ * @throws lsst::pex::exceptions::IoError if the file cannot be written.
+ */
+void writeSparseSystem(std::string const &path, SparseMatrixD const &hessian,
+                       Eigen::VectorXd const &gradient);
+
+/**
+ * Read a file written by writeSparseSystem().
+ *
+ * @throws lsst::pex::exceptions::IoError if the file cannot be read, or is not in the expected format.
+ * @throws lsst::pex::exceptions::InvalidParameterError if the matrix is not a valid compressed sparse
+ *         column matrix: its column starts do not increase from 0 to the number of non-zero entries, or a
+ *         row index is not below the number of rows.
+ */
+SparseSystem readSparseSystem(std::string const &path);
+
+/**
+ * Write the lower triangle of a Hessian, as a symmetric coordinate matrix, and its gradient, as an
+ * array, to two Matrix Market files. Entries are streamed to the files, with full double precision.
+ *
+ * @throws lsst::pex::exceptions::IoError if a file cannot be written.
+ */
+void writeMatrixMarket(std::string const &matrixPath, std::string const &gradientPath,
+                       SparseMatrixD const &hessian, Eigen::VectorXd const &gradient);
+
+}  // namespace jointcal
+}  // namespace lsst
+
+#endif  // LSST_JOINTCAL_SPARSE_SYSTEM_IO_H
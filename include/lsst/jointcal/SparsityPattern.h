@@ -0,0 +1,116 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef LSST_JOINTCAL_SPARSITY_PATTERN_H
+#define LSST_JOINTCAL_SPARSITY_PATTERN_H
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include "lsst/jointcal/Eigenstuff.h"
+
+namespace lsst {
+namespace jointcal {
+
+/**
+ * The nonzero pattern of a compressed sparse matrix, with a hash to quickly detect changes.
+ *
+ * This is what a symbolic factorization depends on: a matrix whose pattern is contained in the one
+ * that was analyzed can be factorized numerically without redoing the analysis, once embedded in
+ * that pattern.
+ */
+class SparsityPattern {
+public:
+    /// An empty pattern, that contains no matrix.
+    SparsityPattern() : _rows(0), _cols(0), _hash(0) {}
+
+    /// Record the pattern of matrix, which must be compressed.
+    void reset(SparseMatrixD const &matrix);
+
+    /// Forget the recorded pattern.
+    void clear();
+
+    /// Is this pattern empty?
+    bool empty() const { return _outer.empty(); }
+
+    /// Number of rows of the recorded matrix.
+    Eigen::Index getRows() const { return _rows; }
+
+    /// Number of columns of the recorded matrix.
+    Eigen::Index getCols() const { return _cols; }
+
+    /// Number of entries of the pattern.
+    std::size_t getNonZeros() const { return _inner.size(); }
+
+    /**
+     * Position of entry (row, col) in the values of a matrix with this pattern, or -1 if the pattern has
+     * no such entry.
+     */
+    std::ptrdiff_t findEntry(Eigen::Index row, Eigen::Index col) const {
+        auto const begin = _inner.begin() + _outer[col];
+        auto const end = _inner.begin() + _outer[col + 1];
+        auto const entry = std::lower_bound(begin, end, row);
+        return (entry != end && *entry == row) ? entry - _inner.begin() : -1;
+    }
+
+    /**
+     * Return the matrix with this pattern and these values.
+     *
+     * @param values  One value per entry, in the order of findEntry().
+     *
+     * @throws lsst::pex::exceptions::LengthError if there is not one value per entry.
+     */
+    SparseMatrixD makeMatrix(std::vector<double> const &values) const;
+
+    /// Is the pattern of matrix identical to this one?
+    bool isSame(SparseMatrixD const &matrix) const;
+
+    /// Is the pattern of matrix identical to, or a subset of this one?
+    bool contains(SparseMatrixD const &matrix) const;
+
+    /**
+     * Return matrix stored with this pattern, with explicit zeros where matrix has no entry.
+     *
+     * @param matrix  A matrix for which contains() is true.
+     */
+    SparseMatrixD embed(SparseMatrixD const &matrix) const;
+
+    /// Hash of the pattern (dimensions and indices, not values).
+    std::size_t getHash() const { return _hash; }
+
+    /// Compute the hash of the pattern of matrix, which must be compressed.
+    static std::size_t computeHash(SparseMatrixD const &matrix);
+
+private:
+    Eigen::Index _rows, _cols;
+    std::vector<SparseMatrixD::StorageIndex> _outer;
+    std::vector<SparseMatrixD::StorageIndex> _inner;
+    std::size_t _hash;
+};
+
+}  // namespace jointcal
+}  // namespace lsst
+
+#endif  // LSST_JOINTCAL_SPARSITY_PATTERN_H
@@ -30,6 +30,7 @@
 #include <iostream>
 #include <memory>
 
+#include "lsst/jointcal/FatPoint.h"
 #include "lsst/jointcal/Point.h"
 
 namespace lsst {
@@ -92,11 +93,17 @@ public:
     void clearList() { cutTail(0); };
 
     //! enables to apply a geometrical transform if Star is Basestar or derives from it.
-    /*! could be extended to other type of transformations. */
+    /*! could be extended to other type of transformations.
+        The whole list goes through a single op.transformPosAndErrorsBatch() call. */
 
     template <class Operator>
     void applyTransform(const Operator &op) {
-        for (auto &p : *this) op.transformStar(*(p));
+        FatPointArrays points(this->size());
+        Eigen::Index i = 0;
+        for (auto const &p : *this) points.set(i++, *p);
+        op.transformPosAndErrorsBatch(points, points);
+        i = 0;
+        for (auto &p : *this) static_cast<FatPoint &>(*p) = points.get(i++);
     }
 };
 
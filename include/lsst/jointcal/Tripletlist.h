@@ -27,16 +27,66 @@
 
 #include "Eigen/Sparse"
 
+#include <memory>
 #include <vector>
 
+#include "lsst/jointcal/Eigenstuff.h"
+
 namespace lsst {
 namespace jointcal {
 
 typedef Eigen::Triplet<double> Trip;
 
+/**
+ * Receives the derivatives of the chi2 terms, one term at a time.
+ *
+ * The fitters compute, for each measurement or reference term, a small dense block of the Jacobian
+ * of the chi2 (already multiplied by the square root of the term weight) and hand it to an accumulator,
+ * which decides what to do with it: store it as a sparse Jacobian (TripletList), or directly accumulate
+ * its contribution to the normal equations (HessianAccumulator).
+ */
+class JacobianAccumulator {
+public:
+    virtual ~JacobianAccumulator() = default;
+
+    /**
+     * Add the Jacobian block of one chi2 term.
+     *
+     * @param indices   Indices in the full parameter vector of the rows of jacobian.
+     * @param jacobian  Derivatives of the term (one row per parameter, one column per Jacobian column
+     *                  of the term). Rows that are identically zero are ignored, and their index may be
+     *                  invalid.
+     */
+    virtual void addTerm(IndexVector const &indices, Eigen::Ref<Eigen::MatrixXd const> const &jacobian) = 0;
+
+    /**
+     * Announce that all terms added until the next endSharedBlock() depend on the parameters in
+     * indices, which are then the leading rows of every block passed to addTerm().
+     *
+     * This is typically the mapping parameters of a CcdImage. Accumulators may use it to sum the
+     * corresponding part of the normal equations densely; the default implementation ignores it.
+     */
+    virtual void beginSharedBlock(IndexVector const &indices) {}
+
+    /// Close the block opened by beginSharedBlock().
+    virtual void endSharedBlock() {}
+
+    /**
+     * Return a new, empty accumulator of the same kind, to be filled independently (e.g. by another
+     * thread) and then merged into this one.
+     */
+    virtual std::unique_ptr<JacobianAccumulator> makeEmptyClone() const = 0;
+
+    /**
+     * Append the terms accumulated in other (obtained from makeEmptyClone()) after the ones already
+     * accumulated here, as if they had been added to this accumulator directly. other is left empty.
+     */
+    virtual void merge(JacobianAccumulator &other) = 0;
+};
+
 // at the moment this class implements the eigen format.
-// it would be wise to implement it differently if talking to cholmod
-class TripletList : public std::vector<Trip> {
+// See CompactJacobian for a storage meant to be handed to cholmod.
+class TripletList : public std::vector<Trip>, public JacobianAccumulator {
 public:
     TripletList(int count) : _nextFreeIndex(0) { reserve(count); };
 
@@ -44,6 +94,33 @@ public:
         push_back(Trip(i, j, val));
     }
 
+    /// Store the non-zero entries of jacobian in the next free columns.
+    void addTerm(IndexVector const &indices, Eigen::Ref<Eigen::MatrixXd const> const &jacobian) override {
+        for (Eigen::Index ipar = 0; ipar < jacobian.rows(); ++ipar) {
+            for (Eigen::Index ic = 0; ic < jacobian.cols(); ++ic) {
+                double val = jacobian(ipar, ic);
+                if (val == 0) continue;
+                addTriplet(indices[ipar], _nextFreeIndex + ic, val);
+            }
+        }
+        _nextFreeIndex += jacobian.cols();
+    }
+
+    std::unique_ptr<JacobianAccumulator> makeEmptyClone() const override {
+        return std::unique_ptr<JacobianAccumulator>(new TripletList(0));
+    }
+
+    /// Append the triplets of other, shifting its columns after the ones used here.
+    void merge(JacobianAccumulator &other) override {
+        auto &otherList = dynamic_cast<TripletList &>(other);
+        for (auto const &trip : otherList) {
+            addTriplet(trip.row(), _nextFreeIndex + trip.col(), trip.value());
+        }
+        _nextFreeIndex += otherList.getNextFreeIndex();
+        otherList.setNextFreeIndex(0);
+        std::vector<Trip>().swap(otherList);
+    }
+
     Eigen::Index getNextFreeIndex() const { return _nextFreeIndex; }
 
     void setNextFreeIndex(Eigen::Index index) { _nextFreeIndex = index; }
@@ -33,5 +33,6 @@ from .photometryMappings import *
 from .photometryModels import *
 from .photometryTransform import *
 from .projectionHandler import *
+from .sparseSystem import *
 from .version import *
 __path__ = pkgutil.extend_path(__path__, __name__)
@@ -27,6 +27,7 @@
 
 #include "lsst/jointcal/Associations.h"
 #include "lsst/jointcal/CcdImage.h"
+#include "lsst/jointcal/PhaseTimer.h"
 #include "lsst/sphgeom/Circle.h"
 
 namespace py = pybind11;
@@ -36,6 +37,22 @@ namespace lsst {
 namespace jointcal {
 namespace {
 
+void declarePhaseStatistics(py::module &mod) {
+    py::class_<PhaseStatistics, std::shared_ptr<PhaseStatistics>> cls(mod, "PhaseStatistics");
+
+    cls.def_readonly("nCalls", &PhaseStatistics::nCalls);
+    cls.def_readonly("wallSeconds", &PhaseStatistics::wallSeconds);
+    cls.def_readonly("cpuSeconds", &PhaseStatistics::cpuSeconds);
+    cls.def_readonly("peakResidentBytes", &PhaseStatistics::peakResidentBytes);
+    cls.def_readonly("peakResidentIncreaseBytes", &PhaseStatistics::peakResidentIncreaseBytes);
+
+    py::class_<AssociationsTimings, std::shared_ptr<AssociationsTimings>> clsTimings(mod,
+                                                                                   "AssociationsTimings");
+    clsTimings.def_readonly("associateCatalogs", &AssociationsTimings::associateCatalogs);
+    clsTimings.def_readonly("collectRefStars", &AssociationsTimings::collectRefStars);
+    clsTimings.def_readonly("prepareFittedStars", &AssociationsTimings::prepareFittedStars);
+}
+
 void declareAssociations(py::module &mod) {
     py::class_<Associations, std::shared_ptr<Associations>> cls(mod, "Associations");
     cls.def(py::init<>());
@@ -55,6 +72,7 @@ void declareAssociations(py::module &mod) {
     cls.def("createCcdImage", &Associations::createCcdImage);
     cls.def("addCcdImage", &Associations::addCcdImage);
     cls.def("prepareFittedStars", &Associations::prepareFittedStars);
+    cls.def("getTimings", &Associations::getTimings, py::return_value_policy::copy);
 
     cls.def("getCcdImageList", &Associations::getCcdImageList, py::return_value_policy::reference_internal);
     cls.def_property_readonly("ccdImageList", &Associations::getCcdImageList,
@@ -70,6 +88,7 @@ void declareAssociations(py::module &mod) {
 PYBIND11_MODULE(associations, mod) {
     py::module::import("lsst.jointcal.ccdImage");
     py::module::import("lsst.sphgeom");
+    declarePhaseStatistics(mod);
     declareAssociations(mod);
 }
 }  // namespace
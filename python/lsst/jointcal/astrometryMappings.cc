@@ -45,6 +45,39 @@ void declareAstrometryMapping(py::module &mod) {
         self.transformPosAndErrors(inPos, outPos);
         return outPos;
     });
+    cls.def("computeTransformAndDerivatives", [](AstrometryMapping const &self, jointcal::FatPoint &inPos) {
+        jointcal::FatPoint outPos;
+        Eigen::MatrixX2d H(self.getNpar(), 2);
+        self.computeTransformAndDerivatives(inPos, outPos, H);
+        return py::make_tuple(outPos, H);
+    });
+    cls.def("transformPosAndErrorsBatch",
+            [](AstrometryMapping const &self, Eigen::ArrayXd const &x, Eigen::ArrayXd const &y,
+               Eigen::ArrayXd const &vx, Eigen::ArrayXd const &vy, Eigen::ArrayXd const &vxy) {
+                FatPointArrays inPos, outPos;
+                inPos.x = x;
+                inPos.y = y;
+                inPos.vx = vx;
+                inPos.vy = vy;
+                inPos.vxy = vxy;
+                self.transformPosAndErrorsBatch(inPos, outPos);
+                return py::make_tuple(outPos.x, outPos.y, outPos.vx, outPos.vy, outPos.vxy);
+            },
+            "x"_a, "y"_a, "vx"_a, "vy"_a, "vxy"_a);
+    cls.def("computeTransformAndDerivativesBatch",
+            [](AstrometryMapping const &self, Eigen::ArrayXd const &x, Eigen::ArrayXd const &y,
+               Eigen::ArrayXd const &vx, Eigen::ArrayXd const &vy, Eigen::ArrayXd const &vxy) {
+                FatPointArrays inPos, outPos;
+                inPos.x = x;
+                inPos.y = y;
+                inPos.vx = vx;
+                inPos.vy = vy;
+                inPos.vxy = vxy;
+                Eigen::MatrixXd H;
+                self.computeTransformAndDerivativesBatch(inPos, outPos, H);
+                return py::make_tuple(outPos.x, outPos.y, outPos.vx, outPos.vy, outPos.vxy, H);
+            },
+            "x"_a, "y"_a, "vx"_a, "vy"_a, "vxy"_a);
 }
 
 void declareChipVisitAstrometryMapping(py::module &mod) {
@@ -60,6 +60,26 @@ void declareAstrometryTransform(py::module &mod) {
         self.computeDerivative(where, derivative, step);
         return derivative;
     });
+    cls.def("applyBatch",
+            [](AstrometryTransform const &self, Eigen::ArrayXd const &x, Eigen::ArrayXd const &y) {
+                Eigen::ArrayXd xOut(x.size()), yOut(x.size());
+                self.applyBatch(x, y, xOut, yOut);
+                return py::make_tuple(xOut, yOut);
+            },
+            "x"_a, "y"_a);
+    cls.def("transformPosAndErrorsBatch",
+            [](AstrometryTransform const &self, Eigen::ArrayXd const &x, Eigen::ArrayXd const &y,
+               Eigen::ArrayXd const &vx, Eigen::ArrayXd const &vy, Eigen::ArrayXd const &vxy) {
+                FatPointArrays points;
+                points.x = x;
+                points.y = y;
+                points.vx = vx;
+                points.vy = vy;
+                points.vxy = vxy;
+                self.transformPosAndErrorsBatch(points, points);
+                return py::make_tuple(points.x, points.y, points.vx, points.vy, points.vxy);
+            },
+            "x"_a, "y"_a, "vx"_a, "vy"_a, "vxy"_a);
 
     utils::python::addOutputOp(cls, "__str__");
 }
@@ -134,6 +154,8 @@ void declareBaseTanWcs(py::module &mod) {
 void declareTanPixelToRaDec(py::module &mod) {
     py::class_<TanPixelToRaDec, std::shared_ptr<TanPixelToRaDec>, AstrometryTransform> cls(mod,
                                                                                            "TanPixelToRaDec");
+    cls.def(py::init<AstrometryTransformLinear const &, Point const &>(), "pixToTan"_a, "tangentPoint"_a);
+    cls.def("inverted", &TanPixelToRaDec::inverted);
 }
 
 void declareTanRaDecToPixel(py::module &mod) {
@@ -23,14 +23,21 @@
  */
 
 #include "pybind11/pybind11.h"
+#include "pybind11/eigen.h"
+#include "pybind11/stl.h"
 
 #include "lsst/jointcal/Associations.h"
 #include "lsst/jointcal/AstrometryFit.h"
 #include "lsst/jointcal/AstrometryModel.h"
 #include "lsst/jointcal/Chi2.h"
 #include "lsst/jointcal/FitterBase.h"
+#include "lsst/jointcal/FitterStatistics.h"
+#include "lsst/jointcal/HessianSolver.h"
+#include "lsst/jointcal/JointcalControl.h"
+#include "lsst/jointcal/PhaseTimer.h"
 #include "lsst/jointcal/PhotometryFit.h"
 #include "lsst/jointcal/PhotometryModel.h"
+#include "lsst/jointcal/Tripletlist.h"
 
 namespace py = pybind11;
 using namespace pybind11::literals;
@@ -39,20 +46,122 @@ namespace lsst {
 namespace jointcal {
 namespace {
 
+void declareFitterStatistics(py::module &mod) {
+    py::class_<FitterStatistics, std::shared_ptr<FitterStatistics>> cls(mod, "FitterStatistics");
+
+    cls.def_readonly("factorization", &FitterStatistics::factorization);
+    cls.def_readonly("nSymbolicAnalyses", &FitterStatistics::nSymbolicAnalyses);
+    cls.def_readonly("ordering", &FitterStatistics::ordering);
+    cls.def_readonly("nCachedOrderings", &FitterStatistics::nCachedOrderings);
+    cls.def_readonly("factorNonZeros", &FitterStatistics::factorNonZeros);
+    cls.def_readonly("factorizationFlops", &FitterStatistics::factorizationFlops);
+    cls.def_readonly("lastHessianTriplets", &FitterStatistics::lastHessianTriplets);
+    cls.def_readonly("nNumericFactorizations", &FitterStatistics::nNumericFactorizations);
+    cls.def_readonly("lastMeasurementOutliers", &FitterStatistics::lastMeasurementOutliers);
+    cls.def_readonly("lastReferenceOutliers", &FitterStatistics::lastReferenceOutliers);
+    cls.def_readonly("nDowndates", &FitterStatistics::nDowndates);
+    cls.def_readonly("nOutlierRefactorizations", &FitterStatistics::nOutlierRefactorizations);
+    cls.def_readonly("lastOutlierUpdate", &FitterStatistics::lastOutlierUpdate);
+    cls.def_readonly("lastOutlierRank", &FitterStatistics::lastOutlierRank);
+    cls.def_readonly("lastFactorizationSeconds", &FitterStatistics::lastFactorizationSeconds);
+    cls.def_readonly("lastRefactorizationSeconds", &FitterStatistics::lastRefactorizationSeconds);
+    cls.def_readonly("lastDowndateSeconds", &FitterStatistics::lastDowndateSeconds);
+    cls.def_readonly("lastDowndateRank", &FitterStatistics::lastDowndateRank);
+    cls.def_readonly("lastPredictedDowndateSeconds", &FitterStatistics::lastPredictedDowndateSeconds);
+    cls.def_readonly("lastComparedRefactorizationSeconds",
+                     &FitterStatistics::lastComparedRefactorizationSeconds);
+    cls.def_readonly("nReducedParameters", &FitterStatistics::nReducedParameters);
+    cls.def_readonly("nConjugateGradientIterations", &FitterStatistics::nConjugateGradientIterations);
+    cls.def_readonly("lastConjugateGradientIterations", &FitterStatistics::lastConjugateGradientIterations);
+    cls.def_readonly("lastConjugateGradientResidual", &FitterStatistics::lastConjugateGradientResidual);
+    cls.def_readonly("nLineSearches", &FitterStatistics::nLineSearches);
+    cls.def_readonly("nLineSearchChi2Evaluations", &FitterStatistics::nLineSearchChi2Evaluations);
+    cls.def_readonly("nLineSearchGradientEvaluations", &FitterStatistics::nLineSearchGradientEvaluations);
+    cls.def_readonly("lastLineSearchScale", &FitterStatistics::lastLineSearchScale);
+    cls.def_readonly("nDampedSteps", &FitterStatistics::nDampedSteps);
+    cls.def_readonly("nRejectedDampedSteps", &FitterStatistics::nRejectedDampedSteps);
+    cls.def_readonly("lastDampingFactor", &FitterStatistics::lastDampingFactor);
+    cls.def_readonly("lastDampingRatio", &FitterStatistics::lastDampingRatio);
+}
+
+void declareFitterTimings(py::module &mod) {
+    py::class_<FitterTimings, std::shared_ptr<FitterTimings>> cls(mod, "FitterTimings");
+
+    cls.def_readonly("assignIndices", &FitterTimings::assignIndices);
+    cls.def_readonly("tripletFill", &FitterTimings::tripletFill);
+    cls.def_readonly("hessianBuild", &FitterTimings::hessianBuild);
+    cls.def_readonly("factorization", &FitterTimings::factorization);
+    cls.def_readonly("solve", &FitterTimings::solve);
+    cls.def_readonly("chi2", &FitterTimings::chi2);
+    cls.def_readonly("findOutliers", &FitterTimings::findOutliers);
+    cls.def_readonly("rankUpdate", &FitterTimings::rankUpdate);
+    cls.def_readonly("lineSearch", &FitterTimings::lineSearch);
+}
+
+void declareIterationResult(py::module &mod) {
+    py::class_<IterationStep, std::shared_ptr<IterationStep>> clsStep(mod, "IterationStep");
+    clsStep.def_readonly("result", &IterationStep::result);
+    clsStep.def_readonly("chi2", &IterationStep::chi2);
+    clsStep.def_readonly("nMeasurementOutliers", &IterationStep::nMeasurementOutliers);
+    clsStep.def_readonly("nReferenceOutliers", &IterationStep::nReferenceOutliers);
+    clsStep.def_readonly("seconds", &IterationStep::seconds);
+
+    py::class_<IterationResult, std::shared_ptr<IterationResult>> cls(mod, "IterationResult");
+    cls.def_readonly("result", &IterationResult::result);
+    cls.def_readonly("chi2", &IterationResult::chi2);
+    cls.def_readonly("steps", &IterationResult::steps);
+    cls.def_readonly("refit", &IterationResult::refit);
+    cls.def_readonly("refitPredictedDecrease", &IterationResult::refitPredictedDecrease);
+}
+
+void declareParameterCovariances(py::module &mod) {
+    py::class_<ParameterCovariances, std::shared_ptr<ParameterCovariances>> cls(mod, "ParameterCovariances");
+    cls.def_readonly("mappings", &ParameterCovariances::mappings);
+    cls.def_readonly("fittedStars", &ParameterCovariances::fittedStars);
+}
+
+// The gradient of the chi2 (-1/2 its derivative) at the current parameters, or offset by offset.
+Eigen::VectorXd computeGradient(FitterBase const &fitter, Eigen::VectorXd const *offset) {
+    TripletList jacobian(0);
+    Eigen::VectorXd grad = Eigen::VectorXd::Zero(fitter.getTotalParameters());
+    fitter.leastSquareDerivatives(jacobian, grad, offset);
+    return grad;
+}
+
 void declareFitterBase(py::module &mod) {
     py::class_<FitterBase, std::shared_ptr<FitterBase>> cls(mod, "FitterBase");
 
     cls.def("minimize", &FitterBase::minimize, "whatToFit"_a, "nSigRejCut"_a = 0, "doRankUpdate"_a = true,
             "doLineSearch"_a = false, "dumpMatrixFile"_a = "");
-    cls.def("computeChi2", &FitterBase::computeChi2);
+    cls.def("iterate", &FitterBase::iterate, "whatToFit"_a, "maxSteps"_a, "nSigRejCut"_a = 0,
+            "doRankUpdate"_a = true, "doLineSearch"_a = false, "dumpMatrixFile"_a = "",
+            "saveChi2BaseName"_a = "", "checkpointFile"_a = "", "firstStep"_a = 0);
+    cls.def("computeChi2", py::overload_cast<>(&FitterBase::computeChi2, py::const_));
+    cls.def("computeChi2", py::overload_cast<Eigen::VectorXd const &>(&FitterBase::computeChi2, py::const_),
+            "offset"_a);
+    cls.def("offsetParams", &FitterBase::offsetParams, "delta"_a);
+    cls.def("computeGradient", [](FitterBase const &self) { return computeGradient(self, nullptr); });
+    cls.def("computeGradient",
+            [](FitterBase const &self, Eigen::VectorXd const &offset) {
+                return computeGradient(self, &offset);
+            },
+            "offset"_a);
+    cls.def("getTotalParameters", &FitterBase::getTotalParameters);
+    cls.def("computeCovarianceBlocks", &FitterBase::computeCovarianceBlocks, "blocks"_a);
+    cls.def("computeParameterCovariances", &FitterBase::computeParameterCovariances);
+    cls.def("getStatistics", &FitterBase::getStatistics, py::return_value_policy::copy);
+    cls.def("getTimings", &FitterBase::getTimings, py::return_value_policy::copy);
     cls.def("saveChi2Contributions", &FitterBase::saveChi2Contributions);
+    cls.def("saveCheckpoint", &FitterBase::saveCheckpoint, "path"_a, "step"_a = 0);
+    cls.def("loadCheckpoint", &FitterBase::loadCheckpoint, "path"_a);
 }
 
 void declareAstrometryFit(py::module &mod) {
     py::class_<AstrometryFit, std::shared_ptr<AstrometryFit>, FitterBase> cls(mod, "AstrometryFit");
 
-    cls.def(py::init<std::shared_ptr<Associations>, std::shared_ptr<AstrometryModel>, double>(),
-            "associations"_a, "astrometryModel"_a, "posError"_a);
+    cls.def(py::init<std::shared_ptr<Associations>, std::shared_ptr<AstrometryModel>, double,
+                     JointcalControl const &>(),
+            "associations"_a, "astrometryModel"_a, "posError"_a, "control"_a = JointcalControl());
 
     cls.def("getModel", &AstrometryFit::getModel, py::return_value_policy::reference_internal);
 }
@@ -60,8 +169,9 @@ void declareAstrometryFit(py::module &mod) {
 void declarePhotometryFit(py::module &mod) {
     py::class_<PhotometryFit, std::shared_ptr<PhotometryFit>, FitterBase> cls(mod, "PhotometryFit");
 
-    cls.def(py::init<std::shared_ptr<Associations>, std::shared_ptr<PhotometryModel>>(), "associations"_a,
-            "photometryModel"_a);
+    cls.def(py::init<std::shared_ptr<Associations>, std::shared_ptr<PhotometryModel>,
+                     JointcalControl const &>(),
+            "associations"_a, "photometryModel"_a, "control"_a = JointcalControl());
 
     cls.def("getModel", &PhotometryFit::getModel, py::return_value_policy::reference_internal);
 }
@@ -70,6 +180,7 @@ PYBIND11_MODULE(fitter, mod) {
     py::module::import("lsst.jointcal.associations");
     py::module::import("lsst.jointcal.astrometryModels");
     py::module::import("lsst.jointcal.chi2");
+    py::module::import("lsst.jointcal.jointcalControl");
     py::module::import("lsst.jointcal.photometryModels");
     py::enum_<MinimizeResult>(mod, "MinimizeResult")
             .value("Converged", MinimizeResult::Converged)
@@ -77,9 +188,15 @@ PYBIND11_MODULE(fitter, mod) {
             .value("NonFinite", MinimizeResult::NonFinite)
             .value("Failed", MinimizeResult::Failed);
 
+    declareFitterStatistics(mod);
+    declareFitterTimings(mod);
+    declareIterationResult(mod);
+    declareParameterCovariances(mod);
     declareFitterBase(mod);
     declareAstrometryFit(mod);
     declarePhotometryFit(mod);
+
+    mod.def("isPartitioningAvailable", &isPartitioningAvailable);
 }
 }  // namespace
 }  // namespace jointcal
@@ -35,7 +35,7 @@ import lsst.afw.table
 import lsst.log
 import lsst.meas.algorithms
 from lsst.pipe.tasks.colorterms import ColortermLibrary
-from lsst.verify import Job, Measurement
+from lsst.verify import Job, Measurement, Metric
 
 from lsst.meas.algorithms import LoadIndexedReferenceObjectsTask, ReferenceSourceSelectorTask
 from lsst.meas.algorithms.sourceSelector import sourceSelectorRegistry
@@ -57,6 +57,44 @@ def add_measurement(job, name, value):
     job.measurements.insert(meas)
 
 
+# The resources recorded for each phase by lsst::jointcal::PhaseStatistics: (attribute, unit, description).
+_PHASE_RESOURCES = (("wallSeconds", u.s, "wall time"),
+                    ("cpuSeconds", u.s, "CPU time, summed over threads"),
+                    ("peakResidentIncreaseBytes", u.byte, "increase of the peak resident memory"),
+                    ("peakResidentBytes", u.byte, "peak resident memory of the process"))
+_ASSOCIATIONS_PHASES = ("associateCatalogs", "collectRefStars", "prepareFittedStars")
+_FITTER_PHASES = ("assignIndices", "tripletFill", "hessianBuild", "factorization", "solve", "chi2",
+                  "findOutliers", "rankUpdate", "lineSearch")
+
+
+def add_phase_measurements(job, name, timings, phases):
+    """Record the resources used by each phase of a computation as
+    measurements named ``jointcal.<name>_<phase>_<resource>``.
+
+    These metrics are not part of the ``verify_metrics`` package: they are
+    defined here, to track the performance of jointcal from run to run.
+
+    Parameters
+    ----------
+    job : `lsst.verify.Job`
+        The job to add the measurements to.
+    name : `str`
+        Name of thing being fit: "astrometry" or "photometry".
+    timings : `lsst.jointcal.AssociationsTimings` or `lsst.jointcal.FitterTimings`
+        The resources used by each phase.
+    phases : `iterable` [`str`]
+        The phases of ``timings`` to record.
+    """
+    for phase in phases:
+        statistics = getattr(timings, phase)
+        for resource, unit, description in _PHASE_RESOURCES:
+            metricName = f"jointcal.{name}_{phase}_{resource}"
+            if metricName not in job.metrics:
+                job.metrics.insert(Metric(metricName, f"{description} of the {name} {phase} phase", unit))
+            job.measurements.insert(Measurement(job.metrics[metricName],
+                                                getattr(statistics, resource)*unit))
+
+
 class JointcalRunner(pipeBase.ButlerInitializedTaskRunner):
     """Subclass of TaskRunner for jointcalTask
 
@@ -191,6 +229,82 @@ class JointcalConfig(pexConfig.Config):
         dtype=bool,
         default=False
     )
+    lineSearchMethod = pexConfig.ChoiceField(
+        doc="How to perform the line search, if allowLineSearch is set.",
+        dtype=str,
+        default="brent",
+        allowed={
+            "brent": "Find the minimum of the chi2 to high precision; costs 20-40 chi2 evaluations.",
+            "model": ("Try the minimum of the quadratic model given by the gradient and Hessian, and refine "
+                      "it by interpolation until it satisfies the Armijo (and optionally Wolfe) conditions; "
+                      "costs 1 to lineSearchMaxEvaluations chi2 evaluations."),
+        }
+    )
+    lineSearchArmijo = pexConfig.Field(
+        doc="Sufficient decrease (Armijo) parameter of the model line search.",
+        dtype=float,
+        default=1e-4,
+        check=lambda x: 0 < x < 1,
+    )
+    lineSearchWolfe = pexConfig.Field(
+        doc=("Curvature (strong Wolfe) parameter of the model line search, larger than lineSearchArmijo "
+             "and smaller than 1. 0 skips this check, which costs one gradient evaluation per step."),
+        dtype=float,
+        default=0.0,
+        check=lambda x: x == 0 or 0 < x < 1,
+    )
+    lineSearchMaxEvaluations = pexConfig.Field(
+        doc="Maximum number of chi2 evaluations of the model line search.",
+        dtype=int,
+        default=3,
+        check=lambda x: x > 0,
+    )
+    levenbergMarquardt = pexConfig.Field(
+        doc=("Take damped (Levenberg-Marquardt) steps: solve (H + lambda*diag(H))*delta = grad, and only "
+             "accept steps that decrease the chi2, adapting lambda to the ratio of the actual to the "
+             "predicted decrease. Replaces the line search; cannot be used with conjugateGradient."),
+        dtype=bool,
+        default=False,
+    )
+    levenbergMarquardtInitialDamping = pexConfig.Field(
+        doc="Initial damping factor lambda of the Levenberg-Marquardt steps.",
+        dtype=float,
+        default=1e-3,
+        check=lambda x: x > 0,
+    )
+    levenbergMarquardtMaxTrials = pexConfig.Field(
+        doc="Maximum number of damping factors tried (each costing a factorization) per step.",
+        dtype=int,
+        default=10,
+        check=lambda x: x > 0,
+    )
+    levenbergMarquardtTolerance = pexConfig.Field(
+        doc=("A Levenberg-Marquardt step predicted to decrease the chi2 by less than this fraction of "
+             "the chi2 is considered converged, and is not retried with more damping."),
+        dtype=float,
+        default=1e-10,
+        check=lambda x: x >= 0,
+    )
+    robustLoss = pexConfig.ChoiceField(
+        doc=("Loss function of the measurement terms. With a robust loss, each fit step reweights the "
+             "terms according to their residuals, so that outliers hardly affect the fit, and "
+             "`outlierRejectSigma` only has to reject the gross outliers."),
+        dtype=str,
+        default="none",
+        allowed={
+            "none": "Least squares.",
+            "huber": "Quadratic up to `robustLossScale`, linear beyond.",
+            "cauchy": "Logarithmic beyond `robustLossScale`.",
+            "tukey": "Constant beyond `robustLossScale`: these terms have no weight at all.",
+        }
+    )
+    robustLossScale = pexConfig.Field(
+        doc=("Scale of the robust loss, in units of the measurement errors; 0 for the usual tuning "
+             "constant of the loss (1.345 for huber, 2.385 for cauchy, 4.685 for tukey)."),
+        dtype=float,
+        default=0,
+        check=lambda x: x >= 0,
+    )
     astrometrySimpleOrder = pexConfig.Field(
         doc="Polynomial order for fitting the simple astrometry model.",
         dtype=int,
@@ -273,6 +387,87 @@ class JointcalConfig(pexConfig.Config):
         dtype=int,
         default=20,
     )
+    assembleNormalEquations = pexConfig.Field(
+        doc=("Accumulate the Hessian directly from the derivatives of each measurement, instead of "
+             "building the full sparse Jacobian J and computing J*J^T. "
+             "This greatly reduces the peak memory use of large fits."),
+        dtype=bool,
+        default=False,
+    )
+    nThreads = pexConfig.Field(
+        doc=("Number of threads used to compute the fit derivatives (0 means one per core). "
+             "Each thread accumulates its part of the derivatives separately before they are merged, "
+             "which temporarily increases the memory use."),
+        dtype=int,
+        default=1,
+        check=lambda x: x >= 0,
+    )
+    ordering = pexConfig.ChoiceField(
+        doc="Fill-reducing ordering of the Cholesky factorization.",
+        dtype=str,
+        default="default",
+        allowed={
+            "default": ("Cholmod's strategy: AMD, and also METIS if AMD gives a lot of fill-in and jointcal "
+                        "is built without NPARTITION."),
+            "amd": "Approximate minimum degree.",
+            "colamd": "Column approximate minimum degree.",
+            "metis": "METIS nested dissection. Only available if jointcal is built without NPARTITION.",
+            "nesdis": ("Cholmod's nested dissection, built on METIS. Only available if jointcal is built "
+                       "without NPARTITION."),
+            "natural": "No reordering.",
+        }
+    )
+    orderingCacheDir = pexConfig.Field(
+        doc=("Directory where the fill-reducing orderings are cached, keyed by a hash of the pattern of the "
+             "normal equations, so that rerunning the same fits (e.g. the same tract and visits) skips "
+             "computing them. Created if needed; no caching if empty."),
+        dtype=str,
+        default="",
+    )
+    schurComplement = pexConfig.Field(
+        doc=("Eliminate the fitted star positions (and proper motions) from the astrometric normal "
+             "equations, so that only the much smaller reduced system over the other parameters is "
+             "factorized; the star positions are then back-substituted. Outlier rejection then always "
+             "refactorizes instead of using rank updates."),
+        dtype=bool,
+        default=False,
+    )
+    adaptiveDowndate = pexConfig.Field(
+        doc=("When rejecting outliers with rank updates (astrometryDoRankUpdate, photometryDoRankUpdate), "
+             "choose at each rejection step between downdating the factorization and recomputing it, "
+             "from the number of outlier terms and the measured factorization time: many outliers are "
+             "cheaper to refactorize, a few to downdate. The fit then depends slightly on timings."),
+        dtype=bool,
+        default=False,
+    )
+    refitTolerance = pexConfig.Field(
+        doc=("After the outlier rejection converged with rank updates, the fit is only redone from scratch "
+             "if the step computed with the downdated factorization would decrease the chi2 by more than "
+             "this fraction of the chi2. With 0, the fit is always redone."),
+        dtype=float,
+        default=0,
+        check=lambda x: x >= 0,
+    )
+    conjugateGradient = pexConfig.Field(
+        doc=("Solve the normal equations with a matrix-free, block-Jacobi preconditioned conjugate gradient "
+             "instead of a Cholesky factorization. The Hessian is never built, which makes fits too large "
+             "to factorize possible, at the cost of recomputing the derivatives at each iteration. "
+             "Overrides schurComplement."),
+        dtype=bool,
+        default=False,
+    )
+    conjugateGradientTolerance = pexConfig.Field(
+        doc="Residual norm, relative to the gradient norm, at which the conjugate gradient stops.",
+        dtype=float,
+        default=1e-8,
+        check=lambda x: x > 0,
+    )
+    conjugateGradientMaxIterations = pexConfig.Field(
+        doc="Maximum number of conjugate gradient iterations per solve.",
+        dtype=int,
+        default=1000,
+        check=lambda x: x > 0,
+    )
     astrometryRefObjLoader = pexConfig.ConfigurableField(
         target=LoadIndexedReferenceObjectsTask,
         doc="Reference object loader for astrometric fit",
@@ -303,11 +498,25 @@ class JointcalConfig(pexConfig.Config):
     )
     writeInitMatrix = pexConfig.Field(
         dtype=bool,
-        doc=("Write the pre/post-initialization Hessian and gradient to text files, for debugging. "
-             "The output files will be of the form 'astrometry_preinit-mat.txt', in the current directory. "
-             "Note that these files are the dense versions of the matrix, and so may be very large."),
+        doc=("Write the pre/post-initialization Hessian and gradient to files, for debugging, in the "
+             "current directory, in the format chosen by `writeInitMatrixFormat`."),
         default=False
     )
+    writeInitMatrixFormat = pexConfig.ChoiceField(
+        dtype=str,
+        doc="Format of the Hessian and gradient files written with `writeInitMatrix`.",
+        default="text",
+        allowed={
+            "text": ("Dense matrix and gradient text files, e.g. 'astrometry_preinit-mat.txt' and "
+                     "'astrometry_preinit-grad.txt', readable with numpy.loadtxt. Matrices too large "
+                     "for that are written in the binary format instead."),
+            "binary": ("The sparse lower triangle of the matrix and the gradient, streamed to a single "
+                       "binary file, e.g. 'astrometry_preinit-system.bin'; read it with "
+                       "`lsst.jointcal.readSparseSystem`."),
+            "matrixMarket": ("Matrix Market files, e.g. 'astrometry_preinit-mat.mtx' (symmetric, sparse) "
+                             "and 'astrometry_preinit-grad.mtx', readable with scipy.io.mmread."),
+        }
+    )
     writeChi2FilesInitialFinal = pexConfig.Field(
         dtype=bool,
         doc="Write .csv files containing the contributions to chi2 for the initialization and final fit.",
@@ -330,6 +539,21 @@ class JointcalConfig(pexConfig.Config):
         doc=("Path to write debug output files to. Used by "
              "`writeInitialModel`, `writeChi2Files*`, `writeInitMatrix`.")
     )
+    checkpointInterval = pexConfig.Field(
+        dtype=int,
+        default=0,
+        doc=("Write a checkpoint of the astrometric and photometric fits every this many outlier rejection "
+             "steps, to files in `debugOutputPath` (e.g. 'astrometry_checkpoint-{dataName}.bin'), "
+             "to resume them with `resumeFromCheckpoint`; 0 to never write checkpoints."),
+        check=lambda x: x >= 0,
+    )
+    resumeFromCheckpoint = pexConfig.Field(
+        dtype=bool,
+        default=False,
+        doc=("Resume the astrometric and photometric fits from the checkpoints written with "
+             "`checkpointInterval`, if they exist, instead of initializing them. The inputs must be those "
+             "of the run that wrote the checkpoints."),
+    )
     sourceFluxType = pexConfig.Field(
         dtype=str,
         doc="Source flux field to use in source selection and to get fluxes from the catalog.",
@@ -345,6 +569,12 @@ class JointcalConfig(pexConfig.Config):
             msg = ("Only doing astrometry, but Colorterms are not applied for astrometry;"
                    "applyColorTerms=True will be ignored.")
             lsst.log.warn(msg)
+        if self.levenbergMarquardt and self.conjugateGradient:
+            msg = "levenbergMarquardt needs the Hessian, which conjugateGradient never builds."
+            raise pexConfig.FieldValidationError(JointcalConfig.levenbergMarquardt, self, msg)
+        if self.ordering in ("metis", "nesdis") and not lsst.jointcal.isPartitioningAvailable():
+            msg = f"The {self.ordering} ordering is not available: jointcal was built with NPARTITION."
+            raise pexConfig.FieldValidationError(JointcalConfig.ordering, self, msg)
 
     def setDefaults(self):
         # Use science source selector which can filter on extendedness, SNR, and whether blended
@@ -498,6 +728,68 @@ class JointcalTask(pipeBase.CmdLineTask):
         """
         return os.path.join(self.config.debugOutputPath, filename)
 
+    def _getCheckpointPath(self, name, dataName):
+        """Return the path of the checkpoint file of a fit.
+        """
+        return self._getDebugPath(f"{name}_checkpoint-{dataName}.bin")
+
+    def _loadCheckpoint(self, fit, name, dataName):
+        """Restore a fit from its checkpoint, if `resumeFromCheckpoint` is
+        set and the checkpoint exists.
+
+        Parameters
+        ----------
+        fit : `lsst.jointcal.FitterBase`
+            The fitter to restore.
+        name : {'photometry' or 'astrometry'}
+            What type of data are we fitting (for logs and debugging files).
+        dataName : `str`
+            Name of the data being processed (e.g. "1234_HSC-Y").
+
+        Returns
+        -------
+        firstStep : `int` or `None`
+            The number of outlier rejection steps done when the checkpoint was
+            written, or `None` if no checkpoint was loaded.
+        """
+        path = self._getCheckpointPath(name, dataName)
+        if not self.config.resumeFromCheckpoint or not os.path.exists(path):
+            return None
+        firstStep = fit.loadCheckpoint(path)
+        self.log.info("Resuming %s fit at step %d from checkpoint: %s", name, firstStep, path)
+        return firstStep
+
+    def _makeJointcalControl(self):
+        """Return a `lsst.jointcal.JointcalControl` built from this task's config.
+        """
+        sourceFluxField = "slot_%sFlux" % (self.config.sourceFluxType,)
+        jointcalControl = lsst.jointcal.JointcalControl(sourceFluxField)
+        jointcalControl.assembleNormalEquations = self.config.assembleNormalEquations
+        jointcalControl.nThreads = self.config.nThreads
+        jointcalControl.ordering = self.config.ordering
+        if self.config.orderingCacheDir:
+            os.makedirs(self.config.orderingCacheDir, exist_ok=True)
+            jointcalControl.orderingCacheDir = self.config.orderingCacheDir
+        jointcalControl.schurComplement = self.config.schurComplement
+        jointcalControl.adaptiveDowndate = self.config.adaptiveDowndate
+        jointcalControl.refitTolerance = self.config.refitTolerance
+        jointcalControl.conjugateGradient = self.config.conjugateGradient
+        jointcalControl.conjugateGradientTolerance = self.config.conjugateGradientTolerance
+        jointcalControl.conjugateGradientMaxIterations = self.config.conjugateGradientMaxIterations
+        jointcalControl.lineSearchMethod = self.config.lineSearchMethod
+        jointcalControl.lineSearchArmijo = self.config.lineSearchArmijo
+        jointcalControl.lineSearchWolfe = self.config.lineSearchWolfe
+        jointcalControl.lineSearchMaxEvaluations = self.config.lineSearchMaxEvaluations
+        jointcalControl.levenbergMarquardt = self.config.levenbergMarquardt
+        jointcalControl.levenbergMarquardtInitialDamping = self.config.levenbergMarquardtInitialDamping
+        jointcalControl.levenbergMarquardtMaxTrials = self.config.levenbergMarquardtMaxTrials
+        jointcalControl.levenbergMarquardtTolerance = self.config.levenbergMarquardtTolerance
+        jointcalControl.robustLoss = self.config.robustLoss
+        jointcalControl.robustLossScale = self.config.robustLossScale
+        jointcalControl.checkpointInterval = self.config.checkpointInterval
+        jointcalControl.dumpMatrixFormat = self.config.writeInitMatrixFormat
+        return jointcalControl
+
     @pipeBase.timeMethod
     def runDataRef(self, dataRefs, profile_jointcal=False):
         """
@@ -527,8 +819,7 @@ class JointcalTask(pipeBase.CmdLineTask):
 
         exitStatus = 0  # exit status for shell
 
-        sourceFluxField = "slot_%sFlux" % (self.config.sourceFluxType,)
-        jointcalControl = lsst.jointcal.JointcalControl(sourceFluxField)
+        jointcalControl = self._makeJointcalControl()
         associations = lsst.jointcal.Associations()
 
         visit_ccd_to_dataRef = {}
@@ -676,6 +967,13 @@ class JointcalTask(pipeBase.CmdLineTask):
         dataName = "{}_{}".format(tract, defaultFilter)
         with pipeBase.cmdLineTask.profile(load_cat_prof_file):
             result = fit_function(associations, dataName)
+        add_phase_measurements(self.job, name, associations.getTimings(), _ASSOCIATIONS_PHASES)
+        timings = result.fit.getTimings()
+        add_phase_measurements(self.job, name, timings, _FITTER_PHASES)
+        self.log.debug("%s fit phases, wall/CPU seconds: %s", name,
+                       ", ".join("%s %.3g/%.3g" % (phase, getattr(timings, phase).wallSeconds,
+                                                   getattr(timings, phase).cpuSeconds)
+                                 for phase in _FITTER_PHASES))
         # TODO DM-12446: turn this into a "butler save" somehow.
         # Save reference and measurement chi2 contributions for this data
         if self.config.writeChi2FilesInitialFinal:
@@ -851,7 +1149,7 @@ class JointcalTask(pipeBase.CmdLineTask):
                                                        errorPedestal=self.config.photometryErrorPedestal)
             doLineSearch = False  # purely linear in model parameters, so no line search needed
 
-        fit = lsst.jointcal.PhotometryFit(associations, model)
+        fit = lsst.jointcal.PhotometryFit(associations, model, self._makeJointcalControl())
         # TODO DM-12446: turn this into a "butler save" somehow.
         # Save reference and measurement chi2 contributions for this data
         if self.config.writeChi2FilesInitialFinal:
@@ -869,26 +1167,32 @@ class JointcalTask(pipeBase.CmdLineTask):
             else:
                 return None
 
-        # The constrained model needs the visit transform fit first; the chip
-        # transform is initialized from the singleFrame PhotoCalib, so it's close.
-        dumpMatrixFile = self._getDebugPath("photometry_preinit") if self.config.writeInitMatrix else ""
-        if self.config.photometryModel.startswith("constrained"):
-            # no line search: should be purely (or nearly) linear,
-            # and we want a large step size to initialize with.
-            fit.minimize("ModelVisit", dumpMatrixFile=dumpMatrixFile)
-            self._logChi2AndValidate(associations, fit, model, writeChi2Name=getChi2Name("ModelVisit"))
-            dumpMatrixFile = ""  # so we don't redo the output on the next step
-
-        fit.minimize("Model", doLineSearch=doLineSearch, dumpMatrixFile=dumpMatrixFile)
-        self._logChi2AndValidate(associations, fit, model, writeChi2Name=getChi2Name("Model"))
-
-        fit.minimize("Fluxes")  # no line search: always purely linear.
-        self._logChi2AndValidate(associations, fit, model, writeChi2Name=getChi2Name("Fluxes"))
-
-        fit.minimize("Model Fluxes", doLineSearch=doLineSearch)
-        self._logChi2AndValidate(associations, fit, model, "Fit prepared",
-                                 writeChi2Name=getChi2Name("ModelFluxes"))
+        firstStep = self._loadCheckpoint(fit, "photometry", dataName)
+        if firstStep is None:
+            # The constrained model needs the visit transform fit first; the chip
+            # transform is initialized from the singleFrame PhotoCalib, so it's close.
+            dumpMatrixFile = self._getDebugPath("photometry_preinit") if self.config.writeInitMatrix else ""
+            if self.config.photometryModel.startswith("constrained"):
+                # no line search: should be purely (or nearly) linear,
+                # and we want a large step size to initialize with.
+                fit.minimize("ModelVisit", dumpMatrixFile=dumpMatrixFile)
+                self._logChi2AndValidate(associations, fit, model, writeChi2Name=getChi2Name("ModelVisit"))
+                dumpMatrixFile = ""  # so we don't redo the output on the next step
+
+            fit.minimize("Model", doLineSearch=doLineSearch, dumpMatrixFile=dumpMatrixFile)
+            self._logChi2AndValidate(associations, fit, model, writeChi2Name=getChi2Name("Model"))
+
+            fit.minimize("Fluxes")  # no line search: always purely linear.
+            self._logChi2AndValidate(associations, fit, model, writeChi2Name=getChi2Name("Fluxes"))
+
+            fit.minimize("Model Fluxes", doLineSearch=doLineSearch)
+            self._logChi2AndValidate(associations, fit, model, "Fit prepared",
+                                     writeChi2Name=getChi2Name("ModelFluxes"))
+            firstStep = 0
+        else:
+            self._logChi2AndValidate(associations, fit, model, "Fit resumed")
 
+        # A resumed fit freezes the error transform at the checkpointed parameters.
         model.freezeErrorTransform()
         self.log.debug("Photometry error scales are frozen.")
 
@@ -899,7 +1203,8 @@ class JointcalTask(pipeBase.CmdLineTask):
                                  "Model Fluxes",
                                  doRankUpdate=self.config.photometryDoRankUpdate,
                                  doLineSearch=doLineSearch,
-                                 dataName=dataName)
+                                 dataName=dataName,
+                                 firstStep=firstStep)
 
         add_measurement(self.job, 'jointcal.photometry_final_chi2', chi2.chi2)
         add_measurement(self.job, 'jointcal.photometry_final_ndof', chi2.ndof)
@@ -949,7 +1254,8 @@ class JointcalTask(pipeBase.CmdLineTask):
                                                         nNotFit=0,
                                                         order=self.config.astrometrySimpleOrder)
 
-        fit = lsst.jointcal.AstrometryFit(associations, model, self.config.positionErrorPedestal)
+        fit = lsst.jointcal.AstrometryFit(associations, model, self.config.positionErrorPedestal,
+                                          self._makeJointcalControl())
         # TODO DM-12446: turn this into a "butler save" somehow.
         # Save reference and measurement chi2 contributions for this data
         if self.config.writeChi2FilesInitialFinal:
@@ -967,23 +1273,29 @@ class JointcalTask(pipeBase.CmdLineTask):
             else:
                 return None
 
-        dumpMatrixFile = self._getDebugPath("astrometry_preinit") if self.config.writeInitMatrix else ""
-        # The constrained model needs the visit transform fit first; the chip
-        # transform is initialized from the detector's cameraGeom, so it's close.
-        if self.config.astrometryModel == "constrained":
-            fit.minimize("DistortionsVisit", dumpMatrixFile=dumpMatrixFile)
-            self._logChi2AndValidate(associations, fit, model, writeChi2Name=getChi2Name("DistortionsVisit"))
-            dumpMatrixFile = ""  # so we don't redo the output on the next step
-
-        fit.minimize("Distortions", dumpMatrixFile=dumpMatrixFile)
-        self._logChi2AndValidate(associations, fit, model, writeChi2Name=getChi2Name("Distortions"))
-
-        fit.minimize("Positions")
-        self._logChi2AndValidate(associations, fit, model, writeChi2Name=getChi2Name("Positions"))
-
-        fit.minimize("Distortions Positions")
-        self._logChi2AndValidate(associations, fit, model, "Fit prepared",
-                                 writeChi2Name=getChi2Name("DistortionsPositions"))
+        firstStep = self._loadCheckpoint(fit, "astrometry", dataName)
+        if firstStep is None:
+            dumpMatrixFile = self._getDebugPath("astrometry_preinit") if self.config.writeInitMatrix else ""
+            # The constrained model needs the visit transform fit first; the chip
+            # transform is initialized from the detector's cameraGeom, so it's close.
+            if self.config.astrometryModel == "constrained":
+                fit.minimize("DistortionsVisit", dumpMatrixFile=dumpMatrixFile)
+                self._logChi2AndValidate(associations, fit, model,
+                                         writeChi2Name=getChi2Name("DistortionsVisit"))
+                dumpMatrixFile = ""  # so we don't redo the output on the next step
+
+            fit.minimize("Distortions", dumpMatrixFile=dumpMatrixFile)
+            self._logChi2AndValidate(associations, fit, model, writeChi2Name=getChi2Name("Distortions"))
+
+            fit.minimize("Positions")
+            self._logChi2AndValidate(associations, fit, model, writeChi2Name=getChi2Name("Positions"))
+
+            fit.minimize("Distortions Positions")
+            self._logChi2AndValidate(associations, fit, model, "Fit prepared",
+                                     writeChi2Name=getChi2Name("DistortionsPositions"))
+            firstStep = 0
+        else:
+            self._logChi2AndValidate(associations, fit, model, "Fit resumed")
 
         chi2 = self._iterate_fit(associations,
                                  fit,
@@ -991,7 +1303,8 @@ class JointcalTask(pipeBase.CmdLineTask):
                                  "astrometry",
                                  "Distortions Positions",
                                  doRankUpdate=self.config.astrometryDoRankUpdate,
-                                 dataName=dataName)
+                                 dataName=dataName,
+                                 firstStep=firstStep)
 
         add_measurement(self.job, 'jointcal.astrometry_final_chi2', chi2.chi2)
         add_measurement(self.job, 'jointcal.astrometry_final_ndof', chi2.ndof)
@@ -1014,8 +1327,10 @@ class JointcalTask(pipeBase.CmdLineTask):
     def _iterate_fit(self, associations, fitter, max_steps, name, whatToFit,
                      dataName="",
                      doRankUpdate=True,
-                     doLineSearch=False):
-        """Run fitter.minimize up to max_steps times, returning the final chi2.
+                     doLineSearch=False,
+                     firstStep=0):
+        """Run fitter.iterate, which calls minimize up to max_steps times,
+        returning the final chi2.
 
         Parameters
         ----------
@@ -1038,6 +1353,8 @@ class JointcalTask(pipeBase.CmdLineTask):
             matrix and gradient?
         doLineSearch : `bool`, optional
             Do a line search for the optimum step during minimization?
+        firstStep : `int`, optional
+            Number of steps already done, when resuming from a checkpoint.
 
         Returns
         -------
@@ -1053,48 +1370,66 @@ class JointcalTask(pipeBase.CmdLineTask):
             log messages will provide further details.
         """
         dumpMatrixFile = self._getDebugPath(f"{name}_postinit") if self.config.writeInitMatrix else ""
-        for i in range(max_steps):
-            if self.config.writeChi2FilesOuterLoop:
-                writeChi2Name = f"{name}_iterate_{i}_chi2-{dataName}"
-            else:
-                writeChi2Name = None
-            result = fitter.minimize(whatToFit,
-                                     self.config.outlierRejectSigma,
-                                     doRankUpdate=doRankUpdate,
-                                     doLineSearch=doLineSearch,
-                                     dumpMatrixFile=dumpMatrixFile)
-            dumpMatrixFile = ""  # clear it so we don't write the matrix again.
-            chi2 = self._logChi2AndValidate(associations, fitter, fitter.getModel(),
-                                            writeChi2Name=writeChi2Name)
-
-            if result == MinimizeResult.Converged:
-                if doRankUpdate:
-                    self.log.debug("fit has converged - no more outliers - redo minimization "
-                                   "one more time in case we have lost accuracy in rank update.")
-                    # Redo minimization one more time in case we have lost accuracy in rank update
-                    result = fitter.minimize(whatToFit, self.config.outlierRejectSigma)
-                    chi2 = self._logChi2AndValidate(associations, fitter, fitter.getModel(), "Fit completed")
-
-                # log a message for a large final chi2, TODO: DM-15247 for something better
-                if chi2.chi2/chi2.ndof >= 4.0:
-                    self.log.error("Potentially bad fit: High chi-squared/ndof.")
-
-                break
-            elif result == MinimizeResult.Chi2Increased:
-                self.log.warn("still some outliers but chi2 increases - retry")
-            elif result == MinimizeResult.NonFinite:
-                filename = self._getDebugPath("{}_failure-nonfinite_chi2-{}.csv".format(name, dataName))
-                # TODO DM-12446: turn this into a "butler save" somehow.
-                fitter.saveChi2Contributions(filename+"{type}")
-                msg = "Nonfinite value in chi2 minimization, cannot complete fit. Dumped star tables to: {}"
-                raise FloatingPointError(msg.format(filename))
-            elif result == MinimizeResult.Failed:
-                raise RuntimeError("Chi2 minimization failure, cannot complete fit.")
-            else:
-                raise RuntimeError("Unxepected return code from minimize().")
+        if self.config.writeChi2FilesOuterLoop:
+            saveChi2BaseName = self._getDebugPath(f"{name}_iterate_{{step}}_chi2-{dataName}") + "{type}"
+        else:
+            saveChi2BaseName = ""
+        if self.config.checkpointInterval > 0:
+            checkpointFile = self._getCheckpointPath(name, dataName)
         else:
-            self.log.error("%s failed to converge after %d steps"%(name, max_steps))
+            checkpointFile = ""
+        # A fit resumed from its last step still gets one step, to report how it ends.
+        iteration = fitter.iterate(whatToFit, max(max_steps, firstStep + 1), self.config.outlierRejectSigma,
+                                   doRankUpdate=doRankUpdate,
+                                   doLineSearch=doLineSearch,
+                                   dumpMatrixFile=dumpMatrixFile,
+                                   saveChi2BaseName=saveChi2BaseName,
+                                   checkpointFile=checkpointFile,
+                                   firstStep=firstStep)
+        # iterate() already warned about each retried step: only the result of the whole iteration is
+        # reported below.
+        for i, step in enumerate(iteration.steps, start=firstStep):
+            self.log.info("%s step %d: %s, %s, %d + %d outliers (measured + reference), %.3g s",
+                          name, i, step.result.name, step.chi2, step.nMeasurementOutliers,
+                          step.nReferenceOutliers, step.seconds)
+
+        result = iteration.result
+        if result == MinimizeResult.NonFinite:
+            filename = self._getDebugPath("{}_failure-nonfinite_chi2-{}.csv".format(name, dataName))
+            # TODO DM-12446: turn this into a "butler save" somehow.
+            fitter.saveChi2Contributions(filename+"{type}")
+            msg = "Nonfinite value in chi2 minimization, cannot complete fit. Dumped star tables to: {}"
+            raise FloatingPointError(msg.format(filename))
+        elif result == MinimizeResult.Failed:
+            raise RuntimeError("Chi2 minimization failure, cannot complete fit.")
+        elif result == MinimizeResult.Converged:
+            if iteration.refit:
+                self.log.debug("fit has converged - no more outliers - redid minimization one more time "
+                               "in case we have lost accuracy in rank update.")
+            elif doRankUpdate:
+                self.log.debug("fit has converged - no more outliers - final minimization skipped: "
+                               "predicted chi2 decrease %g", iteration.refitPredictedDecrease)
+            chi2 = self._logChi2AndValidate(associations, fitter, fitter.getModel(), "Fit completed")
+
+            # log a message for a large final chi2, TODO: DM-15247 for something better
+            if chi2.chi2/chi2.ndof >= 4.0:
+                self.log.error("Potentially bad fit: High chi-squared/ndof.")
+        elif result == MinimizeResult.Chi2Increased:
+            self.log.error("%s failed to converge after %d steps", name, firstStep + len(iteration.steps))
+            chi2 = self._logChi2AndValidate(associations, fitter, fitter.getModel())
+        else:
+            raise RuntimeError("Unxepected return code from iterate().")
 
+        statistics = fitter.getStatistics()
+        if self.config.conjugateGradient:
+            self.log.debug("%s: %d conjugate gradient iterations so far, last relative residual: %g",
+                           name, statistics.nConjugateGradientIterations,
+                           statistics.lastConjugateGradientResidual)
+        else:
+            self.log.debug("%s: used %s factorization; %d symbolic analyses, %d numeric factorizations, "
+                           "%d downdates so far", name, statistics.factorization,
+                           statistics.nSymbolicAnalyses, statistics.nNumericFactorizations,
+                           statistics.nDowndates)
         return chi2
 
     def _write_astrometry_results(self, associations, model, visit_ccd_to_dataRef):
@@ -39,6 +39,28 @@ void declareJointcalControl(py::module &mod) {
     cls.def(py::init<std::string>(), "sourceFluxField"_a = "slot_CalibFlux");
 
     LSST_DECLARE_CONTROL_FIELD(cls, JointcalControl, sourceFluxField);
+    LSST_DECLARE_CONTROL_FIELD(cls, JointcalControl, assembleNormalEquations);
+    LSST_DECLARE_CONTROL_FIELD(cls, JointcalControl, nThreads);
+    LSST_DECLARE_CONTROL_FIELD(cls, JointcalControl, ordering);
+    LSST_DECLARE_CONTROL_FIELD(cls, JointcalControl, orderingCacheDir);
+    LSST_DECLARE_CONTROL_FIELD(cls, JointcalControl, schurComplement);
+    LSST_DECLARE_CONTROL_FIELD(cls, JointcalControl, adaptiveDowndate);
+    LSST_DECLARE_CONTROL_FIELD(cls, JointcalControl, refitTolerance);
+    LSST_DECLARE_CONTROL_FIELD(cls, JointcalControl, conjugateGradient);
+    LSST_DECLARE_CONTROL_FIELD(cls, JointcalControl, conjugateGradientTolerance);
+    LSST_DECLARE_CONTROL_FIELD(cls, JointcalControl, conjugateGradientMaxIterations);
+    LSST_DECLARE_CONTROL_FIELD(cls, JointcalControl, lineSearchMethod);
+    LSST_DECLARE_CONTROL_FIELD(cls, JointcalControl, lineSearchArmijo);
+    LSST_DECLARE_CONTROL_FIELD(cls, JointcalControl, lineSearchWolfe);
+    LSST_DECLARE_CONTROL_FIELD(cls, JointcalControl, lineSearchMaxEvaluations);
+    LSST_DECLARE_CONTROL_FIELD(cls, JointcalControl, levenbergMarquardt);
+    LSST_DECLARE_CONTROL_FIELD(cls, JointcalControl, levenbergMarquardtInitialDamping);
+    LSST_DECLARE_CONTROL_FIELD(cls, JointcalControl, levenbergMarquardtMaxTrials);
+    LSST_DECLARE_CONTROL_FIELD(cls, JointcalControl, levenbergMarquardtTolerance);
+    LSST_DECLARE_CONTROL_FIELD(cls, JointcalControl, robustLoss);
+    LSST_DECLARE_CONTROL_FIELD(cls, JointcalControl, robustLossScale);
+    LSST_DECLARE_CONTROL_FIELD(cls, JointcalControl, checkpointInterval);
+    LSST_DECLARE_CONTROL_FIELD(cls, JointcalControl, dumpMatrixFormat);
 }
 
 PYBIND11_MODULE(jointcalControl, mod) { declareJointcalControl(mod); }
@@ -54,8 +54,10 @@ void declarePhotometryModel(py::module &mod) {
     cls.def("offsetFittedStar", &PhotometryModel::offsetFittedStar);
 
     cls.def("transform", &PhotometryModel::transform);
-    cls.def("transformError", &PhotometryModel::transformError);
-    cls.def("computeResidual", &PhotometryModel::computeResidual);
+    cls.def("transformError", py::overload_cast<CcdImage const &, MeasuredStar const &>(
+                                      &PhotometryModel::transformError, py::const_));
+    cls.def("computeResidual", py::overload_cast<CcdImage const &, MeasuredStar const &>(
+                                       &PhotometryModel::computeResidual, py::const_));
 
     cls.def("getRefError", &PhotometryModel::getRefError);
     cls.def("computeRefResidual", &PhotometryModel::computeRefResidual);
@@ -0,0 +1,110 @@
+# This file is part of jointcal.
+#
+# Developed for the LSST Data Management System.
+# This product includes software developed by the LSST Project
+# (https://www.lsst.org).
+# See the COPYRIGHT file at the top-level directory of this distribution
+# for details of code ownership.
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+"""Read the Hessian and gradient files written with
+``JointcalControl.dumpMatrixFormat="binary"``.
+"""
+import collections
+import os
+
+import numpy as np
+
+__all__ = ["SparseSystem", "readSparseSystem"]
+
+SparseSystem = collections.namedtuple("SparseSystem", ["hessian", "gradient"])
+
+_MAGIC = b"JCSPARSE"
+_BYTE_ORDER_MARK = 0x01020304
+_VERSION = 1
+_HEADER = np.dtype([("magic", "S8"), ("byteOrderMark", "u4"), ("version", "u4"), ("lowerTriangle", "u4"),
+                    ("indexSize", "u4"), ("nRows", "i8"), ("nCols", "i8"), ("nNonZeros", "i8"),
+                    ("nGradient", "i8")])
+
+
+def readSparseSystem(path, symmetric=False):
+    """Read a Hessian and gradient written by ``lsst::jointcal::writeSparseSystem``.
+
+    Parameters
+    ----------
+    path : `str`
+        The file to read, e.g. ``astrometry_preinit-system.bin``.
+    symmetric : `bool`, optional
+        Return the full symmetric Hessian, instead of its lower triangle as
+        stored in the file.
+
+    Returns
+    -------
+    system : `SparseSystem`
+        ``hessian``, a `scipy.sparse.csc_matrix`, and ``gradient``, a
+        `numpy.ndarray`. The fit step solves ``hessian @ step = gradient``.
+
+    Raises
+    ------
+    RuntimeError
+        Raised if the file is not in the expected format, or if the matrix is
+        not a valid compressed sparse column matrix.
+    """
+    import scipy.sparse
+
+    with open(path, "rb") as infile:
+        header = np.fromfile(infile, dtype=_HEADER, count=1)
+        if len(header) != 1 or header["magic"][0] != _MAGIC:
+            raise RuntimeError(f"Not a jointcal sparse system file: {path}")
+        # The file is written in the native byte order of the machine that wrote it.
+        byteOrder = "="
+        if header["byteOrderMark"][0] != _BYTE_ORDER_MARK:
+            byteOrder = "S"
+            header = header.view(_HEADER.newbyteorder(byteOrder))
+            if header["byteOrderMark"][0] != _BYTE_ORDER_MARK:
+                raise RuntimeError(f"Corrupted sparse system file header: {path}")
+        if header["version"][0] != _VERSION or header["indexSize"][0] != 8:
+            raise RuntimeError(f"Unsupported sparse system file version {header['version'][0]}: {path}")
+        nRows, nCols, nNonZeros, nGradient = (int(header[name][0]) for name in
+                                              ("nRows", "nCols", "nNonZeros", "nGradient"))
+        # Check the sizes against the file size before reading (and allocating) anything from them.
+        fileSize = os.fstat(infile.fileno()).st_size
+        sizes = (nRows, nCols, nNonZeros, nGradient)
+        if min(sizes) < 0 or max(sizes) > fileSize // 8:
+            raise RuntimeError(f"Corrupted sparse system file header: {path}")
+        expectedSize = _HEADER.itemsize + 8*(nCols + 1) + 16*nNonZeros + 8*nGradient
+        if fileSize != expectedSize:
+            raise RuntimeError(f"Sparse system file of {fileSize} bytes instead of the {expectedSize} of its "
+                               f"header: {path}")
+
+        def read(dtype, count):
+            array = np.fromfile(infile, dtype=np.dtype(dtype).newbyteorder(byteOrder), count=count)
+            if len(array) != count:
+                raise RuntimeError(f"Truncated sparse system file: {path}")
+            return array
+
+        columnStarts = read("i8", nCols + 1)
+        if columnStarts[0] != 0 or columnStarts[-1] != nNonZeros or np.any(np.diff(columnStarts) < 0):
+            raise RuntimeError(f"Corrupted sparse system column starts: {path}")
+        rows = read("i8", nNonZeros)
+        if nNonZeros > 0 and (rows.min() < 0 or rows.max() >= nRows):
+            raise RuntimeError(f"Corrupted sparse system row indices: {path}")
+        values = read("f8", nNonZeros)
+        gradient = read("f8", nGradient)
+
+    hessian = scipy.sparse.csc_matrix((values, rows, columnStarts), shape=(nRows, nCols))
+    if symmetric and header["lowerTriangle"][0]:
+        hessian = (hessian + scipy.sparse.tril(hessian, k=-1).T).tocsc()
+    return SparseSystem(hessian, gradient)
@@ -36,6 +36,7 @@
 #include "lsst/jointcal/FatPoint.h"
 #include "lsst/jointcal/AstrometryTransform.h"
 #include "lsst/jointcal/MeasuredStar.h"
+#include "lsst/jointcal/PhaseTimer.h"
 
 #include "lsst/afw/image/Image.h"
 #include "lsst/afw/image/VisitInfo.h"
@@ -120,6 +121,7 @@ lsst::sphgeom::Circle Associations::computeBoundingCircle() const {
 
 void Associations::associateCatalogs(const double matchCutInArcSec, const bool useFittedList,
                                      const bool enlargeFittedList) {
+    PhaseTimer timer(_timings.associateCatalogs);
     // clear reference stars
     refStarList.clear();
 
@@ -136,7 +138,7 @@ void Associations::associateCatalogs(const double matchCutInArcSec, const bool u
         // Clear the catalog to fit and copy the whole catalog into it.
         // This allows reassociating from scratch after a fit.
         ccdImage->resetCatalogForFit();
-        MeasuredStarList &catalog = ccdImage->getCatalogForFit();
+        MeasuredStarList &catalog = ccdImage->modifyCatalogForFit();
 
         // Associate with previous lists.
         /* To speed up the match (more precisely the contruction of the FastFinder), select in the
@@ -178,20 +180,24 @@ void Associations::associateCatalogs(const double matchCutInArcSec, const bool u
         LOGLS_INFO(_log, "Matched " << matchedCount << " objects in " << ccdImage->getName());
 
         // add unmatched objets to FittedStarList
-        int unMatchedCount = 0;
+        std::vector<std::shared_ptr<MeasuredStar>> unMatched;
         for (auto const &mstar : catalog) {
             // to check if it was matched, just check if it has a fittedStar Pointer assigned
-            if (mstar->getFittedStar()) continue;
-            if (enlargeFittedList) {
-                auto fs = std::make_shared<FittedStar>(*mstar);
-                // transform coordinates to CommonTangentPlane
-                toCommonTangentPlane->transformPosAndErrors(*fs, *fs);
+            if (!mstar->getFittedStar()) unMatched.push_back(mstar);
+        }
+        if (enlargeFittedList) {
+            // transform coordinates to CommonTangentPlane, all at once
+            FatPointArrays points(unMatched.size());
+            for (std::size_t i = 0; i < unMatched.size(); ++i) points.set(i, *unMatched[i]);
+            toCommonTangentPlane->transformPosAndErrorsBatch(points, points);
+            for (std::size_t i = 0; i < unMatched.size(); ++i) {
+                auto fs = std::make_shared<FittedStar>(*unMatched[i]);
+                static_cast<FatPoint &>(*fs) = points.get(i);
                 fittedStarList.push_back(fs);
-                mstar->setFittedStar(fs);
+                unMatched[i]->setFittedStar(fs);
             }
-            unMatchedCount++;
         }
-        LOGLS_INFO(_log, "Unmatched objects: " << unMatchedCount);
+        LOGLS_INFO(_log, "Unmatched objects: " << unMatched.size());
     }  // end of loop on CcdImages
 
     // !!!!!!!!!!!!!!!!!
@@ -205,6 +211,7 @@ void Associations::associateCatalogs(const double matchCutInArcSec, const bool u
 void Associations::collectRefStars(afw::table::SimpleCatalog &refCat, geom::Angle matchCut,
                                    std::string const &fluxField, float refCoordinateErr,
                                    bool rejectBadFluxes) {
+    PhaseTimer timer(_timings.collectRefStars);
     if (refCat.size() == 0) {
         throw(LSST_EXCEPT(pex::exceptions::InvalidParameterError,
                           " reference catalog is empty : stop here "));
@@ -296,6 +303,7 @@ void Associations::associateRefStars(double matchCutInArcSec, const AstrometryTr
 }
 
 void Associations::prepareFittedStars(int minMeasurements) {
+    PhaseTimer timer(_timings.prepareFittedStars);
     selectFittedStars(minMeasurements);
     normalizeFittedStars();
 }
@@ -307,7 +315,7 @@ void Associations::selectFittedStars(int minMeasurements) {
 
     // first pass: remove objects that have less than a certain number of measurements.
     for (auto const &ccdImage : ccdImageList) {
-        MeasuredStarList &catalog = ccdImage->getCatalogForFit();
+        MeasuredStarList &catalog = ccdImage->modifyCatalogForFit();
         // Iteration happens internal to the loop, as we may delete measuredStars from catalog.
         for (MeasuredStarIterator mi = catalog.begin(); mi != catalog.end();) {
             MeasuredStar &mstar = **mi;
@@ -357,17 +365,27 @@ void Associations::normalizeFittedStars() const {
     // Iterate over measuredStars to add their values into their fittedStars
     for (auto const &ccdImage : ccdImageList) {
         std::shared_ptr<AstrometryTransform> toCommonTangentPlane = ccdImage->getPixelToCommonTangentPlane();
-        MeasuredStarList &catalog = ccdImage->getCatalogForFit();
+        MeasuredStarList const &catalog = ccdImage->getCatalogForFit();
+        // transform the whole catalog to CommonTangentPlane at once
+        Eigen::ArrayXd x(catalog.size()), y(catalog.size());
+        Eigen::Index i = 0;
+        for (auto const &mi : catalog) {
+            x[i] = mi->x;
+            y[i] = mi->y;
+            ++i;
+        }
+        toCommonTangentPlane->applyBatch(x, y, x, y);
+        i = 0;
         for (auto &mi : catalog) {
             auto fittedStar = mi->getFittedStar();
             if (fittedStar == nullptr)
                 throw(LSST_EXCEPT(
                         pex::exceptions::RuntimeError,
                         "All measuredStars must have a fittedStar: did you call selectFittedStars()?"));
-            auto point = toCommonTangentPlane->apply(*mi);
-            fittedStar->x += point.x;
-            fittedStar->y += point.y;
+            fittedStar->x += x[i];
+            fittedStar->y += y[i];
             fittedStar->getFlux() += mi->getFlux();
+            ++i;
         }
     }
 
@@ -382,7 +400,7 @@ void Associations::normalizeFittedStars() const {
 
 void Associations::assignMags() {
     for (auto const &ccdImage : ccdImageList) {
-        MeasuredStarList &catalog = ccdImage->getCatalogForFit();
+        MeasuredStarList const &catalog = ccdImage->getCatalogForFit();
         for (auto const &mstar : catalog) {
             auto fstar = mstar->getFittedStar();
             if (!fstar) continue;
@@ -436,7 +454,7 @@ void Associations::collectMCStars(int realization) {
         }
 
         AstrometryTransformIdentity gti;
-        MeasuredStarList &catalog = ccdImage.getCatalogForFit();
+        MeasuredStarList &catalog = ccdImage.modifyCatalogForFit();
 
         //      BaseStarWithErrorList mctruthlist(mctruth);
         DicStarList mctruthlist(mctruth);
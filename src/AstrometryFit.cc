@@ -26,6 +26,7 @@
 #include <iomanip>
 #include <algorithm>
 #include <fstream>
+#include <unordered_map>
 
 #include "Eigen/Sparse"
 
@@ -38,14 +39,17 @@
 #include "lsst/jointcal/FitterBase.h"
 #include "lsst/jointcal/AstrometryMapping.h"
 #include "lsst/jointcal/AstrometryTransform.h"
+#include "lsst/jointcal/MeasurementArrays.h"
+#include "lsst/jointcal/Threads.h"
 #include "lsst/jointcal/Tripletlist.h"
 
 namespace lsst {
 namespace jointcal {
 
 AstrometryFit::AstrometryFit(std::shared_ptr<Associations> associations,
-                             std::shared_ptr<AstrometryModel> astrometryModel, double posError)
-        : FitterBase(associations),
+                             std::shared_ptr<AstrometryModel> astrometryModel, double posError,
+                             JointcalControl const &control)
+        : FitterBase(associations, control),
           _astrometryModel(astrometryModel),
           _refractionCoefficient(0),
           _nParDistortions(0),
@@ -70,6 +74,7 @@ AstrometryFit::AstrometryFit(std::shared_ptr<Associations> associations,
         if (_sigCol > 0) _sigCol = sqrt(_sigCol / count - std::pow(_referenceColor, 2));
     }
     LOGLS_INFO(_log, "Reference Color: " << _referenceColor << " sig " << _sigCol);
+    prepareMeasurementTerms();
 }
 
 #define NPAR_PM 2
@@ -79,8 +84,29 @@ the derivatives, when computing the Chi2, when filling a tuple.
 */
 Point AstrometryFit::transformFittedStar(FittedStar const &fittedStar, AstrometryTransform const &sky2TP,
                                          Point const &refractionVector, double refractionCoeff,
-                                         double mjd) const {
-    Point fittedStarInTP = sky2TP.apply(fittedStar);
+                                         double mjd, AstrometryTransformLinear *derivative) const {
+    Point fittedStarInTP;
+    if (derivative) {
+        sky2TP.applyWithDerivative(fittedStar, fittedStarInTP, *derivative, 1e-3);
+    } else {
+        fittedStarInTP = sky2TP.apply(fittedStar);
+    }
+    return addMotionAndRefraction(fittedStar, fittedStarInTP, refractionVector, refractionCoeff, mjd);
+}
+
+void AstrometryFit::projectFittedStar(FittedStar const &fittedStar, AstrometryTransform const &sky2TP,
+                                      AstrometryTransformLinear &derivative,
+                                      ProjectedFittedStar &projection) const {
+    Point fittedStarInTP;
+    sky2TP.applyWithDerivative(fittedStar, fittedStarInTP, derivative, 1e-3);
+    projection = {fittedStarInTP.x, fittedStarInTP.y, derivative.A11(), derivative.A12(),
+                  derivative.A21(), derivative.A22()};
+}
+
+Point AstrometryFit::addMotionAndRefraction(FittedStar const &fittedStar, Point const &projected,
+                                            Point const &refractionVector, double refractionCoeff,
+                                            double mjd) const {
+    Point fittedStarInTP = projected;
     if (fittedStar.mightMove) {
         fittedStarInTP.x += fittedStar.pmx * mjd;
         fittedStarInTP.y += fittedStar.pmy * mjd;
@@ -95,24 +121,31 @@ Point AstrometryFit::transformFittedStar(FittedStar const &fittedStar, Astrometr
 }
 
 /*! This is the first implementation of an error "model".  We'll
-  certainly have to upgrade it. MeasuredStar provides the mag in case
-  we need it.  */
-static void tweakAstromMeasurementErrors(FatPoint &P, MeasuredStar const &Ms, double error) {
-    static bool called = false;
-    static double increment = 0;
-    if (!called) {
-        increment = std::pow(error, 2);  // was in Preferences
-        called = true;
-    }
+  certainly have to upgrade it. */
+static void tweakAstromMeasurementErrors(FatPoint &P, double error) {
+    double increment = std::pow(error, 2);  // was in Preferences
     P.vx += increment;
     P.vy += increment;
 }
 
+// Copy the measured positions into points, with the errors tweaked as above, to transform them in a batch.
+static void getMeasuredPoints(MeasurementArrays const &measurements, double error, FatPointArrays &points) {
+    Eigen::Index size = measurements.size();
+    double increment = std::pow(error, 2);
+    points.x = Eigen::Map<Eigen::ArrayXd const>(measurements.x.data(), size);
+    points.y = Eigen::Map<Eigen::ArrayXd const>(measurements.y.data(), size);
+    points.vx = Eigen::Map<Eigen::ArrayXd const>(measurements.vx.data(), size) + increment;
+    points.vy = Eigen::Map<Eigen::ArrayXd const>(measurements.vy.data(), size) + increment;
+    points.vxy = Eigen::Map<Eigen::ArrayXd const>(measurements.vxy.data(), size);
+}
+
 // we could consider computing the chi2 here.
 // (although it is not extremely useful)
-void AstrometryFit::leastSquareDerivativesMeasurement(CcdImage const &ccdImage, TripletList &tripletList,
+void AstrometryFit::leastSquareDerivativesMeasurement(CcdImage const &ccdImage,
+                                                      JacobianAccumulator &accumulator,
                                                       Eigen::VectorXd &fullGrad,
-                                                      MeasuredStarList const *msList) const {
+                                                      MeasuredStarList const *msList,
+                                                      Eigen::VectorXd const *offset) const {
     /**********************************************************************/
     /* @note the math in this method and accumulateStatImage() must be kept consistent,
      * in terms of +/- convention, definition of model, etc. */
@@ -126,6 +159,14 @@ void AstrometryFit::leastSquareDerivativesMeasurement(CcdImage const &ccdImage,
 
     // get the Mapping
     const AstrometryMapping *mapping = _astrometryModel->getMapping(ccdImage);
+    // when offset, differentiate through an offset copy of the mapping, leaving the model untouched.
+    std::unique_ptr<AstrometryMapping> offsetMapping;
+    if (offset != nullptr && _fittingDistortions) {
+        offsetMapping = mapping->cloneWithOffset(*offset);
+        mapping = offsetMapping.get();
+    }
+    double refractionCoefficient = _refractionCoefficient;
+    if (offset != nullptr && _fittingRefrac) refractionCoefficient += (*offset)(_refracPosInMatrix);
     // count parameters
     std::size_t npar_mapping = (_fittingDistortions) ? mapping->getNpar() : 0;
     std::size_t npar_pos = (_fittingPos) ? 2 : 0;
@@ -146,35 +187,45 @@ void AstrometryFit::leastSquareDerivativesMeasurement(CcdImage const &ccdImage,
     auto sky2TP = _astrometryModel->getSkyToTangentPlane(ccdImage);
     // reserve matrices once for all measurements
     AstrometryTransformLinear dypdy;
+    ProjectedFittedStar projection;
     // the shape of H (et al) is required this way in order to be able to
     // separate derivatives along x and y as vectors.
     Eigen::MatrixX2d H(npar_tot, 2), halpha(npar_tot, 2), HW(npar_tot, 2);
     Eigen::Matrix2d transW(2, 2);
     Eigen::Matrix2d alpha(2, 2);
     Eigen::VectorXd grad(npar_tot);
-    // current position in the Jacobian
-    Eigen::Index kTriplets = tripletList.getNextFreeIndex();
-    const MeasuredStarList &catalog = (msList) ? *msList : ccdImage.getCatalogForFit();
-
-    for (auto &i : catalog) {
-        const MeasuredStar &ms = *i;
-        if (!ms.isValid()) continue;
-        // tweak the measurement errors
-        FatPoint inPos = ms;
-        tweakAstromMeasurementErrors(inPos, ms, _posError);
+    // the few outliers of a list are copied to arrays: there is a single loop over the measurements.
+    MeasurementArrays msListArrays;
+    if (msList) msListArrays.assign(*msList);
+    MeasurementArrays const &measurements = (msList) ? msListArrays : ccdImage.getMeasurementArrays();
+    // the FittedStars of a list of outliers, and offset FittedStars, are projected here.
+    auto const *cachedProjections =
+            (msList || (offset != nullptr && _fittingPos)) ? nullptr : getCachedProjections(ccdImage);
+    // transform all the measurements with a single call to the mapping.
+    // should *not* compute the mapping derivatives if whatToFit excludes mapping parameters.
+    FatPointArrays inPos, outPoints;
+    Eigen::MatrixXd mappingH;
+    getMeasuredPoints(measurements, _posError, inPos);
+    if (_fittingDistortions)
+        mapping->computeTransformAndDerivativesBatch(inPos, outPoints, mappingH);
+    else
+        mapping->transformPosAndErrorsBatch(inPos, outPoints);
+    // all measurements of this ccdImage depend on the same mapping parameters
+    if (npar_mapping > 0) {
+        accumulator.beginSharedBlock(IndexVector(indices.begin(), indices.begin() + npar_mapping));
+    }
+
+    for (std::size_t k = 0; k < measurements.size(); ++k) {
+        if (!measurements.valid[k]) continue;
         H.setZero();  // we cannot be sure that all entries will be overwritten.
-        FatPoint outPos;
-        // should *not* fill H if whatToFit excludes mapping parameters.
-        if (_fittingDistortions)
-            mapping->computeTransformAndDerivatives(inPos, outPos, H);
-        else
-            mapping->transformPosAndErrors(inPos, outPos);
+        if (_fittingDistortions) H.topRows(npar_mapping) = mappingH.middleCols(2 * k, 2);
+        FatPoint outPos = outPoints.get(k);
 
         std::size_t ipar = npar_mapping;
         double det = outPos.vx * outPos.vy - std::pow(outPos.vxy, 2);
         if (det <= 0 || outPos.vx <= 0 || outPos.vy <= 0) {
             LOGLS_WARN(_log, "Inconsistent measurement errors: drop measurement at "
-                                     << Point(ms) << " in image " << ccdImage.getName());
+                                     << Point(inPos.x[k], inPos.y[k]) << " in image " << ccdImage.getName());
             continue;
         }
         transW(0, 0) = outPos.vy / det;
@@ -190,21 +241,31 @@ void AstrometryFit::leastSquareDerivativesMeasurement(CcdImage const &ccdImage,
         alpha(1, 1) = 1. / sqrt(det * transW(0, 0));
         alpha(0, 1) = 0;
 
-        std::shared_ptr<FittedStar const> const fs = ms.getFittedStar();
+        FittedStar const *fs = measurements.fittedStars[k];
+        std::unique_ptr<FittedStar> offsetStar;
+        if (offset != nullptr && _fittingPos) {
+            offsetStar = std::make_unique<FittedStar>(*fs);
+            offsetFittedStar(*offsetStar, *offset);
+            fs = offsetStar.get();
+        }
 
-        Point fittedStarInTP =
-                transformFittedStar(*fs, *sky2TP, refractionVector, _refractionCoefficient, mjd);
+        // TP position, and its derivative w.r.t sky position
+        ProjectedFittedStar const *projected = &projection;
+        if (cachedProjections) {
+            projected = (*cachedProjections)[k];
+        } else {
+            projectFittedStar(*fs, *sky2TP, dypdy, projection);
+        }
+        Point fittedStarInTP = addMotionAndRefraction(*fs, Point(projected->x, projected->y),
+                                                      refractionVector, refractionCoefficient, mjd);
 
-        // compute derivative of TP position w.r.t sky position ....
-        if (npar_pos > 0)  // ... if actually fitting FittedStar position
-        {
-            sky2TP->computeDerivative(*fs, dypdy, 1e-3);
+        if (npar_pos > 0) {
             // sign checked
             // TODO Still have to check with non trivial non-diagonal terms
-            H(npar_mapping, 0) = -dypdy.A11();
-            H(npar_mapping + 1, 0) = -dypdy.A12();
-            H(npar_mapping, 1) = -dypdy.A21();
-            H(npar_mapping + 1, 1) = -dypdy.A22();
+            H(npar_mapping, 0) = -projected->a11;
+            H(npar_mapping + 1, 0) = -projected->a12;
+            H(npar_mapping, 1) = -projected->a21;
+            H(npar_mapping + 1, 1) = -projected->a22;
             indices[npar_mapping] = fs->getIndexInMatrix();
             indices.at(npar_mapping + 1) = fs->getIndexInMatrix() + 1;
             ipar += npar_pos;
@@ -237,23 +298,25 @@ void AstrometryFit::leastSquareDerivativesMeasurement(CcdImage const &ccdImage,
         halpha = H * alpha;
         HW = H * transW;
         grad = HW * res;
-        // now feed in triplets and fullGrad
+        if (_robustLoss.isRobust()) {
+            // weight the term by the derivative of the loss at its current chi2 (IRLS).
+            double weight = _robustLoss.weight(res.dot(transW * res));
+            halpha *= std::sqrt(weight);
+            grad *= weight;
+        }
+        // now feed in the Jacobian (2 columns per measurement) and fullGrad
+        accumulator.addTerm(indices, halpha);
         for (std::size_t ipar = 0; ipar < npar_tot; ++ipar) {
-            for (std::size_t ic = 0; ic < 2; ++ic) {
-                double val = halpha(ipar, ic);
-                if (val == 0) continue;
-                tripletList.addTriplet(indices[ipar], kTriplets + ic, val);
-            }
             fullGrad(indices[ipar]) += grad(ipar);
         }
-        kTriplets += 2;  // each measurement contributes 2 columns in the Jacobian
-    }                    // end loop on measurements
-    tripletList.setNextFreeIndex(kTriplets);
+    }  // end loop on measurements
+    if (npar_mapping > 0) accumulator.endSharedBlock();
 }
 
 void AstrometryFit::leastSquareDerivativesReference(FittedStarList const &fittedStarList,
-                                                    TripletList &tripletList,
-                                                    Eigen::VectorXd &fullGrad) const {
+                                                    JacobianAccumulator &accumulator,
+                                                    Eigen::VectorXd &fullGrad,
+                                                    Eigen::VectorXd const *offset) const {
     /**********************************************************************/
     /* @note the math in this method and accumulateStatRefStars() must be kept consistent,
      * in terms of +/- convention, definition of model, etc. */
@@ -271,8 +334,7 @@ void AstrometryFit::leastSquareDerivativesReference(FittedStarList const &fitted
     Eigen::Matrix2d H(2, 2), halpha(2, 2), HW(2, 2);
     AstrometryTransformLinear der;
     Eigen::Vector2d res, grad;
-    Eigen::Index indices[2 + NPAR_PM];
-    Eigen::Index kTriplets = tripletList.getNextFreeIndex();
+    IndexVector indices(2);
     /* We cannot use the spherical coordinates directly to evaluate
        Euclidean distances, we have to use a projector on some plane in
        order to express least squares. Not projecting could lead to a
@@ -281,9 +343,14 @@ void AstrometryFit::leastSquareDerivativesReference(FittedStarList const &fitted
        projection point at every object */
     TanRaDecToPixel proj(AstrometryTransformLinear(), Point(0., 0.));
     for (auto const &i : fittedStarList) {
-        const FittedStar &fs = *i;
-        const RefStar *rs = fs.getRefStar();
+        const RefStar *rs = i->getRefStar();
         if (rs == nullptr) continue;
+        std::unique_ptr<FittedStar> offsetStar;
+        if (offset != nullptr) {
+            offsetStar = std::make_unique<FittedStar>(*i);
+            offsetFittedStar(*offsetStar, *offset);
+        }
+        const FittedStar &fs = (offsetStar) ? *offsetStar : *i;
         proj.setTangentPoint(fs);
         // fs projects to (0,0), no need to compute its transform.
         FatPoint rsProj;
@@ -328,21 +395,16 @@ void AstrometryFit::leastSquareDerivativesReference(FittedStarList const &fitted
         // grad = H*W*res
         HW = H * W;
         grad = HW * res;
-        // now feed in triplets and fullGrad
+        // now feed in the Jacobian (2 columns per reference term) and fullGrad
+        accumulator.addTerm(indices, halpha);
         for (std::size_t ipar = 0; ipar < npar_tot; ++ipar) {
-            for (unsigned ic = 0; ic < 2; ++ic) {
-                double val = halpha(ipar, ic);
-                if (val == 0) continue;
-                tripletList.addTriplet(indices[ipar], kTriplets + ic, val);
-            }
             fullGrad(indices[ipar]) += grad(ipar);
         }
-        kTriplets += 2;  // each measurement contributes 2 columns in the Jacobian
     }
-    tripletList.setNextFreeIndex(kTriplets);
 }
 
-void AstrometryFit::accumulateStatImage(CcdImage const &ccdImage, Chi2Accumulator &accum) const {
+void AstrometryFit::accumulateStatImage(CcdImage const &ccdImage, Chi2Accumulator &accum,
+                                        Eigen::VectorXd const *offset) const {
     /**********************************************************************/
     /** @note the math in this method and leastSquareDerivativesMeasurement() must be kept consistent,
      * in terms of +/- convention, definition of model, etc. */
@@ -350,6 +412,14 @@ void AstrometryFit::accumulateStatImage(CcdImage const &ccdImage, Chi2Accumulato
     /* Setup */
     // 1 : get the Mapping's
     const AstrometryMapping *mapping = _astrometryModel->getMapping(ccdImage);
+    // when offset, evaluate through an offset copy of the mapping, leaving the model untouched.
+    std::unique_ptr<AstrometryMapping> offsetMapping;
+    if (offset != nullptr && _fittingDistortions) {
+        offsetMapping = mapping->cloneWithOffset(*offset);
+        mapping = offsetMapping.get();
+    }
+    double refractionCoefficient = _refractionCoefficient;
+    if (offset != nullptr && _fittingRefrac) refractionCoefficient += (*offset)(_refracPosInMatrix);
     // proper motion stuff
     double mjd = ccdImage.getMjd() - _JDRef;
     // refraction stuff
@@ -359,57 +429,73 @@ void AstrometryFit::accumulateStatImage(CcdImage const &ccdImage, Chi2Accumulato
     // reserve matrix once for all measurements
     Eigen::Matrix2Xd transW(2, 2);
 
-    auto &catalog = ccdImage.getCatalogForFit();
-    for (auto const &ms : catalog) {
-        if (!ms->isValid()) continue;
-        // tweak the measurement errors
-        FatPoint inPos = *ms;
-        tweakAstromMeasurementErrors(inPos, *ms, _posError);
-
-        FatPoint outPos;
-        // should *not* fill H if whatToFit excludes mapping parameters.
-        mapping->transformPosAndErrors(inPos, outPos);
+    MeasurementArrays const &measurements = ccdImage.getMeasurementArrays();
+    // offset FittedStars are projected here.
+    auto const *cachedProjections =
+            (offset != nullptr && _fittingPos) ? nullptr : getCachedProjections(ccdImage);
+    // transform all the measurements with a single call to the mapping.
+    FatPointArrays inPos, outPoints;
+    getMeasuredPoints(measurements, _posError, inPos);
+    mapping->transformPosAndErrorsBatch(inPos, outPoints);
+    for (std::size_t starIndex = 0; starIndex < measurements.size(); ++starIndex) {
+        if (!measurements.valid[starIndex]) continue;
+        FatPoint outPos = outPoints.get(starIndex);
         double det = outPos.vx * outPos.vy - std::pow(outPos.vxy, 2);
         if (det <= 0 || outPos.vx <= 0 || outPos.vy <= 0) {
             LOGLS_WARN(_log, " Inconsistent measurement errors :drop measurement at "
-                                     << Point(*ms) << " in image " << ccdImage.getName());
+                                     << Point(inPos.x[starIndex], inPos.y[starIndex]) << " in image "
+                                     << ccdImage.getName());
             continue;
         }
         transW(0, 0) = outPos.vy / det;
         transW(1, 1) = outPos.vx / det;
         transW(0, 1) = transW(1, 0) = -outPos.vxy / det;
 
-        std::shared_ptr<FittedStar const> const fs = ms->getFittedStar();
-        Point fittedStarInTP =
-                transformFittedStar(*fs, *sky2TP, refractionVector, _refractionCoefficient, mjd);
+        FittedStar const *fs = measurements.fittedStars[starIndex];
+        Point fittedStarInTP;
+        if (offset != nullptr && _fittingPos) {
+            FittedStar offsetStar(*fs);
+            offsetFittedStar(offsetStar, *offset);
+            fittedStarInTP =
+                    transformFittedStar(offsetStar, *sky2TP, refractionVector, refractionCoefficient, mjd);
+        } else if (cachedProjections) {
+            ProjectedFittedStar const *projected = (*cachedProjections)[starIndex];
+            fittedStarInTP = addMotionAndRefraction(*fs, Point(projected->x, projected->y), refractionVector,
+                                                    refractionCoefficient, mjd);
+        } else {
+            fittedStarInTP = transformFittedStar(*fs, *sky2TP, refractionVector, refractionCoefficient, mjd);
+        }
 
         Eigen::Vector2d res(fittedStarInTP.x - outPos.x, fittedStarInTP.y - outPos.y);
         double chi2Val = res.transpose() * transW * res;
+        if (accum.useRobustLoss()) chi2Val = _robustLoss.loss(chi2Val);
 
-        accum.addEntry(chi2Val, 2, ms);
+        accum.addEntry(chi2Val, 2, starIndex);
     }  // end of loop on measurements
 }
 
-void AstrometryFit::accumulateStatImageList(CcdImageList const &ccdImageList, Chi2Accumulator &accum) const {
-    for (auto const &ccdImage : ccdImageList) {
-        accumulateStatImage(*ccdImage, accum);
-    }
-}
-
-void AstrometryFit::accumulateStatRefStars(Chi2Accumulator &accum) const {
+void AstrometryFit::accumulateStatRefStars(Chi2Accumulator &accum, Eigen::VectorXd const *offset) const {
     /**********************************************************************/
     /** @note the math in this method and leastSquareDerivativesReference() must be kept consistent,
      * in terms of +/- convention, definition of model, etc. */
     /**********************************************************************/
 
     /* If you wonder why we project here, read comments in
-       AstrometryFit::leastSquareDerivativesReference(TripletList &TList, Eigen::VectorXd &Rhs) */
+       AstrometryFit::leastSquareDerivativesReference() */
     FittedStarList &fittedStarList = _associations->fittedStarList;
     TanRaDecToPixel proj(AstrometryTransformLinear(), Point(0., 0.));
+    std::size_t nextStarIndex = 0;
     for (auto const &fs : fittedStarList) {
+        std::size_t starIndex = nextStarIndex++;  // position of fs in fittedStarList
         const RefStar *rs = fs->getRefStar();
         if (rs == nullptr) continue;
-        proj.setTangentPoint(*fs);
+        if (offset != nullptr && _fittingPos) {
+            FittedStar offsetStar(*fs);
+            offsetFittedStar(offsetStar, *offset);
+            proj.setTangentPoint(offsetStar);
+        } else {
+            proj.setTangentPoint(*fs);
+        }
         // fs projects to (0,0), no need to compute its transform.
         FatPoint rsProj;
         proj.transformPosAndErrors(*rs, rsProj);
@@ -421,10 +507,25 @@ void AstrometryFit::accumulateStatRefStars(Chi2Accumulator &accum) const {
         double wyy = rsProj.vx / det;
         double wxy = -rsProj.vxy / det;
         double chi2 = wxx * std::pow(rx, 2) + 2 * wxy * rx * ry + wyy * std::pow(ry, 2);
-        accum.addEntry(chi2, 2, fs);
+        accum.addEntry(chi2, 2, starIndex);
     }
 }
 
+void AstrometryFit::getIndicesOfMapping(CcdImage const &ccdImage, IndexVector &indices) const {
+    indices.clear();
+    if (!_fittingDistortions) return;
+    const AstrometryMapping *mapping = _astrometryModel->getMapping(ccdImage);
+    mapping->getMappingIndices(indices);
+    indices.resize(mapping->getNpar());
+}
+
+void AstrometryFit::getIndicesOfFittedStar(FittedStar const &fittedStar, IndexVector &indices) const {
+    indices.clear();
+    if (!_fittingPos) return;
+    indices.push_back(fittedStar.getIndexInMatrix());
+    indices.push_back(fittedStar.getIndexInMatrix() + 1);
+}
+
 //! this routine is to be used only in the framework of outlier removal
 /*! it fills the array of indices of parameters that a Measured star
     constrains. Not really all of them if you check. */
@@ -448,9 +549,26 @@ void AstrometryFit::getIndicesOfMeasuredStar(MeasuredStar const &measuredStar,
        able to remove more than 1 star at a time. */
 }
 
+std::vector<ParameterBlock> AstrometryFit::getEliminableBlocks() const {
+    std::vector<ParameterBlock> blocks;
+    if (!_fittingPos) return blocks;
+    // Each measurement or reference term only involves one FittedStar, so the stars are not coupled.
+    FittedStarList const &fittedStarList = _associations->fittedStarList;
+    blocks.reserve(fittedStarList.size());
+    for (auto const &fittedStar : fittedStarList) {
+        Eigen::Index size = 2;
+        if ((_fittingPM)&fittedStar->mightMove) size += NPAR_PM;
+        blocks.push_back({fittedStar->getIndexInMatrix(), size});
+    }
+    return blocks;
+}
+
 void AstrometryFit::assignIndices(std::string const &whatToFit) {
     _whatToFit = whatToFit;
     LOGLS_INFO(_log, "assignIndices: Now fitting " << whatToFit);
+    // the FittedStars may have been modified since the last fit: project them again, from scratch.
+    _projectionCache.ccdImages.clear();
+    _projectionCache.upToDate = false;
     _fittingDistortions = (_whatToFit.find("Distortions") != std::string::npos);
     _fittingPos = (_whatToFit.find("Positions") != std::string::npos);
     _fittingRefrac = (_whatToFit.find("Refrac") != std::string::npos);
@@ -484,6 +602,7 @@ void AstrometryFit::assignIndices(std::string const &whatToFit) {
         ipar += _nParRefrac;
     }
     _nParTot = ipar;
+    prepareMeasurementTerms();
 }
 
 void AstrometryFit::offsetParams(Eigen::VectorXd const &delta) {
@@ -496,24 +615,133 @@ void AstrometryFit::offsetParams(Eigen::VectorXd const &delta) {
     if (_fittingPos) {
         FittedStarList &fittedStarList = _associations->fittedStarList;
         for (auto const &i : fittedStarList) {
-            FittedStar &fs = *i;
-            // the parameter layout here is used also
-            // - when filling the derivatives
-            // - when assigning indices (assignIndices())
-            Eigen::Index index = fs.getIndexInMatrix();
-            fs.x += delta(index);
-            fs.y += delta(index + 1);
-            if ((_fittingPM)&fs.mightMove) {
-                fs.pmx += delta(index + 2);
-                fs.pmy += delta(index + 3);
-            }
+            offsetFittedStar(*i, delta);
         }
+        // the proper motions are applied after the projection: only moving the positions matters.
+        _projectionCache.upToDate = false;
+        prepareMeasurementTerms();
     }
     if (_fittingRefrac) {
         _refractionCoefficient += delta(_refracPosInMatrix);
     }
 }
 
+Eigen::VectorXd AstrometryFit::getModelParameters() const {
+    Eigen::VectorXd modelParameters = _astrometryModel->getAllParameters(_associations->getCcdImageList());
+    Eigen::VectorXd parameters(modelParameters.size() + 1);
+    parameters << modelParameters, _refractionCoefficient;
+    return parameters;
+}
+
+void AstrometryFit::setModelParameters(Eigen::VectorXd const &parameters) {
+    if (parameters.size() == 0) {
+        throw LSST_EXCEPT(pex::exceptions::LengthError, "Missing the refraction coefficient");
+    }
+    _astrometryModel->setAllParameters(_associations->getCcdImageList(),
+                                       parameters.head(parameters.size() - 1));
+    _refractionCoefficient = parameters[parameters.size() - 1];
+    // the FittedStars are restored along with the parameters (see loadCheckpoint()).
+    _projectionCache.upToDate = false;
+}
+
+void AstrometryFit::prepareMeasurementTerms() {
+    if (_projectionCache.upToDate) return;
+    if (_projectionCache.ccdImages.empty()) buildProjectionCache();
+    // the tangent planes are distributed among the threads.
+    auto &tangentPlanes = _projectionCache.tangentPlanes;
+    std::size_t nThreads = std::min(getNThreads(_control.nThreads), tangentPlanes.size());
+    auto projectTangentPlanes = [&](std::size_t i) {
+        AstrometryTransformLinear derivative;
+        for (std::size_t t = i; t < tangentPlanes.size(); t += nThreads) {
+            auto &tangentPlane = tangentPlanes[t];
+            for (std::size_t k = 0; k < tangentPlane.fittedStars.size(); ++k) {
+                projectFittedStar(*tangentPlane.fittedStars[k], *tangentPlane.sky2TP, derivative,
+                                  tangentPlane.projections[k]);
+            }
+        }
+    };
+    if (nThreads > 1) {
+        runInThreads(nThreads, projectTangentPlanes);
+    } else {
+        projectTangentPlanes(0);
+    }
+    _projectionCache.upToDate = true;
+}
+
+void AstrometryFit::buildProjectionCache() {
+    auto &tangentPlanes = _projectionCache.tangentPlanes;
+    tangentPlanes.clear();
+    _projectionCache.ccdImages.clear();
+    _projectionCache.upToDate = false;
+    // the tangent plane of each sky to tangent plane transform, and of each CcdImage.
+    std::unordered_map<AstrometryTransform const *, std::size_t> tangentPlaneIndices;
+    std::vector<std::size_t> ccdImageTangentPlanes;
+    // the position of each FittedStar in the list of its tangent plane, and of each measurement.
+    std::vector<std::unordered_map<FittedStar const *, std::size_t>> fittedStarIndices;
+    std::vector<std::vector<std::size_t>> measurementIndices;
+    auto const &ccdImageList = _associations->getCcdImageList();
+    for (auto const &ccdImage : ccdImageList) {
+        auto sky2TP = _astrometryModel->getSkyToTangentPlane(*ccdImage);
+        auto inserted = tangentPlaneIndices.emplace(sky2TP.get(), tangentPlanes.size());
+        if (inserted.second) {
+            tangentPlanes.emplace_back();
+            tangentPlanes.back().sky2TP = sky2TP;
+            fittedStarIndices.emplace_back();
+        }
+        std::size_t t = inserted.first->second;
+        ccdImageTangentPlanes.push_back(t);
+        MeasurementArrays const &measurements = ccdImage->getMeasurementArrays();
+        measurementIndices.emplace_back(measurements.size());
+        for (std::size_t k = 0; k < measurements.size(); ++k) {
+            FittedStar const *fittedStar = measurements.fittedStars[k];
+            auto &fittedStars = tangentPlanes[t].fittedStars;
+            auto fittedStarInserted = fittedStarIndices[t].emplace(fittedStar, fittedStars.size());
+            if (fittedStarInserted.second) fittedStars.push_back(fittedStar);
+            measurementIndices.back()[k] = fittedStarInserted.first->second;
+        }
+    }
+    // the projections do not move from now on: the measurements can point to them.
+    for (auto &tangentPlane : tangentPlanes) {
+        tangentPlane.projections.resize(tangentPlane.fittedStars.size());
+    }
+    std::size_t i = 0;
+    for (auto const &ccdImage : ccdImageList) {
+        auto const &tangentPlane = tangentPlanes[ccdImageTangentPlanes[i]];
+        auto &measurements = _projectionCache.ccdImages[ccdImage.get()];
+        measurements.catalogGeneration = ccdImage->getCatalogForFitGeneration();
+        auto &projections = measurements.projections;
+        projections.reserve(measurementIndices[i].size());
+        for (std::size_t index : measurementIndices[i]) {
+            projections.push_back(&tangentPlane.projections[index]);
+        }
+        ++i;
+    }
+}
+
+std::vector<AstrometryFit::ProjectedFittedStar const *> const *AstrometryFit::getCachedProjections(
+        CcdImage const &ccdImage) const {
+    if (!_projectionCache.upToDate) return nullptr;
+    auto found = _projectionCache.ccdImages.find(&ccdImage);
+    if (found == _projectionCache.ccdImages.end() ||
+        found->second.catalogGeneration != ccdImage.getCatalogForFitGeneration()) {
+        return nullptr;
+    }
+    return &found->second.projections;
+}
+
+void AstrometryFit::offsetFittedStar(FittedStar &fittedStar, Eigen::VectorXd const &delta) const {
+    // the parameter layout here is used also
+    // - when filling the derivatives
+    // - when assigning indices (assignIndices())
+    Eigen::Index index = fittedStar.getIndexInMatrix();
+    fittedStar.x += delta(index);
+    fittedStar.y += delta(index + 1);
+    if ((_fittingPM)&fittedStar.mightMove) {
+        fittedStar.pmx += delta(index + 2);
+        fittedStar.pmy += delta(index + 3);
+    }
+}
+
 void AstrometryFit::checkStuff() {
 #if (0)
     const char *what2fit[] = {"Positions",
@@ -579,7 +807,7 @@ void AstrometryFit::saveChi2MeasContributions(std::string const &filename) const
             if (!ms->isValid()) continue;
             FatPoint tpPos;
             FatPoint inPos = *ms;
-            tweakAstromMeasurementErrors(inPos, *ms, _posError);
+            tweakAstromMeasurementErrors(inPos, _posError);
             mapping->transformPosAndErrors(inPos, tpPos);
             auto sky2TP = _astrometryModel->getSkyToTangentPlane(*ccdImage);
             const std::unique_ptr<AstrometryTransform> readPixToTangentPlane =
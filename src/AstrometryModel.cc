@@ -22,7 +22,13 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <string>
+#include <vector>
+
+#include "lsst/pex/exceptions.h"
+
 #include "lsst/jointcal/AstrometryModel.h"
+#include "lsst/jointcal/CcdImage.h"
 
 namespace lsst {
 namespace jointcal {
@@ -39,6 +45,43 @@ bool AstrometryModel::validate(CcdImageList const &ccdImageList, int ndof) const
     return check;
 }
 
+Eigen::VectorXd AstrometryModel::getAllParameters(CcdImageList const &ccdImageList) const {
+    std::vector<Eigen::VectorXd> mappingParameters;
+    Eigen::Index size = 0;
+    for (auto const &ccdImage : ccdImageList) {
+        mappingParameters.push_back(findMapping(*ccdImage)->getAllParameters());
+        size += mappingParameters.back().size();
+    }
+    Eigen::VectorXd parameters(size);
+    Eigen::Index start = 0;
+    for (auto const &mapping : mappingParameters) {
+        parameters.segment(start, mapping.size()) = mapping;
+        start += mapping.size();
+    }
+    return parameters;
+}
+
+void AstrometryModel::setAllParameters(CcdImageList const &ccdImageList, Eigen::VectorXd const &parameters) {
+    // Check the size first, so that the model is left untouched if it does not match.
+    std::vector<Eigen::Index> sizes;
+    Eigen::Index size = 0;
+    for (auto const &ccdImage : ccdImageList) {
+        sizes.push_back(findMapping(*ccdImage)->getAllParameters().size());
+        size += sizes.back();
+    }
+    if (size != parameters.size()) {
+        throw LSST_EXCEPT(pex::exceptions::LengthError,
+                          "Expected " + std::to_string(size) + " model parameters, got " +
+                                  std::to_string(parameters.size()));
+    }
+    Eigen::Index start = 0;
+    auto sizeIt = sizes.begin();
+    for (auto const &ccdImage : ccdImageList) {
+        findMapping(*ccdImage)->setAllParameters(parameters.segment(start, *sizeIt));
+        start += *sizeIt++;
+    }
+}
+
 std::ostream &operator<<(std::ostream &stream, AstrometryModel const &model) {
     model.print(stream);
     return stream;
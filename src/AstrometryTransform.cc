@@ -25,6 +25,7 @@
 #include <iostream>
 #include <iomanip>
 #include <iterator> /* for ostream_iterator */
+#include <algorithm>
 #include <limits>
 #include <cmath>
 #include <math.h>
@@ -71,6 +72,57 @@ bool isIntegerShift(const AstrometryTransform *transform) {
     return false;
 }
 
+namespace {
+void checkBatchSizes(Eigen::Ref<Eigen::ArrayXd const> const &x, Eigen::Ref<Eigen::ArrayXd const> const &y,
+                     Eigen::Ref<Eigen::ArrayXd const> const &xOut,
+                     Eigen::Ref<Eigen::ArrayXd const> const &yOut) {
+    if (y.size() != x.size() || xOut.size() != x.size() || yOut.size() != x.size()) {
+        std::stringstream errMsg;
+        errMsg << "Batch arrays must all have the same size, got x: " << x.size() << ", y: " << y.size()
+               << ", xOut: " << xOut.size() << ", yOut: " << yOut.size();
+        throw LSST_EXCEPT(pexExcept::LengthError, errMsg.str());
+    }
+}
+
+void checkBatchSizes(FatPointArrays const &points) {
+    auto const size = points.x.size();
+    if (points.y.size() != size || points.vx.size() != size || points.vy.size() != size ||
+        points.vxy.size() != size) {
+        std::stringstream errMsg;
+        errMsg << "FatPointArrays must all have the same size, got x: " << size << ", y: " << points.y.size()
+               << ", vx: " << points.vx.size() << ", vy: " << points.vy.size()
+               << ", vxy: " << points.vxy.size();
+        throw LSST_EXCEPT(pexExcept::LengthError, errMsg.str());
+    }
+}
+
+// The matrix (a11, a12, a21, a22) of a derivative, which has no offset.
+void getDerivativeMatrix(AstrometryTransformLinear const &derivative, double *matrix) {
+    matrix[0] = derivative.A11();
+    matrix[1] = derivative.A12();
+    matrix[2] = derivative.A21();
+    matrix[3] = derivative.A22();
+}
+
+void setDerivativeMatrix(double const *matrix, AstrometryTransformLinear &derivative) {
+    derivative.getCoefficient(0, 0, 0) = 0;
+    derivative.getCoefficient(0, 0, 1) = 0;
+    derivative.getCoefficient(1, 0, 0) = matrix[0];
+    derivative.getCoefficient(0, 1, 0) = matrix[1];
+    derivative.getCoefficient(1, 0, 1) = matrix[2];
+    derivative.getCoefficient(0, 1, 1) = matrix[3];
+}
+
+// derivative = the derivative of left(right()), from the matrices of the derivatives of left and right.
+void setComposedDerivative(double const *left, double const *right, AstrometryTransformLinear &derivative) {
+    double const product[4] = {left[0] * right[0] + left[1] * right[2],
+                               left[0] * right[1] + left[1] * right[3],
+                               left[2] * right[0] + left[3] * right[2],
+                               left[2] * right[1] + left[3] * right[3]};
+    setDerivativeMatrix(product, derivative);
+}
+}  // namespace
+
 /********* AstrometryTransform ***********************/
 
 Frame AstrometryTransform::apply(Frame const &inputframe, bool inscribed) const {
@@ -133,11 +185,18 @@ void AstrometryTransform::computeDerivative(Point const &where, AstrometryTransf
     derivative.dy() = 0;
 }
 
+void AstrometryTransform::applyWithDerivative(Point const &where, Point &out,
+                                              AstrometryTransformLinear &derivative,
+                                              const double step) const {
+    computeDerivative(where, derivative, step);
+    apply(where, out);  // last, because nothing forbids &where == &out.
+}
+
 AstrometryTransformLinear AstrometryTransform::linearApproximation(Point const &where,
                                                                    const double step) const {
-    Point outwhere = apply(where);
+    Point outwhere;
     AstrometryTransformLinear der;
-    computeDerivative(where, der, step);
+    applyWithDerivative(where, outwhere, der, step);
     return AstrometryTransformLinearShift(outwhere.x, outwhere.y) * der *
            AstrometryTransformLinearShift(-where.x, -where.y);
 }
@@ -159,6 +218,26 @@ void AstrometryTransform::transformPosAndErrors(FatPoint const &in, FatPoint &ou
     out = res;
 }
 
+void AstrometryTransform::applyBatch(Eigen::Ref<Eigen::ArrayXd const> const &x,
+                                     Eigen::Ref<Eigen::ArrayXd const> const &y,
+                                     Eigen::Ref<Eigen::ArrayXd> xOut,
+                                     Eigen::Ref<Eigen::ArrayXd> yOut) const {
+    checkBatchSizes(x, y, xOut, yOut);
+    for (Eigen::Index i = 0; i < x.size(); ++i) {
+        apply(x[i], y[i], xOut[i], yOut[i]);
+    }
+}
+
+void AstrometryTransform::transformPosAndErrorsBatch(FatPointArrays const &in, FatPointArrays &out) const {
+    checkBatchSizes(in);
+    out.resize(in.size());
+    FatPoint point;
+    for (Eigen::Index i = 0; i < in.size(); ++i) {
+        transformPosAndErrors(in.get(i), point);
+        out.set(i, point);
+    }
+}
+
 void AstrometryTransform::transformErrors(Point const &where, const double *vIn, double *vOut) const {
     AstrometryTransformLinear der;
     computeDerivative(where, der, 0.01);
@@ -379,6 +458,11 @@ public:
 
     //! return second(first(xIn,yIn))
     void apply(const double xIn, const double yIn, double &xOut, double &yOut) const;
+
+    //! first and second each transform the whole arrays.
+    void applyBatch(Eigen::Ref<Eigen::ArrayXd const> const &x, Eigen::Ref<Eigen::ArrayXd const> const &y,
+                    Eigen::Ref<Eigen::ArrayXd> xOut, Eigen::Ref<Eigen::ArrayXd> yOut) const override;
+
     void print(ostream &stream) const;
 
     //!
@@ -401,6 +485,14 @@ void AstrometryTransformComposition::apply(const double xIn, const double yIn, d
     _second->apply(xout, yout, xOut, yOut);
 }
 
+void AstrometryTransformComposition::applyBatch(Eigen::Ref<Eigen::ArrayXd const> const &x,
+                                                Eigen::Ref<Eigen::ArrayXd const> const &y,
+                                                Eigen::Ref<Eigen::ArrayXd> xOut,
+                                                Eigen::Ref<Eigen::ArrayXd> yOut) const {
+    _first->applyBatch(x, y, xOut, yOut);
+    _second->applyBatch(xOut, yOut, xOut, yOut);
+}
+
 void AstrometryTransformComposition::print(ostream &stream) const {
     stream << "Composed AstrometryTransform consisting of:" << std::endl;
     _first->print(stream);
@@ -465,9 +557,130 @@ void AstrometryTransformIdentity::read(istream &stream) {
 
 /***************  AstrometryTransformPolynomial **************************************/
 
+namespace {
+/*
+ * Evaluation of a polynomial of a given order, with the coefficient ordering of
+ * AstrometryTransformPolynomial: monomial x^ix*y^iy has index k = d*(d+1)/2 + iy, with d = ix+iy, in
+ * the x coefficients, and k + nTerms in the y ones. With the order known at compile time, the loops below
+ * have constant trip counts and are unrolled, and the monomials are fixed size arrays.
+ * The powers are the same products as in AstrometryTransformPolynomial::computeMonomials.
+ */
+template <std::size_t Order>
+struct PolynomialKernel {
+    static constexpr std::size_t nTerms = (Order + 1) * (Order + 2) / 2;
+
+    static void computePowers(double x, double y, double *xPowers, double *yPowers) {
+        xPowers[0] = 1;
+        yPowers[0] = 1;
+        for (std::size_t i = 1; i <= Order; ++i) {
+            xPowers[i] = xPowers[i - 1] * x;
+            yPowers[i] = yPowers[i - 1] * y;
+        }
+    }
+
+    static void computeMonomials(double x, double y, double *monomials) {
+        double xPowers[Order + 1], yPowers[Order + 1];
+        computePowers(x, y, xPowers, yPowers);
+        std::size_t k = 0;
+        for (std::size_t degree = 0; degree <= Order; ++degree) {
+            for (std::size_t iy = 0; iy <= degree; ++iy, ++k) {
+                monomials[k] = xPowers[degree - iy] * yPowers[iy];
+            }
+        }
+    }
+
+    static void apply(double const *coeffs, double x, double y, double &xOut, double &yOut) {
+        double monomials[nTerms];
+        computeMonomials(x, y, monomials);
+        double xSum = 0, ySum = 0;
+        for (std::size_t k = 0; k < nTerms; ++k) {
+            xSum += monomials[k] * coeffs[k];
+            ySum += monomials[k] * coeffs[k + nTerms];
+        }
+        xOut = xSum;
+        yOut = ySum;
+    }
+
+    /*
+     * Position (out[0], out[1]) and its derivative w.r.t. x and y (out[2..5] = a11, a12, a21, a22), in a
+     * single pass over the monomials. Also stores the monomials, i.e. the derivatives w.r.t. the
+     * coefficients, if monomials is not null.
+     */
+    static void applyWithDerivatives(double const *coeffs, double x, double y, double *out,
+                                     double *monomials) {
+        double xPowers[Order + 1], yPowers[Order + 1];
+        computePowers(x, y, xPowers, yPowers);
+        double xSum = 0, ySum = 0, a11 = 0, a12 = 0, a21 = 0, a22 = 0;
+        std::size_t k = 0;
+        for (std::size_t degree = 0; degree <= Order; ++degree) {
+            for (std::size_t iy = 0; iy <= degree; ++iy, ++k) {
+                std::size_t const ix = degree - iy;
+                double const xCoeff = coeffs[k];
+                double const yCoeff = coeffs[k + nTerms];
+                double const monomial = xPowers[ix] * yPowers[iy];
+                if (monomials) monomials[k] = monomial;
+                xSum += monomial * xCoeff;
+                ySum += monomial * yCoeff;
+                if (ix > 0) {
+                    double const xDerivative = ix * xPowers[ix - 1] * yPowers[iy];
+                    a11 += xDerivative * xCoeff;
+                    a21 += xDerivative * yCoeff;
+                }
+                if (iy > 0) {
+                    double const yDerivative = iy * xPowers[ix] * yPowers[iy - 1];
+                    a12 += yDerivative * xCoeff;
+                    a22 += yDerivative * yCoeff;
+                }
+            }
+        }
+        out[0] = xSum;
+        out[1] = ySum;
+        out[2] = a11;
+        out[3] = a12;
+        out[4] = a21;
+        out[5] = a22;
+    }
+};
+
+// out = the position result[0..1] of applyWithDerivatives, with the errors of in propagated through the
+// derivative result[2..5]. out may be in.
+void setPosAndErrors(FatPoint const &in, double const *result, FatPoint &out) {
+    double const a11 = result[2], a12 = result[3], a21 = result[4], a22 = result[5];
+    FatPoint res(result[0], result[1]);
+    res.vx = a11 * (a11 * in.vx + 2 * a12 * in.vxy) + a12 * a12 * in.vy;
+    res.vy = a21 * a21 * in.vx + a22 * a22 * in.vy + 2. * a21 * a22 * in.vxy;
+    res.vxy = a21 * a11 * in.vx + a22 * a12 * in.vy + (a21 * a12 + a11 * a22) * in.vxy;
+    out = res;
+}
+}  // namespace
+
+struct AstrometryTransformPolynomial::Kernels {
+    void (*computeMonomials)(double x, double y, double *monomials);
+    void (*apply)(double const *coeffs, double x, double y, double &xOut, double &yOut);
+    void (*applyWithDerivatives)(double const *coeffs, double x, double y, double *out, double *monomials);
+
+    // The distortions fit in practice are of order 1 (per chip) to 7 or so (per visit).
+    static constexpr std::size_t maxOrder = 9;
+
+    template <std::size_t Order>
+    static Kernels make() {
+        return {&PolynomialKernel<Order>::computeMonomials, &PolynomialKernel<Order>::apply,
+                &PolynomialKernel<Order>::applyWithDerivatives};
+    }
+
+    // The kernels of an order, or nullptr above maxOrder.
+    static Kernels const *select(std::size_t order) {
+        static Kernels const kernels[maxOrder + 1] = {make<0>(), make<1>(), make<2>(), make<3>(), make<4>(),
+                                                      make<5>(), make<6>(), make<7>(), make<8>(), make<9>()};
+        return order <= maxOrder ? &kernels[order] : nullptr;
+    }
+};
+
+
 //! Default transform : identity for all orders (>=1 )
 
-AstrometryTransformPolynomial::AstrometryTransformPolynomial(std::size_t order) : _order(order) {
+AstrometryTransformPolynomial::AstrometryTransformPolynomial(std::size_t order)
+        : _order(order), _kernels(Kernels::select(order)) {
     _nterms = (order + 1) * (order + 2) / 2;
 
     // allocate and fill coefficients
@@ -526,6 +739,10 @@ AstrometryTransformPolynomial::AstrometryTransformPolynomial(
 }
 
 void AstrometryTransformPolynomial::computeMonomials(double xIn, double yIn, double *monomial) const {
+    if (_kernels) {
+        _kernels->computeMonomials(xIn, yIn, monomial);
+        return;
+    }
     /* The ordering of monomials is implemented here.
        You may not change it without updating the "mapping" routines
       getCoefficient(std::size_t, std::size_t, std::size_t).
@@ -548,8 +765,24 @@ void AstrometryTransformPolynomial::computeMonomials(double xIn, double yIn, dou
     }
 }
 
+void AstrometryTransformPolynomial::computePowerArrays(Eigen::Ref<Eigen::ArrayXd const> const &x,
+                                                       Eigen::Ref<Eigen::ArrayXd const> const &y,
+                                                       Eigen::ArrayXXd &xPowers,
+                                                       Eigen::ArrayXXd &yPowers) const {
+    // Same products as computeMonomials, so that the batch and single point results are identical.
+    xPowers.resize(x.size(), _order + 1);
+    yPowers.resize(y.size(), _order + 1);
+    xPowers.col(0).setOnes();
+    yPowers.col(0).setOnes();
+    for (std::size_t i = 1; i <= _order; ++i) {
+        xPowers.col(i) = xPowers.col(i - 1) * x;
+        yPowers.col(i) = yPowers.col(i - 1) * y;
+    }
+}
+
 void AstrometryTransformPolynomial::setOrder(std::size_t order) {
     _order = order;
+    _kernels = Kernels::select(order);
     std::size_t old_nterms = _nterms;
     _nterms = (_order + 1) * (_order + 2) / 2;
 
@@ -579,7 +812,12 @@ void AstrometryTransformPolynomial::apply(const double xIn, const double yIn, do
       The code works even if &xIn == &xOut (or &yIn == &yOut)
       It uses Variable Length Allocation (VLA) rather than a vector<double>
       because allocating the later costs about 50 ns. All VLA uses are tagged.
+      The usual orders use the kernels compiled for them, which need neither.
     */
+    if (_kernels) {
+        _kernels->apply(_coeffs.data(), xIn, yIn, xOut, yOut);
+        return;
+    }
     double monomials[_nterms];  // this is VLA, which is (perhaps) not casher C++
     computeMonomials(xIn, yIn, monomials);
 
@@ -593,6 +831,32 @@ void AstrometryTransformPolynomial::apply(const double xIn, const double yIn, do
     for (int k = _nterms; k--;) yOut += (*(pm++)) * (*(c++));
 }
 
+/* Monomials are x^ix * y^iy, of degree ix+iy, with index k = degree*(degree+1)/2 + iy (see
+   computeMonomials), so looping over the degree and then iy visits them in the order of the coefficients. */
+void AstrometryTransformPolynomial::applyBatch(Eigen::Ref<Eigen::ArrayXd const> const &x,
+                                               Eigen::Ref<Eigen::ArrayXd const> const &y,
+                                               Eigen::Ref<Eigen::ArrayXd> xOut,
+                                               Eigen::Ref<Eigen::ArrayXd> yOut) const {
+    checkBatchSizes(x, y, xOut, yOut);
+    Eigen::ArrayXXd xPowers, yPowers;
+    computePowerArrays(x, y, xPowers, yPowers);
+
+    // accumulate into temporaries, because nothing forbids the outputs to be the inputs.
+    Eigen::ArrayXd xSum = Eigen::ArrayXd::Zero(x.size());
+    Eigen::ArrayXd ySum = Eigen::ArrayXd::Zero(x.size());
+    Eigen::ArrayXd monomial(x.size());
+    std::size_t k = 0;
+    for (std::size_t degree = 0; degree <= _order; ++degree) {
+        for (std::size_t iy = 0; iy <= degree; ++iy, ++k) {
+            monomial = xPowers.col(degree - iy) * yPowers.col(iy);
+            xSum += monomial * _coeffs[k];
+            ySum += monomial * _coeffs[k + _nterms];
+        }
+    }
+    xOut = xSum;
+    yOut = ySum;
+}
+
 void AstrometryTransformPolynomial::computeDerivative(Point const &where,
                                                       AstrometryTransformLinear &derivative,
                                                       const double step)
@@ -602,6 +866,17 @@ void AstrometryTransformPolynomial::computeDerivative(Point const &where,
         derivative.dx() = derivative.dy() = 0;
         return;
     }
+    derivative.dx() = 0;
+    derivative.dy() = 0;
+    if (_kernels) {
+        double out[6];
+        _kernels->applyWithDerivatives(_coeffs.data(), where.x, where.y, out, nullptr);
+        derivative.a11() = out[2];
+        derivative.a12() = out[3];
+        derivative.a21() = out[4];
+        derivative.a22() = out[5];
+        return;
+    }
 
     double dermx[2 * _nterms];  // VLA
     double *dermy = dermx + _nterms;
@@ -627,9 +902,6 @@ void AstrometryTransformPolynomial::computeDerivative(Point const &where,
         if (ix >= 1) xxm1 *= xin;
     }
 
-    derivative.dx() = 0;
-    derivative.dy() = 0;
-
     const double *mx = &dermx[0];
     const double *my = &dermy[0];
     const double *c = &_coeffs[0];
@@ -666,6 +938,12 @@ void AstrometryTransformPolynomial::transformPosAndErrors(FatPoint const &in, Fa
        provide the same result. This version is however faster
        (monomials get recycled).
     */
+    if (_kernels) {
+        double result[6];
+        _kernels->applyWithDerivatives(_coeffs.data(), in.x, in.y, result, nullptr);
+        setPosAndErrors(in, result, out);
+        return;
+    }
     double monomials[_nterms];  // VLA
 
     FatPoint res;  // to store the result, because nothing forbids &in == &out.
@@ -733,6 +1011,86 @@ void AstrometryTransformPolynomial::transformPosAndErrors(FatPoint const &in, Fa
     out = res;
 }
 
+void AstrometryTransformPolynomial::transformPosAndErrorsBatch(FatPointArrays const &in,
+                                                               FatPointArrays &out) const {
+    // The batch version of transformPosAndErrors, with the monomial ordering of applyBatch.
+    checkBatchSizes(in);
+    auto const size = in.size();
+    Eigen::ArrayXXd xPowers, yPowers;
+    computePowerArrays(in.x, in.y, xPowers, yPowers);
+
+    Eigen::ArrayXd xSum = Eigen::ArrayXd::Zero(size);
+    Eigen::ArrayXd ySum = Eigen::ArrayXd::Zero(size);
+    Eigen::ArrayXd a11 = Eigen::ArrayXd::Zero(size);
+    Eigen::ArrayXd a12 = Eigen::ArrayXd::Zero(size);
+    Eigen::ArrayXd a21 = Eigen::ArrayXd::Zero(size);
+    Eigen::ArrayXd a22 = Eigen::ArrayXd::Zero(size);
+    Eigen::ArrayXd monomial(size), derivative(size);
+    std::size_t k = 0;
+    for (std::size_t degree = 0; degree <= _order; ++degree) {
+        for (std::size_t iy = 0; iy <= degree; ++iy, ++k) {
+            std::size_t ix = degree - iy;
+            double const xCoeff = _coeffs[k];
+            double const yCoeff = _coeffs[k + _nterms];
+            monomial = xPowers.col(ix) * yPowers.col(iy);
+            xSum += monomial * xCoeff;
+            ySum += monomial * yCoeff;
+            if (ix > 0) {  // d(monomial)/dx
+                derivative = double(ix) * xPowers.col(ix - 1) * yPowers.col(iy);
+                a11 += derivative * xCoeff;
+                a21 += derivative * yCoeff;
+            }
+            if (iy > 0) {  // d(monomial)/dy
+                derivative = double(iy) * xPowers.col(ix) * yPowers.col(iy - 1);
+                a12 += derivative * xCoeff;
+                a22 += derivative * yCoeff;
+            }
+        }
+    }
+
+    // output co-variance, also in temporaries because &in may be &out.
+    Eigen::ArrayXd vx = a11 * (a11 * in.vx + 2 * a12 * in.vxy) + a12 * a12 * in.vy;
+    Eigen::ArrayXd vy = a21 * a21 * in.vx + a22 * a22 * in.vy + 2. * a21 * a22 * in.vxy;
+    Eigen::ArrayXd vxy = a21 * a11 * in.vx + a22 * a12 * in.vy + (a21 * a12 + a11 * a22) * in.vxy;
+    out.resize(size);
+    out.x = xSum;
+    out.y = ySum;
+    out.vx = vx;
+    out.vy = vy;
+    out.vxy = vxy;
+}
+
+void AstrometryTransformPolynomial::applyWithDerivative(Point const &where, Point &out,
+                                                        AstrometryTransformLinear &derivative,
+                                                        const double step) const {
+    if (!_kernels) {
+        AstrometryTransform::applyWithDerivative(where, out, derivative, step);
+        return;
+    }
+    double result[6];
+    _kernels->applyWithDerivatives(_coeffs.data(), where.x, where.y, result, nullptr);
+    out.x = result[0];
+    out.y = result[1];
+    setDerivativeMatrix(result + 2, derivative);
+}
+
+void AstrometryTransformPolynomial::computeTransformAndDerivatives(FatPoint const &in, FatPoint &out,
+                                                                   double *dx, double *dy) const {
+    if (!_kernels) {
+        paramDerivatives(in, dx, dy);  // first, because nothing forbids &in == &out.
+        transformPosAndErrors(in, out);
+        return;
+    }
+    double result[6];
+    // the derivatives w.r.t. the x coefficients are the monomials.
+    _kernels->applyWithDerivatives(_coeffs.data(), in.x, in.y, result, dx);
+    for (std::size_t k = 0; k < _nterms; ++k) {
+        dy[_nterms + k] = dx[k];
+        dx[_nterms + k] = dy[k] = 0;
+    }
+    setPosAndErrors(in, result, out);
+}
+
 /* The coefficient ordering is defined both here *AND* in the
    AstrometryTransformPolynomial::apply, AstrometryTransformPolynomial::Derivative, ... routines
    Change all or none ! */
@@ -1260,6 +1618,37 @@ AstrometryTransformLinear AstrometryTransformLinear::linearApproximation(Point c
     return *this;
 }
 
+void AstrometryTransformLinear::applyBatch(Eigen::Ref<Eigen::ArrayXd const> const &x,
+                                           Eigen::Ref<Eigen::ArrayXd const> const &y,
+                                           Eigen::Ref<Eigen::ArrayXd> xOut,
+                                           Eigen::Ref<Eigen::ArrayXd> yOut) const {
+    checkBatchSizes(x, y, xOut, yOut);
+    double const dx = Dx(), dy = Dy();
+    double const a11 = A11(), a12 = A12(), a21 = A21(), a22 = A22();
+    for (Eigen::Index i = 0; i < x.size(); ++i) {
+        double const xIn = x[i];
+        double const yIn = y[i];
+        xOut[i] = dx + a11 * xIn + a12 * yIn;
+        yOut[i] = dy + a21 * xIn + a22 * yIn;
+    }
+}
+
+void AstrometryTransformLinear::transformPosAndErrorsBatch(FatPointArrays const &in,
+                                                           FatPointArrays &out) const {
+    checkBatchSizes(in);
+    out.resize(in.size());
+    double const dx = Dx(), dy = Dy();
+    double const a11 = A11(), a12 = A12(), a21 = A21(), a22 = A22();
+    for (Eigen::Index i = 0; i < in.size(); ++i) {
+        FatPoint const point = in.get(i);  // a copy, because &in may be &out.
+        out.x[i] = dx + a11 * point.x + a12 * point.y;
+        out.y[i] = dy + a21 * point.x + a22 * point.y;
+        out.vx[i] = a11 * (a11 * point.vx + 2 * a12 * point.vxy) + a12 * a12 * point.vy;
+        out.vy[i] = a21 * a21 * point.vx + a22 * a22 * point.vy + 2. * a21 * a22 * point.vxy;
+        out.vxy[i] = a21 * a11 * point.vx + a22 * a12 * point.vy + (a21 * a12 + a11 * a22) * point.vxy;
+    }
+}
+
 AstrometryTransformLinear AstrometryTransformLinear::inverted() const {
     //
     //   (T1,M1) * (T2,M2) = 1 i.e (0,1) implies
@@ -1424,29 +1813,86 @@ void BaseTanWcs::operator=(const BaseTanWcs &original) {
 }
 
 void BaseTanWcs::apply(const double xIn, const double yIn, double &xOut, double &yOut) const {
-    double l, m;                        // radians in the tangent plane
+    double l, m;
     pixToTangentPlane(xIn, yIn, l, m);  // l, m in degrees.
-    l = deg2rad(l);
-    m = deg2rad(m);  // now in radians
-                     // Code inspired from worldpos.c in wcssubs (ancestor of the wcslib)
-                     /* At variance with wcslib, it collapses the projection to a plane
-                        and expression of sidereal cooordinates into a single set of
-                        operations. */
+    tangentPlaneToSky(l, m, xOut, yOut);
+}
+
+void BaseTanWcs::computeDerivative(Point const &where, AstrometryTransformLinear &derivative,
+                                   const double step) const {
+    Point out;
+    applyWithDerivative(where, out, derivative, step);
+}
+
+void BaseTanWcs::applyWithDerivative(Point const &where, Point &out, AstrometryTransformLinear &derivative,
+                                     const double) const {
+    Point tangentPlane;
+    AstrometryTransformLinear tangentPlaneDerivative;
+    pixToTangentPlaneWithDerivative(where, tangentPlane, tangentPlaneDerivative);
+    double skyMatrix[4], tangentPlaneMatrix[4];
+    tangentPlaneToSky(tangentPlane.x, tangentPlane.y, out.x, out.y, skyMatrix);
+    getDerivativeMatrix(tangentPlaneDerivative, tangentPlaneMatrix);
+    setComposedDerivative(skyMatrix, tangentPlaneMatrix, derivative);
+}
+
+void BaseTanWcs::applyBatch(Eigen::Ref<Eigen::ArrayXd const> const &x,
+                            Eigen::Ref<Eigen::ArrayXd const> const &y, Eigen::Ref<Eigen::ArrayXd> xOut,
+                            Eigen::Ref<Eigen::ArrayXd> yOut) const {
+    checkBatchSizes(x, y, xOut, yOut);
+    Eigen::ArrayXd l(x.size()), m(x.size());
+    pixToTangentPlaneBatch(x, y, l, m);  // l, m in degrees.
+    for (Eigen::Index i = 0; i < x.size(); ++i) {
+        tangentPlaneToSky(l[i], m[i], xOut[i], yOut[i]);
+    }
+}
+
+void BaseTanWcs::pixToTangentPlaneBatch(Eigen::Ref<Eigen::ArrayXd const> const &xPixel,
+                                        Eigen::Ref<Eigen::ArrayXd const> const &yPixel,
+                                        Eigen::Ref<Eigen::ArrayXd> xTangentPlane,
+                                        Eigen::Ref<Eigen::ArrayXd> yTangentPlane) const {
+    checkBatchSizes(xPixel, yPixel, xTangentPlane, yTangentPlane);
+    for (Eigen::Index i = 0; i < xPixel.size(); ++i) {
+        pixToTangentPlane(xPixel[i], yPixel[i], xTangentPlane[i], yTangentPlane[i]);
+    }
+}
+
+void BaseTanWcs::tangentPlaneToSky(double xTangentPlane, double yTangentPlane, double &ra, double &dec,
+                                   double *derivative) const {
+    // radians in the tangent plane
+    double l = deg2rad(xTangentPlane);
+    double m = deg2rad(yTangentPlane);
+    // Code inspired from worldpos.c in wcssubs (ancestor of the wcslib)
+    /* At variance with wcslib, it collapses the projection to a plane
+       and expression of sidereal cooordinates into a single set of
+       operations. */
     double dect = cos0 - m * sin0;
     if (dect == 0) {
         LOGL_WARN(_log, "No sidereal coordinates at pole!");
-        xOut = 0;
-        yOut = 0;
+        ra = 0;
+        dec = 0;
+        if (derivative) std::fill(derivative, derivative + 4, 0.);
         return;
     }
+    if (derivative) {
+        /* With r2 = l^2 + dect^2 and n = m*cos0 + sin0, rat - ra0 = atan2(l, dect) and
+           dec = atan(n / sqrt(r2)). The deg2rad and rad2deg cancel each other. */
+        double const r2 = l * l + dect * dect;
+        double const r = std::sqrt(r2);
+        double const n = m * cos0 + sin0;
+        double const s = r * (r2 + n * n);  // r2 + n^2 = 1 + l^2 + m^2
+        derivative[0] = dect / r2;
+        derivative[1] = l * sin0 / r2;
+        derivative[2] = -n * l / s;
+        derivative[3] = (cos0 * r2 + n * dect * sin0) / s;
+    }
     double rat = ra0 + atan2(l, dect);
     dect = atan(std::cos(rat - ra0) * (m * cos0 + sin0) / dect);
     if (rat - ra0 > M_PI) rat -= (2. * M_PI);
     if (rat - ra0 < -M_PI) rat += (2. * M_PI);
     if (rat < 0.0) rat += (2. * M_PI);
     // convert to degree
-    xOut = rad2deg(rat);
-    yOut = rad2deg(dect);
+    ra = rad2deg(rat);
+    dec = rad2deg(dect);
 }
 
 Point BaseTanWcs::getTangentPoint() const { return Point(rad2deg(ra0), rad2deg(dec0)); }
@@ -1556,6 +2002,27 @@ void TanPixelToRaDec::pixToTangentPlane(double xPixel, double yPixel, double &xT
     }
 }
 
+void TanPixelToRaDec::pixToTangentPlaneWithDerivative(Point const &pixel, Point &tangentPlane,
+                                                      AstrometryTransformLinear &derivative) const {
+    linPixelToTan.applyWithDerivative(pixel, tangentPlane, derivative);
+    if (corr) {
+        AstrometryTransformLinear corrDerivative;
+        corr->applyWithDerivative(tangentPlane, tangentPlane, corrDerivative);
+        double corrMatrix[4], linMatrix[4];
+        getDerivativeMatrix(corrDerivative, corrMatrix);
+        getDerivativeMatrix(derivative, linMatrix);
+        setComposedDerivative(corrMatrix, linMatrix, derivative);
+    }
+}
+
+void TanPixelToRaDec::pixToTangentPlaneBatch(Eigen::Ref<Eigen::ArrayXd const> const &xPixel,
+                                             Eigen::Ref<Eigen::ArrayXd const> const &yPixel,
+                                             Eigen::Ref<Eigen::ArrayXd> xTangentPlane,
+                                             Eigen::Ref<Eigen::ArrayXd> yTangentPlane) const {
+    linPixelToTan.applyBatch(xPixel, yPixel, xTangentPlane, yTangentPlane);
+    if (corr) corr->applyBatch(xTangentPlane, yTangentPlane, xTangentPlane, yTangentPlane);
+}
+
 std::unique_ptr<AstrometryTransform> TanPixelToRaDec::clone() const {
     return std::unique_ptr<AstrometryTransform>(
             new TanPixelToRaDec(getLinPart(), getTangentPoint(), corr.get()));
@@ -1627,6 +2094,32 @@ void TanSipPixelToRaDec::pixToTangentPlane(double xPixel, double yPixel, double
         linPixelToTan.apply(xPixel, yPixel, xTangentPlane, yTangentPlane);
 }
 
+void TanSipPixelToRaDec::pixToTangentPlaneWithDerivative(Point const &pixel, Point &tangentPlane,
+                                                         AstrometryTransformLinear &derivative) const {
+    if (corr) {
+        Point corrected;
+        AstrometryTransformLinear corrDerivative;
+        corr->applyWithDerivative(pixel, corrected, corrDerivative);
+        linPixelToTan.applyWithDerivative(corrected, tangentPlane, derivative);
+        double linMatrix[4], corrMatrix[4];
+        getDerivativeMatrix(derivative, linMatrix);
+        getDerivativeMatrix(corrDerivative, corrMatrix);
+        setComposedDerivative(linMatrix, corrMatrix, derivative);
+    } else
+        linPixelToTan.applyWithDerivative(pixel, tangentPlane, derivative);
+}
+
+void TanSipPixelToRaDec::pixToTangentPlaneBatch(Eigen::Ref<Eigen::ArrayXd const> const &xPixel,
+                                                Eigen::Ref<Eigen::ArrayXd const> const &yPixel,
+                                                Eigen::Ref<Eigen::ArrayXd> xTangentPlane,
+                                                Eigen::Ref<Eigen::ArrayXd> yTangentPlane) const {
+    if (corr) {
+        corr->applyBatch(xPixel, yPixel, xTangentPlane, yTangentPlane);
+        linPixelToTan.applyBatch(xTangentPlane, yTangentPlane, xTangentPlane, yTangentPlane);
+    } else
+        linPixelToTan.applyBatch(xPixel, yPixel, xTangentPlane, yTangentPlane);
+}
+
 std::unique_ptr<AstrometryTransform> TanSipPixelToRaDec::clone() const {
     return std::unique_ptr<AstrometryTransform>(
             new TanSipPixelToRaDec(getLinPart(), getTangentPoint(), corr.get()));
@@ -1683,74 +2176,110 @@ AstrometryTransformLinear TanRaDecToPixel::getLinPart() const { return linTan2Pi
 
 // Use analytic derivatives, computed at the same time as the transform itself
 void TanRaDecToPixel::transformPosAndErrors(FatPoint const &in, FatPoint &out) const {
-    /* this routine is very similar to apply, but also propagates errors.
-       The deg2rad and rad2deg are ignored for errors because they act as
-       2 global scalings that cancel each other.
-       Derivatives were computed using maple:
-
-       l1 := sin(a - a0)*cos(d);
-       m1 := sin(d)*sin(d0)+cos(d)*cos(d0)*cos(a-a0);
-       l2 := sin(d)*cos(d0)-cos(d)*sin(d0)*cos(a-a0);
-       simplify(diff(l1/m1,a));
-       simplify(diff(l1/m1,d));
-       simplify(diff(l2/m1,a));
-       simplify(diff(l2/m1,d));
-
-       Checked against AstrometryTransform::transformPosAndErrors (dec 09)
-    */
-    double ra = deg2rad(in.x);
-    double dec = deg2rad(in.y);
-    if (ra - ra0 > M_PI) ra -= (2. * M_PI);
-    if (ra - ra0 < -M_PI) ra += (2. * M_PI);
-    // Code inspired from worldpos.c in wcssubs (ancestor of the wcslib)
-    // The same code is copied in ::apply()
+    FatPoint tmp;
+    skyToTangentPlane(in, tmp);
+    linTan2Pix.transformPosAndErrors(tmp, out);
+}
 
-    double coss = std::cos(dec);
-    double sins = std::sin(dec);
-    double sinda = std::sin(ra - ra0);
-    double cosda = std::cos(ra - ra0);
-    double l = sinda * coss;
-    double m = sins * sin0 + coss * cos0 * cosda;
-    l = l / m;
-    m = (sins * cos0 - coss * sin0 * cosda) / m;
+void TanRaDecToPixel::transformPosAndErrorsBatch(FatPointArrays const &in, FatPointArrays &out) const {
+    checkBatchSizes(in);
+    // The gnomonic projection is done per point, the linear part on the whole arrays.
+    FatPointArrays tangentPlane(in.size());
+    FatPoint point;
+    for (Eigen::Index i = 0; i < in.size(); ++i) {
+        skyToTangentPlane(in.get(i), point);
+        tangentPlane.set(i, point);
+    }
+    linTan2Pix.transformPosAndErrorsBatch(tangentPlane, out);
+}
 
-    // derivatives
-    double deno =
-            sq(sin0) - sq(coss) + sq(coss * cos0) * (1 + sq(cosda)) + 2 * sins * sin0 * coss * cos0 * cosda;
-    double a11 = coss * (cosda * sins * sin0 + coss * cos0) / deno;
-    double a12 = -sinda * sin0 / deno;
-    double a21 = coss * sinda * sins / deno;
-    double a22 = cosda / deno;
+void TanRaDecToPixel::computeDerivative(Point const &where, AstrometryTransformLinear &derivative,
+                                        const double step) const {
+    Point out;
+    applyWithDerivative(where, out, derivative, step);
+}
+
+void TanRaDecToPixel::applyWithDerivative(Point const &where, Point &out,
+                                          AstrometryTransformLinear &derivative, const double) const {
+    double projectionMatrix[4], linearMatrix[4];
+    Point tangentPlane;
+    skyToTangentPlane(where.x, where.y, tangentPlane.x, tangentPlane.y, projectionMatrix);
+    linTan2Pix.apply(tangentPlane, out);
+    getDerivativeMatrix(linTan2Pix, linearMatrix);
+    setComposedDerivative(linearMatrix, projectionMatrix, derivative);
+}
 
+void TanRaDecToPixel::skyToTangentPlane(FatPoint const &in, FatPoint &out) const {
+    double derivative[4];
     FatPoint tmp;
+    skyToTangentPlane(in.x, in.y, tmp.x, tmp.y, derivative);
+    double a11 = derivative[0];
+    double a12 = derivative[1];
+    double a21 = derivative[2];
+    double a22 = derivative[3];
     tmp.vx = a11 * (a11 * in.vx + 2 * a12 * in.vxy) + a12 * a12 * in.vy;
     tmp.vy = a21 * a21 * in.vx + a22 * a22 * in.vy + 2. * a21 * a22 * in.vxy;
     tmp.vxy = a21 * a11 * in.vx + a22 * a12 * in.vy + (a21 * a12 + a11 * a22) * in.vxy;
+    out = tmp;
+}
 
-    // l and m are now coordinates in the tangent plane, in radians.
-    tmp.x = rad2deg(l);
-    tmp.y = rad2deg(m);
+void TanRaDecToPixel::apply(const double xIn, const double yIn, double &xOut, double &yOut) const {
+    double l, m;
+    skyToTangentPlane(xIn, yIn, l, m);
+    linTan2Pix.apply(l, m, xOut, yOut);
+}
 
-    linTan2Pix.transformPosAndErrors(tmp, out);
+void TanRaDecToPixel::applyBatch(Eigen::Ref<Eigen::ArrayXd const> const &x,
+                                 Eigen::Ref<Eigen::ArrayXd const> const &y, Eigen::Ref<Eigen::ArrayXd> xOut,
+                                 Eigen::Ref<Eigen::ArrayXd> yOut) const {
+    checkBatchSizes(x, y, xOut, yOut);
+    for (Eigen::Index i = 0; i < x.size(); ++i) {
+        skyToTangentPlane(x[i], y[i], xOut[i], yOut[i]);
+    }
+    linTan2Pix.applyBatch(xOut, yOut, xOut, yOut);
 }
 
-void TanRaDecToPixel::apply(const double xIn, const double yIn, double &xOut, double &yOut) const {
-    double ra = deg2rad(xIn);
-    double dec = deg2rad(yIn);
+void TanRaDecToPixel::skyToTangentPlane(double raDeg, double decDeg, double &xTangentPlane,
+                                        double &yTangentPlane, double *derivative) const {
+    double ra = deg2rad(raDeg);
+    double dec = deg2rad(decDeg);
     if (ra - ra0 > M_PI) ra -= (2. * M_PI);
     if (ra - ra0 < -M_PI) ra += (2. * M_PI);
     // Code inspired from worldpos.c in wcssubs (ancestor of the wcslib)
-    // The same code is copied in ::transformPosAndErrors()
     double coss = std::cos(dec);
     double sins = std::sin(dec);
-    double l = std::sin(ra - ra0) * coss;
-    double m = sins * sin0 + coss * cos0 * std::cos(ra - ra0);
+    double sinda = std::sin(ra - ra0);
+    double cosda = std::cos(ra - ra0);
+    double l = sinda * coss;
+    double m = sins * sin0 + coss * cos0 * cosda;
     l = l / m;
-    m = (sins * cos0 - coss * sin0 * std::cos(ra - ra0)) / m;
+    m = (sins * cos0 - coss * sin0 * cosda) / m;
     // l and m are now coordinates in the tangent plane, in radians.
-    l = rad2deg(l);
-    m = rad2deg(m);
-    linTan2Pix.apply(l, m, xOut, yOut);
+    xTangentPlane = rad2deg(l);
+    yTangentPlane = rad2deg(m);
+
+    if (derivative) {
+        /* The deg2rad and rad2deg are ignored for the derivatives because they act as
+           2 global scalings that cancel each other.
+           Derivatives were computed using maple:
+
+           l1 := sin(a - a0)*cos(d);
+           m1 := sin(d)*sin(d0)+cos(d)*cos(d0)*cos(a-a0);
+           l2 := sin(d)*cos(d0)-cos(d)*sin(d0)*cos(a-a0);
+           simplify(diff(l1/m1,a));
+           simplify(diff(l1/m1,d));
+           simplify(diff(l2/m1,a));
+           simplify(diff(l2/m1,d));
+
+           Checked against AstrometryTransform::transformPosAndErrors (dec 09)
+        */
+        double deno = sq(sin0) - sq(coss) + sq(coss * cos0) * (1 + sq(cosda)) +
+                      2 * sins * sin0 * coss * cos0 * cosda;
+        derivative[0] = coss * (cosda * sins * sin0 + coss * cos0) / deno;
+        derivative[1] = -sinda * sin0 / deno;
+        derivative[2] = coss * sinda * sins / deno;
+        derivative[3] = cosda / deno;
+    }
 }
 
 TanPixelToRaDec TanRaDecToPixel::inverted() const {
@@ -0,0 +1,130 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Eigen/Cholesky"
+
+#include "lsst/pex/exceptions.h"
+
+#include "lsst/jointcal/BlockJacobiPreconditioner.h"
+
+namespace lsst {
+namespace jointcal {
+
+BlockJacobiPreconditioner::BlockJacobiPreconditioner(Eigen::Index nParTot,
+                                                     std::vector<ParameterBlock> const &blocks) {
+    auto layout = std::make_shared<Layout>();
+    layout->blockOf.assign(nParTot, -1);
+    for (auto const &block : blocks) {
+        if (block.start < 0 || block.size <= 0 || block.start + block.size > nParTot) {
+            throw LSST_EXCEPT(pex::exceptions::InvalidParameterError,
+                              "Preconditioner block outside of the parameters.");
+        }
+        for (Eigen::Index i = block.start; i < block.start + block.size; ++i) {
+            if (layout->blockOf[i] >= 0) {
+                throw LSST_EXCEPT(pex::exceptions::InvalidParameterError, "Preconditioner blocks overlap.");
+            }
+            layout->blockOf[i] = layout->blocks.size();
+        }
+        layout->blocks.push_back(block);
+    }
+    for (Eigen::Index i = 0; i < nParTot; ++i) {
+        if (layout->blockOf[i] < 0) {
+            layout->blockOf[i] = layout->blocks.size();
+            layout->blocks.push_back({i, 1});
+        }
+    }
+    std::size_t offset = 0;
+    for (auto const &block : layout->blocks) {
+        layout->offsets.push_back(offset);
+        offset += block.size * block.size;
+    }
+    layout->nValues = offset;
+    _layout = layout;
+    _values.assign(offset, 0.);
+}
+
+BlockJacobiPreconditioner::BlockJacobiPreconditioner(std::shared_ptr<Layout const> layout)
+        : _layout(layout), _values(layout->nValues, 0.) {}
+
+void BlockJacobiPreconditioner::addTerm(IndexVector const &indices,
+                                        Eigen::Ref<Eigen::MatrixXd const> const &jacobian) {
+    for (Eigen::Index k = 0; k < jacobian.rows(); ++k) {
+        // zero rows may have stale indices.
+        if ((jacobian.row(k).array() == 0).all()) continue;
+        Eigen::Index const block = _layout->blockOf[indices[k]];
+        Eigen::Index const start = _layout->blocks[block].start;
+        Eigen::Index const size = _layout->blocks[block].size;
+        double *values = _values.data() + _layout->offsets[block];
+        for (Eigen::Index l = 0; l < jacobian.rows(); ++l) {
+            if (indices[l] < start || indices[l] >= start + size) continue;
+            values[(indices[l] - start) * size + indices[k] - start] += jacobian.row(k).dot(jacobian.row(l));
+        }
+    }
+}
+
+std::unique_ptr<JacobianAccumulator> BlockJacobiPreconditioner::makeEmptyClone() const {
+    return std::unique_ptr<JacobianAccumulator>(new BlockJacobiPreconditioner(_layout));
+}
+
+void BlockJacobiPreconditioner::merge(JacobianAccumulator &other) {
+    auto &otherPreconditioner = dynamic_cast<BlockJacobiPreconditioner &>(other);
+    for (std::size_t i = 0; i < _values.size(); ++i) {
+        _values[i] += otherPreconditioner._values[i];
+    }
+    std::vector<double>().swap(otherPreconditioner._values);
+}
+
+std::size_t BlockJacobiPreconditioner::invert() {
+    std::size_t nFailed = 0;
+    for (std::size_t b = 0; b < _layout->blocks.size(); ++b) {
+        Eigen::Index const size = _layout->blocks[b].size;
+        Eigen::Map<Eigen::MatrixXd> block(_values.data() + _layout->offsets[b], size, size);
+        Eigen::LLT<Eigen::MatrixXd> llt(block);
+        if (llt.info() == Eigen::Success) {
+            block = llt.solve(Eigen::MatrixXd::Identity(size, size));
+        } else {
+            ++nFailed;
+            Eigen::VectorXd diagonal = block.diagonal();
+            block.setZero();
+            for (Eigen::Index i = 0; i < size; ++i) {
+                block(i, i) = (diagonal(i) > 0) ? 1. / diagonal(i) : 1.;
+            }
+        }
+    }
+    return nFailed;
+}
+
+Eigen::VectorXd BlockJacobiPreconditioner::apply(Eigen::VectorXd const &vector) const {
+    Eigen::VectorXd result(vector.size());
+    for (std::size_t b = 0; b < _layout->blocks.size(); ++b) {
+        auto const &block = _layout->blocks[b];
+        Eigen::Map<Eigen::MatrixXd const> inverse(_values.data() + _layout->offsets[b], block.size,
+                                                  block.size);
+        result.segment(block.start, block.size) = inverse * vector.segment(block.start, block.size);
+    }
+    return result;
+}
+
+}  // namespace jointcal
+}  // namespace lsst
@@ -156,6 +156,20 @@ CcdImage::CcdImage(afw::table::SourceCatalog &catalog, std::shared_ptr<lsst::afw
     }
 }
 
+MeasurementArrays const &CcdImage::getMeasurementArrays() const {
+    if (_measurementArraysGeneration != _catalogForFitGeneration) {
+        throw LSST_EXCEPT(pex::exceptions::LogicError,
+                          "The measurement arrays of " + _name + " were not built from its current " +
+                                  "catalog for fit: construct the fitter after the catalog is final.");
+    }
+    return _measurementArrays;
+}
+
+void CcdImage::updateMeasurementValidity() {
+    getMeasurementArrays();  // throws if the arrays are stale
+    _measurementArrays.updateValid(_catalogForFit);
+}
+
 std::pair<int, int> CcdImage::countStars() const {
     int measuredStars = 0;
     int refStars = 0;
@@ -22,30 +22,71 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
-#include <utility>
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <limits>
+#include <tuple>
 
+#include "lsst/pex/exceptions.h"
 #include "lsst/jointcal/Chi2.h"
 
 namespace lsst {
 namespace jointcal {
 
-std::pair<double, double> Chi2List::computeAverageAndSigma() {
+void Chi2List::beginCcdImage(std::size_t ccdImageIndex) {
+    if (ccdImageIndex > std::numeric_limits<decltype(_ccdImageIndex)>::max()) {
+        throw LSST_EXCEPT(pex::exceptions::LengthError,
+                          "CcdImage index " + std::to_string(ccdImageIndex) +
+                                  " does not fit in a Chi2Record");
+    }
+    _kind = Chi2TermKind::Measurement;
+    _ccdImageIndex = ccdImageIndex;
+}
+
+Chi2Summary Chi2List::computeSummary() {
+    Chi2Summary summary;
+    std::size_t nval = size();
+    if (nval == 0) {
+        double const nan = std::numeric_limits<double>::quiet_NaN();
+        summary.average = summary.median = summary.sigma = nan;
+        return summary;
+    }
     double sum = 0;
     double sum2 = 0;
-    for (auto i : *this) {
-        sum += i.chi2;
-        sum2 += std::pow(i.chi2, 2);
+    for (auto const& record : *this) {
+        sum += record.chi2;
+        sum2 += std::pow(record.chi2, 2);
     }
-    double average = sum / size();
-    double sigma = sqrt(sum2 / size() - std::pow(average, 2));
-    return std::make_pair(average, sigma);
+    summary.average = sum / nval;
+    summary.sigma = std::sqrt(sum2 / nval - std::pow(summary.average, 2));
+
+    auto byChi2 = [](Chi2Record const& lhs, Chi2Record const& rhs) { return lhs.chi2 < rhs.chi2; };
+    auto middle = begin() + nval / 2;
+    std::nth_element(begin(), middle, end(), byChi2);
+    summary.median = middle->chi2;
+    if ((nval & 1) == 0) {
+        // the other middle value is the largest of the lower half.
+        summary.median = 0.5 * (summary.median + std::max_element(begin(), middle, byChi2)->chi2);
+    }
+    return summary;
+}
+
+std::size_t Chi2List::selectAbove(double cut) {
+    auto tailEnd =
+            std::partition(begin(), end(), [cut](Chi2Record const& record) { return record.chi2 >= cut; });
+    // Ties are broken by the term indices, so that the selection does not depend on the order of the entries.
+    std::sort(begin(), tailEnd, [](Chi2Record const& lhs, Chi2Record const& rhs) {
+        return std::make_tuple(-lhs.chi2, lhs.kind, lhs.ccdImageIndex, lhs.starIndex) <
+               std::make_tuple(-rhs.chi2, rhs.kind, rhs.ccdImageIndex, rhs.starIndex);
+    });
+    return tailEnd - begin();
 }
 
 std::ostream& operator<<(std::ostream& s, Chi2List const& chi2List) {
     s << "chi2 per star : ";
-    for (auto chi2 : chi2List) {
-        s << *(chi2.star) << " chi2: " << chi2.chi2 << " ; ";
+    for (auto const& record : chi2List) {
+        s << record << " ; ";
     }
     s << std::endl;
     return s;
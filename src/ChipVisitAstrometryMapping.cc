@@ -104,6 +104,64 @@ void ChipVisitAstrometryMapping::transformPosAndErrors(const FatPoint &where, Fa
     _m2->transformPosAndErrors(pMid, outPoint);
 }
 
+void ChipVisitAstrometryMapping::computeTransformAndDerivativesBatch(FatPointArrays const &where,
+                                                                    FatPointArrays &outPoints,
+                                                                    Eigen::MatrixXd &H) const {
+    H.resize(getNpar(), 2 * where.size());
+    FatPointArrays pMid;
+    if (_nPar1) {
+        Eigen::MatrixXd h1;
+        _m1->computeTransformAndDerivativesBatch(where, pMid, h1);
+        Eigen::Matrix2d dt2dx;
+        for (Eigen::Index k = 0; k < where.size(); ++k) {
+            // the last argument is epsilon and is not used for polynomials
+            _m2->positionDerivative(pMid.get(k), dt2dx, 1e-4);
+            H.block(0, 2 * k, _nPar1, 2) = h1.middleCols(2 * k, 2) * dt2dx;
+        }
+    } else
+        _m1->transformPosAndErrorsBatch(where, pMid);
+    if (_nPar2) {
+        Eigen::MatrixXd h2;
+        _m2->computeTransformAndDerivativesBatch(pMid, outPoints, h2);
+        H.bottomRows(_nPar2) = h2;
+    } else
+        _m2->transformPosAndErrorsBatch(pMid, outPoints);
+}
+
+void ChipVisitAstrometryMapping::transformPosAndErrorsBatch(FatPointArrays const &where,
+                                                            FatPointArrays &outPoints) const {
+    FatPointArrays pMid;
+    _m1->transformPosAndErrorsBatch(where, pMid);
+    _m2->transformPosAndErrorsBatch(pMid, outPoints);
+}
+
+std::unique_ptr<AstrometryMapping> ChipVisitAstrometryMapping::cloneWithOffset(
+        Eigen::VectorXd const &delta) const {
+    // The model offsets the chip and visit mappings separately, each at its own index, and only if it fits
+    // them: which is what _nPar1 and _nPar2 record.
+    std::shared_ptr<SimpleAstrometryMapping> m1 = _m1->clone();
+    std::shared_ptr<SimpleAstrometryMapping> m2 = _m2->clone();
+    if (_nPar1 > 0) m1->offsetParams(delta.segment(_m1->getIndex(), _nPar1));
+    if (_nPar2 > 0) m2->offsetParams(delta.segment(_m2->getIndex(), _nPar2));
+    auto result = std::make_unique<ChipVisitAstrometryMapping>(m1, m2);
+    result->setWhatToFit(_nPar1 > 0, _nPar2 > 0);
+    return result;
+}
+
+Eigen::VectorXd ChipVisitAstrometryMapping::getAllParameters() const {
+    Eigen::VectorXd parameters1 = _m1->getAllParameters();
+    Eigen::VectorXd parameters2 = _m2->getAllParameters();
+    Eigen::VectorXd parameters(parameters1.size() + parameters2.size());
+    parameters << parameters1, parameters2;
+    return parameters;
+}
+
+void ChipVisitAstrometryMapping::setAllParameters(Eigen::VectorXd const &parameters) {
+    Eigen::Index nPar1 = _m1->getAllParameters().size();
+    _m1->setAllParameters(parameters.head(nPar1));
+    _m2->setAllParameters(parameters.tail(parameters.size() - nPar1));
+}
+
 void ChipVisitAstrometryMapping::positionDerivative(Point const &where, Eigen::Matrix2d &derivative,
                                                     double epsilon) const {
     Eigen::Matrix2d d1, d2;  // seems that it does not trigger dynamic allocation
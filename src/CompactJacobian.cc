@@ -0,0 +1,223 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <limits>
+#include <string>
+
+#include "lsst/pex/exceptions.h"
+
+#include "lsst/jointcal/CompactJacobian.h"
+
+namespace lsst {
+namespace jointcal {
+
+namespace {
+/// The cholmod routines for one integer type of the sparse matrices.
+template <typename Index>
+struct CholmodRoutines;
+
+template <>
+struct CholmodRoutines<int> {
+    static constexpr int itype = CHOLMOD_INT;
+    static int start(cholmod_common *c) { return cholmod_start(c); }
+    static int finish(cholmod_common *c) { return cholmod_finish(c); }
+    static cholmod_sparse *aat(cholmod_sparse *a, cholmod_common *c) {
+        return cholmod_aat(a, nullptr, 0, 1, c);
+    }
+    static int sort(cholmod_sparse *a, cholmod_common *c) { return cholmod_sort(a, c); }
+    static int freeSparse(cholmod_sparse **a, cholmod_common *c) { return cholmod_free_sparse(a, c); }
+};
+
+template <>
+struct CholmodRoutines<SuiteSparse_long> {
+    static constexpr int itype = CHOLMOD_LONG;
+    static int start(cholmod_common *c) { return cholmod_l_start(c); }
+    static int finish(cholmod_common *c) { return cholmod_l_finish(c); }
+    static cholmod_sparse *aat(cholmod_sparse *a, cholmod_common *c) {
+        return cholmod_l_aat(a, nullptr, 0, 1, c);
+    }
+    static int sort(cholmod_sparse *a, cholmod_common *c) { return cholmod_l_sort(a, c); }
+    static int freeSparse(cholmod_sparse **a, cholmod_common *c) { return cholmod_l_free_sparse(a, c); }
+};
+
+/**
+ * Compute the lower triangle of J*J^T, where J (nRows x nCols) is given in packed CSC layout, with sorted
+ * rows and no duplicates.
+ */
+template <typename Index>
+SparseMatrixD lowerProductWithTranspose(Eigen::Index nRows, std::size_t nCols, Index const *columnStarts,
+                                        Index const *rows, double const *values) {
+    using Routines = CholmodRoutines<Index>;
+    // A view of the Jacobian: cholmod_aat does not modify its input.
+    cholmod_sparse jacobian;
+    jacobian.nrow = nRows;
+    jacobian.ncol = nCols;
+    jacobian.nzmax = columnStarts[nCols];
+    jacobian.p = const_cast<Index *>(columnStarts);
+    jacobian.i = const_cast<Index *>(rows);
+    jacobian.nz = nullptr;
+    jacobian.x = const_cast<double *>(values);
+    jacobian.z = nullptr;
+    jacobian.stype = 0;
+    jacobian.itype = Routines::itype;
+    jacobian.xtype = CHOLMOD_REAL;
+    jacobian.dtype = CHOLMOD_DOUBLE;
+    jacobian.sorted = 1;
+    jacobian.packed = 1;
+
+    cholmod_common common;
+    Routines::start(&common);
+    cholmod_sparse *product = Routines::aat(&jacobian, &common);
+    if (product == nullptr || !Routines::sort(product, &common)) {
+        int status = common.status;
+        Routines::freeSparse(&product, &common);
+        Routines::finish(&common);
+        throw LSST_EXCEPT(pex::exceptions::RuntimeError,
+                          "cholmod failed to compute the Hessian, status = " + std::to_string(status));
+    }
+
+    auto const *productStarts = static_cast<Index const *>(product->p);
+    auto const *productRows = static_cast<Index const *>(product->i);
+    auto const *productValues = static_cast<double const *>(product->x);
+    std::size_t nLower = 0;
+    for (Eigen::Index j = 0; j < nRows; ++j) {
+        for (Index k = productStarts[j]; k < productStarts[j + 1]; ++k) {
+            if (productRows[k] >= j) ++nLower;
+        }
+    }
+    SparseMatrixD hessian(nRows, nRows);
+    hessian.resizeNonZeros(nLower);
+    auto *outer = hessian.outerIndexPtr();
+    auto *inner = hessian.innerIndexPtr();
+    double *hessianValues = hessian.valuePtr();
+    Eigen::Index count = 0;
+    for (Eigen::Index j = 0; j < nRows; ++j) {
+        outer[j] = count;
+        for (Index k = productStarts[j]; k < productStarts[j + 1]; ++k) {
+            if (productRows[k] < j) continue;
+            inner[count] = productRows[k];
+            hessianValues[count] = productValues[k];
+            ++count;
+        }
+    }
+    outer[nRows] = count;
+
+    Routines::freeSparse(&product, &common);
+    Routines::finish(&common);
+    return hessian;
+}
+}  // namespace
+
+CompactJacobian::CompactJacobian(Eigen::Index nParTot, std::size_t nEntries)
+        : _nParTot(nParTot),
+          _wideRows(nParTot > std::numeric_limits<std::int32_t>::max()),
+          _columnStarts({0}) {
+    if (_wideRows) {
+        _longRows.reserve(nEntries);
+    } else {
+        _rows.reserve(nEntries);
+    }
+    _values.reserve(nEntries);
+}
+
+template <typename Row>
+void CompactJacobian::_appendColumn(std::vector<Row> &rows, IndexVector const &indices,
+                                    Eigen::Ref<Eigen::MatrixXd const> const &jacobian, Eigen::Index ic) {
+    _column.clear();
+    for (Eigen::Index ipar = 0; ipar < jacobian.rows(); ++ipar) {
+        double val = jacobian(ipar, ic);
+        if (val != 0) _column.emplace_back(indices[ipar], val);
+    }
+    // two rows of the term may refer to the same parameter: their values are summed.
+    std::sort(_column.begin(), _column.end(),
+              [](auto const &left, auto const &right) { return left.first < right.first; });
+    for (auto const &entry : _column) {
+        if (rows.size() > std::size_t(_columnStarts.back()) && rows.back() == entry.first) {
+            _values.back() += entry.second;
+        } else {
+            rows.push_back(static_cast<Row>(entry.first));
+            _values.push_back(entry.second);
+        }
+    }
+    _columnStarts.push_back(_values.size());
+}
+
+void CompactJacobian::addTerm(IndexVector const &indices, Eigen::Ref<Eigen::MatrixXd const> const &jacobian) {
+    for (Eigen::Index ic = 0; ic < jacobian.cols(); ++ic) {
+        if (_wideRows) {
+            _appendColumn(_longRows, indices, jacobian, ic);
+        } else {
+            _appendColumn(_rows, indices, jacobian, ic);
+        }
+    }
+}
+
+std::unique_ptr<JacobianAccumulator> CompactJacobian::makeEmptyClone() const {
+    return std::unique_ptr<JacobianAccumulator>(new CompactJacobian(_nParTot, 0));
+}
+
+void CompactJacobian::merge(JacobianAccumulator &other) {
+    auto &otherJacobian = dynamic_cast<CompactJacobian &>(other);
+    if (getNColumns() == 0) {
+        std::swap(_rows, otherJacobian._rows);
+        std::swap(_longRows, otherJacobian._longRows);
+        std::swap(_values, otherJacobian._values);
+        std::swap(_columnStarts, otherJacobian._columnStarts);
+    } else {
+        SuiteSparse_long shift = _values.size();
+        _rows.insert(_rows.end(), otherJacobian._rows.begin(), otherJacobian._rows.end());
+        _longRows.insert(_longRows.end(), otherJacobian._longRows.begin(), otherJacobian._longRows.end());
+        _values.insert(_values.end(), otherJacobian._values.begin(), otherJacobian._values.end());
+        _columnStarts.reserve(_columnStarts.size() + otherJacobian.getNColumns());
+        for (std::size_t k = 1; k < otherJacobian._columnStarts.size(); ++k) {
+            _columnStarts.push_back(otherJacobian._columnStarts[k] + shift);
+        }
+    }
+    std::vector<std::int32_t>().swap(otherJacobian._rows);
+    std::vector<SuiteSparse_long>().swap(otherJacobian._longRows);
+    std::vector<double>().swap(otherJacobian._values);
+    std::vector<SuiteSparse_long>({0}).swap(otherJacobian._columnStarts);
+}
+
+SparseMatrixD CompactJacobian::makeHessian() const {
+    std::size_t nCols = getNColumns();
+    if (_wideRows) {
+        return lowerProductWithTranspose<SuiteSparse_long>(_nParTot, nCols, _columnStarts.data(),
+                                                           _longRows.data(), _values.data());
+    } else if (_columnStarts.back() <= std::numeric_limits<int>::max() &&
+               nCols < static_cast<std::size_t>(std::numeric_limits<int>::max())) {
+        std::vector<int> columnStarts(_columnStarts.begin(), _columnStarts.end());
+        return lowerProductWithTranspose<int>(_nParTot, nCols, columnStarts.data(), _rows.data(),
+                                              _values.data());
+    } else {
+        // Too many entries for 32-bit column starts: cholmod then needs 64-bit rows too.
+        std::vector<SuiteSparse_long> rows(_rows.begin(), _rows.end());
+        return lowerProductWithTranspose<SuiteSparse_long>(_nParTot, nCols, _columnStarts.data(), rows.data(),
+                                                           _values.data());
+    }
+}
+
+}  // namespace jointcal
+}  // namespace lsst
@@ -125,8 +125,13 @@ std::size_t ConstrainedPhotometryModel::getTotalParameters() const {
 void ConstrainedPhotometryModel::computeParameterDerivatives(MeasuredStar const &measuredStar,
                                                              CcdImage const &ccdImage,
                                                              Eigen::VectorXd &derivatives) const {
-    auto mapping = findMapping(ccdImage);
-    mapping->computeParameterDerivatives(measuredStar, measuredStar.getInstFlux(), derivatives);
+    computeParameterDerivatives(measuredStar, *findMapping(ccdImage), derivatives);
+}
+
+void ConstrainedPhotometryModel::computeParameterDerivatives(MeasuredStar const &measuredStar,
+                                                             PhotometryMappingBase const &mapping,
+                                                             Eigen::VectorXd &derivatives) const {
+    mapping.computeParameterDerivatives(measuredStar, measuredStar.getInstFlux(), derivatives);
 }
 
 namespace {
@@ -266,7 +271,12 @@ ConstrainedPhotometryModel::PrepPhotoCalib ConstrainedPhotometryModel::prepPhoto
 
 double ConstrainedFluxModel::computeResidual(CcdImage const &ccdImage,
                                              MeasuredStar const &measuredStar) const {
-    return transform(ccdImage, measuredStar) - measuredStar.getFittedStar()->getFlux();
+    return computeResidual(measuredStar, *measuredStar.getFittedStar(), *findMapping(ccdImage));
+}
+
+double ConstrainedFluxModel::computeResidual(MeasuredStar const &measuredStar, FittedStar const &fittedStar,
+                                             PhotometryMappingBase const &mapping) const {
+    return mapping.transform(measuredStar, measuredStar.getInstFlux()) - fittedStar.getFlux();
 }
 
 double ConstrainedFluxModel::transform(CcdImage const &ccdImage, MeasuredStar const &measuredStar) const {
@@ -276,9 +286,13 @@ double ConstrainedFluxModel::transform(CcdImage const &ccdImage, MeasuredStar co
 
 double ConstrainedFluxModel::transformError(CcdImage const &ccdImage,
                                             MeasuredStar const &measuredStar) const {
-    auto mapping = findMapping(ccdImage);
+    return transformError(measuredStar, *findMapping(ccdImage));
+}
+
+double ConstrainedFluxModel::transformError(MeasuredStar const &measuredStar,
+                                            PhotometryMappingBase const &mapping) const {
     double tempErr = tweakFluxError(measuredStar);
-    return mapping->transformError(measuredStar, measuredStar.getInstFlux(), tempErr);
+    return mapping.transformError(measuredStar, measuredStar.getInstFlux(), tempErr);
 }
 
 std::shared_ptr<afw::image::PhotoCalib> ConstrainedFluxModel::toPhotoCalib(CcdImage const &ccdImage) const {
@@ -309,7 +323,13 @@ void ConstrainedFluxModel::print(std::ostream &out) const {
 
 double ConstrainedMagnitudeModel::computeResidual(CcdImage const &ccdImage,
                                                   MeasuredStar const &measuredStar) const {
-    return transform(ccdImage, measuredStar) - measuredStar.getFittedStar()->getMag();
+    return computeResidual(measuredStar, *measuredStar.getFittedStar(), *findMapping(ccdImage));
+}
+
+double ConstrainedMagnitudeModel::computeResidual(MeasuredStar const &measuredStar,
+                                                  FittedStar const &fittedStar,
+                                                  PhotometryMappingBase const &mapping) const {
+    return mapping.transform(measuredStar, measuredStar.getInstMag()) - fittedStar.getMag();
 }
 
 double ConstrainedMagnitudeModel::transform(CcdImage const &ccdImage,
@@ -320,9 +340,13 @@ double ConstrainedMagnitudeModel::transform(CcdImage const &ccdImage,
 
 double ConstrainedMagnitudeModel::transformError(CcdImage const &ccdImage,
                                                  MeasuredStar const &measuredStar) const {
-    auto mapping = findMapping(ccdImage);
+    return transformError(measuredStar, *findMapping(ccdImage));
+}
+
+double ConstrainedMagnitudeModel::transformError(MeasuredStar const &measuredStar,
+                                                 PhotometryMappingBase const &mapping) const {
     double tempErr = tweakFluxError(measuredStar);
-    return mapping->transformError(measuredStar, measuredStar.getInstFlux(), tempErr);
+    return mapping.transformError(measuredStar, measuredStar.getInstFlux(), tempErr);
 }
 
 std::shared_ptr<afw::image::PhotoCalib> ConstrainedMagnitudeModel::toPhotoCalib(
@@ -22,23 +22,84 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include "Eigen/Core"
 
 #include <boost/math/tools/minima.hpp>
 
 #include "lsst/log/Log.h"
+#include "lsst/pex/exceptions.h"
 
+#include "lsst/jointcal/BlockJacobiPreconditioner.h"
 #include "lsst/jointcal/Chi2.h"
 #include "lsst/jointcal/CcdImage.h"
+#include "lsst/jointcal/CompactJacobian.h"
 #include "lsst/jointcal/Eigenstuff.h"
 #include "lsst/jointcal/FitterBase.h"
 #include "lsst/jointcal/FittedStar.h"
+#include "lsst/jointcal/HessianAccumulator.h"
 #include "lsst/jointcal/MeasuredStar.h"
+#include "lsst/jointcal/PhaseTimer.h"
+#include "lsst/jointcal/SparseSystemIO.h"
+#include "lsst/jointcal/Threads.h"
 
 namespace lsst {
 namespace jointcal {
 
+namespace {
+/// Wall time in seconds elapsed since start.
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Split ccdImageList into at most nChunks contiguous groups holding about the same number of measurements.
+ */
+std::vector<std::vector<CcdImage const *>> splitCcdImageList(CcdImageList const &ccdImageList,
+                                                             std::size_t nChunks) {
+    std::size_t total = 0;
+    for (auto const &ccdImage : ccdImageList) {
+        total += ccdImage->getCatalogForFit().size();
+    }
+    std::vector<std::vector<CcdImage const *>> chunks(1);
+    std::size_t count = 0;
+    for (auto const &ccdImage : ccdImageList) {
+        // start a new chunk once the current one has its share of the measurements.
+        if (chunks.size() < nChunks && !chunks.back().empty() && count >= total * chunks.size() / nChunks) {
+            chunks.emplace_back();
+        }
+        chunks.back().push_back(ccdImage.get());
+        count += ccdImage->getCatalogForFit().size();
+    }
+    return chunks;
+}
+
+/// Discards the Jacobian terms, to only compute the gradient.
+class GradientOnlyAccumulator : public JacobianAccumulator {
+public:
+    void addTerm(IndexVector const &indices, Eigen::Ref<Eigen::MatrixXd const> const &jacobian) override {}
+
+    std::unique_ptr<JacobianAccumulator> makeEmptyClone() const override {
+        return std::unique_ptr<JacobianAccumulator>(new GradientOnlyAccumulator());
+    }
+
+    void merge(JacobianAccumulator &other) override {}
+};
+}  // namespace
+
 Chi2Statistic FitterBase::computeChi2() const {
     Chi2Statistic chi2;
     accumulateStatImageList(_associations->getCcdImageList(), chi2);
@@ -49,26 +110,171 @@ Chi2Statistic FitterBase::computeChi2() const {
     return chi2;
 }
 
+Chi2Statistic FitterBase::computeChi2(Eigen::VectorXd const &offset) const {
+    if (offset.size() != _nParTot)
+        throw LSST_EXCEPT(pex::exceptions::InvalidParameterError,
+                          "FitterBase::computeChi2 : the provided offset length is not compatible with "
+                          "the current whatToFit setting");
+    Chi2Statistic chi2;
+    accumulateStatImageList(_associations->getCcdImageList(), chi2, &offset);
+    accumulateStatRefStars(chi2, &offset);
+    chi2.ndof -= _nParTot;
+    return chi2;
+}
+
+Chi2Statistic FitterBase::_timedChi2() {
+    PhaseTimer timer(_timings.chi2);
+    return computeChi2();
+}
+
+Chi2Statistic FitterBase::_timedChi2(Eigen::VectorXd const &offset) {
+    PhaseTimer timer(_timings.chi2);
+    return computeChi2(offset);
+}
+
+std::vector<Eigen::MatrixXd> FitterBase::computeCovarianceBlocks(std::vector<IndexVector> const &blocks) {
+    for (auto const &indices : blocks) {
+        for (auto const index : indices) {
+            if (index < 0 || index >= _nParTot) {
+                throw LSST_EXCEPT(pex::exceptions::InvalidParameterError,
+                                  "FitterBase::computeCovarianceBlocks: parameter index " +
+                                          std::to_string(index) + " is not in [0, " +
+                                          std::to_string(_nParTot) + ")");
+            }
+        }
+    }
+
+    if (_control.schurComplement) {
+        _solver->setEliminableBlocks(getEliminableBlocks());
+    }
+    Eigen::VectorXd grad = Eigen::VectorXd::Zero(_nParTot);
+    if (!_solver->factorize(_computeHessian(grad), _statistics)) {
+        throw LSST_EXCEPT(pex::exceptions::RuntimeError,
+                          "FitterBase::computeCovarianceBlocks: the Hessian cannot be factorized");
+    }
+    auto start = std::chrono::steady_clock::now();
+    auto covariances = _solver->computeInverseBlocks(blocks);
+    LOGLS_DEBUG(_log, "Computed " << blocks.size() << " covariance blocks in " << secondsSince(start)
+                                  << " s");
+    return covariances;
+}
+
+ParameterCovariances FitterBase::computeParameterCovariances() {
+    CcdImageList const &ccdImageList = _associations->getCcdImageList();
+    FittedStarList const &fittedStarList = _associations->fittedStarList;
+    std::vector<IndexVector> blocks;
+    blocks.reserve(ccdImageList.size() + fittedStarList.size());
+    IndexVector indices;
+    for (auto const &ccdImage : ccdImageList) {
+        getIndicesOfMapping(*ccdImage, indices);
+        blocks.push_back(indices);
+    }
+    for (auto const &fittedStar : fittedStarList) {
+        getIndicesOfFittedStar(*fittedStar, indices);
+        blocks.push_back(indices);
+    }
+
+    // Computed all at once, so that the Hessian is only factorized and inverted once.
+    auto covariances = computeCovarianceBlocks(blocks);
+    auto const fittedStarsBegin = covariances.begin() + ccdImageList.size();
+    ParameterCovariances result;
+    result.mappings.assign(std::make_move_iterator(covariances.begin()),
+                           std::make_move_iterator(fittedStarsBegin));
+    result.fittedStars.assign(std::make_move_iterator(fittedStarsBegin),
+                              std::make_move_iterator(covariances.end()));
+    return result;
+}
+
+void FitterBase::accumulateStatImageList(CcdImageList const &ccdImageList, Chi2Accumulator &accum,
+                                         Eigen::VectorXd const *offset) const {
+    // One partial accumulator per ccdImage, merged in order: the way the ccdImages are distributed among
+    // threads then cannot change the result, not even by rounding.
+    auto chunks = splitCcdImageList(ccdImageList, _getNThreads());
+    // position in ccdImageList of the first ccdImage of each chunk.
+    std::vector<std::size_t> chunkStarts(1, 0);
+    for (auto const &chunk : chunks) {
+        chunkStarts.push_back(chunkStarts.back() + chunk.size());
+    }
+    std::vector<std::vector<std::unique_ptr<Chi2Accumulator>>> partials(chunks.size());
+    auto accumulateChunk = [&](std::size_t i) {
+        for (std::size_t k = 0; k < chunks[i].size(); ++k) {
+            partials[i].push_back(accum.makeEmptyClone());
+            partials[i].back()->beginCcdImage(chunkStarts[i] + k);
+            accumulateStatImage(*chunks[i][k], *partials[i].back(), offset);
+        }
+    };
+    if (chunks.size() > 1) {
+        runInThreads(chunks.size(), accumulateChunk);
+    } else {
+        accumulateChunk(0);
+    }
+    for (auto &chunk : partials) {
+        for (auto &partial : chunk) {
+            accum.merge(*partial);
+        }
+    }
+}
+
 std::size_t FitterBase::findOutliers(double nSigmaCut, MeasuredStarList &msOutliers,
                                      FittedStarList &fsOutliers) const {
-    // collect chi2 contributions
-    Chi2List chi2List;
+    auto const &ccdImageList = _associations->getCcdImageList();
+    // collect chi2 contributions, reusing the storage of the previous call.
+    Chi2List &chi2List = _outlierChi2List;
+    chi2List.clear();
     chi2List.reserve(_nMeasuredStars + _associations->refStarList.size());
     // contributions from measurement terms:
-    accumulateStatImageList(_associations->ccdImageList, chi2List);
+    accumulateStatImageList(ccdImageList, chi2List);
     // and from reference terms
+    chi2List.beginReferences();
     accumulateStatRefStars(chi2List);
 
     // compute some statistics
     size_t nval = chi2List.size();
     if (nval == 0) return 0;
-    sort(chi2List.begin(), chi2List.end());
-    double median = (nval & 1) ? chi2List[nval / 2].chi2
-                               : 0.5 * (chi2List[nval / 2 - 1].chi2 + chi2List[nval / 2].chi2);
-    auto averageAndSigma = chi2List.computeAverageAndSigma();
-    LOGLS_DEBUG(_log, "findOutliers chi2 stat: mean/median/sigma " << averageAndSigma.first << '/' << median
-                                                                   << '/' << averageAndSigma.second);
-    double cut = averageAndSigma.first + nSigmaCut * averageAndSigma.second;
+    Chi2Summary summary = chi2List.computeSummary();
+    LOGLS_DEBUG(_log, "findOutliers chi2 stat: mean/median/sigma " << summary.average << '/' << summary.median
+                                                                   << '/' << summary.sigma);
+    double cut = summary.average + nSigmaCut * summary.sigma;
+    // Only the entries above the cut are sorted, strongest first.
+    std::size_t nCandidates = chi2List.selectAbove(cut);
+
+    // Look up the stars of the candidates, walking each star list at most once.
+    std::vector<std::size_t> lookupOrder(nCandidates);
+    std::iota(lookupOrder.begin(), lookupOrder.end(), 0);
+    std::sort(lookupOrder.begin(), lookupOrder.end(), [&chi2List](std::size_t lhs, std::size_t rhs) {
+        return std::make_tuple(chi2List[lhs].kind, chi2List[lhs].ccdImageIndex, chi2List[lhs].starIndex) <
+               std::make_tuple(chi2List[rhs].kind, chi2List[rhs].ccdImageIndex, chi2List[rhs].starIndex);
+    });
+    std::vector<std::shared_ptr<MeasuredStar>> candidateMeasuredStars(nCandidates);
+    std::vector<std::shared_ptr<FittedStar>> candidateFittedStars(nCandidates);
+    std::vector<CcdImage const *> ccdImages;
+    ccdImages.reserve(ccdImageList.size());
+    for (auto const &ccdImage : ccdImageList) {
+        ccdImages.push_back(ccdImage.get());
+    }
+    MeasuredStarList::const_iterator catalogIt;
+    FittedStarList::const_iterator fittedStarIt = _associations->fittedStarList.begin();
+    std::size_t currentCcdImage = ccdImages.size();
+    std::size_t position = 0;  // of catalogIt in the catalog of the current ccdImage
+    std::size_t fittedStarPosition = 0;
+    for (auto k : lookupOrder) {
+        Chi2Record const &record = chi2List[k];
+        if (record.kind == Chi2TermKind::Measurement) {
+            if (record.ccdImageIndex != currentCcdImage) {
+                currentCcdImage = record.ccdImageIndex;
+                catalogIt = ccdImages[currentCcdImage]->getCatalogForFit().begin();
+                position = 0;
+            }
+            std::advance(catalogIt, record.starIndex - position);
+            position = record.starIndex;
+            candidateMeasuredStars[k] = *catalogIt;
+        } else {
+            std::advance(fittedStarIt, record.starIndex - fittedStarPosition);
+            fittedStarPosition = record.starIndex;
+            candidateFittedStars[k] = *fittedStarIt;
+        }
+    }
+
     /* For each of the parameters, we will not remove more than 1
        measurement that contributes to constraining it. Keep track using
        of what we are touching using an integer vector. This is the
@@ -76,40 +282,61 @@ std::size_t FitterBase::findOutliers(double nSigmaCut, MeasuredStarList &msOutli
        flats" fits. */
     Eigen::VectorXi affectedParams(_nParTot);
     affectedParams.setZero();
+    // With a robust loss, the outliers hardly pull on the fit: the remaining ones can all be removed at once.
+    bool const removeAll = _robustLoss.isRobust();
+    /* The measurements and reference of each FittedStar that this pass leaves in the fit: a FittedStar
+       always keeps a measurement, or a measurement and its reference, so that its parameters remain
+       constrained. The counts of the stars are only decremented by removeMeasOutliers(), later. */
+    struct RemainingTerms {
+        std::size_t nMeasurements;
+        bool hasRefStar;
+    };
+    std::unordered_map<FittedStar const *, RemainingTerms> remainingTerms;
+    auto getRemainingTerms = [&remainingTerms](FittedStar const &star) -> RemainingTerms & {
+        auto inserted = remainingTerms.emplace(
+                &star, RemainingTerms{static_cast<std::size_t>(std::max(star.getMeasurementCount(), 0)),
+                                      star.getRefStar() != nullptr});
+        return inserted.first->second;
+    };
 
     std::size_t nOutliers = 0;  // returned to the caller
+    IndexVector indices;
     // start from the strongest outliers.
-    for (auto chi2 = chi2List.rbegin(); chi2 != chi2List.rend(); ++chi2) {
-        if (chi2->chi2 < cut) break;  // because the array is sorted.
-        IndexVector indices;
+    for (std::size_t k = 0; k < nCandidates; ++k) {
+        double chi2 = chi2List[k].chi2;
         /* now, we want to get the indices of the parameters this chi2
            term depends on. We have to figure out which kind of term it
-           is; we use for that the type of the star attached to the Chi2Star. */
-        auto measuredStar = std::dynamic_pointer_cast<MeasuredStar>(chi2->star);
-        std::shared_ptr<FittedStar> fittedStar;  // To add to fsOutliers if it is a reference outlier.
+           is; the record tells us. */
+        auto const &measuredStar = candidateMeasuredStars[k];
+        // fittedStar is only set (and added to fsOutliers if it is an outlier) for reference terms.
+        auto const &fittedStar = candidateFittedStars[k];
+        RemainingTerms *remaining;
         if (measuredStar == nullptr) {
             // it is a reference outlier
-            fittedStar = std::dynamic_pointer_cast<FittedStar>(chi2->star);
-            if (fittedStar->getMeasurementCount() == 0) {
-                LOGLS_WARN(_log, "FittedStar with no measuredStars found as an outlier: " << *fittedStar);
+            remaining = &getRemainingTerms(*fittedStar);
+            if (remaining->nMeasurements == 0) {
+                LOGLS_WARN(_log,
+                           "FittedStar with no measuredStars left found as an outlier: " << *fittedStar);
                 continue;
             }
             // NOTE: Stars contribute twice to astrometry (x,y), but once to photometry (flux),
             // NOTE: but we only need to mark one index here because both will be removed with that star.
-            indices.push_back(fittedStar->getIndexInMatrix());
-            LOGLS_TRACE(_log, "Removing refStar " << *(fittedStar->getRefStar()) << " chi2: " << chi2->chi2);
+            indices.assign(1, fittedStar->getIndexInMatrix());
+            LOGLS_TRACE(_log, "Removing refStar " << *(fittedStar->getRefStar()) << " chi2: " << chi2);
             /* One might think it would be useful to account for PM
                parameters here, but it is just useless */
         } else {
             // it is a measurement outlier
             auto tempFittedStar = measuredStar->getFittedStar();
-            if (tempFittedStar->getMeasurementCount() == 1 && tempFittedStar->getRefStar() == nullptr) {
-                LOGLS_WARN(_log, "FittedStar with 1 measuredStar and no refStar found as an outlier: "
+            remaining = &getRemainingTerms(*tempFittedStar);
+            if (remaining->nMeasurements <= 1 && !remaining->hasRefStar) {
+                LOGLS_WARN(_log, "FittedStar with 1 measuredStar left and no refStar found as an outlier: "
                                          << *tempFittedStar);
                 continue;
             }
+            indices.clear();
             getIndicesOfMeasuredStar(*measuredStar, indices);
-            LOGLS_TRACE(_log, "Removing measStar " << *measuredStar << " chi2: " << chi2->chi2);
+            LOGLS_TRACE(_log, "Removing measStar " << *measuredStar << " chi2: " << chi2);
         }
 
         /* Find out if we already discarded a stronger outlier
@@ -118,7 +345,7 @@ std::size_t FitterBase::findOutliers(double nSigmaCut, MeasuredStarList &msOutli
          causing the large chi2 we have in hand.  */
         bool drop_it = true;
         for (auto const &i : indices) {
-            if (affectedParams(i) != 0) {
+            if (affectedParams(i) != 0 && !removeAll) {
                 drop_it = false;
             }
         }
@@ -128,9 +355,11 @@ std::size_t FitterBase::findOutliers(double nSigmaCut, MeasuredStarList &msOutli
             if (measuredStar == nullptr) {
                 // reference term
                 fsOutliers.push_back(fittedStar);
+                remaining->hasRefStar = false;
             } else {
                 // measurement term
                 msOutliers.push_back(measuredStar);
+                remaining->nMeasurements--;
             }
             // mark the parameters as directly changed when we discard this chi2 term.
             for (auto const &i : indices) {
@@ -146,80 +375,95 @@ std::size_t FitterBase::findOutliers(double nSigmaCut, MeasuredStarList &msOutli
 }
 
 namespace {
-/// Return a Hessian matrix filled from tripletList of size nParTot x nParTot.
-SparseMatrixD createHessian(std::size_t nParTot, TripletList const &tripletList) {
-    SparseMatrixD jacobian(nParTot, tripletList.getNextFreeIndex());
-    jacobian.setFromTriplets(tripletList.begin(), tripletList.end());
-    return jacobian * jacobian.transpose();
-}
-
-/// Write matrix and gradient to files built from dumpFile, and log their names.
+/**
+ * Write matrix and gradient to files built from dumpFile, in the given format, and log their names.
+ *
+ * The text format converts the matrix to a dense one: if it is too large for that, the binary format is
+ * written instead.
+ */
 void dumpMatrixAndGradient(SparseMatrixD const &matrix, Eigen::VectorXd const &grad,
-                           std::string const &dumpFile, LOG_LOGGER _log) {
-    std::string ext = ".txt";
-    Eigen::MatrixXd matrixDense(matrix);
-    std::string dumpMatrixPath = dumpFile + "-mat" + ext;
-    std::ofstream matfile(dumpMatrixPath);
-    matfile << matrixDense << std::endl;
-    std::string dumpGradPath = dumpFile + "-grad" + ext;
-    std::ofstream gradfile(dumpGradPath);
-    gradfile << grad << std::endl;
-    LOGLS_INFO(_log, "Dumped Hessian, gradient to: '" << dumpMatrixPath << "', '" << dumpGradPath << "'");
+                           std::string const &dumpFile, std::string const &format, LOG_LOGGER _log) {
+    if (format == "text" && matrix.rows() * matrix.cols() > 2e8) {
+        LOGLS_WARN(_log, "Hessian matrix is too big to dump to a text file, with rows, columns: "
+                                 << matrix.rows() << ", " << matrix.cols()
+                                 << "; writing a binary file instead.");
+    } else if (format == "text") {
+        std::string ext = ".txt";
+        // The matrix may only have its lower triangle filled: symmetrize it.
+        SparseMatrixD matrixFull = matrix.selfadjointView<Eigen::Lower>();
+        Eigen::MatrixXd matrixDense(matrixFull);
+        std::string dumpMatrixPath = dumpFile + "-mat" + ext;
+        std::ofstream matfile(dumpMatrixPath);
+        matfile << matrixDense << std::endl;
+        std::string dumpGradPath = dumpFile + "-grad" + ext;
+        std::ofstream gradfile(dumpGradPath);
+        gradfile << grad << std::endl;
+        LOGLS_INFO(_log, "Dumped Hessian, gradient to: '" << dumpMatrixPath << "', '" << dumpGradPath << "'");
+        return;
+    }
+    if (format == "matrixMarket") {
+        std::string dumpMatrixPath = dumpFile + "-mat.mtx";
+        std::string dumpGradPath = dumpFile + "-grad.mtx";
+        writeMatrixMarket(dumpMatrixPath, dumpGradPath, matrix, grad);
+        LOGLS_INFO(_log, "Dumped Hessian, gradient to: '" << dumpMatrixPath << "', '" << dumpGradPath << "'");
+    } else {
+        std::string dumpPath = dumpFile + "-system.bin";
+        writeSparseSystem(dumpPath, matrix, grad);
+        LOGLS_INFO(_log, "Dumped Hessian and gradient to: '" << dumpPath << "'");
+    }
 }
 }  // namespace
 
 MinimizeResult FitterBase::minimize(std::string const &whatToFit, double nSigmaCut, bool doRankUpdate,
                                     bool const doLineSearch, std::string const &dumpMatrixFile) {
-    assignIndices(whatToFit);
+    // The damping factor carries over from one minimize() to the next only for the same parameters.
+    if (whatToFit != _whatToFit || !(_damping > 0)) {
+        _damping = _control.levenbergMarquardtInitialDamping;
+    }
+    // Another parameter layout: the last Hessian tells nothing about the pattern of the next one.
+    if (whatToFit != _whatToFit) _hessianPattern.clear();
+    {
+        PhaseTimer timer(_timings.assignIndices);
+        assignIndices(whatToFit);
+    }
+    if (_control.schurComplement) {
+        _solver->setEliminableBlocks(getEliminableBlocks());
+    }
 
     MinimizeResult returnCode = MinimizeResult::Converged;
 
-    // TODO : write a guesser for the number of triplets
-    std::size_t nTrip = (_lastNTrip) ? _lastNTrip : 1e6;
-    TripletList tripletList(nTrip);
     Eigen::VectorXd grad(_nParTot);
     grad.setZero();
     double scale = 1.0;
 
-    // Fill the triplets
-    leastSquareDerivatives(tripletList, grad);
-    _lastNTrip = tripletList.size();
-
-    LOGLS_DEBUG(_log, "End of triplet filling, ntrip = " << tripletList.size());
-
-    SparseMatrixD hessian = createHessian(_nParTot, tripletList);
-    tripletList.clear();  // we don't need it any more after we have the hessian.
-
-    LOGLS_DEBUG(_log, "Starting factorization, hessian: dim="
-                              << hessian.rows() << " non-zeros=" << hessian.nonZeros()
-                              << " filling-frac = " << hessian.nonZeros() / std::pow(hessian.rows(), 2));
-
-    if (dumpMatrixFile != "") {
-        if (hessian.rows() * hessian.cols() > 2e8) {
-            LOGLS_WARN(_log, "Hessian matrix is too big to dump to file, with rows, columns: "
-                                     << hessian.rows() << ", " << hessian.cols());
-        } else {
-            dumpMatrixAndGradient(hessian, grad, dumpMatrixFile, _log);
-        }
-    }
-
-    CholmodSimplicialLDLT2<SparseMatrixD> chol(hessian);
-    if (chol.info() != Eigen::Success) {
+    auto start = std::chrono::steady_clock::now();
+    if (!_prepareSolve(grad, dumpMatrixFile)) {
         LOGLS_ERROR(_log, "minimize: factorization failed ");
         return MinimizeResult::Failed;
     }
+    _statistics.lastRefactorizationSeconds = secondsSince(start);
 
     std::size_t totalMeasOutliers = 0;
     std::size_t totalRefOutliers = 0;
-    double oldChi2 = computeChi2().chi2;
+    double oldChi2 = _timedChi2().chi2;
+    // chi2 at the current parameters, for the line search; unknown once outliers have been removed.
+    double startChi2 = oldChi2;
 
     while (true) {
-        Eigen::VectorXd delta = chol.solve(grad);
-        if (doLineSearch) {
-            scale = _lineSearch(delta);
+        if (_control.levenbergMarquardt) {
+            double chi2 = std::isnan(startChi2) ? _timedChi2().chi2 : startChi2;
+            if (!_dampedStep(grad, chi2)) {
+                LOGLS_ERROR(_log, "minimize: factorization failed ");
+                return MinimizeResult::Failed;
+            }
+        } else {
+            Eigen::VectorXd delta = _solveStep(grad);
+            if (doLineSearch) {
+                scale = _lineSearch(delta, grad, startChi2);
+            }
+            offsetParams(scale * delta);
         }
-        offsetParams(scale * delta);
-        Chi2Statistic currentChi2(computeChi2());
+        Chi2Statistic currentChi2(_timedChi2());
         LOGLS_DEBUG(_log, currentChi2);
         if (!isfinite(currentChi2.chi2)) {
             LOGL_ERROR(_log, "chi2 is not finite. Aborting outlier rejection.");
@@ -237,49 +481,65 @@ MinimizeResult FitterBase::minimize(std::string const &whatToFit, double nSigmaC
         MeasuredStarList msOutliers;
         FittedStarList fsOutliers;
         // keep nOutliers so we don't have to sum msOutliers.size()+fsOutliers.size() twice below.
-        std::size_t nOutliers = findOutliers(nSigmaCut, msOutliers, fsOutliers);
+        std::size_t nOutliers;
+        {
+            PhaseTimer timer(_timings.findOutliers);
+            nOutliers = findOutliers(nSigmaCut, msOutliers, fsOutliers);
+        }
         totalMeasOutliers += msOutliers.size();
         totalRefOutliers += fsOutliers.size();
         if (nOutliers == 0) break;
+        // The robust weights of the outliers changed with the step: their contribution to the factorized
+        // Hessian cannot be recomputed to downdate it.
+        bool canDowndate = doRankUpdate && !_control.conjugateGradient && _solver->canDowndate() &&
+                           !_robustLoss.isRobust();
+        start = std::chrono::steady_clock::now();
         TripletList outlierTriplets(nOutliers);
         grad.setZero();  // recycle the gradient
-        // compute the contributions of outliers to derivatives
-        outliersContributions(msOutliers, fsOutliers, outlierTriplets, grad);
+        if (canDowndate) {
+            PhaseTimer timer(_timings.tripletFill);
+            // compute the contributions of outliers to derivatives
+            outliersContributions(msOutliers, fsOutliers, outlierTriplets, grad);
+        }
         // Remove significant outliers
         removeMeasOutliers(msOutliers);
         removeRefOutliers(fsOutliers);
-        if (doRankUpdate) {
+        startChi2 = std::numeric_limits<double>::quiet_NaN();
+        _statistics.lastOutlierRank = outlierTriplets.getNextFreeIndex();
+        if (canDowndate && _shouldDowndate(_statistics.lastOutlierRank)) {
+            PhaseTimer timer(_timings.rankUpdate);
             // convert triplet list to eigen internal format
             SparseMatrixD H(_nParTot, outlierTriplets.getNextFreeIndex());
             H.setFromTriplets(outlierTriplets.begin(), outlierTriplets.end());
-            chol.update(H, false /* means downdate */);
+            _solver->downdate(H, _statistics);
+            if (_control.levenbergMarquardt) {
+                // keep the undamped Hessian in sync, for the chi2 decrease predicted by the next steps.
+                SparseMatrixD outlierHessian =
+                        SparseMatrixD(H * H.transpose()).triangularView<Eigen::Lower>();
+                _hessian -= outlierHessian;
+            }
             // The contribution of outliers to the gradient is the opposite
             // of the contribution of all other terms, because they add up to 0
             grad *= -1;
+            _statistics.lastOutlierUpdate = "downdate";
+            _statistics.lastDowndateSeconds = secondsSince(start);
+            _statistics.lastDowndateRank = _statistics.lastOutlierRank;
         } else {
-            // don't reuse tripletList because we want a new nextFreeIndex.
-            TripletList nextTripletList(_lastNTrip);
             grad.setZero();
             // Rebuild the matrix and gradient
-            leastSquareDerivatives(nextTripletList, grad);
-            _lastNTrip = nextTripletList.size();
-            LOGLS_DEBUG(_log, "Triplets recomputed, ntrip = " << nextTripletList.size());
-
-            hessian = createHessian(_nParTot, nextTripletList);
-            nextTripletList.clear();  // we don't need it any more after we have the hessian.
-
-            LOGLS_DEBUG(_log,
-                        "Restarting factorization, hessian: dim="
-                                << hessian.rows() << " non-zeros=" << hessian.nonZeros()
-                                << " filling-frac = " << hessian.nonZeros() / std::pow(hessian.rows(), 2));
-            chol.compute(hessian);
-            if (chol.info() != Eigen::Success) {
+            start = std::chrono::steady_clock::now();
+            if (!_prepareSolve(grad, "")) {
                 LOGLS_ERROR(_log, "minimize: factorization failed ");
                 return MinimizeResult::Failed;
             }
+            _statistics.lastRefactorizationSeconds = secondsSince(start);
+            _statistics.lastOutlierUpdate = "refactorization";
+            ++_statistics.nOutlierRefactorizations;
         }
     }
 
+    _statistics.lastMeasurementOutliers = totalMeasOutliers;
+    _statistics.lastReferenceOutliers = totalRefOutliers;
     // only print the outlier summary if outlier rejection was turned on.
     if (nSigmaCut != 0) {
         LOGLS_INFO(_log, "Number of outliers (Measured + Reference = Total): "
@@ -289,22 +549,125 @@ MinimizeResult FitterBase::minimize(std::string const &whatToFit, double nSigmaC
     return returnCode;
 }
 
+IterationResult FitterBase::iterate(std::string const &whatToFit, std::size_t maxSteps, double nSigmaCut,
+                                   bool doRankUpdate, bool doLineSearch, std::string const &dumpMatrixFile,
+                                   std::string const &saveChi2BaseName, std::string const &checkpointFile,
+                                   std::size_t firstStep) {
+    IterationResult iteration;
+    // Run one minimize() and record it.
+    auto runStep = [&](bool rankUpdate, bool lineSearch, std::string const &dumpFile) {
+        auto start = std::chrono::steady_clock::now();
+        iteration.result = minimize(whatToFit, nSigmaCut, rankUpdate, lineSearch, dumpFile);
+        iteration.chi2 = _timedChi2();
+        iteration.steps.push_back({iteration.result, iteration.chi2, _statistics.lastMeasurementOutliers,
+                                   _statistics.lastReferenceOutliers, secondsSince(start)});
+        std::size_t stepNumber = firstStep + iteration.steps.size() - 1;
+        LOGLS_INFO(_log, "iterate step " << stepNumber << ": " << iteration.chi2);
+        if (saveChi2BaseName != "") {
+            std::string baseName = saveChi2BaseName;
+            std::string replaceStr = "{step}";
+            auto pos = baseName.find(replaceStr);
+            if (pos != std::string::npos) {
+                baseName.replace(pos, replaceStr.size(), std::to_string(stepNumber));
+            }
+            saveChi2Contributions(baseName);
+        }
+    };
+
+    for (std::size_t step = firstStep; step < maxSteps; ++step) {
+        std::size_t nDowndates = _statistics.nDowndates;
+        runStep(doRankUpdate, doLineSearch, (step == firstStep) ? dumpMatrixFile : "");
+        // Only the downdates of this last minimize() affect the current factorization.
+        if (iteration.result == MinimizeResult::Converged && _statistics.nDowndates > nDowndates) {
+            if (_control.refitTolerance > 0) {
+                iteration.refitPredictedDecrease = _predictedChi2Decrease();
+                iteration.refit = !(iteration.refitPredictedDecrease <=
+                                    _control.refitTolerance * iteration.chi2.chi2);
+                LOGLS_DEBUG(_log, "fit has converged after rank updates; predicted chi2 decrease of a refit: "
+                                          << iteration.refitPredictedDecrease
+                                          << (iteration.refit ? ", refitting" : ", not refitting"));
+            } else {
+                iteration.refit = true;
+            }
+            if (iteration.refit) {
+                // As in a fresh minimize(): recompute the Hessian, in case the downdates lost accuracy.
+                // The refit may reject more outliers: its result is the one of the step.
+                runStep(true, false, "");
+            }
+        }
+        bool converged = iteration.result == MinimizeResult::Converged;
+        if (converged || iteration.result == MinimizeResult::Chi2Increased) {
+            if (checkpointFile != "" && _control.checkpointInterval > 0 &&
+                (step + 1) % _control.checkpointInterval == 0) {
+                saveCheckpoint(checkpointFile, step + 1);
+            }
+        }
+        if (iteration.result != MinimizeResult::Chi2Increased) {
+            break;
+        } else if (step + 1 < maxSteps) {
+            LOGL_WARN(_log, "still some outliers but chi2 increases - retry");
+        }
+    }
+    return iteration;
+}
+
+double FitterBase::_predictedChi2Decrease() {
+    Eigen::VectorXd grad = Eigen::VectorXd::Zero(_nParTot);
+    GradientOnlyAccumulator accumulator;
+    leastSquareDerivatives(accumulator, grad);
+    // grad is -1/2 the derivative of the chi2: along the step Hessian*delta = grad, the quadratic model of
+    // the chi2 decreases by grad.delta.
+    return grad.dot(_solveStep(grad));
+}
+
+bool FitterBase::_shouldDowndate(std::size_t rank) {
+    if (!_control.adaptiveDowndate) return true;
+    double secondsPerRank;
+    if (_statistics.lastDowndateRank > 0) {
+        // calibrated on the last downdate actually done.
+        secondsPerRank = _statistics.lastDowndateSeconds / _statistics.lastDowndateRank;
+    } else {
+        secondsPerRank = _statistics.lastFactorizationSeconds * _solver->getRelativeDowndateCost();
+    }
+    // Without any estimate, downdate as requested.
+    if (!std::isfinite(secondsPerRank)) return true;
+    _statistics.lastPredictedDowndateSeconds = rank * secondsPerRank;
+    _statistics.lastComparedRefactorizationSeconds = _statistics.lastRefactorizationSeconds;
+    bool downdate = _statistics.lastPredictedDowndateSeconds < _statistics.lastRefactorizationSeconds;
+    LOGLS_DEBUG(_log, "Outlier rank " << rank << ": predicted downdate time "
+                                      << _statistics.lastPredictedDowndateSeconds
+                                      << "s, refactorization time " << _statistics.lastRefactorizationSeconds
+                                      << "s: " << (downdate ? "downdating" : "refactorizing"));
+    return downdate;
+}
+
 void FitterBase::outliersContributions(MeasuredStarList &msOutliers, FittedStarList &fsOutliers,
                                        TripletList &tripletList, Eigen::VectorXd &grad) {
+    // Group the measurement outliers per CcdImage, to compute the derivatives of each CcdImage once.
+    std::vector<CcdImage const *> ccdImages;
+    std::unordered_map<CcdImage const *, MeasuredStarList> outliersPerCcdImage;
     for (auto &outlier : msOutliers) {
-        MeasuredStarList tmp;
-        tmp.push_back(outlier);
-        const CcdImage &ccdImage = outlier->getCcdImage();
-        leastSquareDerivativesMeasurement(ccdImage, tripletList, grad, &tmp);
+        CcdImage const *ccdImage = &outlier->getCcdImage();
+        MeasuredStarList &outliers = outliersPerCcdImage[ccdImage];
+        if (outliers.empty()) ccdImages.push_back(ccdImage);
+        outliers.push_back(outlier);
+    }
+    for (auto const *ccdImage : ccdImages) {
+        leastSquareDerivativesMeasurement(*ccdImage, tripletList, grad, &outliersPerCcdImage[ccdImage]);
     }
     leastSquareDerivativesReference(fsOutliers, tripletList, grad);
 }
 
 void FitterBase::removeMeasOutliers(MeasuredStarList &outliers) {
+    std::unordered_set<CcdImage const *> ccdImages;
     for (auto &measuredStar : outliers) {
         auto fittedStar = measuredStar->getFittedStar();
         measuredStar->setValid(false);
         fittedStar->getMeasurementCount()--;  // could be put in setValid
+        ccdImages.insert(&measuredStar->getCcdImage());
+    }
+    for (auto const &ccdImage : _associations->getCcdImageList()) {
+        if (ccdImages.count(ccdImage.get())) ccdImage->updateMeasurementValidity();
     }
 }
 
@@ -314,14 +677,40 @@ void FitterBase::removeRefOutliers(FittedStarList &outliers) {
     }
 }
 
-void FitterBase::leastSquareDerivatives(TripletList &tripletList, Eigen::VectorXd &grad) const {
-    auto ccdImageList = _associations->getCcdImageList();
-    for (auto const &ccdImage : ccdImageList) {
-        leastSquareDerivativesMeasurement(*ccdImage, tripletList, grad);
+void FitterBase::leastSquareDerivatives(JacobianAccumulator &accumulator, Eigen::VectorXd &grad,
+                                        Eigen::VectorXd const *offset) const {
+    auto const &ccdImageList = _associations->getCcdImageList();
+    std::size_t nThreads = _getNThreads();
+    if (nThreads <= 1 || ccdImageList.size() <= 1) {
+        for (auto const &ccdImage : ccdImageList) {
+            leastSquareDerivativesMeasurement(*ccdImage, accumulator, grad, nullptr, offset);
+        }
+    } else {
+        // Each thread fills its own accumulator and gradient from a contiguous range of ccdImages;
+        // merging them in order gives the same Jacobian as the serial loop.
+        auto chunks = splitCcdImageList(ccdImageList, nThreads);
+        std::vector<std::unique_ptr<JacobianAccumulator>> accumulators;
+        std::vector<Eigen::VectorXd> grads;
+        for (std::size_t i = 0; i < chunks.size(); ++i) {
+            accumulators.push_back(accumulator.makeEmptyClone());
+            grads.push_back(Eigen::VectorXd::Zero(grad.size()));
+        }
+        runInThreads(chunks.size(), [&](std::size_t i) {
+            for (auto const &ccdImage : chunks[i]) {
+                leastSquareDerivativesMeasurement(*ccdImage, *accumulators[i], grads[i], nullptr, offset);
+            }
+        });
+        for (std::size_t i = 0; i < chunks.size(); ++i) {
+            accumulator.merge(*accumulators[i]);
+            accumulators[i].reset();
+            grad += grads[i];
+        }
     }
-    leastSquareDerivativesReference(_associations->fittedStarList, tripletList, grad);
+    leastSquareDerivativesReference(_associations->fittedStarList, accumulator, grad, offset);
 }
 
+std::size_t FitterBase::_getNThreads() const { return getNThreads(_control.nThreads); }
+
 void FitterBase::saveChi2Contributions(std::string const &baseName) const {
     std::string replaceStr = "{type}";
     auto pos = baseName.find(replaceStr);
@@ -333,20 +722,534 @@ void FitterBase::saveChi2Contributions(std::string const &baseName) const {
     saveChi2RefContributions(refFilename);
 }
 
-double FitterBase::_lineSearch(Eigen::VectorXd const &delta) {
-    auto func = [this, &delta](double scale) {
-        auto offset = scale * delta;
-        offsetParams(offset);
-        auto chi2 = computeChi2();
-        // reset the system to where it was before offsetting.
-        offsetParams(-offset);
-        return chi2.chi2;
-    };
-    // The maximum theoretical precision is half the number of bits in the mantissa (see boost docs).
-    auto bits = std::numeric_limits<double>::digits / 2;
-    auto result = boost::math::tools::brent_find_minima(func, -1.0, 2.0, bits);
-    LOGLS_DEBUG(_log, "Line search scale factor: " << result.first);
-    return result.first;
+namespace {
+char const checkpointMagic[8] = {'J', 'C', 'C', 'H', 'E', 'C', 'K', 'P'};
+std::uint32_t const checkpointByteOrderMark = 0x01020304;
+std::uint32_t const checkpointVersion = 1;
+// A few keywords: a longer whatToFit size only comes from a corrupted file.
+std::uint64_t const maxCheckpointWhatToFitSize = 1024;
+
+/// The state of a FittedStar saved in a checkpoint.
+struct FittedStarRecord {
+    double x, y, vx, vy, vxy;
+    double flux, fluxErr, mag, magErr;
+    double pmx, pmy, epmx, epmy, epmxy, color;
+    std::int64_t measurementCount;
+    std::int64_t refStarIndex;  // in Associations::refStarList, -1 if none.
+};
+static_assert(sizeof(FittedStarRecord) == 17 * 8, "the checkpoint records must not be padded");
+
+template <typename T>
+void writeCheckpointArray(std::ostream &stream, T const *data, std::size_t size) {
+    stream.write(reinterpret_cast<char const *>(data), size * sizeof(T));
+}
+
+template <typename T>
+void readCheckpointArray(std::istream &stream, T *data, std::size_t size, std::string const &path) {
+    stream.read(reinterpret_cast<char *>(data), size * sizeof(T));
+    if (!stream) {
+        throw LSST_EXCEPT(pex::exceptions::IoError, "Truncated checkpoint file: " + path);
+    }
+}
+
+/// Read a size written as uint64, and check that it is the expected one.
+void readCheckpointSize(std::istream &stream, std::uint64_t expected, std::string const &what,
+                        std::string const &path) {
+    std::uint64_t size;
+    readCheckpointArray(stream, &size, 1, path);
+    if (size != expected) {
+        throw LSST_EXCEPT(pex::exceptions::LengthError,
+                          "Checkpoint " + path + " does not match this fit: it has " + std::to_string(size) +
+                                  " " + what + ", instead of " + std::to_string(expected));
+    }
+}
+}  // namespace
+
+void FitterBase::saveCheckpoint(std::string const &path, std::size_t step) const {
+    // Written to a temporary file first, so that an interrupted write does not destroy the last checkpoint.
+    std::string tmpPath = path + ".tmp";
+    std::ofstream file(tmpPath, std::ios::binary);
+
+    writeCheckpointArray(file, checkpointMagic, sizeof(checkpointMagic));
+    writeCheckpointArray(file, &checkpointByteOrderMark, 1);
+    writeCheckpointArray(file, &checkpointVersion, 1);
+    std::uint64_t size = step;
+    writeCheckpointArray(file, &size, 1);
+    size = _whatToFit.size();
+    writeCheckpointArray(file, &size, 1);
+    writeCheckpointArray(file, _whatToFit.data(), _whatToFit.size());
+
+    Eigen::VectorXd parameters = getModelParameters();
+    size = parameters.size();
+    writeCheckpointArray(file, &size, 1);
+    writeCheckpointArray(file, parameters.data(), parameters.size());
+
+    auto const &ccdImageList = _associations->getCcdImageList();
+    size = ccdImageList.size();
+    writeCheckpointArray(file, &size, 1);
+    std::vector<std::uint8_t> valid;
+    for (auto const &ccdImage : ccdImageList) {
+        auto const &catalog = ccdImage->getCatalogForFit();
+        valid.clear();
+        for (auto const &measuredStar : catalog) valid.push_back(measuredStar->isValid());
+        size = valid.size();
+        writeCheckpointArray(file, &size, 1);
+        writeCheckpointArray(file, valid.data(), valid.size());
+    }
+
+    std::unordered_map<RefStar const *, std::int64_t> refStarIndices;
+    for (auto const &refStar : _associations->refStarList) {
+        refStarIndices.emplace(refStar.get(), refStarIndices.size());
+    }
+    size = refStarIndices.size();
+    writeCheckpointArray(file, &size, 1);
+    size = _associations->fittedStarList.size();
+    writeCheckpointArray(file, &size, 1);
+    for (auto const &fittedStar : _associations->fittedStarList) {
+        FittedStarRecord record{fittedStar->x,        fittedStar->y,          fittedStar->vx,
+                                fittedStar->vy,       fittedStar->vxy,        fittedStar->getFlux(),
+                                fittedStar->getFluxErr(), fittedStar->getMag(), fittedStar->getMagErr(),
+                                fittedStar->pmx,      fittedStar->pmy,        fittedStar->epmx,
+                                fittedStar->epmy,     fittedStar->epmxy,      fittedStar->color,
+                                fittedStar->getMeasurementCount(), -1};
+        if (fittedStar->getRefStar() != nullptr) {
+            record.refStarIndex = refStarIndices.at(fittedStar->getRefStar());
+        }
+        writeCheckpointArray(file, &record, 1);
+    }
+
+    file.close();
+    if (!file || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        throw LSST_EXCEPT(pex::exceptions::IoError, "Cannot write checkpoint file: " + path);
+    }
+    LOGLS_DEBUG(_log, "Wrote checkpoint of step " << step << " to: " << path);
+}
+
+std::size_t FitterBase::loadCheckpoint(std::string const &path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw LSST_EXCEPT(pex::exceptions::IoError, "Cannot open checkpoint file: " + path);
+    }
+    char magic[sizeof(checkpointMagic)];
+    readCheckpointArray(file, magic, sizeof(magic), path);
+    std::uint32_t byteOrderMark, version;
+    readCheckpointArray(file, &byteOrderMark, 1, path);
+    readCheckpointArray(file, &version, 1, path);
+    if (std::memcmp(magic, checkpointMagic, sizeof(magic)) != 0 || byteOrderMark != checkpointByteOrderMark ||
+        version != checkpointVersion) {
+        throw LSST_EXCEPT(pex::exceptions::IoError, "Not a jointcal checkpoint file, or from another version "
+                                                    "or machine: " + path);
+    }
+
+    // Read and check everything before modifying anything. Nothing is allocated from a size read from the
+    // file before it is checked.
+    std::uint64_t step, size;
+    readCheckpointArray(file, &step, 1, path);
+    readCheckpointArray(file, &size, 1, path);
+    if (size > maxCheckpointWhatToFitSize) {
+        throw LSST_EXCEPT(pex::exceptions::IoError, "Corrupted whatToFit in checkpoint: " + path);
+    }
+    std::string whatToFit(size, ' ');
+    readCheckpointArray(file, &whatToFit[0], size, path);
+
+    Eigen::VectorXd parameters(getModelParameters().size());
+    readCheckpointSize(file, parameters.size(), "model parameters", path);
+    readCheckpointArray(file, parameters.data(), parameters.size(), path);
+
+    auto const &ccdImageList = _associations->getCcdImageList();
+    readCheckpointSize(file, ccdImageList.size(), "ccdImages", path);
+    std::vector<std::vector<std::uint8_t>> valid;
+    for (auto const &ccdImage : ccdImageList) {
+        valid.emplace_back(ccdImage->getCatalogForFit().size());
+        readCheckpointSize(file, valid.back().size(), "measured stars in " + ccdImage->getName(), path);
+        readCheckpointArray(file, valid.back().data(), valid.back().size(), path);
+    }
+
+    std::vector<RefStar const *> refStars;
+    for (auto const &refStar : _associations->refStarList) refStars.push_back(refStar.get());
+    readCheckpointSize(file, refStars.size(), "reference stars", path);
+    readCheckpointSize(file, _associations->fittedStarList.size(), "fitted stars", path);
+    std::vector<FittedStarRecord> records(_associations->fittedStarList.size());
+    readCheckpointArray(file, records.data(), records.size(), path);
+    for (auto const &record : records) {
+        if (record.refStarIndex < -1 || record.refStarIndex >= static_cast<std::int64_t>(refStars.size())) {
+            throw LSST_EXCEPT(pex::exceptions::IoError,
+                              "Corrupted reference star index in checkpoint: " + path);
+        }
+    }
+
+    // Throws, without modifying the model, if the parameters do not match it.
+    setModelParameters(parameters);
+
+    auto validIt = valid.begin();
+    for (auto const &ccdImage : ccdImageList) {
+        auto flagIt = validIt->begin();
+        for (auto const &measuredStar : ccdImage->getCatalogForFit()) measuredStar->setValid(*flagIt++);
+        ccdImage->updateMeasurementValidity();
+        ++validIt;
+    }
+    auto recordIt = records.begin();
+    for (auto const &fittedStar : _associations->fittedStarList) {
+        auto const &record = *recordIt++;
+        fittedStar->x = record.x;
+        fittedStar->y = record.y;
+        fittedStar->vx = record.vx;
+        fittedStar->vy = record.vy;
+        fittedStar->vxy = record.vxy;
+        fittedStar->setFlux(record.flux);
+        fittedStar->setFluxErr(record.fluxErr);
+        fittedStar->getMag() = record.mag;
+        fittedStar->setMagErr(record.magErr);
+        fittedStar->pmx = record.pmx;
+        fittedStar->pmy = record.pmy;
+        fittedStar->epmx = record.epmx;
+        fittedStar->epmy = record.epmy;
+        fittedStar->epmxy = record.epmxy;
+        fittedStar->color = record.color;
+        fittedStar->getMeasurementCount() = record.measurementCount;
+        fittedStar->setRefStar(nullptr);  // setRefStar() does not replace an association.
+        if (record.refStarIndex >= 0) fittedStar->setRefStar(refStars[record.refStarIndex]);
+    }
+
+    if (!whatToFit.empty()) assignIndices(whatToFit);
+    _hessianPattern.clear();
+    prepareMeasurementTerms();
+    LOGLS_INFO(_log, "Loaded checkpoint of step " << step << " from: " << path);
+    return step;
+}
+
+bool FitterBase::_prepareSolve(Eigen::VectorXd &grad, std::string const &dumpMatrixFile) {
+    if (_control.conjugateGradient) {
+        if (dumpMatrixFile != "") {
+            LOGLS_WARN(_log, "The conjugate gradient solver does not build the Hessian: cannot dump it.");
+        }
+        _computePreconditioner(grad);
+        return true;
+    }
+
+    SparseMatrixD hessian = _computeHessian(grad);
+
+    LOGLS_DEBUG(_log, "Starting factorization, hessian: dim="
+                              << hessian.rows() << " non-zeros=" << hessian.nonZeros()
+                              << " filling-frac = " << hessian.nonZeros() / std::pow(hessian.rows(), 2));
+
+    if (dumpMatrixFile != "") {
+        dumpMatrixAndGradient(hessian, grad, dumpMatrixFile, _control.dumpMatrixFormat, _log);
+    }
+
+    if (_control.levenbergMarquardt) {
+        _hessian = std::move(hessian);
+        return _factorizeDamped();
+    }
+    PhaseTimer timer(_timings.factorization);
+    return _solver->factorize(hessian, _statistics);
+}
+
+bool FitterBase::_factorizeDamped() {
+    PhaseTimer timer(_timings.factorization);
+    // Only the diagonal changes with the damping: the pattern, and so the symbolic analysis, is the same.
+    SparseMatrixD damped = _hessian;
+    for (Eigen::Index j = 0; j < damped.outerSize(); ++j) {
+        for (SparseMatrixD::InnerIterator it(damped, j); it; ++it) {
+            if (it.row() == j) it.valueRef() *= 1 + _damping;
+        }
+    }
+    return _solver->factorize(damped, _statistics);
+}
+
+bool FitterBase::_dampedStep(Eigen::VectorXd const &grad, double chi2) {
+    double growth = 2;  // how much to increase the damping at the next rejected step
+    for (int trial = 0; trial < _control.levenbergMarquardtMaxTrials; ++trial) {
+        // The first trial uses the current factorization, computed (or downdated) with the current damping.
+        if (trial > 0 && !_factorizeDamped()) return false;
+        Eigen::VectorXd delta;
+        {
+            PhaseTimer timer(_timings.solve);
+            delta = _solver->solve(grad);
+        }
+        // decrease of the quadratic model of the chi2: 2*grad.delta - delta^T*H*delta
+        Eigen::VectorXd hessianDelta = _hessian.selfadjointView<Eigen::Lower>() * delta;
+        double predicted = 2 * grad.dot(delta) - delta.dot(hessianDelta);
+        double actual = chi2 - _timedChi2(delta).chi2;
+        double ratio = actual / predicted;
+        ++_statistics.nDampedSteps;
+        _statistics.lastDampingFactor = _damping;
+        _statistics.lastDampingRatio = ratio;
+        LOGLS_DEBUG(_log, "Levenberg-Marquardt step with lambda=" << _damping << ": chi2 decrease "
+                                                                  << actual << ", predicted " << predicted);
+        if (predicted <= _control.levenbergMarquardtTolerance * chi2) {
+            // Converged: more damping would only make the step smaller.
+            if (actual >= 0) offsetParams(delta);
+            return true;
+        }
+        if (ratio > 0) {
+            offsetParams(delta);
+            // Nielsen's update: less damping the better the quadratic model predicted the decrease.
+            _damping *= std::max(1.0 / 3, 1 - std::pow(2 * ratio - 1, 3));
+            return true;
+        }
+        ++_statistics.nRejectedDampedSteps;
+        _damping *= growth;
+        growth *= 2;
+    }
+    LOGLS_WARN(_log, "No Levenberg-Marquardt step decreased the chi2 after "
+                             << _control.levenbergMarquardtMaxTrials << " trials; keeping the parameters");
+    return true;
+}
+
+Eigen::VectorXd FitterBase::_solveStep(Eigen::VectorXd const &grad) {
+    PhaseTimer timer(_timings.solve);
+    if (_control.conjugateGradient) {
+        return _solveConjugateGradient(grad);
+    }
+    return _solver->solve(grad);
+}
+
+std::vector<ParameterBlock> FitterBase::_getPreconditionerBlocks() const {
+    std::vector<ParameterBlock> blocks = getEliminableBlocks();
+    // The parameters of each elementary mapping are contiguous, but the index ranges of the mappings
+    // composing the mapping of a CcdImage (e.g. chip and visit) may be adjacent: a mapping boundary is
+    // any place where some CcdImage's indices start or stop being consecutive.
+    std::vector<bool> inMapping(_nParTot, false);
+    std::vector<bool> startsBlock(_nParTot + 1, false);
+    IndexVector indices;
+    for (auto const &ccdImage : _associations->getCcdImageList()) {
+        getIndicesOfMapping(*ccdImage, indices);
+        for (std::size_t k = 0; k < indices.size(); ++k) {
+            inMapping[indices[k]] = true;
+            if (k == 0 || indices[k - 1] != indices[k] - 1) startsBlock[indices[k]] = true;
+            if (k + 1 == indices.size() || indices[k + 1] != indices[k] + 1) {
+                startsBlock[indices[k] + 1] = true;
+            }
+        }
+    }
+    for (Eigen::Index i = 0; i < _nParTot; ++i) {
+        if (!inMapping[i]) continue;
+        if (startsBlock[i] || i == 0 || !inMapping[i - 1]) {
+            blocks.push_back({i, 1});
+        } else {
+            blocks.back().size++;
+        }
+    }
+    return blocks;
+}
+
+void FitterBase::_computePreconditioner(Eigen::VectorXd &grad) {
+    _preconditioner.reset(new BlockJacobiPreconditioner(_nParTot, _getPreconditionerBlocks()));
+    leastSquareDerivatives(*_preconditioner, grad);
+    std::size_t nFailed = _preconditioner->invert();
+    if (nFailed > 0) {
+        LOGLS_WARN(_log, nFailed << " blocks of the preconditioner are not positive definite; using their "
+                                    "diagonal instead");
+    }
+}
+
+Eigen::VectorXd FitterBase::_hessianProduct(Eigen::VectorXd const &vector) const {
+    HessianProductAccumulator accumulator(vector);
+    Eigen::VectorXd grad = Eigen::VectorXd::Zero(_nParTot);  // not needed here
+    leastSquareDerivatives(accumulator, grad);
+    return accumulator.getProduct();
+}
+
+Eigen::VectorXd FitterBase::_solveConjugateGradient(Eigen::VectorXd const &grad) {
+    Eigen::VectorXd solution = Eigen::VectorXd::Zero(_nParTot);
+    Eigen::VectorXd residual = grad;
+    double const gradNorm = grad.norm();
+    double residualNorm = gradNorm;
+    std::size_t iteration = 0;
+    if (gradNorm > 0) {
+        Eigen::VectorXd preconditioned = _preconditioner->apply(residual);
+        Eigen::VectorXd direction = preconditioned;
+        double product = residual.dot(preconditioned);
+        while (residualNorm > _control.conjugateGradientTolerance * gradNorm &&
+               iteration < static_cast<std::size_t>(_control.conjugateGradientMaxIterations)) {
+            Eigen::VectorXd hessianDirection = _hessianProduct(direction);
+            double curvature = direction.dot(hessianDirection);
+            if (!(curvature > 0)) {
+                LOGLS_WARN(_log, "Conjugate gradient: non-positive curvature " << curvature
+                                                                              << ", stopping.");
+                break;
+            }
+            double alpha = product / curvature;
+            solution += alpha * direction;
+            residual -= alpha * hessianDirection;
+            residualNorm = residual.norm();
+            ++iteration;
+            preconditioned = _preconditioner->apply(residual);
+            double newProduct = residual.dot(preconditioned);
+            direction = preconditioned + (newProduct / product) * direction;
+            product = newProduct;
+        }
+    }
+    double relativeResidual = (gradNorm > 0) ? residualNorm / gradNorm : 0;
+    _statistics.nConjugateGradientIterations += iteration;
+    _statistics.lastConjugateGradientIterations = iteration;
+    _statistics.lastConjugateGradientResidual = relativeResidual;
+    if (relativeResidual > _control.conjugateGradientTolerance) {
+        LOGLS_WARN(_log, "Conjugate gradient did not converge: relative residual " << relativeResidual
+                                                                                  << " after " << iteration
+                                                                                  << " iterations");
+    } else {
+        LOGLS_DEBUG(_log, "Conjugate gradient converged: relative residual " << relativeResidual << " after "
+                                                                            << iteration << " iterations");
+    }
+    return solution;
+}
+
+SparseMatrixD FitterBase::_computeHessian(Eigen::VectorXd &grad) {
+    // TODO : write a guesser for the number of triplets
+    std::size_t nTrip = (_lastNTrip) ? _lastNTrip : 1e6;
+    if (_control.assembleNormalEquations) {
+        // The entries already in the last Hessian are summed in place: only new ones need triplets.
+        bool const hasPattern = !_hessianPattern.empty() && _hessianPattern.getRows() == _nParTot;
+        HessianAccumulator hessianAccumulator(_nParTot, hasPattern ? 0 : nTrip, &_hessianPattern);
+        {
+            PhaseTimer timer(_timings.tripletFill);
+            leastSquareDerivatives(hessianAccumulator, grad);
+        }
+        _statistics.lastHessianTriplets = hessianAccumulator.size();
+        if (!hasPattern) _lastNTrip = hessianAccumulator.size();
+        LOGLS_DEBUG(_log, "End of normal equations filling, ntrip = " << hessianAccumulator.size());
+        PhaseTimer timer(_timings.hessianBuild);
+        SparseMatrixD hessian = hessianAccumulator.makeHessian();
+        if (!hasPattern || _statistics.lastHessianTriplets > 0) _hessianPattern.reset(hessian);
+        return hessian;
+    } else {
+        CompactJacobian jacobian(_nParTot, nTrip);
+        {
+            PhaseTimer timer(_timings.tripletFill);
+            leastSquareDerivatives(jacobian, grad);
+        }
+        _lastNTrip = jacobian.size();
+        LOGLS_DEBUG(_log, "End of Jacobian filling, non-zeros = " << jacobian.size());
+        PhaseTimer timer(_timings.hessianBuild);
+        return jacobian.makeHessian();
+    }
+}
+
+double FitterBase::_lineSearch(Eigen::VectorXd const &delta, Eigen::VectorXd const &grad,
+                               double startChi2) {
+    PhaseTimer timer(_timings.lineSearch);
+    ++_statistics.nLineSearches;
+    double scale;
+    if (_control.lineSearchMethod == "model") {
+        scale = _modelLineSearch(delta, grad, startChi2);
+    } else {
+        std::size_t nEvaluations = 0;
+        auto func = [this, &delta, &nEvaluations](double scale) {
+            ++nEvaluations;
+            return _timedChi2(scale * delta).chi2;
+        };
+        // The maximum theoretical precision is half the number of bits in the mantissa (see boost docs).
+        auto bits = std::numeric_limits<double>::digits / 2;
+        auto result = boost::math::tools::brent_find_minima(func, -1.0, 2.0, bits);
+        scale = result.first;
+        _statistics.nLineSearchChi2Evaluations += nEvaluations;
+        LOGLS_DEBUG(_log, "Line search: " << nEvaluations << " chi2 evaluations");
+    }
+    _statistics.lastLineSearchScale = scale;
+    LOGLS_DEBUG(_log, "Line search scale factor: " << scale);
+    return scale;
+}
+
+double FitterBase::_slopeAtOffset(Eigen::VectorXd const &offset, Eigen::VectorXd const &delta) const {
+    // the parameters (and what is cached from them) are left untouched, as in computeChi2(offset).
+    GradientOnlyAccumulator accumulator;
+    Eigen::VectorXd grad = Eigen::VectorXd::Zero(_nParTot);
+    leastSquareDerivatives(accumulator, grad, &offset);
+    // grad is -1/2 the derivative of the chi2.
+    return -2 * grad.dot(delta);
+}
+
+double FitterBase::_modelLineSearch(Eigen::VectorXd const &delta, Eigen::VectorXd const &grad,
+                                    double startChi2) {
+    // Along delta, the quadratic model of the chi2 built from the gradient and the Hessian is
+    // phi(alpha) = phi(0) - 2*alpha*grad.delta + alpha^2*delta.Hessian.delta, and Hessian*delta = grad, so
+    // that its minimum is at alpha=1. The trial steps are checked against the real chi2, and refined
+    // by interpolation if needed.
+    double const slope0 = -2 * grad.dot(delta);
+    if (!(slope0 < 0)) {
+        LOGLS_WARN(_log, "Line search: the step is not a descent direction (slope " << slope0
+                                                                                  << "); not searching.");
+        return 1.0;
+    }
+    double const armijo = _control.lineSearchArmijo;
+    double const wolfe = _control.lineSearchWolfe;
+    std::size_t nChi2 = 0;
+    std::size_t nGradient = 0;
+    if (!std::isfinite(startChi2)) {
+        startChi2 = _timedChi2().chi2;
+        ++nChi2;
+    }
+
+    // The trial steps, and the chi2 there.
+    std::vector<double> alphas;
+    std::vector<double> chi2s;
+    double alpha = 1.0;
+    double accepted = std::numeric_limits<double>::quiet_NaN();
+    while (true) {
+        double chi2 = _timedChi2(alpha * delta).chi2;
+        ++nChi2;
+        alphas.push_back(alpha);
+        chi2s.push_back(chi2);
+        bool sufficientDecrease = chi2 <= startChi2 + armijo * alpha * slope0;
+
+        double next;
+        if (sufficientDecrease) {
+            if (wolfe <= 0) {
+                accepted = alpha;
+                break;
+            }
+            double slope = _slopeAtOffset(alpha * delta, delta);
+            ++nGradient;
+            if (std::abs(slope) <= wolfe * std::abs(slope0)) {
+                accepted = alpha;
+                break;
+            }
+            // Secant on the slope: beyond alpha if still going down, before it otherwise.
+            next = alpha * slope0 / (slope0 - slope);
+            next = (slope < 0) ? std::min(std::max(next, 1.1 * alpha), 4 * alpha)
+                               : std::min(std::max(next, 0.1 * alpha), 0.9 * alpha);
+        } else {
+            // Backtrack to the minimum of the quadratic (first step) or cubic interpolating the chi2.
+            std::size_t n = alphas.size();
+            double a1 = alphas[n - 1];
+            double f1 = chi2s[n - 1] - startChi2 - slope0 * a1;
+            if (n == 1) {
+                next = -slope0 * a1 * a1 / (2 * f1);
+            } else {
+                double a0 = alphas[n - 2];
+                double f0 = chi2s[n - 2] - startChi2 - slope0 * a0;
+                double denominator = a0 * a0 * a1 * a1 * (a1 - a0);
+                double a = (a0 * a0 * f1 - a1 * a1 * f0) / denominator;
+                double b = (-a0 * a0 * a0 * f1 + a1 * a1 * a1 * f0) / denominator;
+                double discriminant = b * b - 3 * a * slope0;
+                if (a == 0) {
+                    next = -slope0 / (2 * b);
+                } else if (discriminant >= 0) {
+                    next = (-b + std::sqrt(discriminant)) / (3 * a);
+                } else {
+                    next = 0.5 * a1;
+                }
+            }
+            if (!std::isfinite(next)) next = 0.5 * alpha;
+            next = std::min(std::max(next, 0.1 * alpha), 0.5 * alpha);
+        }
+        if (nChi2 >= static_cast<std::size_t>(_control.lineSearchMaxEvaluations)) break;
+        alpha = next;
+    }
+
+    if (std::isnan(accepted)) {
+        // Out of evaluations: take the best step tried.
+        auto best = std::min_element(chi2s.begin(), chi2s.end()) - chi2s.begin();
+        accepted = alphas[best];
+        LOGLS_WARN(_log, "Line search: no step satisfied the conditions after "
+                                 << nChi2 << " chi2 evaluations; using the best one: " << accepted);
+    }
+    _statistics.nLineSearchChi2Evaluations += nChi2;
+    _statistics.nLineSearchGradientEvaluations += nGradient;
+    LOGLS_DEBUG(_log, "Line search: " << nChi2 << " chi2 and " << nGradient << " gradient evaluations");
+    return accepted;
 }
 
 }  // namespace jointcal
@@ -0,0 +1,151 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cassert>
+
+#include "lsst/jointcal/HessianAccumulator.h"
+
+namespace lsst {
+namespace jointcal {
+
+namespace {
+bool isZeroRow(Eigen::Ref<Eigen::MatrixXd const> const &jacobian, Eigen::Index row) {
+    return (jacobian.row(row).array() == 0).all();
+}
+}  // namespace
+
+HessianAccumulator::HessianAccumulator(Eigen::Index nParTot, std::size_t count,
+                                       SparsityPattern const *pattern)
+        : _nParTot(nParTot), _pattern(nullptr) {
+    if (pattern && !pattern->empty() && pattern->getRows() == nParTot && pattern->getCols() == nParTot) {
+        _pattern = pattern;
+        _values.assign(pattern->getNonZeros(), 0.);
+    }
+    _triplets.reserve(count);
+}
+
+void HessianAccumulator::addTerm(IndexVector const &indices,
+                                 Eigen::Ref<Eigen::MatrixXd const> const &jacobian) {
+    Eigen::Index nShared = _sharedIndices.size();
+    Eigen::Index nRows = jacobian.rows();
+    assert(nShared <= nRows);
+
+    if (nShared > 0) {
+        _sharedBlock.selfadjointView<Eigen::Lower>().rankUpdate(jacobian.topRows(nShared));
+    }
+    for (Eigen::Index k = nShared; k < nRows; ++k) {
+        if (isZeroRow(jacobian, k)) continue;
+        Eigen::Index row = indices[k];
+        // products with the shared parameters
+        for (Eigen::Index l = 0; l < nShared; ++l) {
+            double val = jacobian.row(k).dot(jacobian.row(l));
+            if (val != 0) addLower(row, _sharedIndices[l], val);
+        }
+        // products between the parameters private to this term, diagonal included
+        for (Eigen::Index l = nShared; l <= k; ++l) {
+            if (l < k && isZeroRow(jacobian, l)) continue;
+            double val = jacobian.row(k).dot(jacobian.row(l));
+            if (val == 0) continue;
+            // two rows of the term may refer to the same parameter: the transposed product then lands
+            // on the same (diagonal) entry.
+            if (l < k && indices[l] == row) val *= 2;
+            addLower(row, indices[l], val);
+        }
+    }
+}
+
+void HessianAccumulator::beginSharedBlock(IndexVector const &indices) {
+    _sharedIndices = indices;
+    _sharedBlock.setZero(indices.size(), indices.size());
+}
+
+void HessianAccumulator::endSharedBlock() {
+    Eigen::Index nShared = _sharedIndices.size();
+    for (Eigen::Index j = 0; j < nShared; ++j) {
+        for (Eigen::Index i = j; i < nShared; ++i) {
+            double val = _sharedBlock(i, j);
+            if (val != 0) addLower(_sharedIndices[i], _sharedIndices[j], val);
+        }
+    }
+    _sharedIndices.clear();
+}
+
+std::unique_ptr<JacobianAccumulator> HessianAccumulator::makeEmptyClone() const {
+    return std::unique_ptr<JacobianAccumulator>(new HessianAccumulator(_nParTot, 0, _pattern));
+}
+
+void HessianAccumulator::merge(JacobianAccumulator &other) {
+    auto &otherAccumulator = dynamic_cast<HessianAccumulator &>(other);
+    assert(_sharedIndices.empty() && otherAccumulator._sharedIndices.empty());
+    _triplets.insert(_triplets.end(), otherAccumulator._triplets.begin(), otherAccumulator._triplets.end());
+    std::vector<Trip>().swap(otherAccumulator._triplets);
+    for (std::size_t k = 0; k < _values.size(); ++k) _values[k] += otherAccumulator._values[k];
+    std::vector<double>().swap(otherAccumulator._values);
+}
+
+SparseMatrixD HessianAccumulator::makeHessian() {
+    SparseMatrixD hessian(_nParTot, _nParTot);
+    hessian.setFromTriplets(_triplets.begin(), _triplets.end());
+    // release the memory now rather than when we go out of scope.
+    std::vector<Trip>().swap(_triplets);
+    if (_pattern) {
+        // the entries that vanished since the pattern was recorded (e.g. of outliers) stay as explicit
+        // zeros, so that the symbolic analysis of the pattern can be reused.
+        SparseMatrixD summed = _pattern->makeMatrix(_values);
+        std::vector<double>().swap(_values);
+        if (hessian.nonZeros() == 0) return summed;
+        hessian += summed;
+    }
+    return hessian;
+}
+
+HessianProductAccumulator::HessianProductAccumulator(Eigen::VectorXd const &vector)
+        : _vector(vector), _product(Eigen::VectorXd::Zero(vector.size())) {}
+
+void HessianProductAccumulator::addTerm(IndexVector const &indices,
+                                        Eigen::Ref<Eigen::MatrixXd const> const &jacobian) {
+    // J_t^T*v, one value per column of the term; zero rows may have stale indices.
+    Eigen::VectorXd projection = Eigen::VectorXd::Zero(jacobian.cols());
+    for (Eigen::Index k = 0; k < jacobian.rows(); ++k) {
+        if (isZeroRow(jacobian, k)) continue;
+        projection += jacobian.row(k).transpose() * _vector(indices[k]);
+    }
+    for (Eigen::Index k = 0; k < jacobian.rows(); ++k) {
+        if (isZeroRow(jacobian, k)) continue;
+        _product(indices[k]) += jacobian.row(k).dot(projection);
+    }
+}
+
+std::unique_ptr<JacobianAccumulator> HessianProductAccumulator::makeEmptyClone() const {
+    return std::unique_ptr<JacobianAccumulator>(new HessianProductAccumulator(_vector));
+}
+
+void HessianProductAccumulator::merge(JacobianAccumulator &other) {
+    auto &otherAccumulator = dynamic_cast<HessianProductAccumulator &>(other);
+    _product += otherAccumulator._product;
+    Eigen::VectorXd().swap(otherAccumulator._product);
+}
+
+}  // namespace jointcal
+}  // namespace lsst
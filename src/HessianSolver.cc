@@ -0,0 +1,494 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#include "lsst/log/Log.h"
+#include "lsst/pex/exceptions.h"
+
+#include "lsst/jointcal/HessianSolver.h"
+#include "lsst/jointcal/SchurComplementSolver.h"
+#include "lsst/jointcal/SparsityPattern.h"
+
+namespace lsst {
+namespace jointcal {
+
+namespace {
+LOG_LOGGER _log = LOG_GET("jointcal.HessianSolver");
+
+/// The cholmod ordering method of an ordering name of makeHessianSolver(), or -1 for the default strategy.
+int getCholmodOrdering(std::string const &ordering) {
+    if (ordering == "default") return -1;
+    if (ordering == "amd") return CHOLMOD_AMD;
+    if (ordering == "colamd") return CHOLMOD_COLAMD;
+    if (ordering == "metis") return CHOLMOD_METIS;
+    if (ordering == "nesdis") return CHOLMOD_NESDIS;
+    if (ordering == "natural") return CHOLMOD_NATURAL;
+    throw LSST_EXCEPT(pex::exceptions::InvalidParameterError,
+                      "Unknown ordering: " + ordering +
+                              ", must be default, amd, colamd, metis, nesdis or natural");
+}
+
+/// The name of a cholmod ordering method.
+std::string getOrderingName(int ordering) {
+    switch (ordering) {
+        case CHOLMOD_NATURAL:
+            return "natural";
+        case CHOLMOD_GIVEN:
+            return "given";
+        case CHOLMOD_AMD:
+            return "amd";
+        case CHOLMOD_METIS:
+            return "metis";
+        case CHOLMOD_NESDIS:
+            return "nesdis";
+        case CHOLMOD_COLAMD:
+            return "colamd";
+        case CHOLMOD_POSTORDERED:
+            return "postordered";
+    }
+    return "unknown";
+}
+
+/*
+ * The ordering cache files hold, in native byte order: the magic string "JCORDER1", the number of rows and
+ * of non-zeros of the lower triangle of the Hessian (int64 each), then the permutation (int64 each row).
+ */
+char const orderingMagic[8] = {'J', 'C', 'O', 'R', 'D', 'E', 'R', '1'};
+
+/**
+ * Read the ordering of hessian from a cache file.
+ *
+ * @return false, leaving permutation unspecified, if there is no such file, or if it does not match hessian.
+ */
+bool readCachedOrdering(std::string const &path, SparseMatrixD const &hessian,
+                        std::vector<Eigen::Index> &permutation) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+    char magic[8];
+    std::int64_t sizes[2];
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char *>(sizes), sizeof(sizes));
+    if (!file || std::memcmp(magic, orderingMagic, sizeof(magic)) != 0 || sizes[0] != hessian.rows() ||
+        sizes[1] != hessian.nonZeros()) {
+        LOGLS_WARN(_log, "Ignoring the ordering cache file " << path << ", which does not match the Hessian");
+        return false;
+    }
+    permutation.resize(hessian.rows());
+    file.read(reinterpret_cast<char *>(permutation.data()), permutation.size() * sizeof(Eigen::Index));
+    // Only a valid permutation can be given to cholmod.
+    std::vector<bool> seen(permutation.size(), false);
+    for (auto const row : permutation) {
+        if (!file || row < 0 || row >= hessian.rows() || seen[row]) {
+            LOGLS_WARN(_log, "Ignoring the corrupted ordering cache file " << path);
+            return false;
+        }
+        seen[row] = true;
+    }
+    return true;
+}
+
+/// Write the ordering of hessian to a cache file, only warning if it cannot be written.
+void writeCachedOrdering(std::string const &path, SparseMatrixD const &hessian,
+                         Eigen::Index const *permutation) {
+    static_assert(sizeof(Eigen::Index) == sizeof(std::int64_t), "the permutation is written as int64");
+    // Written under a temporary name and renamed, so that concurrent runs never read a partial file.
+    std::string const temporaryPath = path + ".tmp";
+    std::ofstream file(temporaryPath, std::ios::binary);
+    std::int64_t const sizes[2] = {hessian.rows(), hessian.nonZeros()};
+    file.write(orderingMagic, sizeof(orderingMagic));
+    file.write(reinterpret_cast<char const *>(sizes), sizeof(sizes));
+    file.write(reinterpret_cast<char const *>(permutation), hessian.rows() * sizeof(Eigen::Index));
+    file.close();
+    if (!file || std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        LOGLS_WARN(_log, "Cannot write the ordering cache file " << path);
+        std::remove(temporaryPath.c_str());
+        return;
+    }
+    LOGLS_DEBUG(_log, "Wrote the ordering cache file " << path);
+}
+
+/**
+ * The entries of the inverse of a factorized matrix on the pattern of its cholmod factor.
+ *
+ * With the factorization P A P^T = L D L^T, the inverse Z of P A P^T satisfies Z = D^-1 L^-1 - (L^T - I) Z,
+ * which gives the entries of Z on the pattern of L column by column, from the last one, each from
+ * entries of later columns that are also in the pattern (Takahashi, Fagan & Chin 1973): the cost is
+ * about that of the numeric factorization.
+ */
+class SelectedInverse {
+public:
+    /**
+     * @param factor  A cholmod factor. It is converted to simplicial LDL^T on a copy if it is not one,
+     *                leaving factor untouched.
+     * @param common  The cholmod workspace of factor.
+     */
+    SelectedInverse(cholmod_factor *factor, cholmod_common *common) {
+        auto freeFactor = [common](cholmod_factor *factor) { cholmod_l_free_factor(&factor, common); };
+        std::unique_ptr<cholmod_factor, decltype(freeFactor)> copy(nullptr, freeFactor);
+        if (factor->is_super || factor->is_ll) {
+            copy.reset(cholmod_l_copy_factor(factor, common));
+            if (!copy ||
+                !cholmod_l_change_factor(CHOLMOD_REAL, false, false, true, true, copy.get(), common)) {
+                throw LSST_EXCEPT(pex::exceptions::RuntimeError,
+                                  "Cannot convert the factorization to simplicial LDLT");
+            }
+            factor = copy.get();
+        }
+
+        auto const n = static_cast<Eigen::Index>(factor->n);
+        auto const *perm = static_cast<Eigen::Index const *>(factor->Perm);
+        _permutedIndex.resize(n);
+        for (Eigen::Index k = 0; k < n; ++k) _permutedIndex[perm ? perm[k] : k] = k;
+
+        // Copy the strictly lower part of L, with the rows of each column sorted; D is the first entry of
+        // each column of a simplicial LDLT factor.
+        auto const *columnStarts = static_cast<Eigen::Index const *>(factor->p);
+        auto const *columnSizes = static_cast<Eigen::Index const *>(factor->nz);
+        auto const *rows = static_cast<Eigen::Index const *>(factor->i);
+        auto const *values = static_cast<double const *>(factor->x);
+        _columnStarts.assign(n + 1, 0);
+        for (Eigen::Index j = 0; j < n; ++j) {
+            _columnStarts[j + 1] = _columnStarts[j] + columnSizes[j] - 1;
+        }
+        _rows.resize(_columnStarts[n]);
+        std::vector<double> lower(_columnStarts[n]);
+        Eigen::VectorXd diagonal(n);
+        std::vector<std::pair<Eigen::Index, double>> column;
+        for (Eigen::Index j = 0; j < n; ++j) {
+            diagonal[j] = values[columnStarts[j]];
+            if (diagonal[j] == 0) {
+                throw LSST_EXCEPT(pex::exceptions::RuntimeError, "Singular factorization: cannot invert it");
+            }
+            column.clear();
+            for (Eigen::Index k = columnStarts[j] + 1; k < columnStarts[j] + columnSizes[j]; ++k) {
+                column.emplace_back(rows[k], values[k]);
+            }
+            std::sort(column.begin(), column.end());
+            for (std::size_t k = 0; k < column.size(); ++k) {
+                _rows[_columnStarts[j] + k] = column[k].first;
+                lower[_columnStarts[j] + k] = column[k].second;
+            }
+        }
+
+        // Z(i, j) = -sum_k L(k, j) Z(i, k) and Z(j, j) = 1/D(j) - sum_k L(k, j) Z(k, j), over the rows k > j
+        // of column j of L. The pattern of L is closed under this recurrence: Z(i, k) is in it.
+        _values.assign(_rows.size(), 0);
+        _diagonal.resize(n);
+        std::vector<double> sums;
+        for (Eigen::Index j = n - 1; j >= 0; --j) {
+            Eigen::Index const start = _columnStarts[j];
+            Eigen::Index const size = _columnStarts[j + 1] - start;
+            sums.assign(size, 0);
+            for (Eigen::Index a = 0; a < size; ++a) {
+                Eigen::Index const row = _rows[start + a];
+                sums[a] += lower[start + a] * _diagonal[row];
+                // Z is symmetric: each entry of the lower triangle contributes to two sums.
+                for (Eigen::Index b = 0; b < a; ++b) {
+                    double const z = _values[_find(row, _rows[start + b])];
+                    sums[a] += lower[start + b] * z;
+                    sums[b] += lower[start + a] * z;
+                }
+            }
+            double diagonalInverse = 1 / diagonal[j];
+            for (Eigen::Index a = 0; a < size; ++a) {
+                _values[start + a] = -sums[a];
+                diagonalInverse += lower[start + a] * sums[a];
+            }
+            _diagonal[j] = diagonalInverse;
+        }
+    }
+
+    /**
+     * Get entry (i, j) of the inverse of the factorized matrix, in its original ordering.
+     *
+     * @return false if the entry is not in the pattern of the factor, and so was not computed.
+     */
+    bool get(Eigen::Index i, Eigen::Index j, double &value) const {
+        Eigen::Index row = _permutedIndex[i];
+        Eigen::Index col = _permutedIndex[j];
+        if (row == col) {
+            value = _diagonal[row];
+            return true;
+        }
+        if (row < col) std::swap(row, col);
+        Eigen::Index const index = _search(row, col);
+        if (index < 0) return false;
+        value = _values[index];
+        return true;
+    }
+
+private:
+    // Index of the permuted entry (row, col), row > col, in _rows and _values, or -1 if not in the pattern.
+    Eigen::Index _search(Eigen::Index row, Eigen::Index col) const {
+        auto const begin = _rows.begin() + _columnStarts[col];
+        auto const end = _rows.begin() + _columnStarts[col + 1];
+        auto const found = std::lower_bound(begin, end, row);
+        return (found != end && *found == row) ? found - _rows.begin() : -1;
+    }
+
+    // As _search(), for an entry that the recurrence needs, and so must be in the pattern.
+    Eigen::Index _find(Eigen::Index row, Eigen::Index col) const {
+        Eigen::Index const index = _search(row, col);
+        if (index < 0) {
+            throw LSST_EXCEPT(pex::exceptions::LogicError, "The factor pattern is not closed: cannot invert");
+        }
+        return index;
+    }
+
+    std::vector<Eigen::Index> _permutedIndex;  // row of each original parameter in the factorization
+    std::vector<Eigen::Index> _columnStarts;   // pattern of the strictly lower part of L
+    std::vector<Eigen::Index> _rows;
+    std::vector<double> _values;  // the inverse on that pattern
+    Eigen::VectorXd _diagonal;    // and on the diagonal
+};
+
+/// A HessianSolver using a cholmod simplicial LDLT factorization, which can be downdated in place.
+class CholmodSolver : public HessianSolver {
+public:
+    /// See makeHessianSolver() for the arguments.
+    CholmodSolver(std::string const &ordering, std::string const &orderingCacheDir)
+            : _ordering(ordering), _orderingCacheDir(orderingCacheDir) {
+        int const method = getCholmodOrdering(ordering);
+        if (method >= 0) {
+            cholmod_common &common = _factorization.cholmod();
+            common.nmethods = 1;
+            common.method[0].ordering = method;
+        }
+    }
+
+    Eigen::VectorXd solve(Eigen::VectorXd const &rhs) const override { return _factorization.solve(rhs); }
+
+    Eigen::Index getNParameters() const override {
+        cholmod_factor const *factor = _factorization.getFactor();
+        return factor ? static_cast<Eigen::Index>(factor->n) : 0;
+    }
+
+    void downdate(SparseMatrixD const &H, FitterStatistics &statistics) override {
+        _factorization.update(H, false /* means downdate */);
+        ++statistics.nDowndates;
+    }
+
+    double getRelativeDowndateCost() const override { return _relativeDowndateCost; }
+
+    std::string getMethod() const override { return "simplicial LDLT"; }
+
+    /**
+     * @copydoc HessianSolver::computeInverseBlocks
+     *
+     * @throws lsst::pex::exceptions::LogicError if there is no valid factorization.
+     */
+    std::vector<Eigen::MatrixXd> computeInverseBlocks(
+            std::vector<IndexVector> const &blocks) const override {
+        cholmod_factor *factor = _factorization.getFactor();
+        if (factor == nullptr || _factorization.info() != Eigen::Success) {
+            throw LSST_EXCEPT(pex::exceptions::LogicError, "No valid factorization to invert");
+        }
+        SelectedInverse inverse(factor, _factorization.getCommon());
+        std::vector<Eigen::MatrixXd> result;
+        result.reserve(blocks.size());
+        std::size_t nSolved = 0;
+        for (auto const &indices : blocks) {
+            auto const size = static_cast<Eigen::Index>(indices.size());
+            Eigen::MatrixXd block(size, size);
+            bool inPattern = true;
+            for (Eigen::Index j = 0; j < size && inPattern; ++j) {
+                for (Eigen::Index i = j; i < size && inPattern; ++i) {
+                    inPattern = inverse.get(indices[i], indices[j], block(i, j));
+                    block(j, i) = block(i, j);
+                }
+            }
+            if (!inPattern) {
+                block = solveInverseBlock(indices);
+                ++nSolved;
+            }
+            result.push_back(std::move(block));
+        }
+        if (nSolved > 0) {
+            LOGLS_DEBUG(_log, nSolved << " inverse blocks outside of the factor pattern were solved for");
+        }
+        return result;
+    }
+
+protected:
+    bool analyzePattern(SparseMatrixD const &hessian, FitterStatistics &statistics) override {
+        std::vector<Eigen::Index> permutation;
+        std::string const cachePath = _getCachePath(_ordering, hessian);
+        bool const cached = !cachePath.empty() && readCachedOrdering(cachePath, hessian, permutation);
+        cholmod_common &common = _factorization.cholmod();
+        std::string orderingUsed = "cached";
+        if (cached) {
+            _factorization.analyzePattern(hessian, permutation);
+            ++statistics.nCachedOrderings;
+        } else {
+            _factorization.analyzePattern(hessian);
+            if (_factorization.getFactor() == nullptr && (_ordering == "metis" || _ordering == "nesdis")) {
+                LOGLS_WARN(_log, "The " << _ordering
+                                        << " ordering failed (cholmod may have been built without METIS): "
+                                        << "using amd instead");
+                // Only for this analysis: the next ones try the requested ordering again.
+                int const method = common.method[0].ordering;
+                common.method[0].ordering = CHOLMOD_AMD;
+                _factorization.analyzePattern(hessian);
+                orderingUsed = getOrderingName(common.method[common.selected].ordering);
+                common.method[0].ordering = method;
+            } else {
+                orderingUsed = getOrderingName(common.method[common.selected].ordering);
+            }
+        }
+        cholmod_factor const *factor = _factorization.getFactor();
+        if (factor == nullptr) return false;
+        if (!cached && !cachePath.empty()) {
+            // The default strategy is cached as such: it is what the next analyses look up.
+            std::string const path =
+                    (_ordering == "default") ? cachePath : _getCachePath(orderingUsed, hessian);
+            writeCachedOrdering(path, hessian, static_cast<Eigen::Index const *>(factor->Perm));
+        }
+
+        // The analysis gives the number of non-zeros of the factor and the flop count of the factorization.
+        statistics.ordering = orderingUsed;
+        statistics.factorNonZeros = common.lnz;
+        statistics.factorizationFlops = common.fl;
+        LOGLS_DEBUG(_log, "Symbolic analysis with the " << statistics.ordering
+                                                        << " ordering: factor non-zeros=" << common.lnz
+                                                        << " factorization flops=" << common.fl);
+        // A rank-1 downdate visits at most every non-zero of the factor, with a couple of flops for each.
+        _relativeDowndateCost = (common.fl > 0) ? 2 * common.lnz / common.fl
+                                                : std::numeric_limits<double>::quiet_NaN();
+        return _factorization.info() == Eigen::Success;
+    }
+
+    bool factorizeNumeric(SparseMatrixD const &hessian) override {
+        _factorization.factorize(hessian);
+        return _factorization.info() == Eigen::Success;
+    }
+
+private:
+    // The cache file of the given ordering of hessian, or an empty string if there is no cache.
+    std::string _getCachePath(std::string const &ordering, SparseMatrixD const &hessian) const {
+        if (_orderingCacheDir.empty()) return "";
+        std::ostringstream name;
+        name << _orderingCacheDir << "/ordering-" << ordering << "-" << std::hex << std::setfill('0')
+             << std::setw(16) << SparsityPattern::computeHash(hessian) << ".bin";
+        return name.str();
+    }
+
+    CholmodSimplicialLDLT2<SparseMatrixD> _factorization;
+    double _relativeDowndateCost = std::numeric_limits<double>::quiet_NaN();
+    std::string _ordering;
+    std::string _orderingCacheDir;
+};
+}  // namespace
+
+bool HessianSolver::factorize(SparseMatrixD const &hessian, FitterStatistics &statistics) {
+    auto start = std::chrono::steady_clock::now();
+    bool success;
+    if (_analyzedPattern.isSame(hessian)) {
+        LOGLS_DEBUG(_log, "Hessian pattern unchanged, reusing the symbolic factorization");
+        success = factorizeNumeric(hessian);
+    } else if (_analyzedPattern.contains(hessian)) {
+        LOGLS_DEBUG(_log, "Hessian pattern shrank, reusing the symbolic factorization");
+        success = factorizeNumeric(_analyzedPattern.embed(hessian));
+    } else {
+        LOGLS_DEBUG(_log, "Hessian pattern changed, computing a new symbolic factorization");
+        if (!analyzePattern(hessian, statistics)) {
+            _analyzedPattern.clear();
+            return false;
+        }
+        ++statistics.nSymbolicAnalyses;
+        _analyzedPattern.reset(hessian);
+        success = factorizeNumeric(hessian);
+    }
+    ++statistics.nNumericFactorizations;
+    statistics.lastFactorizationSeconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (success) {
+        statistics.factorization = getMethod();
+        LOGLS_DEBUG(_log, "Computed a " << statistics.factorization << " factorization");
+    }
+    return success;
+}
+
+std::vector<Eigen::MatrixXd> HessianSolver::computeInverseBlocks(
+        std::vector<IndexVector> const &blocks) const {
+    std::vector<Eigen::MatrixXd> result;
+    result.reserve(blocks.size());
+    for (auto const &indices : blocks) {
+        result.push_back(solveInverseBlock(indices));
+    }
+    return result;
+}
+
+Eigen::MatrixXd HessianSolver::solveInverseBlock(IndexVector const &indices) const {
+    auto const size = static_cast<Eigen::Index>(indices.size());
+    Eigen::MatrixXd block(size, size);
+    Eigen::VectorXd unit = Eigen::VectorXd::Zero(getNParameters());
+    for (Eigen::Index j = 0; j < size; ++j) {
+        unit[indices[j]] = 1;
+        Eigen::VectorXd column = solve(unit);
+        unit[indices[j]] = 0;
+        for (Eigen::Index i = 0; i < size; ++i) block(i, j) = column[indices[i]];
+    }
+    return block;
+}
+
+bool isPartitioningAvailable() {
+#ifdef NPARTITION
+    return false;
+#else
+    return true;
+#endif
+}
+
+std::unique_ptr<HessianSolver> makeHessianSolver(std::string const &ordering,
+                                                 std::string const &orderingCacheDir) {
+    if ((ordering == "metis" || ordering == "nesdis") && !isPartitioningAvailable()) {
+        throw LSST_EXCEPT(pex::exceptions::InvalidParameterError,
+                          "The " + ordering + " ordering is not available: jointcal was built with " +
+                                  "NPARTITION");
+    }
+    return std::make_unique<CholmodSolver>(ordering, orderingCacheDir);
+}
+
+std::unique_ptr<HessianSolver> makeHessianSolver(JointcalControl const &control) {
+    auto solver = makeHessianSolver(control.ordering, control.orderingCacheDir);
+    if (control.schurComplement) {
+        return std::make_unique<SchurComplementSolver>(std::move(solver), control.nThreads);
+    }
+    return solver;
+}
+
+}  // namespace jointcal
+}  // namespace lsst
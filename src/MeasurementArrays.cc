@@ -0,0 +1,71 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <string>
+
+#include "lsst/pex/exceptions.h"
+
+#include "lsst/jointcal/MeasurementArrays.h"
+
+namespace lsst {
+namespace jointcal {
+
+void MeasurementArrays::assign(MeasuredStarList const &measuredStarList) {
+    std::size_t const size = measuredStarList.size();
+    for (auto *array : {&x, &y, &vx, &vy, &vxy}) {
+        array->clear();
+        array->reserve(size);
+    }
+    measuredStars.clear();
+    measuredStars.reserve(size);
+    fittedStars.clear();
+    fittedStars.reserve(size);
+    valid.clear();
+    valid.reserve(size);
+    for (auto const &measuredStar : measuredStarList) {
+        x.push_back(measuredStar->x);
+        y.push_back(measuredStar->y);
+        vx.push_back(measuredStar->vx);
+        vy.push_back(measuredStar->vy);
+        vxy.push_back(measuredStar->vxy);
+        measuredStars.push_back(measuredStar.get());
+        fittedStars.push_back(measuredStar->getFittedStar().get());
+        valid.push_back(measuredStar->isValid());
+    }
+}
+
+void MeasurementArrays::updateValid(MeasuredStarList const &measuredStarList) {
+    if (measuredStarList.size() != size()) {
+        throw LSST_EXCEPT(pex::exceptions::LengthError,
+                          "MeasurementArrays::updateValid: " + std::to_string(measuredStarList.size()) +
+                                  " measurements, instead of " + std::to_string(size()));
+    }
+    auto validIt = valid.begin();
+    for (auto const &measuredStar : measuredStarList) {
+        *validIt++ = measuredStar->isValid();
+    }
+}
+
+}  // namespace jointcal
+}  // namespace lsst
@@ -0,0 +1,71 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <sys/resource.h>
+
+#include "lsst/jointcal/PhaseTimer.h"
+
+namespace lsst {
+namespace jointcal {
+
+namespace {
+/// CPU time (seconds) of the process and its peak resident memory (bytes), from a single getrusage().
+void getResourceUsage(double &cpuSeconds, std::size_t &peakResidentBytes) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        cpuSeconds = 0;
+        peakResidentBytes = 0;
+        return;
+    }
+    cpuSeconds = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+                 1e-6 * (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+#ifdef __APPLE__
+    peakResidentBytes = usage.ru_maxrss;  // bytes on macOS
+#else
+    peakResidentBytes = static_cast<std::size_t>(usage.ru_maxrss) * 1024;  // kilobytes on linux
+#endif
+}
+}  // namespace
+
+PhaseTimer::PhaseTimer(PhaseStatistics &statistics)
+        : _statistics(statistics), _wallStart(std::chrono::steady_clock::now()) {
+    getResourceUsage(_cpuStart, _peakResidentStart);
+}
+
+PhaseTimer::~PhaseTimer() {
+    double cpuEnd;
+    std::size_t peakResidentEnd;
+    getResourceUsage(cpuEnd, peakResidentEnd);
+    ++_statistics.nCalls;
+    _statistics.wallSeconds +=
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - _wallStart).count();
+    _statistics.cpuSeconds += cpuEnd - _cpuStart;
+    _statistics.peakResidentBytes = peakResidentEnd;
+    if (peakResidentEnd > _peakResidentStart) {
+        _statistics.peakResidentIncreaseBytes += peakResidentEnd - _peakResidentStart;
+    }
+}
+
+}  // namespace jointcal
+}  // namespace lsst
@@ -37,16 +37,19 @@
 #include "lsst/jointcal/Chi2.h"
 #include "lsst/jointcal/Eigenstuff.h"
 #include "lsst/jointcal/AstrometryTransform.h"
+#include "lsst/jointcal/MeasurementArrays.h"
 #include "lsst/jointcal/Tripletlist.h"
 
 namespace lsst {
 namespace jointcal {
 
-void PhotometryFit::leastSquareDerivativesMeasurement(CcdImage const &ccdImage, TripletList &tripletList,
+void PhotometryFit::leastSquareDerivativesMeasurement(CcdImage const &ccdImage,
+                                                      JacobianAccumulator &accumulator,
                                                       Eigen::VectorXd &grad,
-                                                      MeasuredStarList const *measuredStarList) const {
+                                                      MeasuredStarList const *measuredStarList,
+                                                      Eigen::VectorXd const *offset) const {
     /**********************************************************************/
-    /* @note the math in this method and accumulateStatImageList() must be kept consistent,
+    /* @note the math in this method and accumulateStatImage() must be kept consistent,
      * in terms of +/- convention, definition of model, etc. */
     /**********************************************************************/
 
@@ -58,44 +61,71 @@ void PhotometryFit::leastSquareDerivativesMeasurement(CcdImage const &ccdImage,
     std::size_t nparModel = (_fittingModel) ? _photometryModel->getNpar(ccdImage) : 0;
     std::size_t nparFlux = (_fittingFluxes) ? 1 : 0;
     std::size_t nparTotal = nparModel + nparFlux;
-    IndexVector indices(nparModel, -1);
+    IndexVector indices(nparTotal, -1);
     if (_fittingModel) _photometryModel->getMappingIndices(ccdImage, indices);
 
     Eigen::VectorXd H(nparTotal);  // derivative matrix
-    // current position in the Jacobian
-    Eigen::Index kTriplets = tripletList.getNextFreeIndex();
-    const MeasuredStarList &catalog = (measuredStarList) ? *measuredStarList : ccdImage.getCatalogForFit();
+    // when offset, differentiate through an offset copy of the mapping, leaving the model untouched.
+    std::unique_ptr<PhotometryMappingBase> offsetMapping;
+    if (offset != nullptr && _fittingModel) {
+        offsetMapping = _photometryModel->getMapping(ccdImage).cloneWithOffset(*offset);
+    }
+    PhotometryMappingBase const &mapping =
+            (offsetMapping) ? *offsetMapping : _photometryModel->getMapping(ccdImage);
+    // the few outliers of a list are copied to arrays: there is a single loop over the measurements.
+    MeasurementArrays listArrays;
+    if (measuredStarList) listArrays.assign(*measuredStarList);
+    MeasurementArrays const &measurements = (measuredStarList) ? listArrays : ccdImage.getMeasurementArrays();
+    // all measurements of this ccdImage depend on the same model parameters
+    if (nparModel > 0) {
+        accumulator.beginSharedBlock(IndexVector(indices.begin(), indices.begin() + nparModel));
+    }
 
-    for (auto const &measuredStar : catalog) {
-        if (!measuredStar->isValid()) continue;
+    for (std::size_t k = 0; k < measurements.size(); ++k) {
+        if (!measurements.valid[k]) continue;
+        // the photometry models read the instrumental fluxes (and focal plane positions) from the star.
+        MeasuredStar const *measuredStar = measurements.measuredStars[k];
+        FittedStar const *fittedStar = measurements.fittedStars[k];
+        std::unique_ptr<FittedStar> offsetStar;
+        if (offset != nullptr && _fittingFluxes) {
+            offsetStar = std::make_unique<FittedStar>(*fittedStar);
+            _photometryModel->offsetFittedStar(*offsetStar, (*offset)(offsetStar->getIndexInMatrix()));
+            fittedStar = offsetStar.get();
+        }
         H.setZero();  // we cannot be sure that all entries will be overwritten.
 
-        double residual = _photometryModel->computeResidual(ccdImage, *measuredStar);
-        double inverseSigma = 1.0 / _photometryModel->transformError(ccdImage, *measuredStar);
+        double residual = _photometryModel->computeResidual(*measuredStar, *fittedStar, mapping);
+        double inverseSigma = 1.0 / _photometryModel->transformError(*measuredStar, mapping);
         double W = std::pow(inverseSigma, 2);
+        if (_robustLoss.isRobust()) {
+            // weight the term by the derivative of the loss at its current chi2 (IRLS).
+            double weight = _robustLoss.weight(std::pow(residual * inverseSigma, 2));
+            W *= weight;
+            inverseSigma *= std::sqrt(weight);
+        }
 
         if (_fittingModel) {
-            _photometryModel->computeParameterDerivatives(*measuredStar, ccdImage, H);
-            for (std::size_t k = 0; k < indices.size(); k++) {
-                Eigen::Index l = indices[k];
-                tripletList.addTriplet(l, kTriplets, H[k] * inverseSigma);
-                grad[l] += H[k] * W * residual;
+            _photometryModel->computeParameterDerivatives(*measuredStar, mapping, H);
+            for (std::size_t k = 0; k < nparModel; k++) {
+                grad[indices[k]] += H[k] * W * residual;
             }
         }
         if (_fittingFluxes) {
-            Eigen::Index index = measuredStar->getFittedStar()->getIndexInMatrix();
+            Eigen::Index index = fittedStar->getIndexInMatrix();
             // Note: H = dR/dFittedStarFlux == -1
-            tripletList.addTriplet(index, kTriplets, -1.0 * inverseSigma);
+            H[nparModel] = -1.0;
+            indices[nparModel] = index;
             grad[index] += -1.0 * W * residual;
         }
-        kTriplets += 1;  // each measurement contributes 1 column in the Jacobian
+        // each measurement contributes 1 column in the Jacobian
+        accumulator.addTerm(indices, H * inverseSigma);
     }
-
-    tripletList.setNextFreeIndex(kTriplets);
+    if (nparModel > 0) accumulator.endSharedBlock();
 }
 
 void PhotometryFit::leastSquareDerivativesReference(FittedStarList const &fittedStarList,
-                                                    TripletList &tripletList, Eigen::VectorXd &grad) const {
+                                                    JacobianAccumulator &accumulator, Eigen::VectorXd &grad,
+                                                    Eigen::VectorXd const *offset) const {
     /**********************************************************************/
     /** @note the math in this method and accumulateStatReference() must be kept consistent,
      * in terms of +/- convention, definition of model, etc. */
@@ -106,7 +136,8 @@ void PhotometryFit::leastSquareDerivativesReference(FittedStarList const &fitted
     // Can't compute anything if there are no refStars.
     if (_associations->refStarList.size() == 0) return;
 
-    Eigen::Index kTriplets = tripletList.getNextFreeIndex();
+    IndexVector indices(1);
+    Eigen::Matrix<double, 1, 1> H;
 
     for (auto const &fittedStar : fittedStarList) {
         auto refStar = fittedStar->getRefStar();
@@ -120,53 +151,99 @@ void PhotometryFit::leastSquareDerivativesReference(FittedStarList const &fitted
 
         double inverseSigma = 1.0 / _photometryModel->getRefError(*refStar);
         // Residual is fittedStar - refStar for consistency with measurement terms.
-        double residual = _photometryModel->computeRefResidual(*fittedStar, *refStar);
+        double residual;
+        if (offset != nullptr) {
+            FittedStar offsetStar(*fittedStar);
+            _photometryModel->offsetFittedStar(offsetStar, (*offset)(offsetStar.getIndexInMatrix()));
+            residual = _photometryModel->computeRefResidual(offsetStar, *refStar);
+        } else {
+            residual = _photometryModel->computeRefResidual(*fittedStar, *refStar);
+        }
 
         Eigen::Index index = fittedStar->getIndexInMatrix();
         // Note: H = dR/dFittedStar == 1
-        tripletList.addTriplet(index, kTriplets, 1.0 * inverseSigma);
+        indices[0] = index;
+        H(0, 0) = 1.0 * inverseSigma;
+        accumulator.addTerm(indices, H);
         grad(index) += 1.0 * std::pow(inverseSigma, 2) * residual;
-        kTriplets += 1;
     }
-    tripletList.setNextFreeIndex(kTriplets);
 }
 
-void PhotometryFit::accumulateStatImageList(CcdImageList const &ccdImageList, Chi2Accumulator &accum) const {
+void PhotometryFit::accumulateStatImage(CcdImage const &ccdImage, Chi2Accumulator &accum,
+                                        Eigen::VectorXd const *offset) const {
     /**********************************************************************/
     /** @note the math in this method and leastSquareDerivativesMeasurement() must be kept consistent,
      * in terms of +/- convention, definition of model, etc. */
     /**********************************************************************/
-    for (auto const &ccdImage : ccdImageList) {
-        auto &catalog = ccdImage->getCatalogForFit();
-
-        for (auto const &measuredStar : catalog) {
-            if (!measuredStar->isValid()) continue;
-            double sigma = _photometryModel->transformError(*ccdImage, *measuredStar);
-            double residual = _photometryModel->computeResidual(*ccdImage, *measuredStar);
+    MeasurementArrays const &measurements = ccdImage.getMeasurementArrays();
 
-            double chi2Val = std::pow(residual / sigma, 2);
-            accum.addEntry(chi2Val, 1, measuredStar);
-        }  // end loop on measurements
+    // when offset, evaluate through an offset copy of the mapping, leaving the model untouched.
+    std::unique_ptr<PhotometryMappingBase> offsetMapping;
+    if (offset != nullptr && _fittingModel) {
+        offsetMapping = _photometryModel->getMapping(ccdImage).cloneWithOffset(*offset);
     }
+    PhotometryMappingBase const &mapping =
+            (offsetMapping) ? *offsetMapping : _photometryModel->getMapping(ccdImage);
+
+    for (std::size_t starIndex = 0; starIndex < measurements.size(); ++starIndex) {
+        if (!measurements.valid[starIndex]) continue;
+        MeasuredStar const &measuredStar = *measurements.measuredStars[starIndex];
+        FittedStar const &fittedStar = *measurements.fittedStars[starIndex];
+        double sigma = _photometryModel->transformError(measuredStar, mapping);
+        double residual;
+        if (offset != nullptr && _fittingFluxes) {
+            FittedStar offsetStar(fittedStar);
+            _photometryModel->offsetFittedStar(offsetStar, (*offset)(offsetStar.getIndexInMatrix()));
+            residual = _photometryModel->computeResidual(measuredStar, offsetStar, mapping);
+        } else {
+            residual = _photometryModel->computeResidual(measuredStar, fittedStar, mapping);
+        }
+
+        double chi2Val = std::pow(residual / sigma, 2);
+        if (accum.useRobustLoss()) chi2Val = _robustLoss.loss(chi2Val);
+        accum.addEntry(chi2Val, 1, starIndex);
+    }  // end loop on measurements
 }
 
-void PhotometryFit::accumulateStatRefStars(Chi2Accumulator &accum) const {
+void PhotometryFit::accumulateStatRefStars(Chi2Accumulator &accum, Eigen::VectorXd const *offset) const {
     /**********************************************************************/
     /** @note the math in this method and leastSquareDerivativesReference() must be kept consistent,
      * in terms of +/- convention, definition of model, etc. */
     /**********************************************************************/
 
     FittedStarList &fittedStarList = _associations->fittedStarList;
+    std::size_t nextStarIndex = 0;
     for (auto const &fittedStar : fittedStarList) {
+        std::size_t starIndex = nextStarIndex++;  // position of fittedStar in fittedStarList
         auto refStar = fittedStar->getRefStar();
         if (refStar == nullptr) continue;
         double sigma = _photometryModel->getRefError(*refStar);
-        double residual = _photometryModel->computeRefResidual(*fittedStar, *refStar);
+        double residual;
+        if (offset != nullptr && _fittingFluxes) {
+            FittedStar offsetStar(*fittedStar);
+            _photometryModel->offsetFittedStar(offsetStar, (*offset)(offsetStar.getIndexInMatrix()));
+            residual = _photometryModel->computeRefResidual(offsetStar, *refStar);
+        } else {
+            residual = _photometryModel->computeRefResidual(*fittedStar, *refStar);
+        }
         double chi2 = std::pow(residual / sigma, 2);
-        accum.addEntry(chi2, 1, fittedStar);
+        accum.addEntry(chi2, 1, starIndex);
     }
 }
 
+void PhotometryFit::getIndicesOfMapping(CcdImage const &ccdImage, IndexVector &indices) const {
+    indices.clear();
+    if (!_fittingModel) return;
+    _photometryModel->getMappingIndices(ccdImage, indices);
+    indices.resize(_photometryModel->getNpar(ccdImage));
+}
+
+void PhotometryFit::getIndicesOfFittedStar(FittedStar const &fittedStar, IndexVector &indices) const {
+    indices.clear();
+    if (!_fittingFluxes) return;
+    indices.push_back(fittedStar.getIndexInMatrix());
+}
+
 //! this routine is to be used only in the framework of outlier removal
 /*! it fills the array of indices of parameters that a Measured star
     constrains. Not really all of them if you check. */
@@ -227,6 +304,14 @@ void PhotometryFit::offsetParams(Eigen::VectorXd const &delta) {
     }
 }
 
+Eigen::VectorXd PhotometryFit::getModelParameters() const {
+    return _photometryModel->getAllParameters(_associations->getCcdImageList());
+}
+
+void PhotometryFit::setModelParameters(Eigen::VectorXd const &parameters) {
+    _photometryModel->setAllParameters(_associations->getCcdImageList(), parameters);
+}
+
 void PhotometryFit::saveChi2MeasContributions(std::string const &filename) const {
     std::ofstream ofile(filename.c_str());
     std::string separator = "\t";
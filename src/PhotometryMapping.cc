@@ -68,8 +68,30 @@ void ChipVisitPhotometryMapping::setWhatToFit(bool const fittingChips, bool cons
     }
 }
 
+void ChipVisitPhotometryMapping::offsetClone(Eigen::VectorXd const &delta,
+                                             ChipVisitPhotometryMapping &result) const {
+    result.index = index;
+    result.fixed = fixed;
+    result._nParChip = _nParChip;
+    result._nParVisit = _nParVisit;
+    // The model offsets the chip and visit mappings separately, each at its own index.
+    if (_nParChip > 0 && !_chipMapping->isFixed()) {
+        result._chipMapping->offsetParams(delta.segment(_chipMapping->getIndex(), _nParChip));
+    }
+    if (_nParVisit > 0) {
+        result._visitMapping->offsetParams(delta.segment(_visitMapping->getIndex(), _nParVisit));
+    }
+}
+
 // ChipVisitFluxMapping methods
 
+std::unique_ptr<PhotometryMappingBase> ChipVisitFluxMapping::cloneWithOffset(
+        Eigen::VectorXd const &delta) const {
+    auto result = std::make_unique<ChipVisitFluxMapping>(_chipMapping->clone(), _visitMapping->clone());
+    offsetClone(delta, *result);
+    return result;
+}
+
 double ChipVisitFluxMapping::transformError(MeasuredStar const &measuredStar, double instFlux,
                                             double instFluxErr) const {
     // The transformed error is s_m = dM(f,x,y)/df + s_f.
@@ -109,6 +131,13 @@ void ChipVisitFluxMapping::computeParameterDerivatives(MeasuredStar const &measu
 
 // ChipVisitMagnitudeMapping methods
 
+std::unique_ptr<PhotometryMappingBase> ChipVisitMagnitudeMapping::cloneWithOffset(
+        Eigen::VectorXd const &delta) const {
+    auto result = std::make_unique<ChipVisitMagnitudeMapping>(_chipMapping->clone(), _visitMapping->clone());
+    offsetClone(delta, *result);
+    return result;
+}
+
 double ChipVisitMagnitudeMapping::transformError(MeasuredStar const &measuredStar, double instFlux,
                                                  double instFluxErr) const {
     // The transformed error is s_mout = 2.5/ln(10) * instFluxErr / instFlux
@@ -221,6 +221,17 @@ Eigen::VectorXd PhotometryTransformChebyshev::getParameters() const {
     return parameters;
 }
 
+void PhotometryTransformChebyshev::setParameters(Eigen::VectorXd const &parameters) {
+    // NOTE: the indexing in this method and offsetParams must be kept consistent!
+    Eigen::VectorXd::Index k = 0;
+    for (ndarray::Size j = 0; j <= _order; ++j) {
+        ndarray::Size const iMax = _order - j;  // to save re-computing `i+j <= order` every inner step.
+        for (ndarray::Size i = 0; i <= iMax; ++i, ++k) {
+            _coefficients[j][i] = parameters[k];
+        }
+    }
+}
+
 double PhotometryTransformChebyshev::computeChebyshev(double x, double y) const {
     geom::Point2D p = _toChebyshevRange(geom::Point2D(x, y));
     return evaluateFunction1d(RecursionArrayImitator(_coefficients, p.getX()), p.getY(),
@@ -0,0 +1,93 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <cmath>
+
+#include "lsst/pex/exceptions.h"
+
+#include "lsst/jointcal/RobustLoss.h"
+
+namespace lsst {
+namespace jointcal {
+
+RobustLoss::RobustLoss(std::string const &name, double scale) : _scale(scale) {
+    double defaultScale = 0;
+    if (name == "none") {
+        _kind = Kind::None;
+    } else if (name == "huber") {
+        _kind = Kind::Huber;
+        defaultScale = 1.345;
+    } else if (name == "cauchy") {
+        _kind = Kind::Cauchy;
+        defaultScale = 2.385;
+    } else if (name == "tukey") {
+        _kind = Kind::Tukey;
+        defaultScale = 4.685;
+    } else {
+        throw LSST_EXCEPT(pex::exceptions::InvalidParameterError,
+                          "Unknown robust loss: " + name + ", must be none, huber, cauchy or tukey");
+    }
+    if (!(scale >= 0)) {
+        throw LSST_EXCEPT(pex::exceptions::InvalidParameterError, "The robust loss scale must be >= 0");
+    }
+    if (_scale == 0) _scale = defaultScale;
+    _scale2 = _scale * _scale;
+}
+
+double RobustLoss::loss(double chi2) const {
+    switch (_kind) {
+        case Kind::None:
+            return chi2;
+        case Kind::Huber:
+            return (chi2 <= _scale2) ? chi2 : 2 * _scale * std::sqrt(chi2) - _scale2;
+        case Kind::Cauchy:
+            return _scale2 * std::log1p(chi2 / _scale2);
+        case Kind::Tukey:
+            return (chi2 <= _scale2) ? _scale2 / 3 * (1 - std::pow(1 - chi2 / _scale2, 3)) : _scale2 / 3;
+    }
+    return chi2;
+}
+
+double RobustLoss::weight(double chi2) const {
+    double weight = 1;
+    switch (_kind) {
+        case Kind::None:
+            return 1;
+        case Kind::Huber:
+            weight = (chi2 <= _scale2) ? 1 : _scale / std::sqrt(chi2);
+            break;
+        case Kind::Cauchy:
+            weight = 1 / (1 + chi2 / _scale2);
+            break;
+        case Kind::Tukey:
+            weight = (chi2 <= _scale2) ? std::pow(1 - chi2 / _scale2, 2) : 0;
+            break;
+    }
+    return std::max(weight, minWeight);
+}
+
+}  // namespace jointcal
+}  // namespace lsst
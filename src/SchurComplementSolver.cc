@@ -0,0 +1,336 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include "Eigen/Cholesky"
+
+#include "lsst/log/Log.h"
+#include "lsst/pex/exceptions.h"
+
+#include "lsst/jointcal/SchurComplementSolver.h"
+#include "lsst/jointcal/Threads.h"
+#include "lsst/jointcal/Tripletlist.h"
+
+namespace lsst {
+namespace jointcal {
+
+namespace {
+LOG_LOGGER _log = LOG_GET("jointcal.SchurComplementSolver");
+
+/// An entry of B: index of the parameter in the reduced system, index within the block, value.
+struct CouplingTerm {
+    Eigen::Index reduced;
+    Eigen::Index offset;
+    double value;
+
+    bool operator<(CouplingTerm const &other) const {
+        return reduced < other.reduced || (reduced == other.reduced && offset < other.offset);
+    }
+};
+}  // namespace
+
+SchurComplementSolver::SchurComplementSolver(std::unique_ptr<HessianSolver> reducedSolver, int nThreads)
+        : _reducedSolver(std::move(reducedSolver)), _nThreads(getNThreads(nThreads)), _nParTot(0) {}
+
+bool SchurComplementSolver::factorize(SparseMatrixD const &hessian, FitterStatistics &statistics) {
+    _nParTot = hessian.rows();
+    std::size_t const nBlocks = _blocks.size();
+
+    // Which block each parameter belongs to (-1 for none), and the index of the others in the reduced system.
+    std::vector<Eigen::Index> blockOf(_nParTot, -1);
+    for (std::size_t b = 0; b < nBlocks; ++b) {
+        auto const &block = _blocks[b];
+        if (block.start < 0 || block.size <= 0 || block.start + block.size > _nParTot) {
+            throw LSST_EXCEPT(pex::exceptions::InvalidParameterError,
+                              "Eliminable parameter block outside of the Hessian.");
+        }
+        for (Eigen::Index k = block.start; k < block.start + block.size; ++k) {
+            if (blockOf[k] >= 0) {
+                throw LSST_EXCEPT(pex::exceptions::InvalidParameterError,
+                                  "Eliminable parameter blocks overlap.");
+            }
+            blockOf[k] = b;
+        }
+    }
+    std::vector<Eigen::Index> reducedIndex(_nParTot, -1);
+    _keptParameters.clear();
+    for (Eigen::Index i = 0; i < _nParTot; ++i) {
+        if (blockOf[i] < 0) {
+            reducedIndex[i] = _keptParameters.size();
+            _keptParameters.push_back(i);
+        }
+    }
+    Eigen::Index const nReduced = _keptParameters.size();
+
+    // Split the lower triangle of the Hessian into A, the blocks of C and the terms of B.
+    std::vector<Trip> reducedTriplets;
+    std::vector<Eigen::MatrixXd> diagonalBlocks(nBlocks);
+    for (std::size_t b = 0; b < nBlocks; ++b) {
+        diagonalBlocks[b].setZero(_blocks[b].size, _blocks[b].size);
+    }
+    std::vector<std::vector<CouplingTerm>> couplings(nBlocks);
+    for (Eigen::Index col = 0; col < hessian.outerSize(); ++col) {
+        for (SparseMatrixD::InnerIterator it(hessian, col); it; ++it) {
+            Eigen::Index const row = it.row();
+            if (row < col) continue;
+            Eigen::Index const rowBlock = blockOf[row];
+            Eigen::Index const colBlock = blockOf[col];
+            if (rowBlock < 0 && colBlock < 0) {
+                reducedTriplets.emplace_back(reducedIndex[row], reducedIndex[col], it.value());
+            } else if (rowBlock == colBlock) {
+                Eigen::Index const start = _blocks[rowBlock].start;
+                diagonalBlocks[rowBlock](row - start, col - start) = it.value();
+                diagonalBlocks[rowBlock](col - start, row - start) = it.value();
+            } else if (rowBlock < 0) {
+                couplings[colBlock].push_back({reducedIndex[row], col - _blocks[colBlock].start, it.value()});
+            } else if (colBlock < 0) {
+                couplings[rowBlock].push_back({reducedIndex[col], row - _blocks[rowBlock].start, it.value()});
+            } else {
+                throw LSST_EXCEPT(pex::exceptions::LogicError,
+                                  "The Hessian couples two different eliminable parameter blocks.");
+            }
+        }
+    }
+
+    // Invert each block of C, and compute its contribution -B C^-1 B^T to the reduced system.
+    _eliminated.assign(nBlocks, EliminatedBlock());
+    std::size_t const nChunks = std::max<std::size_t>(1, std::min(_nThreads, nBlocks));
+    std::vector<std::vector<Trip>> chunkTriplets(nChunks);
+    std::vector<Eigen::Index> singularBlocks(nChunks, -1);
+    auto eliminateChunk = [&](std::size_t i) {
+        for (std::size_t b = nBlocks * i / nChunks; b < nBlocks * (i + 1) / nChunks; ++b) {
+            auto &eliminated = _eliminated[b];
+            Eigen::Index const size = _blocks[b].size;
+            Eigen::LLT<Eigen::MatrixXd> llt(diagonalBlocks[b]);
+            if (llt.info() != Eigen::Success) {
+                singularBlocks[i] = b;
+                return;
+            }
+            eliminated.inverse = llt.solve(Eigen::MatrixXd::Identity(size, size));
+            Eigen::MatrixXd().swap(diagonalBlocks[b]);
+
+            auto &coupling = couplings[b];
+            std::sort(coupling.begin(), coupling.end());
+            for (auto const &term : coupling) {
+                if (eliminated.kept.empty() || eliminated.kept.back() != term.reduced) {
+                    eliminated.kept.push_back(term.reduced);
+                }
+            }
+            eliminated.coupling.setZero(eliminated.kept.size(), size);
+            Eigen::Index k = -1;
+            for (std::size_t j = 0; j < coupling.size(); ++j) {
+                if (j == 0 || coupling[j].reduced != coupling[j - 1].reduced) ++k;
+                eliminated.coupling(k, coupling[j].offset) = coupling[j].value;
+            }
+            std::vector<CouplingTerm>().swap(coupling);
+
+            // kept is sorted, so (p, q) with p >= q is in the lower triangle.
+            Eigen::MatrixXd update =
+                    eliminated.coupling * eliminated.inverse * eliminated.coupling.transpose();
+            for (std::size_t q = 0; q < eliminated.kept.size(); ++q) {
+                for (std::size_t p = q; p < eliminated.kept.size(); ++p) {
+                    chunkTriplets[i].emplace_back(eliminated.kept[p], eliminated.kept[q], -update(p, q));
+                }
+            }
+        }
+    };
+    if (nChunks > 1) {
+        runInThreads(nChunks, eliminateChunk);
+    } else {
+        eliminateChunk(0);
+    }
+    for (auto const &singular : singularBlocks) {
+        if (singular >= 0) {
+            LOGLS_ERROR(_log, "Eliminable parameter block starting at " << _blocks[singular].start
+                                                                       << " is not positive definite");
+            return false;
+        }
+    }
+    // Merging in chunk order makes the reduced system independent of thread scheduling.
+    for (auto &triplets : chunkTriplets) {
+        reducedTriplets.insert(reducedTriplets.end(), triplets.begin(), triplets.end());
+        std::vector<Trip>().swap(triplets);
+    }
+
+    SparseMatrixD reduced(nReduced, nReduced);
+    reduced.setFromTriplets(reducedTriplets.begin(), reducedTriplets.end());
+    std::vector<Trip>().swap(reducedTriplets);
+    LOGLS_DEBUG(_log, "Eliminated " << _nParTot - nReduced << " parameters in " << nBlocks
+                                    << " blocks, reduced system: dim=" << nReduced
+                                    << " non-zeros=" << reduced.nonZeros());
+    statistics.nReducedParameters = nReduced;
+    if (nReduced > 0 && !_reducedSolver->factorize(reduced, statistics)) {
+        return false;
+    }
+    statistics.factorization = getMethod();
+    return true;
+}
+
+Eigen::VectorXd SchurComplementSolver::solve(Eigen::VectorXd const &rhs) const {
+    Eigen::Index const nReduced = _keptParameters.size();
+    Eigen::VectorXd reducedRhs(nReduced);
+    for (Eigen::Index p = 0; p < nReduced; ++p) {
+        reducedRhs(p) = rhs(_keptParameters[p]);
+    }
+    for (std::size_t b = 0; b < _blocks.size(); ++b) {
+        auto const &eliminated = _eliminated[b];
+        Eigen::VectorXd contribution =
+                eliminated.coupling * (eliminated.inverse * rhs.segment(_blocks[b].start, _blocks[b].size));
+        for (std::size_t p = 0; p < eliminated.kept.size(); ++p) {
+            reducedRhs(eliminated.kept[p]) -= contribution(p);
+        }
+    }
+
+    Eigen::VectorXd solution(_nParTot);
+    if (nReduced > 0) {
+        Eigen::VectorXd reducedSolution = _reducedSolver->solve(reducedRhs);
+        for (Eigen::Index p = 0; p < nReduced; ++p) {
+            solution(_keptParameters[p]) = reducedSolution(p);
+        }
+    }
+
+    // Back-substitute the eliminated parameters; each block only writes its own part of the solution.
+    std::size_t const nBlocks = _blocks.size();
+    std::size_t const nChunks = std::max<std::size_t>(1, std::min(_nThreads, nBlocks));
+    auto backSubstituteChunk = [&](std::size_t i) {
+        for (std::size_t b = nBlocks * i / nChunks; b < nBlocks * (i + 1) / nChunks; ++b) {
+            auto const &eliminated = _eliminated[b];
+            Eigen::VectorXd keptSolution(eliminated.kept.size());
+            for (std::size_t p = 0; p < eliminated.kept.size(); ++p) {
+                keptSolution(p) = solution(_keptParameters[eliminated.kept[p]]);
+            }
+            solution.segment(_blocks[b].start, _blocks[b].size) =
+                    eliminated.inverse * (rhs.segment(_blocks[b].start, _blocks[b].size) -
+                                          eliminated.coupling.transpose() * keptSolution);
+        }
+    };
+    if (nChunks > 1) {
+        runInThreads(nChunks, backSubstituteChunk);
+    } else {
+        backSubstituteChunk(0);
+    }
+    return solution;
+}
+
+std::vector<Eigen::MatrixXd> SchurComplementSolver::computeInverseBlocks(
+        std::vector<IndexVector> const &blocks) const {
+    // Which eliminated block each parameter belongs to (-1 for none), and the index of the others in the
+    // reduced system.
+    std::vector<Eigen::Index> blockOf(_nParTot, -1);
+    for (std::size_t b = 0; b < _blocks.size(); ++b) {
+        for (Eigen::Index k = _blocks[b].start; k < _blocks[b].start + _blocks[b].size; ++k) blockOf[k] = b;
+    }
+    std::vector<Eigen::Index> reducedIndex(_nParTot, -1);
+    for (std::size_t p = 0; p < _keptParameters.size(); ++p) reducedIndex[_keptParameters[p]] = p;
+
+    // The block of each request in the reduced system: its own parameters if they are all in A, or the
+    // parameters coupled to its block of C; -1 if it has to be solved for.
+    std::vector<IndexVector> reducedBlocks;
+    std::vector<Eigen::Index> reducedBlockOf(blocks.size(), -1);
+    std::vector<Eigen::Index> eliminatedBlockOf(blocks.size(), -1);
+    std::size_t nSolved = 0;
+    for (std::size_t r = 0; r < blocks.size(); ++r) {
+        auto const &indices = blocks[r];
+        bool const inA = std::all_of(indices.begin(), indices.end(),
+                                     [&](Eigen::Index index) { return blockOf[index] < 0; });
+        Eigen::Index const b = indices.empty() ? -1 : blockOf[indices[0]];
+        bool const inC = b >= 0 && std::all_of(indices.begin(), indices.end(),
+                                               [&](Eigen::Index index) { return blockOf[index] == b; });
+        if (inA) {
+            IndexVector reduced;
+            for (auto const index : indices) reduced.push_back(reducedIndex[index]);
+            reducedBlockOf[r] = reducedBlocks.size();
+            reducedBlocks.push_back(std::move(reduced));
+        } else if (inC) {
+            eliminatedBlockOf[r] = b;
+            reducedBlockOf[r] = reducedBlocks.size();
+            reducedBlocks.emplace_back(_eliminated[b].kept.begin(), _eliminated[b].kept.end());
+        } else {
+            ++nSolved;
+        }
+    }
+    std::vector<Eigen::MatrixXd> reducedInverse;
+    if (!_keptParameters.empty()) {
+        reducedInverse = _reducedSolver->computeInverseBlocks(reducedBlocks);
+    } else {
+        for (auto const &reduced : reducedBlocks) reducedInverse.emplace_back(reduced.size(), reduced.size());
+    }
+
+    // Only the blocks formed from the inverse of the reduced system are split among threads: solve() is
+    // not reentrant.
+    std::vector<Eigen::MatrixXd> result(blocks.size());
+    auto computeBlock = [&](std::size_t r) {
+        auto const &indices = blocks[r];
+        if (reducedBlockOf[r] < 0) {
+            return;
+        } else if (eliminatedBlockOf[r] < 0) {
+            result[r] = std::move(reducedInverse[reducedBlockOf[r]]);
+        } else {
+            Eigen::Index const b = eliminatedBlockOf[r];
+            auto const &eliminated = _eliminated[b];
+            Eigen::MatrixXd const couplingInverse = eliminated.coupling * eliminated.inverse;
+            Eigen::MatrixXd const inverse =
+                    eliminated.inverse +
+                    couplingInverse.transpose() * reducedInverse[reducedBlockOf[r]] * couplingInverse;
+            auto const size = static_cast<Eigen::Index>(indices.size());
+            result[r].resize(size, size);
+            for (Eigen::Index j = 0; j < size; ++j) {
+                for (Eigen::Index i = 0; i < size; ++i) {
+                    result[r](i, j) = inverse(indices[i] - _blocks[b].start, indices[j] - _blocks[b].start);
+                }
+            }
+        }
+    };
+    std::size_t const nChunks = std::max<std::size_t>(1, std::min(_nThreads, blocks.size()));
+    auto computeChunks = [&](std::size_t i) {
+        for (std::size_t r = blocks.size() * i / nChunks; r < blocks.size() * (i + 1) / nChunks; ++r) {
+            computeBlock(r);
+        }
+    };
+    if (nChunks > 1) {
+        runInThreads(nChunks, computeChunks);
+    } else {
+        computeChunks(0);
+    }
+    for (std::size_t r = 0; r < blocks.size(); ++r) {
+        if (reducedBlockOf[r] < 0) result[r] = solveInverseBlock(blocks[r]);
+    }
+    if (nSolved > 0) {
+        LOGLS_DEBUG(_log, nSolved << " inverse blocks mixing eliminated and reduced parameters were "
+                                  << "solved for");
+    }
+    return result;
+}
+
+void SchurComplementSolver::downdate(SparseMatrixD const &H, FitterStatistics &statistics) {
+    throw LSST_EXCEPT(pex::exceptions::LogicError, "A Schur complement factorization cannot be downdated.");
+}
+
+std::string SchurComplementSolver::getMethod() const {
+    return "Schur complement, reduced system: " + _reducedSolver->getMethod();
+}
+
+}  // namespace jointcal
+}  // namespace lsst
@@ -49,17 +49,19 @@ void SimpleAstrometryMapping::transformPosAndErrors(FatPoint const &where, FatPo
 
 void SimpleAstrometryMapping::positionDerivative(Point const &where, Eigen::Matrix2d &derivative,
                                                  double epsilon) const {
-    errorProp->computeDerivative(where, *lin, epsilon);
-    derivative(0, 0) = lin->getCoefficient(1, 0, 0);
+    // a local transform (rather than a member) keeps this method safe to call from several threads.
+    AstrometryTransformLinear lin;
+    errorProp->computeDerivative(where, lin, epsilon);
+    derivative(0, 0) = lin.getCoefficient(1, 0, 0);
     //
     /* This does not work : it was proved by rotating the frame
        see the compilation switch ROTATE_T2 in constrainedAstrometryModel.cc
     derivative(1,0) = lin->getCoefficient(1,0,1);
     derivative(0,1) = lin->getCoefficient(0,1,0);
     */
-    derivative(1, 0) = lin->getCoefficient(0, 1, 0);
-    derivative(0, 1) = lin->getCoefficient(1, 0, 1);
-    derivative(1, 1) = lin->getCoefficient(0, 1, 1);
+    derivative(1, 0) = lin.getCoefficient(0, 1, 0);
+    derivative(0, 1) = lin.getCoefficient(1, 0, 1);
+    derivative(1, 1) = lin.getCoefficient(0, 1, 1);
 }
 
 void SimpleAstrometryMapping::computeTransformAndDerivatives(FatPoint const &where, FatPoint &outPoint,
@@ -68,6 +70,48 @@ void SimpleAstrometryMapping::computeTransformAndDerivatives(FatPoint const &whe
     transform->paramDerivatives(where, &H(0, 0), &H(0, 1));
 }
 
+void SimpleAstrometryMapping::computeTransformAndDerivativesBatch(FatPointArrays const &where,
+                                                                  FatPointArrays &outPoints,
+                                                                  Eigen::MatrixXd &H) const {
+    transformPosAndErrorsBatch(where, outPoints);
+    H.resize(getNpar(), 2 * where.size());
+    if (H.rows() == 0) return;
+    for (Eigen::Index k = 0; k < where.size(); ++k) {
+        transform->paramDerivatives(where.get(k), &H(0, 2 * k), &H(0, 2 * k + 1));
+    }
+}
+
+void SimpleAstrometryMapping::transformPosAndErrorsBatch(FatPointArrays const &where,
+                                                         FatPointArrays &outPoints) const {
+    transform->transformPosAndErrorsBatch(where, outPoints);
+    if (errorProp == transform) return;
+    FatPointArrays tmp;
+    errorProp->transformPosAndErrorsBatch(where, tmp);
+    outPoints.vx = tmp.vx;
+    outPoints.vy = tmp.vy;
+    outPoints.vxy = tmp.vxy;
+}
+
+std::unique_ptr<AstrometryMapping> SimpleAstrometryMapping::cloneWithOffset(
+        Eigen::VectorXd const &delta) const {
+    auto result = clone();
+    if (getNpar() > 0) result->offsetParams(delta.segment(index, getNpar()));
+    return result;
+}
+
+std::unique_ptr<SimpleAstrometryMapping> SimpleAstrometryMapping::clone() const {
+    auto result = std::make_unique<SimpleAstrometryMapping>(*transform, toBeFit);
+    result->copyFitState(*this);
+    return result;
+}
+
+void SimpleAstrometryMapping::copyFitState(SimpleAstrometryMapping const &other) {
+    toBeFit = other.toBeFit;
+    index = other.index;
+    // A frozen error transform no longer follows the parameters: share it rather than the new transform.
+    if (other.errorProp != other.transform) errorProp = other.errorProp;
+}
+
 void SimpleAstrometryMapping::print(std::ostream &out) const { out << *transform; }
 
 SimplePolyMapping::SimplePolyMapping(AstrometryTransformLinear const &CenterAndScale,
@@ -90,17 +134,18 @@ SimplePolyMapping::SimplePolyMapping(AstrometryTransformLinear const &CenterAndS
 void SimplePolyMapping::positionDerivative(Point const &where, Eigen::Matrix2d &derivative,
                                            double epsilon) const {
     Point tmp = _centerAndScale.apply(where);
-    errorProp->computeDerivative(tmp, *lin, epsilon);
-    derivative(0, 0) = lin->getCoefficient(1, 0, 0);
+    AstrometryTransformLinear lin;
+    errorProp->computeDerivative(tmp, lin, epsilon);
+    derivative(0, 0) = lin.getCoefficient(1, 0, 0);
     //
     /* This does not work : it was proved by rotating the frame
        see the compilation switch ROTATE_T2 in constrainedAstrometryModel.cc
     derivative(1,0) = lin->getCoefficient(1,0,1);
     derivative(0,1) = lin->getCoefficient(0,1,0);
     */
-    derivative(1, 0) = lin->getCoefficient(0, 1, 0);
-    derivative(0, 1) = lin->getCoefficient(1, 0, 1);
-    derivative(1, 1) = lin->getCoefficient(0, 1, 1);
+    derivative(1, 0) = lin.getCoefficient(0, 1, 0);
+    derivative(0, 1) = lin.getCoefficient(1, 0, 1);
+    derivative(1, 1) = lin.getCoefficient(0, 1, 1);
     derivative = preDer * derivative;
 }
 
@@ -108,13 +153,17 @@ void SimplePolyMapping::computeTransformAndDerivatives(FatPoint const &where, Fa
                                                        Eigen::MatrixX2d &H) const {
     FatPoint mid;
     _centerAndScale.transformPosAndErrors(where, mid);
-    transform->transformPosAndErrors(mid, outPoint);
-    FatPoint tmp;
-    errorProp->transformPosAndErrors(mid, tmp);
-    outPoint.vx = tmp.vx;
-    outPoint.vy = tmp.vy;
-    outPoint.vxy = tmp.vxy;
-    transform->paramDerivatives(mid, &H(0, 0), &H(0, 1));
+    // Cannot fail given the contructor. The monomials are evaluated once for the position, the errors
+    // and the parameter derivatives.
+    auto const &poly = static_cast<AstrometryTransformPolynomial const &>(*transform);
+    poly.computeTransformAndDerivatives(mid, outPoint, &H(0, 0), &H(0, 1));
+    if (errorProp != transform) {
+        FatPoint tmp;
+        errorProp->transformPosAndErrors(mid, tmp);
+        outPoint.vx = tmp.vx;
+        outPoint.vy = tmp.vy;
+        outPoint.vxy = tmp.vxy;
+    }
 }
 
 void SimplePolyMapping::transformPosAndErrors(FatPoint const &where, FatPoint &outPoint) const {
@@ -128,6 +177,54 @@ void SimplePolyMapping::transformPosAndErrors(FatPoint const &where, FatPoint &o
     outPoint.vxy = tmp.vxy;
 }
 
+void SimplePolyMapping::computeTransformAndDerivativesBatch(FatPointArrays const &where,
+                                                            FatPointArrays &outPoints,
+                                                            Eigen::MatrixXd &H) const {
+    H.resize(getNpar(), 2 * where.size());
+    if (H.rows() == 0) {
+        transformPosAndErrorsBatch(where, outPoints);
+        return;
+    }
+    FatPointArrays mid;
+    _centerAndScale.transformPosAndErrorsBatch(where, mid);
+    // Cannot fail given the contructor. A non-virtual call per point, as in the single point version.
+    auto const &poly = static_cast<AstrometryTransformPolynomial const &>(*transform);
+    outPoints.resize(where.size());
+    FatPoint outPoint;
+    for (Eigen::Index k = 0; k < where.size(); ++k) {
+        poly.computeTransformAndDerivatives(mid.get(k), outPoint, &H(0, 2 * k), &H(0, 2 * k + 1));
+        outPoints.set(k, outPoint);
+    }
+    if (errorProp != transform) {
+        FatPointArrays tmp;
+        errorProp->transformPosAndErrorsBatch(mid, tmp);
+        outPoints.vx = tmp.vx;
+        outPoints.vy = tmp.vy;
+        outPoints.vxy = tmp.vxy;
+    }
+}
+
+void SimplePolyMapping::transformPosAndErrorsBatch(FatPointArrays const &where,
+                                                   FatPointArrays &outPoints) const {
+    FatPointArrays mid;
+    _centerAndScale.transformPosAndErrorsBatch(where, mid);
+    transform->transformPosAndErrorsBatch(mid, outPoints);
+    if (errorProp == transform) return;
+    FatPointArrays tmp;
+    errorProp->transformPosAndErrorsBatch(mid, tmp);
+    outPoints.vx = tmp.vx;
+    outPoints.vy = tmp.vy;
+    outPoints.vxy = tmp.vxy;
+}
+
+std::unique_ptr<SimpleAstrometryMapping> SimplePolyMapping::clone() const {
+    // Cannot fail given the contructor.
+    auto const &fittedPoly = dynamic_cast<AstrometryTransformPolynomial const &>(*transform);
+    auto result = std::make_unique<SimplePolyMapping>(_centerAndScale, fittedPoly);
+    result->copyFitState(*this);
+    return result;
+}
+
 AstrometryTransform const &SimplePolyMapping::getTransform() const {
     // Cannot fail given the contructor:
     const AstrometryTransformPolynomial *fittedPoly =
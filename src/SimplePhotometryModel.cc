@@ -76,8 +76,13 @@ std::size_t SimplePhotometryModel::getTotalParameters() const {
 void SimplePhotometryModel::computeParameterDerivatives(MeasuredStar const &measuredStar,
                                                         CcdImage const &ccdImage,
                                                         Eigen::VectorXd &derivatives) const {
-    auto mapping = findMapping(ccdImage);
-    mapping->computeParameterDerivatives(measuredStar, measuredStar.getInstFlux(), derivatives);
+    computeParameterDerivatives(measuredStar, *findMapping(ccdImage), derivatives);
+}
+
+void SimplePhotometryModel::computeParameterDerivatives(MeasuredStar const &measuredStar,
+                                                        PhotometryMappingBase const &mapping,
+                                                        Eigen::VectorXd &derivatives) const {
+    mapping.computeParameterDerivatives(measuredStar, measuredStar.getInstFlux(), derivatives);
 }
 
 void SimplePhotometryModel::print(std::ostream &out) const {
@@ -108,7 +113,12 @@ SimpleFluxModel::SimpleFluxModel(CcdImageList const &ccdImageList, double errorP
 }
 
 double SimpleFluxModel::computeResidual(CcdImage const &ccdImage, MeasuredStar const &measuredStar) const {
-    return transform(ccdImage, measuredStar) - measuredStar.getFittedStar()->getFlux();
+    return computeResidual(measuredStar, *measuredStar.getFittedStar(), *findMapping(ccdImage));
+}
+
+double SimpleFluxModel::computeResidual(MeasuredStar const &measuredStar, FittedStar const &fittedStar,
+                                        PhotometryMappingBase const &mapping) const {
+    return mapping.transform(measuredStar, measuredStar.getInstFlux()) - fittedStar.getFlux();
 }
 
 double SimpleFluxModel::transform(CcdImage const &ccdImage, MeasuredStar const &star) const {
@@ -117,9 +127,12 @@ double SimpleFluxModel::transform(CcdImage const &ccdImage, MeasuredStar const &
 }
 
 double SimpleFluxModel::transformError(CcdImage const &ccdImage, MeasuredStar const &star) const {
-    auto mapping = findMapping(ccdImage);
+    return transformError(star, *findMapping(ccdImage));
+}
+
+double SimpleFluxModel::transformError(MeasuredStar const &star, PhotometryMappingBase const &mapping) const {
     double tempErr = tweakFluxError(star);
-    return mapping->transformError(star, star.getInstFlux(), tempErr);
+    return mapping.transformError(star, star.getInstFlux(), tempErr);
 }
 
 std::shared_ptr<afw::image::PhotoCalib> SimpleFluxModel::toPhotoCalib(CcdImage const &ccdImage) const {
@@ -147,7 +160,12 @@ SimpleMagnitudeModel::SimpleMagnitudeModel(CcdImageList const &ccdImageList, dou
 
 double SimpleMagnitudeModel::computeResidual(CcdImage const &ccdImage,
                                              MeasuredStar const &measuredStar) const {
-    return transform(ccdImage, measuredStar) - measuredStar.getFittedStar()->getMag();
+    return computeResidual(measuredStar, *measuredStar.getFittedStar(), *findMapping(ccdImage));
+}
+
+double SimpleMagnitudeModel::computeResidual(MeasuredStar const &measuredStar, FittedStar const &fittedStar,
+                                             PhotometryMappingBase const &mapping) const {
+    return mapping.transform(measuredStar, measuredStar.getInstMag()) - fittedStar.getMag();
 }
 
 double SimpleMagnitudeModel::transform(CcdImage const &ccdImage, MeasuredStar const &star) const {
@@ -156,9 +174,13 @@ double SimpleMagnitudeModel::transform(CcdImage const &ccdImage, MeasuredStar co
 }
 
 double SimpleMagnitudeModel::transformError(CcdImage const &ccdImage, MeasuredStar const &star) const {
-    auto mapping = findMapping(ccdImage);
+    return transformError(star, *findMapping(ccdImage));
+}
+
+double SimpleMagnitudeModel::transformError(MeasuredStar const &star,
+                                            PhotometryMappingBase const &mapping) const {
     double tempErr = tweakMagnitudeError(star);
-    return mapping->transformError(star, star.getInstMag(), tempErr);
+    return mapping.transformError(star, star.getInstMag(), tempErr);
 }
 
 std::shared_ptr<afw::image::PhotoCalib> SimpleMagnitudeModel::toPhotoCalib(CcdImage const &ccdImage) const {
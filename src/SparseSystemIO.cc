@@ -0,0 +1,233 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "lsst/pex/exceptions.h"
+
+#include "lsst/jointcal/SparseSystemIO.h"
+
+namespace pexExcept = lsst::pex::exceptions;
+
+namespace lsst {
+namespace jointcal {
+
+namespace {
+
+char const magic[8] = {'J', 'C', 'S', 'P', 'A', 'R', 'S', 'E'};
+std::uint32_t const byteOrderMark = 0x01020304;
+std::uint32_t const formatVersion = 1;
+
+struct Header {
+    char magic[8];
+    std::uint32_t byteOrderMark;
+    std::uint32_t version;
+    std::uint32_t lowerTriangle;
+    std::uint32_t indexSize;
+    std::int64_t nRows;
+    std::int64_t nCols;
+    std::int64_t nNonZeros;
+    std::int64_t nGradient;
+};
+static_assert(sizeof(Header) == 56, "the file header must not be padded");
+
+template <typename T>
+void writeArray(std::ostream &stream, T const *data, std::int64_t size) {
+    stream.write(reinterpret_cast<char const *>(data), size * sizeof(T));
+}
+
+template <typename T>
+void readArray(std::istream &stream, T *data, std::int64_t size, std::string const &path) {
+    stream.read(reinterpret_cast<char *>(data), size * sizeof(T));
+    if (!stream) {
+        throw LSST_EXCEPT(pexExcept::IoError, "Truncated sparse system file: " + path);
+    }
+}
+
+/// Number of entries of column j, whether the matrix is compressed or not.
+Eigen::Index columnSize(SparseMatrixD const &matrix, Eigen::Index j) {
+    if (matrix.isCompressed()) {
+        return matrix.outerIndexPtr()[j + 1] - matrix.outerIndexPtr()[j];
+    }
+    return matrix.innerNonZeroPtr()[j];
+}
+
+void checkStream(std::ios const &stream, std::string const &path) {
+    if (!stream) {
+        throw LSST_EXCEPT(pexExcept::IoError, "Cannot write to file: " + path);
+    }
+}
+}  // namespace
+
+void writeSparseSystem(std::string const &path, SparseMatrixD const &hessian,
+                       Eigen::VectorXd const &gradient) {
+    static_assert(sizeof(SparseMatrixD::StorageIndex) == sizeof(std::int64_t),
+                  "the file indices are the SparseMatrixD indices");
+    std::ofstream file(path, std::ios::binary);
+    checkStream(file, path);
+
+    Header header;
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.byteOrderMark = byteOrderMark;
+    header.version = formatVersion;
+    header.lowerTriangle = 1;
+    header.indexSize = sizeof(std::int64_t);
+    header.nRows = hessian.rows();
+    header.nCols = hessian.cols();
+    header.nNonZeros = hessian.nonZeros();
+    header.nGradient = gradient.size();
+    writeArray(file, &header, 1);
+
+    // Each array is streamed column by column, which also skips the free space of uncompressed columns.
+    if (hessian.isCompressed()) {
+        writeArray(file, hessian.outerIndexPtr(), hessian.cols() + 1);
+    } else {
+        std::int64_t start = 0;
+        writeArray(file, &start, 1);
+        for (Eigen::Index j = 0; j < hessian.cols(); ++j) {
+            start += columnSize(hessian, j);
+            writeArray(file, &start, 1);
+        }
+    }
+    for (Eigen::Index j = 0; j < hessian.cols(); ++j) {
+        writeArray(file, hessian.innerIndexPtr() + hessian.outerIndexPtr()[j], columnSize(hessian, j));
+    }
+    for (Eigen::Index j = 0; j < hessian.cols(); ++j) {
+        writeArray(file, hessian.valuePtr() + hessian.outerIndexPtr()[j], columnSize(hessian, j));
+    }
+    writeArray(file, gradient.data(), gradient.size());
+    file.close();
+    checkStream(file, path);
+}
+
+SparseSystem readSparseSystem(std::string const &path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw LSST_EXCEPT(pexExcept::IoError, "Cannot open file: " + path);
+    }
+    Header header;
+    readArray(file, &header, 1, path);
+    if (std::memcmp(header.magic, magic, sizeof(magic)) != 0) {
+        throw LSST_EXCEPT(pexExcept::IoError, "Not a jointcal sparse system file: " + path);
+    }
+    if (header.byteOrderMark != byteOrderMark) {
+        throw LSST_EXCEPT(pexExcept::IoError,
+                          "Sparse system file written with another byte order: " + path);
+    }
+    if (header.version != formatVersion || header.indexSize != sizeof(std::int64_t)) {
+        throw LSST_EXCEPT(pexExcept::IoError,
+                          "Unsupported sparse system file version " + std::to_string(header.version) +
+                                  ": " + path);
+    }
+    // Nothing is allocated from the sizes of the header before they are checked against the size of the
+    // file: a corrupted header could ask for any amount of memory. Each size is bounded first, so that the
+    // expected file size cannot overflow.
+    file.seekg(0, std::ios::end);
+    std::int64_t const fileSize = file.tellg();
+    file.seekg(sizeof(Header));
+    std::int64_t const maxEntries = fileSize / sizeof(double);
+    auto isValidSize = [maxEntries](std::int64_t size) { return size >= 0 && size <= maxEntries; };
+    if (!file || !isValidSize(header.nRows) || !isValidSize(header.nCols) ||
+        !isValidSize(header.nNonZeros) || !isValidSize(header.nGradient)) {
+        throw LSST_EXCEPT(pexExcept::IoError, "Corrupted sparse system file header: " + path);
+    }
+    std::int64_t const expectedSize = sizeof(Header) + sizeof(std::int64_t) * (header.nCols + 1) +
+                                      (sizeof(std::int64_t) + sizeof(double)) * header.nNonZeros +
+                                      sizeof(double) * header.nGradient;
+    if (fileSize != expectedSize) {
+        throw LSST_EXCEPT(pexExcept::IoError,
+                          "Sparse system file of " + std::to_string(fileSize) + " bytes instead of the " +
+                                  std::to_string(expectedSize) + " of its header: " + path);
+    }
+
+    SparseSystem system;
+    std::vector<std::int64_t> columnStarts(header.nCols + 1);
+    readArray(file, columnStarts.data(), header.nCols + 1, path);
+    // The matrix is checked before it is used: Eigen and cholmod do not check its arrays.
+    if (columnStarts.front() != 0 || columnStarts.back() != header.nNonZeros) {
+        throw LSST_EXCEPT(pexExcept::InvalidParameterError,
+                          "Sparse system column starts do not run from 0 to the number of non-zero "
+                          "entries (" + std::to_string(header.nNonZeros) + "): " + path);
+    }
+    for (std::int64_t j = 0; j < header.nCols; ++j) {
+        if (columnStarts[j + 1] < columnStarts[j]) {
+            throw LSST_EXCEPT(pexExcept::InvalidParameterError,
+                              "Sparse system column starts decrease at column " + std::to_string(j) + ": " +
+                                      path);
+        }
+    }
+    system.hessian.resize(header.nRows, header.nCols);
+    system.hessian.resizeNonZeros(header.nNonZeros);
+    std::copy(columnStarts.begin(), columnStarts.end(), system.hessian.outerIndexPtr());
+    readArray(file, system.hessian.innerIndexPtr(), header.nNonZeros, path);
+    for (std::int64_t k = 0; k < header.nNonZeros; ++k) {
+        auto row = system.hessian.innerIndexPtr()[k];
+        if (row < 0 || row >= header.nRows) {
+            throw LSST_EXCEPT(pexExcept::InvalidParameterError,
+                              "Sparse system row index " + std::to_string(row) + " is not below the " +
+                                      std::to_string(header.nRows) + " rows: " + path);
+        }
+    }
+    readArray(file, system.hessian.valuePtr(), header.nNonZeros, path);
+    system.gradient.resize(header.nGradient);
+    readArray(file, system.gradient.data(), header.nGradient, path);
+    return system;
+}
+
+void writeMatrixMarket(std::string const &matrixPath, std::string const &gradientPath,
+                       SparseMatrixD const &hessian, Eigen::VectorXd const &gradient) {
+    std::ofstream matrixFile(matrixPath);
+    checkStream(matrixFile, matrixPath);
+    matrixFile.precision(std::numeric_limits<double>::max_digits10);
+    // The symmetric Matrix Market format stores the lower triangle, with 1-based indices.
+    matrixFile << "%%MatrixMarket matrix coordinate real symmetric\n";
+    matrixFile << hessian.rows() << " " << hessian.cols() << " " << hessian.nonZeros() << "\n";
+    for (Eigen::Index j = 0; j < hessian.outerSize(); ++j) {
+        for (SparseMatrixD::InnerIterator it(hessian, j); it; ++it) {
+            matrixFile << it.row() + 1 << " " << j + 1 << " " << it.value() << "\n";
+        }
+    }
+    matrixFile.close();
+    checkStream(matrixFile, matrixPath);
+
+    std::ofstream gradientFile(gradientPath);
+    checkStream(gradientFile, gradientPath);
+    gradientFile.precision(std::numeric_limits<double>::max_digits10);
+    gradientFile << "%%MatrixMarket matrix array real general\n";
+    gradientFile << gradient.size() << " 1\n";
+    for (Eigen::Index i = 0; i < gradient.size(); ++i) {
+        gradientFile << gradient[i] << "\n";
+    }
+    gradientFile.close();
+    checkStream(gradientFile, gradientPath);
+}
+
+}  // namespace jointcal
+}  // namespace lsst
@@ -0,0 +1,161 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+#include "lsst/pex/exceptions.h"
+
+#include "lsst/jointcal/SparsityPattern.h"
+
+namespace lsst {
+namespace jointcal {
+
+namespace {
+// 64 bit FNV-1a, fed with whole indices rather than bytes.
+std::uint64_t const fnvOffset = 14695981039346656037ULL;
+std::uint64_t const fnvPrime = 1099511628211ULL;
+
+void hashCombine(std::uint64_t &hash, std::uint64_t value) {
+    hash ^= value;
+    hash *= fnvPrime;
+}
+
+void checkCompressed(SparseMatrixD const &matrix) {
+    if (!matrix.isCompressed()) {
+        throw LSST_EXCEPT(pex::exceptions::InvalidParameterError,
+                          "SparsityPattern requires a compressed sparse matrix.");
+    }
+}
+}  // namespace
+
+void SparsityPattern::reset(SparseMatrixD const &matrix) {
+    checkCompressed(matrix);
+    _rows = matrix.rows();
+    _cols = matrix.cols();
+    _outer.assign(matrix.outerIndexPtr(), matrix.outerIndexPtr() + matrix.outerSize() + 1);
+    _inner.assign(matrix.innerIndexPtr(), matrix.innerIndexPtr() + matrix.nonZeros());
+    _hash = computeHash(matrix);
+}
+
+void SparsityPattern::clear() {
+    _rows = _cols = 0;
+    std::vector<SparseMatrixD::StorageIndex>().swap(_outer);
+    std::vector<SparseMatrixD::StorageIndex>().swap(_inner);
+    _hash = 0;
+}
+
+bool SparsityPattern::isSame(SparseMatrixD const &matrix) const {
+    if (empty() || matrix.rows() != _rows || matrix.cols() != _cols ||
+        matrix.nonZeros() != static_cast<Eigen::Index>(_inner.size())) {
+        return false;
+    }
+    if (computeHash(matrix) != _hash) return false;
+    // Equal hashes: check the indices themselves, which is cheap compared to a factorization.
+    return std::equal(_outer.begin(), _outer.end(), matrix.outerIndexPtr()) &&
+           std::equal(_inner.begin(), _inner.end(), matrix.innerIndexPtr());
+}
+
+bool SparsityPattern::contains(SparseMatrixD const &matrix) const {
+    checkCompressed(matrix);
+    if (empty() || matrix.rows() != _rows || matrix.cols() != _cols ||
+        matrix.nonZeros() > static_cast<Eigen::Index>(_inner.size())) {
+        return false;
+    }
+    auto const *outer = matrix.outerIndexPtr();
+    auto const *inner = matrix.innerIndexPtr();
+    for (Eigen::Index col = 0; col < _cols; ++col) {
+        // Both columns are sorted: every index of matrix must be found while walking ours.
+        auto mine = _inner.begin() + _outer[col];
+        auto const mineEnd = _inner.begin() + _outer[col + 1];
+        for (auto k = outer[col]; k < outer[col + 1]; ++k) {
+            mine = std::lower_bound(mine, mineEnd, inner[k]);
+            if (mine == mineEnd || *mine != inner[k]) return false;
+            ++mine;
+        }
+    }
+    return true;
+}
+
+SparseMatrixD SparsityPattern::makeMatrix(std::vector<double> const &values) const {
+    if (values.size() != _inner.size()) {
+        throw LSST_EXCEPT(pex::exceptions::LengthError,
+                          "Cannot make a matrix of " + std::to_string(_inner.size()) + " entries from " +
+                                  std::to_string(values.size()) + " values.");
+    }
+    SparseMatrixD result(_rows, _cols);
+    result.resizeNonZeros(_inner.size());
+    std::copy(_outer.begin(), _outer.end(), result.outerIndexPtr());
+    std::copy(_inner.begin(), _inner.end(), result.innerIndexPtr());
+    std::copy(values.begin(), values.end(), result.valuePtr());
+    return result;
+}
+
+SparseMatrixD SparsityPattern::embed(SparseMatrixD const &matrix) const {
+    checkCompressed(matrix);
+    if (matrix.rows() != _rows || matrix.cols() != _cols) {
+        throw LSST_EXCEPT(pex::exceptions::InvalidParameterError,
+                          "Cannot embed a matrix in a sparsity pattern of different dimensions.");
+    }
+    SparseMatrixD result(_rows, _cols);
+    result.resizeNonZeros(_inner.size());
+    std::copy(_outer.begin(), _outer.end(), result.outerIndexPtr());
+    std::copy(_inner.begin(), _inner.end(), result.innerIndexPtr());
+    std::fill(result.valuePtr(), result.valuePtr() + _inner.size(), 0.);
+    auto const *outer = matrix.outerIndexPtr();
+    auto const *inner = matrix.innerIndexPtr();
+    auto const *values = matrix.valuePtr();
+    for (Eigen::Index col = 0; col < _cols; ++col) {
+        auto mine = _inner.begin() + _outer[col];
+        auto const mineEnd = _inner.begin() + _outer[col + 1];
+        for (auto k = outer[col]; k < outer[col + 1]; ++k) {
+            mine = std::lower_bound(mine, mineEnd, inner[k]);
+            if (mine == mineEnd || *mine != inner[k]) {
+                throw LSST_EXCEPT(pex::exceptions::InvalidParameterError,
+                                  "Cannot embed a matrix in a sparsity pattern that does not contain it.");
+            }
+            result.valuePtr()[mine - _inner.begin()] = values[k];
+            ++mine;
+        }
+    }
+    return result;
+}
+
+std::size_t SparsityPattern::computeHash(SparseMatrixD const &matrix) {
+    checkCompressed(matrix);
+    std::uint64_t hash = fnvOffset;
+    hashCombine(hash, matrix.rows());
+    hashCombine(hash, matrix.cols());
+    for (Eigen::Index i = 0; i <= matrix.outerSize(); ++i) {
+        hashCombine(hash, matrix.outerIndexPtr()[i]);
+    }
+    for (Eigen::Index i = 0; i < matrix.nonZeros(); ++i) {
+        hashCombine(hash, matrix.innerIndexPtr()[i]);
+    }
+    return static_cast<std::size_t>(hash);
+}
+
+}  // namespace jointcal
+}  // namespace lsst
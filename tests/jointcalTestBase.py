@@ -233,8 +233,13 @@ class JointcalTestBase:
             Result metric dictionary from jointcal.py
         expect : dict
             Expected metric dictionary; set a value to None to not test it.
+            The resources used by each phase, which vary from run to run,
+            are never tested.
         """
+        phaseResources = ("_wallSeconds", "_cpuSeconds", "_peakResidentBytes", "_peakResidentIncreaseBytes")
         for key in result:
+            if key.metric.endswith(phaseResources):
+                continue
             if expect[key.metric] is not None:
                 value = result[key].quantity.value
                 if isinstance(value, float):
@@ -166,6 +166,39 @@ class AstrometryModelTestBase:
     def testMakeSkyWcsModel2(self):
         self.CheckMakeSkyWcsModel(self.model2, self.fitter2, self.inverseMaxDiff2)
 
+    def testMappingBatchModel1(self):
+        self.checkMappingBatch(self.model1)
+
+    def testMappingBatchModel2(self):
+        self.checkMappingBatch(self.model2)
+
+    def checkMappingBatch(self, model):
+        """Test that the batch transforms of the mappings match their single
+        point versions, with the derivatives of point k in columns 2k, 2k+1.
+        """
+        rng = np.random.RandomState(100)
+        for ccdImage in self.associations.getCcdImageList():
+            mapping = model.getMapping(ccdImage)
+            bbox = ccdImage.getDetector().getBBox()
+            num = 20
+            stars = [lsst.jointcal.star.BaseStar(x, y, 0, 0)
+                     for x, y in zip(rng.uniform(bbox.getMinX(), bbox.getMaxX(), num),
+                                     rng.uniform(bbox.getMinY(), bbox.getMaxY(), num))]
+            inputs = [np.array([getattr(star, name) for star in stars])
+                      for name in ("x", "y", "vx", "vy", "vxy")]
+            batch = mapping.transformPosAndErrorsBatch(*inputs)
+            *batchWithDerivatives, H = mapping.computeTransformAndDerivativesBatch(*inputs)
+            self.assertEqual(H.shape, (mapping.getNpar(), 2*num))
+            for result, expect in zip(batchWithDerivatives, batch):
+                self.assertFloatsAlmostEqual(result, expect, rtol=1e-13)
+            for k, star in enumerate(stars):
+                expect = mapping.transformPosAndErrors(star)
+                expectWithDerivatives, expectH = mapping.computeTransformAndDerivatives(star)
+                self.assertFloatsAlmostEqual(batch[0][k], expect.x, rtol=1e-13)
+                self.assertFloatsAlmostEqual(batch[1][k], expect.y, rtol=1e-13)
+                self.assertFloatsAlmostEqual(expectWithDerivatives.x, expect.x, rtol=1e-13)
+                self.assertFloatsAlmostEqual(H[:, 2*k:2*k + 2], expectH, rtol=1e-13, atol=1e-15)
+
     def CheckMakeSkyWcsModel(self, model, fitter, inverseMaxDiff):
         """Test producing a SkyWcs on a model for every cdImage,
         both post-initialization and after one fitting step.
@@ -27,9 +27,11 @@ import lsst.utils.tests
 
 import lsst.geom
 import lsst.log
+import lsst.pex.exceptions
 import lsst.jointcal
 from lsst.jointcal.astrometryTransform import (AstrometryTransformLinear,
-                                               AstrometryTransformPolynomial, inversePolyTransform)
+                                               AstrometryTransformPolynomial, inversePolyTransform,
+                                               TanPixelToRaDec)
 
 
 class AstrometryTransformPolynomialBase:
@@ -210,6 +212,163 @@ class AstrometryTransformPolynomialTestCase(AstrometryTransformPolynomialBase, l
         self.assertIn(expect, str(poly2))
 
 
+class PolynomialKernelTestCase(lsst.utils.tests.TestCase):
+    """Test the polynomials of the orders with compiled kernels against the
+    generic code, used for larger orders."""
+    def setUp(self):
+        np.random.seed(100)
+        self.points = [lsst.jointcal.star.Point(x, y) for x, y in np.random.uniform(-1, 1, (100, 2))]
+
+    def testKernels(self):
+        for order in range(1, 10):
+            with self.subTest(order=order):
+                poly = AstrometryTransformPolynomial(order)
+                # zero-padded to an order without kernel.
+                generic = AstrometryTransformPolynomial(10)
+                for degree in range(order + 1):
+                    for powY in range(degree + 1):
+                        for whichCoord in range(2):
+                            value = np.random.uniform(-1, 1)
+                            poly.setCoefficient(degree - powY, powY, whichCoord, value)
+                            generic.setCoefficient(degree - powY, powY, whichCoord, value)
+                for point in self.points:
+                    result = poly.apply(point)
+                    expect = generic.apply(point)
+                    self.assertFloatsAlmostEqual(result.x, expect.x, rtol=1e-14, atol=1e-14)
+                    self.assertFloatsAlmostEqual(result.y, expect.y, rtol=1e-14, atol=1e-14)
+                    derivative = poly.computeDerivative(point, 0.01)
+                    expectDerivative = generic.computeDerivative(point, 0.01)
+                    for powX, powY, whichCoord in ((1, 0, 0), (0, 1, 0), (1, 0, 1), (0, 1, 1)):
+                        self.assertFloatsAlmostEqual(derivative.getCoefficient(powX, powY, whichCoord),
+                                                     expectDerivative.getCoefficient(powX, powY, whichCoord),
+                                                     rtol=1e-13, atol=1e-13)
+
+
+class ApplyBatchTestCase(AstrometryTransformPolynomialBase, lsst.utils.tests.TestCase):
+    """Test that the batched transforms agree with the point by point ones."""
+    def setUp(self):
+        super().setUp()
+        size = 500
+        self.x = np.random.uniform(0, 1000, size)
+        self.y = np.random.uniform(0, 1000, size)
+        self.vx = np.random.uniform(0.5, 2, size)
+        self.vy = np.random.uniform(0.5, 2, size)
+        self.vxy = np.random.uniform(-0.2, 0.2, size)
+
+        self.linear = AstrometryTransformLinear()
+        self.linear.setCoefficient(0, 0, 0, -0.1)
+        self.linear.setCoefficient(1, 0, 0, 5e-5)
+        self.linear.setCoefficient(0, 1, 0, 2e-7)
+        self.linear.setCoefficient(0, 0, 1, 0.2)
+        self.linear.setCoefficient(1, 0, 1, -1e-7)
+        self.linear.setCoefficient(0, 1, 1, 5e-5)
+        self.tanPixelToRaDec = TanPixelToRaDec(self.linear, lsst.jointcal.star.Point(30, -20))
+
+    def checkApplyBatch(self, transform, x, y):
+        xOut, yOut = transform.applyBatch(x, y)
+        expect = [transform.apply(lsst.jointcal.star.Point(xx, yy)) for xx, yy in zip(x, y)]
+        np.testing.assert_allclose(xOut, [point.x for point in expect], rtol=1e-12)
+        np.testing.assert_allclose(yOut, [point.y for point in expect], rtol=1e-12)
+
+    def checkTransformPosAndErrorsBatch(self, transform, x, y, step=0.01, rtol=1e-11):
+        """Compare with the errors propagated through computeDerivative,
+        which is analytic for polynomials and gnomonic projections."""
+        xOut, yOut, vxOut, vyOut, vxyOut = transform.transformPosAndErrorsBatch(x, y, self.vx, self.vy,
+                                                                                self.vxy)
+        xExpect, yExpect = transform.applyBatch(x, y)
+        np.testing.assert_allclose(xOut, xExpect, rtol=1e-13)
+        np.testing.assert_allclose(yOut, yExpect, rtol=1e-13)
+        for i in range(len(x)):
+            derivative = transform.computeDerivative(lsst.jointcal.star.Point(x[i], y[i]), step)
+            a11 = derivative.getCoefficient(1, 0, 0)
+            a12 = derivative.getCoefficient(0, 1, 0)
+            a21 = derivative.getCoefficient(1, 0, 1)
+            a22 = derivative.getCoefficient(0, 1, 1)
+            vx, vy, vxy = self.vx[i], self.vy[i], self.vxy[i]
+            # the covariance can be close to zero: compare it on the scale of the variances.
+            atol = rtol*(vxOut[i] + vyOut[i])
+            self.assertFloatsAlmostEqual(vxOut[i], a11*(a11*vx + 2*a12*vxy) + a12*a12*vy, rtol=rtol)
+            self.assertFloatsAlmostEqual(vyOut[i], a21*a21*vx + a22*a22*vy + 2*a21*a22*vxy, rtol=rtol)
+            self.assertFloatsAlmostEqual(vxyOut[i], a21*a11*vx + a22*a12*vy + (a21*a12 + a11*a22)*vxy,
+                                         rtol=rtol, atol=atol)
+
+    def testPolynomial(self):
+        for poly in (self.polyIdentity, self.poly2, self.poly3, self.poly9):
+            with self.subTest(order=poly.getOrder()):
+                self.checkApplyBatch(poly, self.x, self.y)
+                self.checkTransformPosAndErrorsBatch(poly, self.x, self.y)
+
+    def testLinear(self):
+        self.checkApplyBatch(self.linear, self.x, self.y)
+        self.checkTransformPosAndErrorsBatch(self.linear, self.x, self.y)
+
+    def testTan(self):
+        self.checkApplyBatch(self.tanPixelToRaDec, self.x, self.y)
+        raDec = self.tanPixelToRaDec.applyBatch(self.x, self.y)
+        tanRaDecToPixel = self.tanPixelToRaDec.inverted()
+        self.checkApplyBatch(tanRaDecToPixel, *raDec)
+        # the inverse of the batch is the batch of the inverse.
+        xOut, yOut = tanRaDecToPixel.applyBatch(*raDec)
+        np.testing.assert_allclose(xOut, self.x, atol=1e-7)
+        np.testing.assert_allclose(yOut, self.y, atol=1e-7)
+        self.checkTransformPosAndErrorsBatch(tanRaDecToPixel, *raDec, rtol=1e-10)
+
+    def testSizeMismatch(self):
+        with self.assertRaises(lsst.pex.exceptions.LengthError):
+            self.poly2.applyBatch(self.x, self.y[:-1])
+        with self.assertRaises(lsst.pex.exceptions.LengthError):
+            self.poly2.transformPosAndErrorsBatch(self.x, self.y, self.vx, self.vy, self.vxy[:-1])
+
+
+class DerivativeTestCase(lsst.utils.tests.TestCase):
+    """Test the analytic derivatives of the gnomonic projections against
+    central finite differences."""
+    def setUp(self):
+        np.random.seed(200)
+        self.x = np.random.uniform(0, 1000, 50)
+        self.y = np.random.uniform(0, 1000, 50)
+        linear = AstrometryTransformLinear()
+        linear.setCoefficient(0, 0, 0, -0.1)
+        linear.setCoefficient(1, 0, 0, 5e-5)
+        linear.setCoefficient(0, 1, 0, 2e-7)
+        linear.setCoefficient(0, 0, 1, 0.2)
+        linear.setCoefficient(1, 0, 1, -1e-7)
+        linear.setCoefficient(0, 1, 1, 5e-5)
+        self.tanPixelToRaDec = TanPixelToRaDec(linear, lsst.jointcal.star.Point(30, -20))
+
+    def checkDerivative(self, transform, x, y, step, rtol):
+        for xx, yy in zip(x, y):
+            derivative = transform.computeDerivative(lsst.jointcal.star.Point(xx, yy), 0.01)
+            # the step is ignored by the analytic derivatives: compare with a numeric one.
+            plusX = transform.apply(lsst.jointcal.star.Point(xx + step, yy))
+            minusX = transform.apply(lsst.jointcal.star.Point(xx - step, yy))
+            plusY = transform.apply(lsst.jointcal.star.Point(xx, yy + step))
+            minusY = transform.apply(lsst.jointcal.star.Point(xx, yy - step))
+            expect = np.array([[plusX.x - minusX.x, plusY.x - minusY.x],
+                               [plusX.y - minusX.y, plusY.y - minusY.y]]) / (2*step)
+            result = np.array([[derivative.getCoefficient(1, 0, 0), derivative.getCoefficient(0, 1, 0)],
+                               [derivative.getCoefficient(1, 0, 1), derivative.getCoefficient(0, 1, 1)]])
+            np.testing.assert_allclose(result, expect, rtol=rtol, atol=rtol*np.abs(expect).max())
+            self.assertEqual(derivative.getCoefficient(0, 0, 0), 0)
+            self.assertEqual(derivative.getCoefficient(0, 0, 1), 0)
+
+    def testTanPixelToRaDec(self):
+        self.checkDerivative(self.tanPixelToRaDec, self.x, self.y, step=1e-2, rtol=1e-7)
+
+    def testTanRaDecToPixel(self):
+        raDec = self.tanPixelToRaDec.applyBatch(self.x, self.y)
+        self.checkDerivative(self.tanPixelToRaDec.inverted(), *raDec, step=1e-6, rtol=1e-6)
+
+    def testApplyWithDerivative(self):
+        """linearApproximation goes through applyWithDerivative."""
+        where = lsst.jointcal.star.Point(self.x[0], self.y[0])
+        approximation = self.tanPixelToRaDec.linearApproximation(where, 0.01)
+        expect = self.tanPixelToRaDec.apply(where)
+        result = approximation.apply(where)
+        self.assertFloatsAlmostEqual(result.x, expect.x, rtol=1e-12)
+        self.assertFloatsAlmostEqual(result.y, expect.y, rtol=1e-12)
+
+
 class MemoryTester(lsst.utils.tests.MemoryTestCase):
     pass
 
@@ -0,0 +1,129 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_DYN_LINK
+
+#define BOOST_TEST_MODULE test_chi2
+
+// The boost unit test header
+#include "boost/test/unit_test.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "lsst/pex/exceptions.h"
+#include "lsst/jointcal/Chi2.h"
+
+namespace jointcal = lsst::jointcal;
+
+namespace {
+// A list of measurement terms of one ccdImage, with these chi2.
+jointcal::Chi2List makeChi2List(std::vector<double> const &chi2s) {
+    jointcal::Chi2List chi2List;
+    chi2List.beginCcdImage(0);
+    for (std::size_t i = 0; i < chi2s.size(); ++i) chi2List.addEntry(chi2s[i], 2, i);
+    return chi2List;
+}
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(test_summary_odd) {
+    auto chi2List = makeChi2List({5, 1, 3});
+    jointcal::Chi2Summary summary = chi2List.computeSummary();
+    BOOST_CHECK_EQUAL(summary.median, 3);
+    BOOST_CHECK_CLOSE(summary.average, 3, 1e-12);
+    BOOST_CHECK_CLOSE(summary.sigma, std::sqrt(8. / 3.), 1e-12);
+}
+
+BOOST_AUTO_TEST_CASE(test_summary_even) {
+    // the median is the mean of the two middle values.
+    auto chi2List = makeChi2List({4, 1, 3, 2});
+    jointcal::Chi2Summary summary = chi2List.computeSummary();
+    BOOST_CHECK_EQUAL(summary.median, 2.5);
+    BOOST_CHECK_CLOSE(summary.average, 2.5, 1e-12);
+    BOOST_CHECK_CLOSE(summary.sigma, std::sqrt(1.25), 1e-12);
+
+    auto pair = makeChi2List({7, 2});
+    BOOST_CHECK_EQUAL(pair.computeSummary().median, 4.5);
+}
+
+BOOST_AUTO_TEST_CASE(test_summary_empty) {
+    jointcal::Chi2List chi2List;
+    jointcal::Chi2Summary summary = chi2List.computeSummary();
+    BOOST_CHECK(std::isnan(summary.average));
+    BOOST_CHECK(std::isnan(summary.median));
+    BOOST_CHECK(std::isnan(summary.sigma));
+    BOOST_CHECK_EQUAL(chi2List.selectAbove(0), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(test_select_above) {
+    // equal chi2 are ordered by kind, ccdImage index, then star index, whatever their order in the list.
+    jointcal::Chi2List chi2List;
+    chi2List.beginCcdImage(1);
+    chi2List.addEntry(9, 2, 5);
+    chi2List.addEntry(1, 2, 6);
+    chi2List.addEntry(9, 2, 2);
+    chi2List.beginCcdImage(0);
+    chi2List.addEntry(9, 2, 7);
+    chi2List.addEntry(12, 2, 3);
+    chi2List.beginReferences();
+    chi2List.addEntry(9, 2, 0);
+    chi2List.addEntry(4, 2, 1);
+
+    BOOST_REQUIRE_EQUAL(chi2List.selectAbove(9), 5u);
+    struct Expected {
+        double chi2;
+        jointcal::Chi2TermKind kind;
+        std::uint32_t ccdImageIndex;
+        std::uint64_t starIndex;
+    };
+    auto measurement = jointcal::Chi2TermKind::Measurement;
+    std::vector<Expected> expected = {{12, measurement, 0, 3},
+                                      {9, measurement, 0, 7},
+                                      {9, measurement, 1, 2},
+                                      {9, measurement, 1, 5},
+                                      {9, jointcal::Chi2TermKind::Reference, 0, 0}};
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+        BOOST_CHECK_EQUAL(chi2List[i].chi2, expected[i].chi2);
+        BOOST_CHECK(chi2List[i].kind == expected[i].kind);
+        BOOST_CHECK_EQUAL(chi2List[i].starIndex, expected[i].starIndex);
+        if (expected[i].kind == measurement) {
+            BOOST_CHECK_EQUAL(chi2List[i].ccdImageIndex, expected[i].ccdImageIndex);
+        }
+    }
+
+    BOOST_CHECK_EQUAL(chi2List.selectAbove(100), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(test_ccd_image_index_range) {
+    jointcal::Chi2List chi2List;
+    std::size_t const maxIndex = std::numeric_limits<std::uint32_t>::max();
+    chi2List.beginCcdImage(maxIndex);
+    chi2List.addEntry(1, 2, 0);
+    BOOST_CHECK_EQUAL(chi2List[0].ccdImageIndex, maxIndex);
+    if (std::numeric_limits<std::size_t>::max() > maxIndex) {
+        BOOST_CHECK_THROW(chi2List.beginCcdImage(maxIndex + 1), lsst::pex::exceptions::LengthError);
+    }
+}
@@ -0,0 +1,134 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#define BOOST_TEST_DYN_LINK
+
+#define BOOST_TEST_MODULE test_compactJacobian
+
+// The boost unit test header
+#include "boost/test/unit_test.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "Eigen/Core"
+
+#include "lsst/jointcal/CompactJacobian.h"
+#include "lsst/jointcal/Eigenstuff.h"
+#include "lsst/jointcal/Tripletlist.h"
+
+namespace jointcal = lsst::jointcal;
+
+namespace {
+Eigen::Index const nParTot = 12;
+
+// A few terms, some of them with repeated parameters and zero derivatives.
+struct Term {
+    IndexVector indices;
+    Eigen::MatrixXd jacobian;
+};
+
+std::vector<Term> makeTerms() {
+    std::vector<Term> terms;
+    for (int k = 0; k < 10; ++k) {
+        Term term;
+        term.indices = {k % nParTot, (3 * k + 1) % nParTot, (3 * k + 1) % nParTot, (7 * k + 2) % nParTot};
+        term.jacobian = Eigen::MatrixXd::Random(4, 2);
+        if (k % 3 == 0) term.jacobian(3, 1) = 0;
+        terms.push_back(term);
+    }
+    return terms;
+}
+
+// The lower triangle of the Hessian, computed as in the baseline: from a TripletList, with Eigen.
+Eigen::MatrixXd referenceHessian(std::vector<Term> const &terms) {
+    jointcal::TripletList tripletList(0);
+    for (auto const &term : terms) tripletList.addTerm(term.indices, term.jacobian);
+    SparseMatrixD jacobian(nParTot, tripletList.getNextFreeIndex());
+    jacobian.setFromTriplets(tripletList.begin(), tripletList.end());
+    SparseMatrixD hessian = jacobian * jacobian.transpose();
+    return Eigen::MatrixXd(hessian).triangularView<Eigen::Lower>();
+}
+
+void checkHessian(jointcal::CompactJacobian const &jacobian, std::vector<Term> const &terms) {
+    Eigen::MatrixXd hessian(jacobian.makeHessian());
+    Eigen::MatrixXd expected = referenceHessian(terms);
+    BOOST_CHECK_EQUAL(hessian.rows(), nParTot);
+    BOOST_CHECK_SMALL((hessian - expected).cwiseAbs().maxCoeff(), 1e-12);
+}
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(test_hessian) {
+    auto terms = makeTerms();
+    jointcal::CompactJacobian jacobian(nParTot, 0);
+    for (auto const &term : terms) jacobian.addTerm(term.indices, term.jacobian);
+    BOOST_CHECK_EQUAL(jacobian.getNColumns(), 2 * terms.size());
+    BOOST_CHECK(!jacobian.hasWideRows());
+    checkHessian(jacobian, terms);
+}
+
+BOOST_AUTO_TEST_CASE(test_duplicate_rows) {
+    // the two rows of the term refer to the same parameter: one entry holds their sum.
+    jointcal::CompactJacobian jacobian(nParTot, 0);
+    Eigen::MatrixXd derivatives(3, 1);
+    derivatives << 1, 2, 4;
+    jacobian.addTerm({5, 3, 5}, derivatives);
+    BOOST_CHECK_EQUAL(jacobian.size(), 2u);
+    Eigen::MatrixXd hessian(jacobian.makeHessian());
+    BOOST_CHECK_EQUAL(hessian(5, 5), 25);
+    BOOST_CHECK_EQUAL(hessian(3, 3), 4);
+    BOOST_CHECK_EQUAL(hessian(5, 3), 10);
+}
+
+BOOST_AUTO_TEST_CASE(test_merge) {
+    // as in the threaded fill: each part is filled in a clone, and the clones are merged in order.
+    auto terms = makeTerms();
+    jointcal::CompactJacobian jacobian(nParTot, 0);
+    std::size_t nTermsPerPart = 3;
+    for (std::size_t start = 0; start < terms.size(); start += nTermsPerPart) {
+        auto part = jacobian.makeEmptyClone();
+        for (std::size_t k = start; k < std::min(start + nTermsPerPart, terms.size()); ++k) {
+            part->addTerm(terms[k].indices, terms[k].jacobian);
+        }
+        jacobian.merge(*part);
+        BOOST_CHECK_EQUAL(dynamic_cast<jointcal::CompactJacobian &>(*part).size(), 0u);
+    }
+    BOOST_CHECK_EQUAL(jacobian.getNColumns(), 2 * terms.size());
+    checkHessian(jacobian, terms);
+}
+
+BOOST_AUTO_TEST_CASE(test_wide_rows) {
+    // too many parameters for 32-bit row indices.
+    Eigen::Index nWide = Eigen::Index(std::numeric_limits<std::int32_t>::max()) + 10;
+    jointcal::CompactJacobian jacobian(nWide, 0);
+    BOOST_CHECK(jacobian.hasWideRows());
+    Eigen::MatrixXd derivatives(2, 1);
+    derivatives << 1, 2;
+    jacobian.addTerm({nWide - 1, nWide - 1}, derivatives);
+    BOOST_CHECK_EQUAL(jacobian.size(), 1u);
+    BOOST_CHECK_EQUAL(jacobian.getNColumns(), 1u);
+}
@@ -0,0 +1,917 @@
+# This file is part of jointcal.
+#
+# Developed for the LSST Data Management System.
+# This product includes software developed by the LSST Project
+# (https://www.lsst.org).
+# See the COPYRIGHT file at the top-level directory of this distribution
+# for details of code ownership.
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+"""Tests of the fitters' alternative computation modes, which must give the
+same results as the default ones.
+"""
+import itertools
+import os
+import struct
+
+import unittest
+
+import numpy as np
+
+import lsst.utils.tests
+
+import lsst.afw.table
+import lsst.afw.image
+import lsst.afw.image.utils
+import lsst.daf.persistence
+import lsst.jointcal
+from lsst.meas.algorithms import astrometrySourceSelector
+
+
+class FitterTestCase(lsst.utils.tests.TestCase):
+    @classmethod
+    def setUpClass(cls):
+        try:
+            cls.dataDir = lsst.utils.getPackageDir('testdata_jointcal')
+        except lsst.pex.exceptions.NotFoundError:
+            raise unittest.SkipTest("testdata_jointcal not setup")
+
+        # Work around the fact that the testdata_jointcal catalogs were produced
+        # before DM-13493, and so have a different definition of the interpolated flag.
+        sourceSelectorConfig = astrometrySourceSelector.AstrometrySourceSelectorConfig()
+        sourceSelectorConfig.badFlags.append("base_PixelFlags_flag_interpolated")
+        sourceSelector = astrometrySourceSelector.AstrometrySourceSelectorTask(config=sourceSelectorConfig)
+
+        lsst.afw.image.utils.resetFilters()
+        # jointcal's cfht test data has 6 ccds and 2 visits.
+        inputDir = os.path.join(cls.dataDir, 'cfht')
+        visits = [849375, 850587]
+        ccds = [12, 13, 14, 21, 22, 23]
+        butler = lsst.daf.persistence.Butler(inputDir)
+
+        # The inputs are read once: each fit gets its own associations, built from them.
+        cls.inputs = []
+        for (visit, ccd) in itertools.product(visits, ccds):
+            dataRef = butler.dataRef('calexp', visit=visit, ccd=ccd)
+
+            src = dataRef.get("src", flags=lsst.afw.table.SOURCE_IO_NO_FOOTPRINTS, immediate=True)
+            goodSrc = sourceSelector.run(src)
+            # Need memory contiguity to do vector-like things on the sourceCat.
+            goodSrc = goodSrc.sourceCat.copy(deep=True)
+
+            cls.inputs.append((goodSrc, dataRef.get('calexp_wcs'), dataRef.get('calexp_visitInfo'),
+                               dataRef.get('calexp_bbox'), dataRef.get('calexp_filter').getName(),
+                               dataRef.get('calexp_detector'), visit))
+
+    def setUp(self):
+        # Ensure that the filter list is reset for each test so that we avoid
+        # confusion or contamination each time we create a cfht camera below.
+        lsst.afw.image.utils.resetFilters()
+        self.associations = self.makeAssociations()
+
+    def makeAssociations(self, inputs=None):
+        """Build associations of the test data, or of ``inputs`` if given,
+        independent of those of any other fit: the fits move the fitted stars
+        and reject outliers in their associations.
+        """
+        matchCut = 2.0  # arcseconds
+        minMeasurements = 2  # accept all star pairs.
+
+        jointcalControl = lsst.jointcal.JointcalControl("slot_CalibFlux")
+        associations = lsst.jointcal.Associations()
+        if inputs is None:
+            inputs = self.inputs
+        for goodSrc, wcs, visitInfo, bbox, filterName, detector, visit in inputs:
+            photoCalib = lsst.afw.image.PhotoCalib(100.0, 1.0)
+            associations.createCcdImage(goodSrc, wcs, visitInfo, bbox, filterName, photoCalib,
+                                        detector, visit, detector.getId(), jointcalControl)
+
+        # Have to set the common tangent point so projectionHandler can use skyToCTP.
+        associations.computeCommonTangentPoint()
+        associations.associateCatalogs(matchCut)
+        associations.prepareFittedStars(minMeasurements)
+        associations.deprojectFittedStars()
+        return associations
+
+    def makeAstrometryFit(self, control, associations=None):
+        """Make an astrometry fit of ``associations``, by default those of
+        the test.
+        """
+        if associations is None:
+            associations = self.associations
+        projectionHandler = lsst.jointcal.OneTPPerVisitHandler(associations.getCcdImageList())
+        model = lsst.jointcal.ConstrainedAstrometryModel(associations.getCcdImageList(),
+                                                         projectionHandler,
+                                                         chipOrder=1, visitOrder=3)
+        return lsst.jointcal.AstrometryFit(associations, model, 0.02, control)
+
+    def makePhotometryFit(self, control, associations=None):
+        """Make a photometry fit of ``associations``, by default those of
+        the test.
+        """
+        if associations is None:
+            associations = self.associations
+        model = lsst.jointcal.SimpleFluxModel(associations.getCcdImageList())
+        return lsst.jointcal.PhotometryFit(associations, model, control)
+
+    def checkSameFit(self, makeFit, whatToFit, control, rtol=1e-8, outlierUpdate=None, **kwargs):
+        """Check that a fit with ``control`` gives the same chi2 as the
+        default fit, starting from identical models and stars.
+
+        Each fit gets its own associations, so that both reject the same
+        outliers. With ``nSigRejCut`` in ``kwargs`` (which are passed to
+        ``minimize``), the test fit must reject outliers, and its last
+        rejection step must update the factorization by ``outlierUpdate``
+        ("downdate" or "refactorization"), if given.
+
+        Returns the test fit, for further checks of its statistics.
+        """
+        fitDefault = makeFit(lsst.jointcal.JointcalControl(), self.makeAssociations())
+        fitTest = makeFit(control, self.makeAssociations())
+        nOutliers = 0
+        for what in whatToFit:
+            resultDefault = fitDefault.minimize(what, **kwargs)
+            resultTest = fitTest.minimize(what, **kwargs)
+            self.assertEqual(resultTest, resultDefault)
+            chi2Default = fitDefault.computeChi2()
+            chi2Test = fitTest.computeChi2()
+            self.assertFloatsAlmostEqual(chi2Test.chi2, chi2Default.chi2, rtol=rtol, msg=what)
+            self.assertEqual(chi2Test.ndof, chi2Default.ndof, msg=what)
+            default = fitDefault.getStatistics()
+            test = fitTest.getStatistics()
+            self.assertEqual(test.lastMeasurementOutliers, default.lastMeasurementOutliers, msg=what)
+            self.assertEqual(test.lastReferenceOutliers, default.lastReferenceOutliers, msg=what)
+            nOutliers += test.lastMeasurementOutliers + test.lastReferenceOutliers
+        if kwargs.get("nSigRejCut", 0) > 0:
+            self.assertGreater(nOutliers, 0)
+            if outlierUpdate is not None:
+                self.assertEqual(fitTest.getStatistics().lastOutlierUpdate, outlierUpdate)
+        return fitTest
+
+    def testSameFit(self):
+        """Each alternative computation mode, set by the control fields of an
+        entry, must give the same fit as the default one.
+        """
+        astrometry = self.makeAstrometryFit
+        photometry = self.makePhotometryFit
+        conjugateGradient = {"conjugateGradient": True, "conjugateGradientTolerance": 1e-10, "nThreads": 2}
+        # (makeFit, whatToFit, control fields, checkSameFit keyword arguments)
+        entries = [
+            (astrometry, ["DistortionsVisit", "Distortions"], {"assembleNormalEquations": True}, {}),
+            (photometry, ["Model"], {"assembleNormalEquations": True}, {}),
+            (astrometry, ["DistortionsVisit", "Distortions"], {"nThreads": 3}, {}),
+            (astrometry, ["DistortionsVisit", "Distortions"],
+             {"nThreads": 3, "assembleNormalEquations": True}, {}),
+            (photometry, ["Model"], {"nThreads": 3}, {}),
+            (photometry, ["Model"], {"ordering": "amd"}, {"rtol": 1e-6}),
+            (photometry, ["Model"], {"ordering": "natural"}, {"rtol": 1e-6}),
+            (photometry, ["Model"], {"adaptiveDowndate": True}, {"rtol": 1e-6, "nSigRejCut": 3}),
+            (astrometry, ["Distortions"], {"adaptiveDowndate": True}, {"rtol": 1e-6, "nSigRejCut": 3}),
+            (astrometry, ["Distortions", "Distortions Positions"], {"adaptiveDowndate": True},
+             {"rtol": 1e-6, "nSigRejCut": 3}),
+            (astrometry, ["DistortionsVisit", "Distortions", "Positions", "Distortions Positions"],
+             {"schurComplement": True}, {"rtol": 1e-6}),
+            (astrometry, ["Distortions", "Distortions Positions"], {"schurComplement": True, "nThreads": 3},
+             {"rtol": 1e-6, "outlierUpdate": "refactorization", "nSigRejCut": 3, "doRankUpdate": False}),
+            (astrometry, ["DistortionsVisit", "Distortions", "Distortions Positions"], conjugateGradient,
+             {"rtol": 1e-6}),
+            # the outliers are removed by recomputing the preconditioner: nothing to downdate.
+            (astrometry, ["Distortions", "Distortions Positions"], conjugateGradient,
+             {"rtol": 1e-6, "outlierUpdate": "refactorization", "nSigRejCut": 3}),
+            (photometry, ["Model", "Model Fluxes"], conjugateGradient, {"rtol": 1e-6}),
+        ]
+        if lsst.jointcal.isPartitioningAvailable():
+            for ordering in ("metis", "nesdis"):
+                entries.append((photometry, ["Model"], {"ordering": ordering}, {"rtol": 1e-6}))
+        for makeFit, whatToFit, fields, kwargs in entries:
+            with self.subTest(makeFit=makeFit.__name__, whatToFit=whatToFit, fields=fields, **kwargs):
+                control = lsst.jointcal.JointcalControl()
+                for field, value in fields.items():
+                    setattr(control, field, value)
+                self.checkSameFit(makeFit, whatToFit, control, **kwargs)
+
+    def testAssembleNormalEquationsPattern(self):
+        """Once a Hessian was assembled, the next ones for the same
+        parameters are summed into its pattern instead of stored as triplets,
+        and still give the same fit.
+        """
+        control = lsst.jointcal.JointcalControl()
+        control.assembleNormalEquations = True
+        fit = self.makeAstrometryFit(control)
+        fitTriplets = self.makeAstrometryFit(lsst.jointcal.JointcalControl(), self.makeAssociations())
+        for whatToFit in ("DistortionsVisit", "Distortions"):
+            fit.minimize(whatToFit)
+            fitTriplets.minimize(whatToFit)
+            # a new parameter layout: all entries are new.
+            firstTriplets = fit.getStatistics().lastHessianTriplets
+            self.assertGreater(firstTriplets, 0)
+            # rejecting outliers without rank update rebuilds the Hessian, with fewer entries.
+            fit.minimize(whatToFit, nSigRejCut=3, doRankUpdate=False)
+            fitTriplets.minimize(whatToFit, nSigRejCut=3, doRankUpdate=False)
+            self.assertEqual(fit.getStatistics().lastHessianTriplets, 0)
+            chi2 = fit.computeChi2()
+            expected = fitTriplets.computeChi2()
+            self.assertFloatsAlmostEqual(chi2.chi2, expected.chi2, rtol=1e-8)
+            self.assertEqual(chi2.ndof, expected.ndof)
+
+    def testRepeatedMinimize(self):
+        """Successive minimize calls reuse the symbolic factorization while
+        the Hessian pattern is unchanged or shrinks (outlier rejection without
+        rank update), and must still converge to the same solution.
+        """
+        fit = self.makeAstrometryFit(lsst.jointcal.JointcalControl())
+        fit.minimize("Distortions")
+        fit.minimize("Distortions", nSigRejCut=5, doRankUpdate=False)
+        chi2 = fit.computeChi2()
+        nSymbolicAnalyses = fit.getStatistics().nSymbolicAnalyses
+        for i in range(2):
+            result = fit.minimize("Distortions")
+            self.assertEqual(result, lsst.jointcal.MinimizeResult.Converged)
+            newChi2 = fit.computeChi2()
+            self.assertFloatsAlmostEqual(newChi2.chi2, chi2.chi2, rtol=1e-6)
+            self.assertEqual(newChi2.ndof, chi2.ndof)
+        statistics = fit.getStatistics()
+        self.assertEqual(statistics.nSymbolicAnalyses, nSymbolicAnalyses)
+        self.assertEqual(statistics.factorization, "simplicial LDLT")
+
+    def testCheckpoint(self):
+        """A fit restored from a checkpoint into freshly built associations
+        continues as the original one.
+        """
+        control = lsst.jointcal.JointcalControl()
+        fit = self.makeAstrometryFit(control)
+        fit.minimize("Distortions")
+        fit.minimize("Distortions Positions", nSigRejCut=3)
+        chi2 = fit.computeChi2()
+        with lsst.utils.tests.getTempFilePath(".bin") as path:
+            fit.saveCheckpoint(path, 2)
+            # mismatched checkpoints are rejected without modifying the fit.
+            photometryFit = self.makePhotometryFit(control)
+            photometryChi2 = photometryFit.computeChi2()
+            with self.assertRaises(lsst.pex.exceptions.LengthError):
+                photometryFit.loadCheckpoint(path)
+            self.assertEqual(photometryFit.computeChi2().chi2, photometryChi2.chi2)
+
+            resumedFit = self.makeAstrometryFit(control, self.makeAssociations())
+            self.assertEqual(resumedFit.loadCheckpoint(path), 2)
+        resumedChi2 = resumedFit.computeChi2()
+        self.assertEqual(resumedChi2.chi2, chi2.chi2)
+        self.assertEqual(resumedChi2.ndof, chi2.ndof)
+
+        fit.minimize("Distortions Positions", nSigRejCut=3)
+        resumedFit.minimize("Distortions Positions", nSigRejCut=3)
+        self.assertFloatsAlmostEqual(resumedFit.computeChi2().chi2, fit.computeChi2().chi2, rtol=1e-10)
+
+    def testCorruptedCheckpoint(self):
+        """Corrupted checkpoints are rejected without modifying the fit, and
+        without allocating from the sizes they hold.
+        """
+        fit = self.makePhotometryFit(lsst.jointcal.JointcalControl())
+        fit.minimize("Model")
+        chi2 = fit.computeChi2()
+        with lsst.utils.tests.getTempFilePath(".bin") as path:
+            fit.saveCheckpoint(path)
+            with open(path, "rb") as checkpoint:
+                data = checkpoint.read()
+            # the header is the magic (8 bytes), byte order mark and version (4 bytes each) and the step.
+            whatToFitSizeOffset = 24
+            whatToFitSize, = struct.unpack_from("=Q", data, whatToFitSizeOffset)
+            parameterSizeOffset = whatToFitSizeOffset + 8 + whatToFitSize
+            corruptions = {"truncated": (data[:-1], lsst.pex.exceptions.IoError),
+                           "whatToFit size": (data[:whatToFitSizeOffset] + struct.pack("=Q", 2**62)
+                                              + data[whatToFitSizeOffset + 8:],
+                                              lsst.pex.exceptions.IoError),
+                           "parameter count": (data[:parameterSizeOffset] + struct.pack("=Q", 2**62)
+                                               + data[parameterSizeOffset + 8:],
+                                               lsst.pex.exceptions.LengthError)}
+            for name, (corrupted, exception) in corruptions.items():
+                with self.subTest(corruption=name):
+                    with open(path, "wb") as checkpoint:
+                        checkpoint.write(corrupted)
+                    with self.assertRaises(exception):
+                        fit.loadCheckpoint(path)
+                    self.assertEqual(fit.computeChi2().chi2, chi2.chi2)
+
+    def testIterateCheckpoint(self):
+        control = lsst.jointcal.JointcalControl()
+        control.checkpointInterval = 1
+        fit = self.makePhotometryFit(control)
+        with lsst.utils.tests.getTempFilePath(".bin") as path:
+            iteration = fit.iterate("Model Fluxes", 5, 3, checkpointFile=path)
+            chi2 = fit.computeChi2()
+            resumedFit = self.makePhotometryFit(control, self.makeAssociations())
+            firstStep = resumedFit.loadCheckpoint(path)
+        self.assertEqual(firstStep, len(iteration.steps) - iteration.refit)
+        # the steps were done: the fit is already converged.
+        resumedIteration = resumedFit.iterate("Model Fluxes", firstStep + 1, 3, firstStep=firstStep)
+        self.assertEqual(resumedIteration.result, lsst.jointcal.MinimizeResult.Converged)
+        self.assertFloatsAlmostEqual(resumedFit.computeChi2().chi2, chi2.chi2, rtol=1e-8)
+
+    def testTimings(self):
+        """Each phase run by a fit or the associations records its calls
+        and resources.
+        """
+        timings = self.associations.getTimings()
+        for phase in (timings.associateCatalogs, timings.prepareFittedStars):
+            self.assertEqual(phase.nCalls, 1)
+            self.assertGreater(phase.peakResidentBytes, 0)
+        self.assertEqual(timings.collectRefStars.nCalls, 0)
+
+        fit = self.makeAstrometryFit(lsst.jointcal.JointcalControl())
+        fit.minimize("Distortions", nSigRejCut=5, doLineSearch=True)
+        timings = fit.getTimings()
+        for name in ("assignIndices", "tripletFill", "hessianBuild", "factorization", "solve", "chi2",
+                     "findOutliers", "lineSearch"):
+            with self.subTest(phase=name):
+                phase = getattr(timings, name)
+                self.assertGreater(phase.nCalls, 0)
+                self.assertGreater(phase.wallSeconds, 0)
+                self.assertGreaterEqual(phase.cpuSeconds, 0)
+                self.assertGreater(phase.peakResidentBytes, 0)
+        self.assertEqual(timings.rankUpdate.nCalls, fit.getStatistics().nDowndates)
+        # the line search evaluates the chi2 many times.
+        self.assertGreater(timings.chi2.nCalls, timings.lineSearch.nCalls)
+        # the const chi2 computations, which may run concurrently, are not timed.
+        nChi2 = timings.chi2.nCalls
+        fit.computeChi2()
+        fit.computeChi2(np.zeros(fit.getTotalParameters()))
+        self.assertEqual(fit.getTimings().chi2.nCalls, nChi2)
+
+    def testMeasurementArrays(self):
+        """The fitters loop over copies of the catalogs, which must follow
+        the outlier rejection and be rebuilt with the catalogs.
+        """
+        fit = self.makePhotometryFit(lsst.jointcal.JointcalControl())
+        fit.minimize("Model Fluxes", nSigRejCut=3)
+        self.assertGreater(fit.getStatistics().lastMeasurementOutliers, 0)
+        # A new fit copies the catalogs with their valid flags as they are now.
+        newFit = self.makePhotometryFit(lsst.jointcal.JointcalControl())
+        self.assertEqual(fit.computeChi2().chi2, newFit.computeChi2().chi2)
+
+        # Any change of the catalogs makes the copies stale, whatever the
+        # sizes of the new catalogs.
+        self.associations.associateCatalogs(2.0)
+        with self.assertRaises(lsst.pex.exceptions.LogicError):
+            fit.computeChi2()
+
+    def testProjectionCache(self):
+        """The astrometry fitter caches the projections of the fitted stars,
+        which must follow the fitted positions.
+        """
+        fit = self.makeAstrometryFit(lsst.jointcal.JointcalControl())
+        fit.minimize("Distortions")
+        chi2 = fit.computeChi2()
+        fit.minimize("Distortions Positions")
+        self.assertLess(fit.computeChi2().chi2, chi2.chi2)
+        # A new fit projects the fitted stars where they are now.
+        newFit = self.makeAstrometryFit(lsst.jointcal.JointcalControl())
+        self.assertFloatsAlmostEqual(newFit.computeChi2().chi2, fit.computeChi2().chi2, rtol=1e-12)
+
+    def checkGradientAtOffset(self, makeFit, whatToFit):
+        """The gradient at offset parameters is the one after offsetting them,
+        and computing it leaves the parameters untouched.
+        """
+        fit = makeFit(lsst.jointcal.JointcalControl())
+        fit.minimize(whatToFit)
+        rng = np.random.RandomState(100)
+        offset = 1e-4*rng.standard_normal(fit.getTotalParameters())
+        chi2 = fit.computeChi2().chi2
+        gradient = fit.computeGradient()
+        gradientAtOffset = fit.computeGradient(offset)
+        self.assertEqual(fit.computeChi2().chi2, chi2)
+        self.assertFloatsEqual(fit.computeGradient(), gradient)
+        fit.offsetParams(offset)
+        self.assertFloatsAlmostEqual(gradientAtOffset, fit.computeGradient(), rtol=1e-8, atol=1e-8)
+
+    def testGradientAtOffsetAstrometry(self):
+        self.checkGradientAtOffset(self.makeAstrometryFit, "Distortions Positions")
+
+    def testGradientAtOffsetPhotometry(self):
+        self.checkGradientAtOffset(self.makePhotometryFit, "Model Fluxes")
+
+    def testDumpMatrixFormats(self):
+        """The sparse dumps hold the same system as the dense text dump."""
+        hessians = {}
+        gradients = {}
+        with lsst.utils.tests.temporaryDirectory() as tempdir:
+            for dumpFormat in ("text", "binary", "matrixMarket"):
+                control = lsst.jointcal.JointcalControl()
+                control.dumpMatrixFormat = dumpFormat
+                fit = self.makeAstrometryFit(control)
+                base = os.path.join(tempdir, dumpFormat)
+                fit.minimize("Distortions", dumpMatrixFile=base)
+                if dumpFormat == "text":
+                    hessians[dumpFormat] = np.loadtxt(base + "-mat.txt")
+                    gradients[dumpFormat] = np.loadtxt(base + "-grad.txt")
+                elif dumpFormat == "binary":
+                    system = lsst.jointcal.readSparseSystem(base + "-system.bin", symmetric=True)
+                    hessians[dumpFormat] = system.hessian.toarray()
+                    gradients[dumpFormat] = system.gradient
+                else:
+                    import scipy.io
+                    hessians[dumpFormat] = scipy.io.mmread(base + "-mat.mtx").toarray()
+                    gradients[dumpFormat] = scipy.io.mmread(base + "-grad.mtx").ravel()
+
+        for dumpFormat in ("binary", "matrixMarket"):
+            # the text dump is written with limited precision.
+            self.assertFloatsAlmostEqual(hessians[dumpFormat], hessians["text"], rtol=1e-5, atol=1e-8)
+            self.assertFloatsAlmostEqual(gradients[dumpFormat], gradients["text"], rtol=1e-5, atol=1e-8)
+        self.assertFloatsEqual(hessians["matrixMarket"], hessians["binary"])
+        self.assertFloatsEqual(gradients["matrixMarket"], gradients["binary"])
+
+    def testCorruptedSparseSystem(self):
+        """Sparse system dumps whose header sizes, column starts or row
+        indices are invalid are rejected.
+        """
+        control = lsst.jointcal.JointcalControl()
+        control.dumpMatrixFormat = "binary"
+        fit = self.makeAstrometryFit(control)
+        with lsst.utils.tests.temporaryDirectory() as tempdir:
+            base = os.path.join(tempdir, "system")
+            fit.minimize("Distortions", dumpMatrixFile=base)
+            path = base + "-system.bin"
+            system = lsst.jointcal.readSparseSystem(path)
+            with open(path, "rb") as infile:
+                data = infile.read()
+            # the column starts follow the 56 byte header, and are followed by the row indices.
+            nCols = system.hessian.shape[1]
+            columnStartsOffset = 56
+            rowsOffset = columnStartsOffset + 8*(nCols + 1)
+
+            def replace(offset, value):
+                return data[:offset] + struct.pack("=q", value) + data[offset + 8:]
+
+            corruptions = {"decreasing column starts": replace(columnStartsOffset + 8, system.hessian.nnz),
+                           "last column start": replace(rowsOffset - 8, system.hessian.nnz - 1),
+                           "row index": replace(rowsOffset, system.hessian.shape[0]),
+                           "huge nRows": replace(24, 2**62),
+                           "huge nCols": replace(32, 2**62),
+                           "huge nNonZeros": replace(40, 2**62),
+                           "negative nGradient": replace(48, -1),
+                           "size mismatch": replace(40, system.hessian.nnz + 1),
+                           "truncated": data[:-8]}
+            for name, corrupted in corruptions.items():
+                with self.subTest(corruption=name):
+                    with open(path, "wb") as outfile:
+                        outfile.write(corrupted)
+                    with self.assertRaises(RuntimeError):
+                        lsst.jointcal.readSparseSystem(path)
+
+    def testCovariances(self):
+        """The selected inverse of the factorized Hessian must match blocks of
+        its dense inverse, for every solver.
+        """
+        controls = {"simplicial": lsst.jointcal.JointcalControl()}
+        controls["schurComplement"] = lsst.jointcal.JointcalControl()
+        controls["schurComplement"].schurComplement = True
+        whatToFit = "Distortions Positions"
+        for name, control in controls.items():
+            with self.subTest(name=name), lsst.utils.tests.temporaryDirectory() as tempdir:
+                control.dumpMatrixFormat = "binary"
+                fit = self.makeAstrometryFit(control)
+                fit.minimize(whatToFit)
+                nPar = fit.getTotalParameters()
+                # a mapping, the last star, and a block that is not coupled in the Hessian.
+                blocks = [list(range(6)), [nPar - 2, nPar - 1], [0, nPar - 1]]
+                covariances = fit.computeCovarianceBlocks(blocks)
+                parameterCovariances = fit.computeParameterCovariances()
+
+                # The dump is written before the step, at the parameters the covariances are computed for.
+                base = os.path.join(tempdir, name)
+                fit.minimize(whatToFit, dumpMatrixFile=base)
+                system = lsst.jointcal.readSparseSystem(base + "-system.bin", symmetric=True)
+                inverse = np.linalg.inv(system.hessian.toarray())
+                for block, covariance in zip(blocks, covariances):
+                    self.assertFloatsAlmostEqual(covariance, inverse[np.ix_(block, block)], rtol=1e-6,
+                                                 atol=1e-14)
+
+                self.assertEqual(len(parameterCovariances.mappings),
+                                 len(self.associations.getCcdImageList()))
+                for covariance in parameterCovariances.mappings:
+                    self.assertGreater(covariance.shape[0], 0)
+                    self.assertFloatsEqual(covariance, covariance.T)
+                for covariance in parameterCovariances.fittedStars:
+                    self.assertEqual(covariance.shape, (2, 2))
+                    self.assertTrue(np.all(np.diag(covariance) > 0))
+                # the FittedStars are the last fitted parameters.
+                self.assertFloatsAlmostEqual(parameterCovariances.fittedStars[-1], covariances[1], rtol=1e-10)
+
+                with self.assertRaises(lsst.pex.exceptions.InvalidParameterError):
+                    fit.computeCovarianceBlocks([[nPar]])
+
+    def testIterate(self):
+        """iterate() must reach the same fit as the equivalent sequence of
+        minimize calls, with the final refit done by default.
+        """
+        control = lsst.jointcal.JointcalControl()
+        self.assertEqual(control.refitTolerance, 0)
+        fitMinimize = self.makeAstrometryFit(control)
+        fitIterate = self.makeAstrometryFit(control, self.makeAssociations())
+        for fit in (fitMinimize, fitIterate):
+            fit.minimize("Distortions")
+        nSteps = 0
+        refit = False
+        for i in range(10):
+            nDowndates = fitMinimize.getStatistics().nDowndates
+            result = fitMinimize.minimize("Distortions", nSigRejCut=3)
+            nSteps += 1
+            if (result == lsst.jointcal.MinimizeResult.Converged
+                    and fitMinimize.getStatistics().nDowndates > nDowndates):
+                # the refit may reject outliers again, and then be retried.
+                refit = True
+                result = fitMinimize.minimize("Distortions", nSigRejCut=3)
+                nSteps += 1
+            if result != lsst.jointcal.MinimizeResult.Chi2Increased:
+                break
+        iteration = fitIterate.iterate("Distortions", 10, nSigRejCut=3)
+        self.assertEqual(iteration.result, result)
+        self.assertEqual(len(iteration.steps), nSteps)
+        self.assertEqual(iteration.refit, refit)
+        chi2 = fitMinimize.computeChi2()
+        self.assertFloatsAlmostEqual(iteration.chi2.chi2, chi2.chi2, rtol=1e-8)
+        self.assertEqual(iteration.chi2.ndof, chi2.ndof)
+        self.assertEqual(iteration.steps[-1].chi2.chi2, iteration.chi2.chi2)
+        nOutliers = sum(step.nMeasurementOutliers + step.nReferenceOutliers for step in iteration.steps)
+        self.assertGreater(nOutliers, 0)
+
+        # With a loose tolerance, the final refit is skipped.
+        control.refitTolerance = 1
+        fit = self.makeAstrometryFit(control)
+        fit.minimize("Distortions")
+        iteration = fit.iterate("Distortions", 10, nSigRejCut=3)
+        self.assertFalse(iteration.refit)
+
+    def testOrdering(self):
+        for ordering in ("amd", "natural"):
+            with self.subTest(ordering=ordering):
+                control = lsst.jointcal.JointcalControl()
+                control.ordering = ordering
+                fit = self.makePhotometryFit(control)
+                fit.minimize("Model")
+                self.assertEqual(fit.getStatistics().ordering, ordering)
+                self.assertGreater(fit.getStatistics().factorNonZeros, 0)
+                self.assertGreater(fit.getStatistics().factorizationFlops, 0)
+
+    def testPartitioningOrdering(self):
+        """Without partitioning, the orderings that need it are rejected (see
+        testSameFit otherwise).
+        """
+        if lsst.jointcal.isPartitioningAvailable():
+            raise unittest.SkipTest("the partitioning orderings are available")
+        for ordering in ("metis", "nesdis"):
+            with self.subTest(ordering=ordering):
+                control = lsst.jointcal.JointcalControl()
+                control.ordering = ordering
+                with self.assertRaises(lsst.pex.exceptions.InvalidParameterError):
+                    self.makePhotometryFit(control)
+
+    def testOrderingCache(self):
+        """A second fit of the same problem with the same ordering reads it
+        from the cache, in a file named after that ordering.
+        """
+        for ordering in ("default", "amd", "natural"):
+            with self.subTest(ordering=ordering), lsst.utils.tests.temporaryDirectory() as tempdir:
+                control = lsst.jointcal.JointcalControl()
+                control.ordering = ordering
+                control.orderingCacheDir = tempdir
+                chi2s = []
+                for nCached in (0, 1):
+                    fit = self.makePhotometryFit(control, self.makeAssociations())
+                    fit.minimize("Model")
+                    self.assertEqual(fit.getStatistics().nCachedOrderings, nCached)
+                    if nCached > 0:
+                        self.assertEqual(fit.getStatistics().ordering, "cached")
+                    chi2s.append(fit.computeChi2().chi2)
+                self.assertEqual(len(os.listdir(tempdir)), 1)
+                self.assertTrue(os.listdir(tempdir)[0].startswith("ordering-%s-" % ordering))
+                self.assertFloatsAlmostEqual(chi2s[0], chi2s[1], rtol=1e-10)
+
+                # another ordering does not read this one.
+                control.ordering = "natural" if ordering == "amd" else "amd"
+                fit = self.makePhotometryFit(control, self.makeAssociations())
+                fit.minimize("Model")
+                self.assertEqual(fit.getStatistics().nCachedOrderings, 0)
+                self.assertEqual(fit.getStatistics().ordering, control.ordering)
+                self.assertEqual(len(os.listdir(tempdir)), 2)
+
+    def testAdaptiveDowndate(self):
+        """Each rejection step downdates exactly when the predicted downdate
+        time is below the refactorization time it was compared to.
+        """
+        for whatToFit in ("Distortions", "Distortions Positions"):
+            with self.subTest(whatToFit=whatToFit):
+                control = lsst.jointcal.JointcalControl()
+                control.adaptiveDowndate = True
+                fit = self.makeAstrometryFit(control, self.makeAssociations())
+                fit.minimize(whatToFit)
+                for i in range(3):
+                    fit.minimize(whatToFit, nSigRejCut=3)
+                    statistics = fit.getStatistics()
+                    if statistics.lastMeasurementOutliers + statistics.lastReferenceOutliers == 0:
+                        break
+                    self.assertGreater(statistics.lastPredictedDowndateSeconds, 0)
+                    self.assertGreater(statistics.lastComparedRefactorizationSeconds, 0)
+                    downdate = (statistics.lastPredictedDowndateSeconds
+                                < statistics.lastComparedRefactorizationSeconds)
+                    self.assertEqual(statistics.lastOutlierUpdate,
+                                     "downdate" if downdate else "refactorization")
+                    if downdate:
+                        self.assertEqual(statistics.lastDowndateRank, statistics.lastOutlierRank)
+                self.assertGreater(statistics.nDowndates + statistics.nOutlierRefactorizations, 0)
+
+        # Otherwise, every rejection step downdates, without any prediction.
+        fit = self.makeAstrometryFit(lsst.jointcal.JointcalControl())
+        fit.minimize("Distortions")
+        fit.minimize("Distortions", nSigRejCut=3)
+        statistics = fit.getStatistics()
+        self.assertGreater(statistics.nDowndates, 0)
+        self.assertEqual(statistics.nOutlierRefactorizations, 0)
+        self.assertEqual(statistics.lastOutlierUpdate, "downdate")
+        self.assertEqual(statistics.lastPredictedDowndateSeconds, 0)
+
+    def testSchurComplement(self):
+        """Only the distortion parameters are left in the reduced system, which
+        is refactorized to reject outliers without rank update.
+        """
+        control = lsst.jointcal.JointcalControl()
+        control.schurComplement = True
+        control.nThreads = 3
+        fit = self.makeAstrometryFit(control)
+        fit.minimize("Distortions")
+        nDistortions = fit.getStatistics().nReducedParameters
+        fit.minimize("Distortions Positions", nSigRejCut=3, doRankUpdate=False)
+        statistics = fit.getStatistics()
+        self.assertEqual(statistics.nReducedParameters, nDistortions)
+        self.assertTrue(statistics.factorization.startswith("Schur complement"))
+        self.assertEqual(statistics.nDowndates, 0)
+
+    def testConjugateGradient(self):
+        """The conjugate gradient solver converges to the requested tolerance,
+        without any numeric factorization.
+        """
+        control = lsst.jointcal.JointcalControl()
+        control.conjugateGradient = True
+        control.conjugateGradientTolerance = 1e-10
+        control.nThreads = 2
+        fit = self.makeAstrometryFit(control)
+        for whatToFit in ("DistortionsVisit", "Distortions", "Distortions Positions"):
+            fit.minimize(whatToFit)
+        statistics = fit.getStatistics()
+        self.assertGreater(statistics.lastConjugateGradientIterations, 0)
+        self.assertLessEqual(statistics.lastConjugateGradientResidual, control.conjugateGradientTolerance)
+        self.assertEqual(statistics.nNumericFactorizations, 0)
+
+    def testConjugateGradientMaxIterations(self):
+        """Stopping early gives a worse, but still finite, solution."""
+        control = lsst.jointcal.JointcalControl()
+        control.conjugateGradient = True
+        control.conjugateGradientMaxIterations = 2
+        fit = self.makeAstrometryFit(control)
+        fit.minimize("Distortions")
+        statistics = fit.getStatistics()
+        self.assertEqual(statistics.lastConjugateGradientIterations, 2)
+        self.assertGreater(statistics.lastConjugateGradientResidual, control.conjugateGradientTolerance)
+        self.assertTrue(np.isfinite(fit.computeChi2().chi2))
+
+    def checkModelLineSearch(self, makeFit, whatToFit, lineSearchWolfe):
+        """The model line search must reach about the same chi2 as the brent
+        one, with at most lineSearchMaxEvaluations chi2 evaluations per line
+        search.
+        """
+        control = lsst.jointcal.JointcalControl()
+        control.lineSearchMethod = "model"
+        control.lineSearchWolfe = lineSearchWolfe
+        fitBrent = makeFit(lsst.jointcal.JointcalControl())
+        fitModel = makeFit(control)
+        for what in whatToFit:
+            fitBrent.minimize(what, doLineSearch=True)
+            fitModel.minimize(what, doLineSearch=True)
+            chi2Brent = fitBrent.computeChi2()
+            chi2Model = fitModel.computeChi2()
+            self.assertLessEqual(chi2Model.chi2, chi2Brent.chi2*(1 + 1e-4), msg=what)
+        statistics = fitModel.getStatistics()
+        self.assertEqual(statistics.nLineSearches, len(whatToFit))
+        self.assertLessEqual(statistics.nLineSearchChi2Evaluations,
+                             control.lineSearchMaxEvaluations*statistics.nLineSearches)
+        self.assertLess(statistics.nLineSearchChi2Evaluations,
+                        fitBrent.getStatistics().nLineSearchChi2Evaluations)
+        if lineSearchWolfe == 0:
+            self.assertEqual(statistics.nLineSearchGradientEvaluations, 0)
+
+    def testModelLineSearchAstrometry(self):
+        self.checkModelLineSearch(self.makeAstrometryFit, ["DistortionsVisit", "Distortions"], 0)
+        self.checkModelLineSearch(self.makeAstrometryFit, ["DistortionsVisit", "Distortions"], 0.5)
+
+    def testModelLineSearchPhotometry(self):
+        self.checkModelLineSearch(self.makePhotometryFit, ["Model", "Fluxes"], 0)
+        self.checkModelLineSearch(self.makePhotometryFit, ["Model", "Fluxes"], 0.5)
+
+    def testLevenbergMarquardt(self):
+        """Damped steps never increase the chi2, and converge to the
+        Gauss-Newton solution of a linear fit.
+        """
+        control = lsst.jointcal.JointcalControl()
+        control.levenbergMarquardt = True
+        fit = self.makeAstrometryFit(control)
+        chi2 = fit.computeChi2().chi2
+        for i in range(5):
+            fit.minimize("Distortions")
+            newChi2 = fit.computeChi2().chi2
+            self.assertLessEqual(newChi2, chi2)
+            chi2 = newChi2
+        fitDefault = self.makeAstrometryFit(lsst.jointcal.JointcalControl())
+        fitDefault.minimize("Distortions")
+        self.assertFloatsAlmostEqual(chi2, fitDefault.computeChi2().chi2, rtol=1e-6)
+        statistics = fit.getStatistics()
+        self.assertGreaterEqual(statistics.nDampedSteps, 5)
+        self.assertGreater(statistics.lastDampingFactor, 0)
+        # the damping is only changed numerically, so the symbolic analysis is done once.
+        self.assertEqual(statistics.nSymbolicAnalyses, 1)
+
+        # with outlier rejection, the undamped Hessian follows the rank updates.
+        fit = self.makePhotometryFit(control)
+        result = fit.minimize("Model", nSigRejCut=3)
+        self.assertEqual(result, lsst.jointcal.MinimizeResult.Converged)
+        self.assertGreater(fit.getStatistics().nDampedSteps, 1)
+
+    def testLevenbergMarquardtRejectedStep(self):
+        """A step that would increase the chi2 is rejected.
+
+        The photometry errors scale with the flux scales, which the quadratic
+        model of the chi2 ignores: the fixed point of the undamped steps is
+        not the minimum of the chi2. Moving the converged scales towards that
+        minimum makes the next step go back, increasing the chi2.
+        """
+        control = lsst.jointcal.JointcalControl()
+        control.levenbergMarquardt = True
+        fit = self.makePhotometryFit(control)
+        for i in range(10):
+            fit.minimize("Model")
+        chi2 = fit.computeChi2().chi2
+        offset = None
+        for size, sign in itertools.product(10.0**np.arange(2, -9, -1), (1, -1)):
+            trial = np.full(fit.getTotalParameters(), sign*size)
+            if fit.computeChi2(trial).chi2 < chi2:
+                offset = trial
+                break
+        self.assertIsNotNone(offset)
+        fit.offsetParams(offset)
+        chi2 = fit.computeChi2().chi2
+        nRejected = fit.getStatistics().nRejectedDampedSteps
+        fit.minimize("Model")
+        self.assertGreater(fit.getStatistics().nRejectedDampedSteps, nRejected)
+        self.assertLessEqual(fit.computeChi2().chi2, chi2)
+
+    def testRobustLoss(self):
+        """Reweighted steps never increase the robust chi2 of a linear fit,
+        and outliers beyond a hard cut are removed in a single pass.
+        """
+        chi2Default = self.makePhotometryFit(lsst.jointcal.JointcalControl()).computeChi2()
+        for loss in ("huber", "cauchy", "tukey"):
+            with self.subTest(loss=loss):
+                control = lsst.jointcal.JointcalControl()
+                control.robustLoss = loss
+                fit = self.makePhotometryFit(control)
+                chi2 = fit.computeChi2()
+                # the loss is at most the chi2, term by term.
+                self.assertLessEqual(chi2.chi2, chi2Default.chi2)
+                self.assertEqual(chi2.ndof, chi2Default.ndof)
+                for i in range(5):
+                    fit.minimize("Model")
+                    newChi2 = fit.computeChi2()
+                    self.assertLessEqual(newChi2.chi2, chi2.chi2*(1 + 1e-10))
+                    chi2 = newChi2
+
+                iteration = fit.iterate("Model Fluxes", 10, nSigRejCut=5)
+                self.assertEqual(iteration.result, lsst.jointcal.MinimizeResult.Converged)
+                # the outliers are never downdated: their weights changed with the step.
+                self.assertEqual(fit.getStatistics().nDowndates, 0)
+
+        # a hard cut on a strong loss can neither reject all the terms of a
+        # star, nor give them all zero weight: the Hessian remains regular.
+        control = lsst.jointcal.JointcalControl()
+        control.robustLoss = "tukey"
+        control.robustLossScale = 1
+        fit = self.makePhotometryFit(control)
+        result = fit.minimize("Model Fluxes", nSigRejCut=2)
+        self.assertNotEqual(result, lsst.jointcal.MinimizeResult.Failed)
+        self.assertGreater(fit.getStatistics().lastMeasurementOutliers, 0)
+        self.assertTrue(np.isfinite(fit.computeChi2().chi2))
+
+        control = lsst.jointcal.JointcalControl()
+        control.robustLoss = "bad"
+        with self.assertRaises(lsst.pex.exceptions.InvalidParameterError):
+            self.makePhotometryFit(control)
+
+    def testRobustLossOutliers(self):
+        """A robust loss down-weights injected outliers: they pull the flux
+        scale of their ccd much less than in a least squares fit.
+        """
+        fluxKey = "slot_CalibFlux_instFlux"
+        corrupted = self.inputs[0][0].copy(deep=True)
+        for record in itertools.islice(corrupted, 0, None, 10):
+            record.set(fluxKey, 10*record.get(fluxKey))
+        corruptedInputs = [(corrupted,) + self.inputs[0][1:]] + self.inputs[1:]
+        shifts = {}
+        for loss in ("none", "cauchy"):
+            control = lsst.jointcal.JointcalControl()
+            control.robustLoss = loss
+            calibrations = []
+            for inputs in (self.inputs, corruptedInputs):
+                associations = self.makeAssociations(inputs)
+                model = lsst.jointcal.SimpleFluxModel(associations.getCcdImageList())
+                fit = lsst.jointcal.PhotometryFit(associations, model, control)
+                for i in range(5):
+                    fit.minimize("Model")
+                ccdImage = associations.getCcdImageList()[0]
+                calibrations.append(model.toPhotoCalib(ccdImage).getCalibrationMean())
+            shifts[loss] = abs(calibrations[1]/calibrations[0] - 1)
+        self.assertGreater(shifts["none"], 0)
+        self.assertLess(shifts["cauchy"], shifts["none"]/2)
+
+    def testInvalidControl(self):
+        """The fitters validate the control fields set after its
+        construction.
+        """
+        invalid = {"ordering": {"ordering": "bad"},
+                   "nThreads": {"nThreads": -1},
+                   "levenbergMarquardt": {"levenbergMarquardt": True, "conjugateGradient": True},
+                   "conjugateGradientTolerance": {"conjugateGradientTolerance": 0},
+                   "lineSearchArmijo": {"lineSearchArmijo": 2},
+                   "robustLossScale": {"robustLossScale": -1}}
+        for name, fields in invalid.items():
+            for makeFit in (self.makeAstrometryFit, self.makePhotometryFit):
+                with self.subTest(name=name, makeFit=makeFit.__name__):
+                    control = lsst.jointcal.JointcalControl()
+                    for field, value in fields.items():
+                        setattr(control, field, value)
+                    with self.assertRaises(lsst.pex.exceptions.InvalidParameterError):
+                        makeFit(control)
+
+    def checkChi2ThreadIndependent(self, makeFit):
+        """The chi2 must be bit-identical for any number of threads."""
+        chi2s = []
+        for nThreads in (1, 2, 5):
+            control = lsst.jointcal.JointcalControl()
+            control.nThreads = nThreads
+            chi2 = makeFit(control).computeChi2()
+            chi2s.append((chi2.chi2, chi2.ndof))
+        self.assertEqual(chi2s[1], chi2s[0])
+        self.assertEqual(chi2s[2], chi2s[0])
+
+    def testChi2ThreadIndependentAstrometry(self):
+        self.checkChi2ThreadIndependent(self.makeAstrometryFit)
+
+    def testChi2ThreadIndependentPhotometry(self):
+        self.checkChi2ThreadIndependent(self.makePhotometryFit)
+
+    def checkChi2AtOffset(self, makeFit, whatToFit):
+        """computeChi2(offset) must give the chi2 of the offset parameters,
+        without modifying the fit."""
+        fit = makeFit(lsst.jointcal.JointcalControl())
+        fit.minimize(whatToFit)
+        chi2 = fit.computeChi2()
+        rng = np.random.RandomState(100)
+        offset = 1e-5 * rng.standard_normal(fit.getTotalParameters())
+        chi2Offset = fit.computeChi2(offset)
+        self.assertNotEqual(chi2Offset.chi2, chi2.chi2)
+        self.assertEqual(fit.computeChi2().chi2, chi2.chi2)
+
+        fit.offsetParams(offset)
+        chi2Expect = fit.computeChi2()
+        self.assertFloatsAlmostEqual(chi2Offset.chi2, chi2Expect.chi2, rtol=1e-12)
+        self.assertEqual(chi2Offset.ndof, chi2Expect.ndof)
+
+        with self.assertRaises(lsst.pex.exceptions.InvalidParameterError):
+            fit.computeChi2(offset[1:])
+
+    def testChi2AtOffsetAstrometry(self):
+        self.checkChi2AtOffset(self.makeAstrometryFit, "Distortions Positions")
+
+    def testChi2AtOffsetPhotometry(self):
+        self.checkChi2AtOffset(self.makePhotometryFit, "Model Fluxes")
+
+
+class MemoryTester(lsst.utils.tests.MemoryTestCase):
+    pass
+
+
+def setup_module(module):
+    lsst.utils.tests.init()
+
+
+if __name__ == "__main__":
+    lsst.utils.tests.init()
+    unittest.main()
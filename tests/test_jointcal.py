@@ -19,6 +19,7 @@
 # You should have received a copy of the GNU General Public License
 # along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
+import types
 import unittest
 from unittest import mock
 
@@ -101,10 +102,36 @@ class TestJointcalIterateFit(JointcalTestBase, lsst.utils.tests.TestCase):
         self.fitter = mock.Mock(spec=lsst.jointcal.PhotometryFit)
         self.fitter.computeChi2.return_value = self.goodChi2
         self.fitter.minimize.return_value = MinimizeResult.Converged
+        self.fitter.iterate.side_effect = self.iterate
         self.model = mock.Mock(spec=lsst.jointcal.SimpleFluxModel)
 
         self.jointcal = lsst.jointcal.JointcalTask(config=self.config, butler=self.butler)
 
+    def iterate(self, whatToFit, maxSteps, nSigmaCut=0, doRankUpdate=True, doLineSearch=False,
+                dumpMatrixFile="", saveChi2BaseName="", checkpointFile="", firstStep=0):
+        """Mimic FitterBase.iterate with the mocked minimize, as if every
+        converged step had downdated the factorization and needed a refit.
+        """
+        iteration = types.SimpleNamespace(steps=[], refit=False, refitPredictedDecrease=np.nan)
+
+        def runStep():
+            iteration.result = self.fitter.minimize(whatToFit, nSigmaCut, doRankUpdate, doLineSearch)
+            iteration.chi2 = self.fitter.computeChi2()
+            iteration.steps.append(types.SimpleNamespace(result=iteration.result, chi2=iteration.chi2,
+                                                         nMeasurementOutliers=0, nReferenceOutliers=0,
+                                                         seconds=0))
+            if saveChi2BaseName:
+                self.fitter.saveChi2Contributions(saveChi2BaseName)
+
+        for step in range(firstStep, maxSteps):
+            runStep()
+            if iteration.result == MinimizeResult.Converged and doRankUpdate:
+                iteration.refit = True
+                runStep()
+            if iteration.result != MinimizeResult.Chi2Increased:
+                break
+        return iteration
+
     def test_iterateFit_success(self):
         chi2 = self.jointcal._iterate_fit(self.associations, self.fitter,
                                           self.maxSteps, self.name, self.whatToFit)
@@ -151,7 +178,9 @@ class TestJointcalIterateFit(JointcalTestBase, lsst.utils.tests.TestCase):
                                           maxSteps, self.name, self.whatToFit)
         self.assertEqual(chi2, self.goodChi2)
         self.assertEqual(self.fitter.minimize.call_count, maxSteps)
-        log.error.assert_called_with("testing failed to converge after %s steps" % maxSteps)
+        log.error.assert_called_with("%s failed to converge after %d steps", "testing", maxSteps)
+        # iterate() warns about each retry: _iterate_fit does not repeat it.
+        log.warn.assert_not_called()
 
     def test_invalid_model(self):
         self.model.validate.return_value = False